@@ -0,0 +1,142 @@
+/*
+ * crc_driver.h
+ *
+ * Header file for crc_driver.c
+ * Contains functions for the CRC calculation unit, with resumable (incremental) checksums over many chunks
+ *
+ * The hardware only does one thing: CRC-32 polynomial 0x04C11DB7, initial value 0xFFFFFFFF, fed 32 bits
+ * at a time MSB first, no reflection and no final XOR. Two modes are built on top of it:
+ *
+ * - CRC_MODE_STANDARD: the "normal" CRC-32 (zlib, Ethernet, PNG, `crc32` in Python...) over any number of bytes.
+ *   Each word is bit reversed before it's fed in and the result is bit reversed and inverted, which turns the
+ *   hardware's MSB first CRC into the reflected one. Trailing bytes (len % 4) are done in software
+ * - CRC_MODE_NATIVE: exactly what the hardware computes over little endian words (= CRC-32/MPEG-2 on the
+ *   byte-swapped words). Lengths must be a multiple of 4. This is the only mode the DMA can feed, as the
+ *   DMA can't bit reverse the data on its way in
+ *
+ * The F446 CRC unit has no writable initial value register, so the driver restores an arbitrary running value
+ * by resetting the unit and feeding it the one word that produces that value (see restore_state()).
+ * That is what lets several contexts interleave, or a checksum resume after other code has used the unit.
+ * The restore is skipped when the unit already holds the right value
+ *
+ *  Written by Ryan Wong
+ */
+
+#ifndef CRC_DRIVER_H_
+#define CRC_DRIVER_H_
+
+#include <stdint.h>
+#include "drivers/types.h"
+
+
+// REGISTERS ==============================================================
+#define CRC_BASE 0x40023000U
+#define CRC ((CRC_Reg_TypeDef*)CRC_BASE)
+
+typedef struct {
+    volatile uint32_t DR;
+    volatile uint32_t IDR;
+    volatile uint32_t CR;
+} CRC_Reg_TypeDef;
+
+#define CRC_POLY 0x04C11DB7U
+#define CRC_POLY_REFLECTED 0xEDB88320U
+#define CRC_INIT 0xFFFFFFFFU
+
+
+// CRC Config Types ==============================================================
+typedef enum {
+    CRC_MODE_STANDARD = 0x00U,
+    CRC_MODE_NATIVE = 0x01U
+} CRC_Mode;
+
+/**
+ * Running checksum, one per stream of data. Don't modify the fields directly
+ *
+ * mode - standard or native
+ * state - running CRC register value (bit reversed for standard mode)
+ * dma_busy - 1 while a DMA transfer started with CRC_update_dma() is still running
+ * failed - 1 once a DMA update hit a transfer error, the checksum is lost until CRC_begin()
+ */
+typedef struct {
+    CRC_Mode mode;
+    uint32_t state;
+    volatile uint8_t dma_busy;
+    uint8_t failed;
+} CRC_Context;
+
+typedef enum {
+    CRC_DMA_IDLE = 0x00U, // finished (or nothing started), the running value is in the context
+    CRC_DMA_BUSY = 0x01U,
+    CRC_DMA_ERROR = 0x02U // transfer error, the context is marked failed
+} CRC_DMA_State;
+
+
+// HAL FUNCTIONS ==============================================================
+/**
+ * @brief enables the AHB1 peripheral clock for the CRC unit (and DMA2, used by CRC_update_dma())
+ *
+ * @return HAL_Status
+ */
+HAL_Status CRC_enable_clock(void);
+
+/**
+ * @brief Starts a new checksum
+ *
+ * @param ctx - context to initialise
+ * @param mode - standard or native
+ * @return HAL_Status
+ */
+HAL_Status CRC_begin(CRC_Context* ctx, CRC_Mode mode);
+
+/**
+ * @brief Feeds the next chunk of data with the CPU, one word per bus write. Chunks can be any size
+ * 		  in standard mode and don't need to be aligned. In native mode len must be a multiple of 4
+ *
+ * @param ctx - running checksum
+ * @param data - next chunk
+ * @param len - chunk length in bytes
+ * @return HAL_Status - HAL_ERROR if a DMA update is still running on this or another context
+ */
+HAL_Status CRC_update(CRC_Context* ctx, const void* data, uint32_t len);
+
+/**
+ * @brief Starts feeding the next chunk with DMA2 stream 1 and returns straight away (native mode only).
+ * 		  The CPU and the unit must not be used for other checksums until CRC_dma_poll() reports done
+ *
+ * @param ctx - running checksum (native mode)
+ * @param data - next chunk, word aligned
+ * @param len - chunk length in bytes, multiple of 4, up to 4 * 65535
+ * @return HAL_Status - HAL_OK or HAL_ERROR
+ */
+HAL_Status CRC_update_dma(CRC_Context* ctx, const void* data, uint32_t len);
+
+/**
+ * @brief Checks whether the DMA update has finished, and if so saves the running value into the context.
+ * 		  A transfer error leaves part of the chunk unchecked, so the context is marked failed instead: it keeps
+ * 		  reporting ERROR, and CRC_update(), CRC_update_dma() and CRC_finish() refuse it until CRC_begin()
+ *
+ * @param ctx
+ * @return CRC_DMA_State - IDLE once no DMA update is running on this context
+ */
+CRC_DMA_State CRC_dma_poll(CRC_Context* ctx);
+
+/**
+ * @brief Returns the final checksum. The context isn't modified, so more data can still be added afterwards
+ *
+ * @param ctx
+ * @return uint32_t - CRC (0 if a DMA update on this context failed)
+ */
+uint32_t CRC_finish(const CRC_Context* ctx);
+
+/**
+ * @brief One shot begin/update/finish
+ *
+ * @param mode - standard or native
+ * @param data
+ * @param len - in bytes (multiple of 4 in native mode)
+ * @return uint32_t - CRC (0 on invalid arguments)
+ */
+uint32_t CRC_compute(CRC_Mode mode, const void* data, uint32_t len);
+
+#endif
@@ -0,0 +1,213 @@
+/*
+ * dma_driver.h
+ *
+ * Header file for dma_driver.c
+ * Contains function prototypes, register struct definitions, macros for the DMA1/DMA2 stream controllers
+ *
+ *  Written by Ryan Wong
+ */
+
+#ifndef DMA_DRIVER_H_
+#define DMA_DRIVER_H_
+
+#include <stdint.h>
+#include "drivers/types.h"
+
+
+// REGISTERS ==============================================================
+#define DMA1_BASE 0x40026000U
+#define DMA2_BASE 0x40026400U
+#define DMA1 ((DMA_Reg_TypeDef*)DMA1_BASE)
+#define DMA2 ((DMA_Reg_TypeDef*)DMA2_BASE)
+
+// Streams are 0x18 spaced starting 0x10 after their controller's base
+#define DMA1_STREAM0 ((DMA_Stream_TypeDef*)(DMA1_BASE + 0x10U))
+#define DMA1_STREAM1 ((DMA_Stream_TypeDef*)(DMA1_BASE + 0x28U))
+#define DMA1_STREAM2 ((DMA_Stream_TypeDef*)(DMA1_BASE + 0x40U))
+#define DMA1_STREAM3 ((DMA_Stream_TypeDef*)(DMA1_BASE + 0x58U))
+#define DMA1_STREAM4 ((DMA_Stream_TypeDef*)(DMA1_BASE + 0x70U))
+#define DMA1_STREAM5 ((DMA_Stream_TypeDef*)(DMA1_BASE + 0x88U))
+#define DMA1_STREAM6 ((DMA_Stream_TypeDef*)(DMA1_BASE + 0xA0U))
+#define DMA1_STREAM7 ((DMA_Stream_TypeDef*)(DMA1_BASE + 0xB8U))
+#define DMA2_STREAM0 ((DMA_Stream_TypeDef*)(DMA2_BASE + 0x10U))
+#define DMA2_STREAM1 ((DMA_Stream_TypeDef*)(DMA2_BASE + 0x28U))
+#define DMA2_STREAM2 ((DMA_Stream_TypeDef*)(DMA2_BASE + 0x40U))
+#define DMA2_STREAM3 ((DMA_Stream_TypeDef*)(DMA2_BASE + 0x58U))
+#define DMA2_STREAM4 ((DMA_Stream_TypeDef*)(DMA2_BASE + 0x70U))
+#define DMA2_STREAM5 ((DMA_Stream_TypeDef*)(DMA2_BASE + 0x88U))
+#define DMA2_STREAM6 ((DMA_Stream_TypeDef*)(DMA2_BASE + 0xA0U))
+#define DMA2_STREAM7 ((DMA_Stream_TypeDef*)(DMA2_BASE + 0xB8U))
+
+typedef struct {
+    volatile uint32_t LISR;
+    volatile uint32_t HISR;
+    volatile uint32_t LIFCR;
+    volatile uint32_t HIFCR;
+} DMA_Reg_TypeDef;
+
+typedef struct {
+    volatile uint32_t CR;
+    volatile uint32_t NDTR;
+    volatile uint32_t PAR;
+    volatile uint32_t M0AR;
+    volatile uint32_t M1AR;
+    volatile uint32_t FCR;
+} DMA_Stream_TypeDef;
+
+// Per-stream status flags, as returned by DMA_get_flags() (same layout as each stream's field in LISR/HISR)
+#define DMA_FLAG_FE (0x01U << 0) // FIFO error
+#define DMA_FLAG_DME (0x01U << 2) // Direct mode error
+#define DMA_FLAG_TE (0x01U << 3) // Transfer error
+#define DMA_FLAG_HT (0x01U << 4) // Half transfer
+#define DMA_FLAG_TC (0x01U << 5) // Transfer complete
+#define DMA_FLAG_ALL (DMA_FLAG_FE | DMA_FLAG_DME | DMA_FLAG_TE | DMA_FLAG_HT | DMA_FLAG_TC)
+
+
+// DMA Config Types ==============================================================
+/**
+ * Make sure to check the request mapping tables (RM0390 tables 28/29) to see which stream/channel
+ * a peripheral request is wired to
+ */
+typedef enum {
+    DMA_CHANNEL_0 = 0x00U,
+    DMA_CHANNEL_1 = 0x01U,
+    DMA_CHANNEL_2 = 0x02U,
+    DMA_CHANNEL_3 = 0x03U,
+    DMA_CHANNEL_4 = 0x04U,
+    DMA_CHANNEL_5 = 0x05U,
+    DMA_CHANNEL_6 = 0x06U,
+    DMA_CHANNEL_7 = 0x07U
+} DMA_Channel;
+
+typedef enum {
+    DMA_DIR_P2M = 0x00U, // Peripheral to memory
+    DMA_DIR_M2P = 0x01U, // Memory to peripheral
+    DMA_DIR_M2M = 0x02U // Memory to memory (DMA2 only, PAR is the source, M0AR the destination)
+} DMA_Direction;
+
+typedef enum {
+    DMA_SIZE_BYTE = 0x00U,
+    DMA_SIZE_HALFWORD = 0x01U,
+    DMA_SIZE_WORD = 0x02U
+} DMA_Size;
+
+typedef enum {
+    DMA_PRIORITY_LOW = 0x00U,
+    DMA_PRIORITY_MED = 0x01U,
+    DMA_PRIORITY_HIGH = 0x02U,
+    DMA_PRIORITY_VERY_HIGH = 0x03U
+} DMA_Priority;
+
+// Bursts are only allowed with the FIFO enabled
+typedef enum {
+    DMA_BURST_SINGLE = 0x00U,
+    DMA_BURST_INC4 = 0x01U,
+    DMA_BURST_INC8 = 0x02U,
+    DMA_BURST_INC16 = 0x03U
+} DMA_Burst;
+
+typedef enum {
+    DMA_FIFO_1_4 = 0x00U,
+    DMA_FIFO_1_2 = 0x01U,
+    DMA_FIFO_3_4 = 0x02U,
+    DMA_FIFO_FULL = 0x03U
+} DMA_FIFO_Threshold;
+
+/**
+ * make sure to use the above enums when setting this init struct
+ *
+ * channel - request channel this stream listens to (ignored for M2M)
+ * direction - P2M/M2P/M2M
+ * psize/msize - peripheral/memory data width
+ * pinc/minc - 1 to increment the peripheral/memory address after each transfer
+ * circular - 1 to reload NDTR and restart automatically at the end (not allowed for M2M)
+ * priority - arbitration priority against other streams on the same controller
+ * fifo_enable - 0 for direct mode, 1 to use the 4 word FIFO (required for M2M and bursts)
+ * fifo_threshold - FIFO level which triggers a memory side burst
+ * pburst/mburst - burst lengths for each side (default SINGLE)
+ * irq_enable - 1 to enable the transfer complete/error interrupts (NVIC must be enabled separately)
+ * periph_flow - 1 to let the peripheral decide when the transfer ends (PFCTRL, only the SDIO supports this).
+ * 				 NDTR is ignored, and the stream can't be circular or M2M
+ */
+typedef struct {
+    DMA_Channel channel;
+    DMA_Direction direction;
+    DMA_Size psize;
+    DMA_Size msize;
+    uint8_t pinc;
+    uint8_t minc;
+    uint8_t circular;
+    DMA_Priority priority;
+    uint8_t fifo_enable;
+    DMA_FIFO_Threshold fifo_threshold;
+    DMA_Burst pburst;
+    DMA_Burst mburst;
+    uint8_t irq_enable;
+    uint8_t periph_flow;
+} DMA_Init_TypeDef;
+
+
+// HAL FUNCTIONS ==============================================================
+/**
+ * @brief enables the AHB1 peripheral clock for the given DMA controller
+ *
+ * @param dma - DMA1 or DMA2
+ * @return HAL_Status - HAL_OK or HAL_ERROR
+ */
+HAL_Status DMA_enable_clock(DMA_Reg_TypeDef* dma);
+
+/**
+ * @brief Disables the stream (waiting for any transfer to stop), clears its flags and applies the config
+ * 		  You MUST enable the clock for the stream's controller FIRST
+ *
+ * @param stream - one of the DMAx_STREAMy macros
+ * @param init_struct - pointer to init struct which contains the stream configuration
+ * @return HAL_Status - HAL_OK or HAL_ERROR
+ */
+HAL_Status DMA_init(DMA_Stream_TypeDef* stream, const DMA_Init_TypeDef* init_struct);
+
+/**
+ * @brief Loads the addresses and item count, clears stale flags and enables the stream
+ *
+ * @param stream - one of the DMAx_STREAMy macros
+ * @param periph_addr - peripheral address (the SOURCE for M2M)
+ * @param mem_addr - memory address (the DESTINATION for M2M)
+ * @param count - number of items (of psize) to transfer, 1 to 65535
+ * @return HAL_Status - HAL_OK or HAL_ERROR (count is 0 or stream is still busy)
+ */
+HAL_Status DMA_start(DMA_Stream_TypeDef* stream, uint32_t periph_addr, uint32_t mem_addr, uint16_t count);
+
+/**
+ * @brief Disables the stream and waits until the hardware has actually stopped it
+ *
+ * @param stream
+ * @return HAL_Status
+ */
+HAL_Status DMA_stop(DMA_Stream_TypeDef* stream);
+
+/**
+ * @brief Returns the stream's status flags, use the DMA_FLAG_x masks
+ *
+ * @param stream
+ * @return uint32_t - flags (0 if stream is invalid)
+ */
+uint32_t DMA_get_flags(DMA_Stream_TypeDef* stream);
+
+/**
+ * @brief Clears the given status flags for the stream
+ *
+ * @param stream
+ * @param flags - OR of DMA_FLAG_x masks
+ * @return HAL_Status
+ */
+HAL_Status DMA_clear_flags(DMA_Stream_TypeDef* stream, uint32_t flags);
+
+/**
+ * @brief Returns how many items are left to transfer (NDTR)
+ *
+ * @param stream
+ * @return uint16_t
+ */
+uint16_t DMA_get_remaining(DMA_Stream_TypeDef* stream);
+
+#endif
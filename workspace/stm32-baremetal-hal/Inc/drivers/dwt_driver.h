@@ -0,0 +1,54 @@
+/*
+ * dwt_driver.h
+ *
+ * Header file for dwt_driver.c
+ * Contains functions for the Cortex-M4 DWT cycle counter, used for timestamps and benchmarks
+ *
+ *  Written by Ryan Wong
+ */
+
+#ifndef DWT_DRIVER_H_
+#define DWT_DRIVER_H_
+
+#include <stdint.h>
+#include "drivers/types.h"
+
+
+// REGISTERS =====================================================================
+#define DWT_DEMCR (*(volatile uint32_t*)0xE000EDFCU)
+#define DWT_CTRL (*(volatile uint32_t*)0xE0001000U)
+#define DWT_CYCCNT (*(volatile uint32_t*)0xE0001004U)
+
+/**
+ * Reading the counter directly through this macro is a single LDR, use it in
+ * timing-critical code (ISRs) instead of DWT_get_cycles() to avoid the call overhead
+ */
+#define DWT_CYCLES() (DWT_CYCCNT)
+
+
+// HAL FUNCTIONS ==============================================================
+/**
+ * @brief Enables trace (TRCENA) and starts the free running 32 bit cycle counter from 0
+ * The counter runs at HCLK, so it wraps every 2^32 / HCLK_frequency seconds
+ *
+ * @return HAL_Status - HAL_ERROR if the core doesn't implement CYCCNT
+ */
+HAL_Status DWT_init(void);
+
+/**
+ * @brief Returns the current cycle count
+ *
+ * @return uint32_t - cycles since DWT_init()
+ */
+uint32_t DWT_get_cycles(void);
+
+/**
+ * @brief Converts bytes moved in a number of cycles into a throughput, using the current HCLK_frequency
+ *
+ * @param bytes
+ * @param cycles - DWT cycles the transfer took
+ * @return uint32_t - kB/s (1000 bytes), 0 if cycles is 0
+ */
+uint32_t DWT_to_kbps(uint32_t bytes, uint32_t cycles);
+
+#endif
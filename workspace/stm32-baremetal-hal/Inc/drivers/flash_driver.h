@@ -0,0 +1,115 @@
+/*
+ * flash_driver.h
+ *
+ * Header file for flash_driver.c
+ * Contains functions for the embedded flash interface: wait states/caches, and erasing and programming the main memory
+ *
+ * Things to keep in mind:
+ * - Call FLASH_set_latency() with the NEW HCLK before raising the clock, and after lowering it
+ * - While an erase/program is running, any read from flash (instruction fetches included, so every ISR that lives
+ *   in flash) stalls the bus until the operation is done. A 16K sector erase takes ~0.25-0.5s
+ * - Programming can only clear bits (1 -> 0), only an erase sets them back to 1
+ * - Programming assumes VDD is 2.7-3.6V (NUCLEO board is 3.3V), so words are programmed 32 bits at a time
+ *
+ *  Written by Ryan Wong
+ */
+
+#ifndef FLASH_DRIVER_H_
+#define FLASH_DRIVER_H_
+
+#include <stdint.h>
+#include "drivers/types.h"
+
+
+// REGISTERS ==============================================================
+#define FLASH_BASE 0x40023C00U
+#define FLASH ((FLASH_Reg_TypeDef*)FLASH_BASE)
+
+typedef struct {
+    volatile uint32_t ACR;
+    volatile uint32_t KEYR;
+    volatile uint32_t OPTKEYR;
+    volatile uint32_t SR;
+    volatile uint32_t CR;
+    volatile uint32_t OPTCR;
+} FLASH_Reg_TypeDef;
+
+#define FLASH_MAIN_BASE 0x08000000U
+#define FLASH_NUM_SECTORS 8U
+
+// Max HCLK per wait state at 2.7-3.6V (RM0390 table 5)
+#define FLASH_WS_STEP 30000000U
+#define FLASH_MAX_LATENCY 5U
+
+
+// HAL FUNCTIONS ==============================================================
+/**
+ * @brief Sets the number of wait states for the given HCLK and turns on the prefetch buffer and the
+ * 		  instruction and data caches (the ART accelerator)
+ *
+ * @param hclk - HCLK frequency in Hz the flash will be read at
+ * @return HAL_Status - HAL_ERROR if hclk is above 180MHz
+ */
+HAL_Status FLASH_set_latency(uint32_t hclk);
+
+/**
+ * @brief Unlocks FLASH_CR with the key sequence. Needed before any erase or program
+ *
+ * @return HAL_Status - HAL_ERROR if the interface stayed locked (wrong sequence since reset locks it until the next reset)
+ */
+HAL_Status FLASH_unlock(void);
+
+/**
+ * @brief Locks FLASH_CR again
+ */
+void FLASH_lock(void);
+
+/**
+ * @brief Erases one main memory sector (0-7). Blocks until done, then flushes the caches
+ *
+ * @param sector - 0-3 are 16K, 4 is 64K, 5-7 are 128K
+ * @return HAL_Status - HAL_ERROR if locked, invalid sector, or the interface reported an error
+ */
+HAL_Status FLASH_erase_sector(uint32_t sector);
+
+/**
+ * @brief Programs one 32 bit word. Blocks until done, then flushes the data cache
+ *
+ * @param address - word aligned address in main memory
+ * @param value
+ * @return HAL_Status - HAL_ERROR if locked, misaligned, or the interface reported an error
+ */
+HAL_Status FLASH_program_word(uint32_t address, uint32_t value);
+
+/**
+ * @brief Programs count consecutive words starting at address
+ *
+ * @param address - word aligned address in main memory
+ * @param data
+ * @param count - number of words
+ * @return HAL_Status
+ */
+HAL_Status FLASH_program(uint32_t address, const uint32_t* data, uint32_t count);
+
+/**
+ * @brief Returns the start address of a sector
+ *
+ * @param sector - 0-7
+ * @return uint32_t - address, 0 for an invalid sector
+ */
+uint32_t FLASH_get_sector_address(uint32_t sector);
+
+/**
+ * @brief Returns the size of a sector in bytes
+ *
+ * @param sector - 0-7
+ * @return uint32_t - size, 0 for an invalid sector
+ */
+uint32_t FLASH_get_sector_size(uint32_t sector);
+
+/**
+ * @brief Resets the instruction and data caches, so no stale copies of erased/reprogrammed flash are read
+ */
+void FLASH_flush_caches(void);
+
+#endif
@@ -0,0 +1,95 @@
+/*
+ * fpu_driver.h
+ *
+ * Header file for fpu_driver.c
+ * Contains functions which enable the FPU and configure how its context is stacked on exception entry,
+ * plus macros for marking ISRs as integer-only or floating point
+ *
+ * Background (Cortex-M4 exception entry):
+ * - If the interrupted code has used the FPU (CONTROL.FPCA = 1) and ASPEN is set, the core reserves
+ *   a 26 word frame (8 integer + S0-S15 + FPSCR) instead of the basic 8 word frame
+ * - With LSPEN also set (lazy stacking), the space is reserved but S0-S15 are only actually written
+ *   if the ISR executes an FP instruction. Integer-only ISRs then keep the 12 cycle entry latency
+ * - With LSPEN clear, S0-S15 are always pushed/popped (~17 extra cycles on entry AND exit)
+ * - With ASPEN clear, FP registers are never saved - ISRs MUST NOT use the FPU
+ *
+ *  Written by Ryan Wong
+ */
+
+#ifndef FPU_DRIVER_H_
+#define FPU_DRIVER_H_
+
+#include <stdint.h>
+#include "drivers/types.h"
+
+
+// REGISTERS =====================================================================
+#define FPU_CPACR (*(volatile uint32_t*)0xE000ED88U)
+#define FPU_FPCCR (*(volatile uint32_t*)0xE000EF34U)
+#define FPU_FPCAR (*(volatile uint32_t*)0xE000EF38U)
+
+#define FPU_FPCCR_LSPACT (0x01U << 0)
+#define FPU_FPCCR_LSPEN (0x01U << 30)
+#define FPU_FPCCR_ASPEN (0x01U << 31)
+
+
+// ISR GUIDANCE MACROS ===========================================================
+/**
+ * Put FPU_ISR_INTEGER in front of any handler that must stay on the fast path, e.g.
+ *     FPU_ISR_INTEGER void TIM2_IRQHandler(void) { ... }
+ * The compiler is then not allowed to use FP registers in that function (it errors if the code needs them),
+ * so a lazy FP save can never be triggered and entry/exit stay at the integer latency.
+ * Note this only covers the handler itself, any function it calls should also be integer-only
+ */
+#define FPU_ISR_INTEGER __attribute__((target("general-regs-only")))
+
+/**
+ * Put FPU_ISR_FLOAT in front of handlers which do floating point maths. It doesn't change code generation,
+ * it just documents that the handler pays the lazy save (~17 cycles on its first FP instruction)
+ * and REQUIRES FPU_STACKING_LAZY or FPU_STACKING_ALWAYS to be configured.
+ * For the lowest latency, do the FP work as late in the handler as possible (after any time-critical IO)
+ */
+#define FPU_ISR_FLOAT
+
+
+// FPU Config Types ==============================================================
+typedef enum {
+    FPU_STACKING_NONE = 0x00U, // ASPEN = 0, LSPEN = 0 - no FP context saved, ISRs can't use floats
+    FPU_STACKING_ALWAYS = 0x01U, // ASPEN = 1, LSPEN = 0 - FP context always saved if FPCA is set
+    FPU_STACKING_LAZY = 0x02U // ASPEN = 1, LSPEN = 1 - space reserved, registers saved on first FP use (reset default)
+} FPU_Stacking;
+
+
+// HAL FUNCTIONS ==============================================================
+/**
+ * @brief Enables full access to CP10/CP11 (the FPU). Called from SystemInit, before any float code runs
+ *
+ */
+void FPU_enable(void);
+
+/**
+ * @brief Configures how FP context is stacked on exception entry (see the header comment for the tradeoffs)
+ * Should only be called from thread mode, with no exception using the FPU active
+ *
+ * @param mode - enum above specifying the stacking mode
+ * @return HAL_Status - HAL_OK or HAL_ERROR
+ */
+HAL_Status FPU_set_stacking(FPU_Stacking mode);
+
+/**
+ * @brief Reads back the currently configured stacking mode from FPCCR
+ *
+ * @return FPU_Stacking
+ */
+FPU_Stacking FPU_get_stacking(void);
+
+/**
+ * @brief Clears CONTROL.FPCA, telling the core that thread mode no longer has live FP state.
+ * Every exception taken afterwards uses the basic 8 word frame until the thread executes another FP instruction.
+ * ONLY call this when the caller has no floats it still needs (e.g. just before sleeping in the idle loop),
+ * as the contents of S0-S31 are considered lost
+ *
+ */
+void FPU_discard_context(void);
+
+#endif
@@ -175,6 +175,17 @@ HAL_Status GPIO_write_pin(GPIO_Reg_TypeDef* port, GPIO_Pin pin, PIN_State val);
 HAL_Status GPIO_write_port(GPIO_Reg_TypeDef* port, uint16_t val);
 
 
+/**
+ * @brief Writes only the pins selected by mask, in a single atomic BSRR write. Pins outside mask are untouched
+ * 
+ * @param port 
+ * @param mask 16 bit bitmask of pins to write. LSB = PIN0, MSB = PIN15
+ * @param val 16 bit uint with the new states for the masked pins
+ * @return HAL_Status 
+ */
+HAL_Status GPIO_write_port_masked(GPIO_Reg_TypeDef* port, uint16_t mask, uint16_t val);
+
+
 /**
  * @brief Toggles given pin from high->low or low->high depending on current state
  * 
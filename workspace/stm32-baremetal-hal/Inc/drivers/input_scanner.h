@@ -0,0 +1,141 @@
+/*
+ * input_scanner.h
+ *
+ * Header file for input_scanner.c
+ * Debounces whole GPIO ports (and matrix keypads) at once using vertical counters.
+ *
+ * Each input bit has a 2 bit counter, but the counters are stored "vertically": bit n of cnt0 and cnt1
+ * together form the counter for pin n. Updating all 16 counters is then a handful of bitwise operations
+ * on two uint16_t, so the cost of a scan doesn't depend on how many pins are being watched.
+ * An input has to read the same (new) value for 4 consecutive ticks before its debounced state changes
+ *
+ * Call the tick functions from a periodic timer interrupt (1-5ms is typical for mechanical contacts)
+ * and read the edge bitmasks from the main loop with SCAN_get_events()
+ *
+ *  Written by Ryan Wong
+ */
+
+#ifndef INPUT_SCANNER_H_
+#define INPUT_SCANNER_H_
+
+#include <stdint.h>
+#include "drivers/types.h"
+#include "drivers/gpio_driver.h"
+
+// Maximum number of rows in a matrix keypad (each row gets its own 16 bit lane of columns)
+#define SCAN_MATRIX_MAX_ROWS 8U
+
+
+// SCANNER TYPES ==============================================================
+/**
+ * Debounce state for up to 16 inputs. Bit n is input n everywhere
+ *
+ * state - debounced logical state (1 = active)
+ * cnt0/cnt1 - vertical counter bits
+ * pressed/released - edges (inactive->active / active->inactive) accumulated since the last SCAN_get_events()
+ */
+typedef struct {
+    uint16_t state;
+    uint16_t cnt0;
+    uint16_t cnt1;
+    volatile uint16_t pressed;
+    volatile uint16_t released;
+} SCAN_Lane;
+
+/**
+ * A directly connected set of inputs on one port
+ *
+ * port - GPIO port to sample
+ * mask - pins to watch, other pins always read as 0
+ * invert - pins which are active low (e.g. buttons to ground with pull ups)
+ */
+typedef struct {
+    GPIO_Reg_TypeDef* port;
+    uint16_t mask;
+    uint16_t invert;
+    SCAN_Lane lane;
+} SCAN_Port;
+
+/**
+ * A row/column keypad. Rows are outputs and are driven LOW one at a time (all others high),
+ * columns are inputs with pull ups, so a pressed key pulls its column low while its row is driven.
+ * Row pins should be open drain (or have series resistors) so two keys in the same column can't short rows.
+ *
+ * Lane r holds the keys on the r-th set bit of row_mask, indexed by column pin number
+ */
+typedef struct {
+    GPIO_Reg_TypeDef* row_port;
+    uint16_t row_mask;
+    GPIO_Reg_TypeDef* col_port;
+    uint16_t col_mask;
+    uint8_t num_rows;
+    uint8_t current_row;
+    uint8_t row_pins[SCAN_MATRIX_MAX_ROWS];
+    SCAN_Lane lanes[SCAN_MATRIX_MAX_ROWS];
+} SCAN_Matrix;
+
+
+// HAL FUNCTIONS ==============================================================
+/**
+ * @brief Runs one debounce step for all 16 inputs of a lane with a new raw sample.
+ * 		  The tick functions below call this, it's exposed for inputs that don't come from a GPIO port
+ *
+ * @param lane - debounce state
+ * @param sample - raw logical input sample (1 = active)
+ */
+void SCAN_debounce(SCAN_Lane* lane, uint16_t sample);
+
+/**
+ * @brief Sets up a directly connected port. The current pin levels are taken as the initial debounced state
+ * 		  so no events are reported at startup. The pins must already be configured as inputs with GPIO_init()
+ *
+ * @param scan - scanner state to initialise
+ * @param port - GPIO port
+ * @param mask - pins to watch
+ * @param invert - pins which are active low
+ * @return HAL_Status - HAL_OK or HAL_ERROR
+ */
+HAL_Status SCAN_port_init(SCAN_Port* scan, GPIO_Reg_TypeDef* port, uint16_t mask, uint16_t invert);
+
+/**
+ * @brief Samples the whole port with one IDR read and debounces it. Call from the periodic tick
+ *
+ * @param scan
+ * @return HAL_Status
+ */
+HAL_Status SCAN_port_tick(SCAN_Port* scan);
+
+/**
+ * @brief Sets up a matrix keypad and starts driving the first row.
+ * 		  Row pins must already be outputs and column pins inputs with pull ups (GPIO_init())
+ *
+ * @param matrix - scanner state to initialise
+ * @param row_port - port the rows are on
+ * @param row_mask - row pins (1 to SCAN_MATRIX_MAX_ROWS bits set)
+ * @param col_port - port the columns are on
+ * @param col_mask - column pins
+ * @return HAL_Status - HAL_OK or HAL_ERROR
+ */
+HAL_Status SCAN_matrix_init(SCAN_Matrix* matrix, GPIO_Reg_TypeDef* row_port, uint16_t row_mask, GPIO_Reg_TypeDef* col_port, uint16_t col_mask);
+
+/**
+ * @brief Reads the columns for the row driven on the previous tick (so the lines have had a whole tick to settle),
+ * 		  debounces them, then drives the next row with a single masked port write.
+ * 		  Each row is therefore sampled every num_rows ticks
+ *
+ * @param matrix
+ * @return HAL_Status
+ */
+HAL_Status SCAN_matrix_tick(SCAN_Matrix* matrix);
+
+/**
+ * @brief Returns and clears the edges accumulated on a lane since the last call. Safe against the tick ISR
+ *
+ * @param lane - e.g. &scan.lane or &matrix.lanes[row]
+ * @param pressed - bitmask of inputs that became active (can be NULL)
+ * @param released - bitmask of inputs that became inactive (can be NULL)
+ * @return HAL_Status
+ */
+HAL_Status SCAN_get_events(SCAN_Lane* lane, uint16_t* pressed, uint16_t* released);
+
+#endif
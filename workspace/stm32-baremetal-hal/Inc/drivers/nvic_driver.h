@@ -0,0 +1,131 @@
+/*
+ * nvic_driver.h
+ *
+ * Header file for nvic_driver.c
+ * Contains functions which enable, pend and prioritise interrupts in the Cortex-M4 NVIC
+ *
+ *  Written by Ryan Wong
+ */
+
+#ifndef NVIC_DRIVER_H_
+#define NVIC_DRIVER_H_
+
+#include <stdint.h>
+#include "drivers/types.h"
+
+
+// REGISTERS =====================================================================
+// Each of these is an array of 32 bit registers, one bit per IRQ (IPR is one byte per IRQ)
+#define NVIC_ISER ((volatile uint32_t*)0xE000E100U)
+#define NVIC_ICER ((volatile uint32_t*)0xE000E180U)
+#define NVIC_ISPR ((volatile uint32_t*)0xE000E200U)
+#define NVIC_ICPR ((volatile uint32_t*)0xE000E280U)
+#define NVIC_IPR ((volatile uint8_t*)0xE000E400U)
+
+// Software trigger interrupt register - writing the IRQ number pends it
+#define NVIC_STIR (*(volatile uint32_t*)0xE000EF00U)
+
+// STM32F446 implements the top 4 bits of each priority byte
+#define NVIC_PRIO_BITS 4U
+#define NVIC_MAX_PRIORITY 15U
+
+
+// NVIC Config Types =============================================================
+/**
+ * IRQ numbers are the position in the vector table AFTER the 16 system exceptions
+ * Only the ones used by drivers in this HAL are listed, check RM0390 table 38 for the rest
+ */
+typedef enum {
+    NVIC_IRQ_DMA1_STREAM0 = 11U,
+    NVIC_IRQ_DMA1_STREAM1 = 12U,
+    NVIC_IRQ_DMA1_STREAM2 = 13U,
+    NVIC_IRQ_DMA1_STREAM3 = 14U,
+    NVIC_IRQ_DMA1_STREAM4 = 15U,
+    NVIC_IRQ_DMA1_STREAM5 = 16U,
+    NVIC_IRQ_DMA1_STREAM6 = 17U,
+    NVIC_IRQ_TIM1_UP_TIM10 = 25U,
+    NVIC_IRQ_TIM1_CC = 27U,
+    NVIC_IRQ_TIM2 = 28U,
+    NVIC_IRQ_TIM3 = 29U,
+    NVIC_IRQ_TIM4 = 30U,
+    NVIC_IRQ_TIM8_UP_TIM13 = 44U,
+    NVIC_IRQ_DMA1_STREAM7 = 47U,
+    NVIC_IRQ_FMC = 48U,
+    NVIC_IRQ_SDIO = 49U,
+    NVIC_IRQ_TIM5 = 50U,
+    NVIC_IRQ_TIM6_DAC = 54U,
+    NVIC_IRQ_TIM7 = 55U,
+    NVIC_IRQ_DMA2_STREAM0 = 56U,
+    NVIC_IRQ_DMA2_STREAM1 = 57U,
+    NVIC_IRQ_DMA2_STREAM2 = 58U,
+    NVIC_IRQ_DMA2_STREAM3 = 59U,
+    NVIC_IRQ_DMA2_STREAM4 = 60U,
+    NVIC_IRQ_OTG_FS = 67U,
+    NVIC_IRQ_DMA2_STREAM5 = 68U,
+    NVIC_IRQ_DMA2_STREAM6 = 69U,
+    NVIC_IRQ_DMA2_STREAM7 = 70U,
+    NVIC_IRQ_DCMI = 78U,
+    NVIC_IRQ_QUADSPI = 92U,
+    NVIC_IRQ_MAX = 96U
+} NVIC_IRQn;
+
+
+// HAL FUNCTIONS ==============================================================
+/**
+ * @brief Enables the given IRQ in the NVIC
+ *
+ * @param irq - IRQ number (use the enum above)
+ * @return HAL_Status - HAL_OK or HAL_ERROR
+ */
+HAL_Status NVIC_enable_irq(NVIC_IRQn irq);
+
+/**
+ * @brief Disables the given IRQ in the NVIC
+ *
+ * @param irq - IRQ number (use the enum above)
+ * @return HAL_Status - HAL_OK or HAL_ERROR
+ */
+HAL_Status NVIC_disable_irq(NVIC_IRQn irq);
+
+/**
+ * @brief Sets the pending bit for the given IRQ so its handler runs as soon as priority allows.
+ * Useful for triggering handlers from software (e.g. latency measurements)
+ *
+ * @param irq - IRQ number (use the enum above)
+ * @return HAL_Status - HAL_OK or HAL_ERROR
+ */
+HAL_Status NVIC_set_pending(NVIC_IRQn irq);
+
+/**
+ * @brief Clears the pending bit for the given IRQ
+ *
+ * @param irq - IRQ number (use the enum above)
+ * @return HAL_Status - HAL_OK or HAL_ERROR
+ */
+HAL_Status NVIC_clear_pending(NVIC_IRQn irq);
+
+/**
+ * @brief Sets the priority of the given IRQ. 0 is the HIGHEST priority, 15 is the lowest
+ *
+ * @param irq - IRQ number (use the enum above)
+ * @param priority - 0 to 15
+ * @return HAL_Status - HAL_OK or HAL_ERROR
+ */
+HAL_Status NVIC_set_priority(NVIC_IRQn irq, uint8_t priority);
+
+/**
+ * @brief Disables all interrupts (sets PRIMASK) and returns the previous PRIMASK value
+ * Pair with NVIC_exit_critical() to restore. Safe to nest
+ *
+ * @return uint32_t - previous PRIMASK to pass to NVIC_exit_critical()
+ */
+uint32_t NVIC_enter_critical(void);
+
+/**
+ * @brief Restores PRIMASK saved by NVIC_enter_critical()
+ *
+ * @param primask - value returned from NVIC_enter_critical()
+ */
+void NVIC_exit_critical(uint32_t primask);
+
+#endif
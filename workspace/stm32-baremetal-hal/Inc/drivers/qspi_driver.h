@@ -0,0 +1,189 @@
+/*
+ * qspi_driver.h
+ *
+ * Header file for qspi_driver.c
+ * Contains function prototypes, register struct definitions, macros for the QUADSPI controller.
+ * Like sdio_driver.h, this is just the bus: sending flash commands in indirect mode, polling a status register
+ * in hardware, and mapping the flash into the address space at QSPI_MEMORY_BASE. The flash chip's commands
+ * live in utils/qspi_flash.h
+ *
+ * Things to keep in mind:
+ * - Pins are fixed for the 64 pin package: PB2 = CLK, PB6 = NCS (AF10), PC9/PC10/PC8/PA1 = IO0-IO3 (AF9).
+ *   PC8-PC10 are also SDIO D0-D2, so QUADSPI and SDIO can't be used at the same time on this board
+ * - Only one mode at a time: indirect commands and auto polling abort memory mapped mode first, and nothing
+ *   may read the mapped region (including code running from it) while that's happening
+ * - The kernel clock is HCLK, the flash clock is HCLK / (prescaler + 1)
+ *
+ *  Written by Ryan Wong
+ */
+
+#ifndef QSPI_DRIVER_H_
+#define QSPI_DRIVER_H_
+
+#include <stdint.h>
+#include "drivers/types.h"
+
+
+// REGISTERS ==============================================================
+#define QSPI_BASE 0xA0001000U
+#define QUADSPI ((QSPI_Reg_TypeDef*)QSPI_BASE)
+#define QSPI_MEMORY_BASE 0x90000000U
+
+typedef struct {
+    volatile uint32_t CR;
+    volatile uint32_t DCR;
+    volatile uint32_t SR;
+    volatile uint32_t FCR;
+    volatile uint32_t DLR;
+    volatile uint32_t CCR;
+    volatile uint32_t AR;
+    volatile uint32_t ABR;
+    volatile uint32_t DR;
+    volatile uint32_t PSMKR;
+    volatile uint32_t PSMAR;
+    volatile uint32_t PIR;
+    volatile uint32_t LPTR;
+} QSPI_Reg_TypeDef;
+
+#define QSPI_SR_TEF (0x01U << 0)
+#define QSPI_SR_TCF (0x01U << 1)
+#define QSPI_SR_FTF (0x01U << 2)
+#define QSPI_SR_SMF (0x01U << 3)
+#define QSPI_SR_TOF (0x01U << 4)
+#define QSPI_SR_BUSY (0x01U << 5)
+#define QSPI_FIFO_SIZE 32U
+
+
+// QSPI Config Types ==============================================================
+/**
+ * Lines used by each phase of a command, NONE skips the phase
+ */
+typedef enum {
+    QSPI_LINES_NONE = 0x00U,
+    QSPI_LINES_1 = 0x01U,
+    QSPI_LINES_2 = 0x02U,
+    QSPI_LINES_4 = 0x03U
+} QSPI_Lines;
+
+typedef enum {
+    QSPI_ADDRESS_8BIT = 0x00U,
+    QSPI_ADDRESS_16BIT = 0x01U,
+    QSPI_ADDRESS_24BIT = 0x02U,
+    QSPI_ADDRESS_32BIT = 0x03U
+} QSPI_Address_Size;
+
+/**
+ * One flash command: instruction, address, one alternate byte (e.g. the mode bits of a fast read),
+ * dummy cycles, then data. Which phases happen depends on the *_lines fields
+ *
+ * instruction - command byte
+ * instruction_lines, address_lines, alt_lines, data_lines - lines per phase (NONE skips it)
+ * address_size - 8 to 32 bits
+ * address - ignored in memory mapped mode (the CPU's address is used)
+ * alt_byte - sent in the alternate bytes phase
+ * dummy_cycles - 0 to 31
+ */
+typedef struct {
+    uint8_t instruction;
+    QSPI_Lines instruction_lines;
+    QSPI_Lines address_lines;
+    QSPI_Address_Size address_size;
+    uint32_t address;
+    QSPI_Lines alt_lines;
+    uint8_t alt_byte;
+    uint8_t dummy_cycles;
+    QSPI_Lines data_lines;
+} QSPI_Command_TypeDef;
+
+/**
+ * clock_frequency - highest flash clock in Hz, the fastest HCLK / (prescaler + 1) below it is used
+ * flash_size_log2 - flash size as a power of 2 (e.g. 24 for 16MB), also the size of the memory mapped window
+ * cs_high_ns - shortest time the flash needs NCS high between commands
+ */
+typedef struct {
+    uint32_t clock_frequency;
+    uint8_t flash_size_log2;
+    uint16_t cs_high_ns;
+} QSPI_Init_TypeDef;
+
+
+// HAL FUNCTIONS ==============================================================
+/**
+ * @brief Enables the QUADSPI and GPIO clocks, sets up the pins and the controller (SDR, clock mode 0)
+ *
+ * @param init_struct
+ * @return HAL_Status - HAL_ERROR if the settings are out of range
+ */
+HAL_Status QSPI_init(const QSPI_Init_TypeDef* init_struct);
+
+/**
+ * @brief The flash clock QSPI_init() picked, in Hz
+ *
+ * @return uint32_t
+ */
+uint32_t QSPI_get_clock(void);
+
+/**
+ * @brief Sends a command with no data phase (data_lines is ignored), e.g. write enable or an erase
+ *
+ * @param command
+ * @return HAL_Status - HAL_ERROR on timeout
+ */
+HAL_Status QSPI_command(const QSPI_Command_TypeDef* command);
+
+/**
+ * @brief Sends a command and reads len bytes back through the FIFO (indirect read mode)
+ *
+ * @param command - data_lines must not be NONE
+ * @param buffer
+ * @param len - 1 or more bytes
+ * @return HAL_Status - HAL_ERROR on invalid arguments or timeout
+ */
+HAL_Status QSPI_read(const QSPI_Command_TypeDef* command, void* buffer, uint32_t len);
+
+/**
+ * @brief Sends a command followed by len bytes of data (indirect write mode), e.g. a page program
+ *
+ * @param command - data_lines must not be NONE
+ * @param buffer
+ * @param len - 1 or more bytes
+ * @return HAL_Status - HAL_ERROR on invalid arguments or timeout
+ */
+HAL_Status QSPI_write(const QSPI_Command_TypeDef* command, const void* buffer, uint32_t len);
+
+/**
+ * @brief Has the controller repeat a 1 byte read command (e.g. read status register) until (value & mask) == match.
+ * 		  The CPU only waits for the match flag, it doesn't clock the flash itself
+ *
+ * @param command - data_lines must not be NONE
+ * @param match
+ * @param mask
+ * @param timeout_ms
+ * @return HAL_Status - HAL_ERROR if it didn't match in time
+ */
+HAL_Status QSPI_auto_poll(const QSPI_Command_TypeDef* command, uint8_t match, uint8_t mask, uint32_t timeout_ms);
+
+/**
+ * @brief Maps the flash at QSPI_MEMORY_BASE: every read there becomes the given read command. Sequential reads
+ * 		  are prefetched, so NCS stays low and only the first access pays for the command
+ *
+ * @param command - read command to issue, address is ignored
+ * @return HAL_Status
+ */
+HAL_Status QSPI_memory_mapped(const QSPI_Command_TypeDef* command);
+
+/**
+ * @brief 1 if the flash is currently mapped
+ *
+ * @return uint8_t
+ */
+uint8_t QSPI_is_memory_mapped(void);
+
+/**
+ * @brief Stops whatever the controller is doing (including memory mapped mode) and waits for it to go idle
+ *
+ * @return HAL_Status - HAL_ERROR on timeout
+ */
+HAL_Status QSPI_abort(void);
+
+#endif
@@ -17,13 +17,28 @@
 // Global variable specifying HCLK frequency in Hz (driving the CPU and SysTick)
 extern volatile uint32_t HCLK_frequency;
 
+// Global variables specifying the APB1 (low speed) and APB2 (high speed) bus clock frequencies in Hz
+extern volatile uint32_t PCLK1_frequency;
+extern volatile uint32_t PCLK2_frequency;
+
 // HSI is 16MHz for the STM32F4 (dunno if its a cortex M4 default or vendor specific)
 #define HSI_FREQ 16000000U
 
+// The USB OTG FS, SDIO and RNG need exactly this from PLL48CLK
+#define RCC_PLL48_FREQ 48000000U
+
 
 // REGISTERS =====================================================================
 #define RCC_BASE 0x40023800U
+#define RCC_CR (*(volatile uint32_t*)(RCC_BASE + 0x00U))
+#define RCC_PLLCFGR (*(volatile uint32_t*)(RCC_BASE + 0x04U))
 #define RCC_CFGR *((volatile uint32_t*)(RCC_BASE + 0x08))
+#define RCC_AHB1ENR (*(volatile uint32_t*)(RCC_BASE + 0x30U))
+#define RCC_AHB2ENR (*(volatile uint32_t*)(RCC_BASE + 0x34U))
+#define RCC_AHB3ENR (*(volatile uint32_t*)(RCC_BASE + 0x38U))
+#define RCC_APB1ENR (*(volatile uint32_t*)(RCC_BASE + 0x40U))
+#define RCC_APB2ENR (*(volatile uint32_t*)(RCC_BASE + 0x44U))
+#define RCC_DCKCFGR2 (*(volatile uint32_t*)(RCC_BASE + 0x94U))
 
 // RCC Config Types ==============================================================
 typedef enum {
@@ -46,6 +61,22 @@ typedef enum {
     RCC_APB_DIV_16 = 0b111U,
 } RCC_APB_Prescaler;
 
+/**
+ * Main PLL, fed from HSI: VCO = HSI / m * n, P output (SYSCLK) = VCO / p, Q output (PLL48CLK) = VCO / q
+ * m - 2 to 63, VCO input (HSI / m) must be 1-2MHz, 2MHz gives the least jitter
+ * n - 50 to 432, VCO output must be 100-432MHz
+ * p - 2, 4, 6 or 8, at most 180MHz out
+ * q - 2 to 15, at most 48MHz out
+ *
+ * e.g. m = 8, n = 192, p = 4, q = 8: 384MHz VCO, 96MHz P, 48MHz Q
+ */
+typedef struct {
+    uint8_t m;
+    uint16_t n;
+    uint8_t p;
+    uint8_t q;
+} RCC_PLL_Config;
+
 
 // HAL FUNCTIONS ==============================================================
 
@@ -56,6 +87,22 @@ typedef enum {
  */
 void update_hclk();
 
+/**
+ * @brief Returns the clock feeding the timers on APB1 (TIM2-7, TIM12-14).
+ * The timer clock is PCLK1 if the APB1 prescaler is 1, otherwise it is 2x PCLK1 (TIMPRE = 0)
+ * 
+ * @return uint32_t - timer clock frequency in Hz
+ */
+uint32_t RCC_get_APB1_timer_clock();
+
+/**
+ * @brief Returns the clock feeding the timers on APB2 (TIM1, TIM8-11).
+ * The timer clock is PCLK2 if the APB2 prescaler is 1, otherwise it is 2x PCLK2 (TIMPRE = 0)
+ * 
+ * @return uint32_t - timer clock frequency in Hz
+ */
+uint32_t RCC_get_APB2_timer_clock();
+
 /**
  * @brief Sets the HCLK (AHB clock) prescaler.
  * The clocks are divided with the new prescaler factor from 1 to 16 AHB cycles after HPRE write.
@@ -86,4 +133,20 @@ HAL_Status RCC_set_APB1_prescaler(RCC_APB_Prescaler div);
  */
 HAL_Status RCC_set_APB2_prescaler(RCC_APB_Prescaler div);
 
+/**
+ * @brief Configures and starts the main PLL from HSI, and selects its Q output as the 48MHz clock (CK48MSEL).
+ * SYSCLK stays where it is, this only makes the PLL outputs available
+ * 
+ * @param config - checked against the limits above before anything is written
+ * @return HAL_Status - HAL_ERROR if the config is out of range, the PLL is driving SYSCLK or it doesn't lock
+ */
+HAL_Status RCC_enable_PLL(const RCC_PLL_Config* config);
+
+/**
+ * @brief Returns the 48MHz domain clock (USB OTG FS, SDIO, RNG) if it comes from a running PLL
+ * 
+ * @return uint32_t - PLL Q output in Hz, 0 if the PLL isn't locked
+ */
+uint32_t RCC_get_PLL48_clock();
+
 #endif
\ No newline at end of file
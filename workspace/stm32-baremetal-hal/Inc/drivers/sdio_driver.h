@@ -0,0 +1,180 @@
+/*
+ * sdio_driver.h
+ *
+ * Header file for sdio_driver.c
+ * Contains function prototypes, register struct definitions, macros for the SDIO host controller.
+ * This is just the bus: sending commands and moving data blocks with the DMA. The SD card protocol
+ * (init sequence, addressing, streaming writes) lives in utils/sd_card.h, with kv_store style backend ops
+ * in sd_card_sdio.c
+ *
+ * Things to keep in mind:
+ * - Pins are fixed: PC8-PC11 = D0-D3, PC12 = CK, PD2 = CMD (AF12). D0-D3 and CMD get the internal pull ups
+ * - Data always goes through the DMA (DMA2 stream 3 for reads, stream 6 for writes, both channel 4), with the
+ *   SDIO as flow controller, so this module owns those two streams
+ * - Data buffers must be word aligned. 16 byte aligned buffers also get 4 word memory bursts
+ * - Hardware flow control is left off (it glitches the clock on some F4 revisions), the DMA keeps
+ *   the FIFO fed easily at these bus speeds
+ *
+ *  Written by Ryan Wong
+ */
+
+#ifndef SDIO_DRIVER_H_
+#define SDIO_DRIVER_H_
+
+#include <stdint.h>
+#include "drivers/types.h"
+
+
+// REGISTERS ==============================================================
+#define SDIO_BASE 0x40012C00U
+#define SDIO ((SDIO_Reg_TypeDef*)SDIO_BASE)
+
+typedef struct {
+    volatile uint32_t POWER;
+    volatile uint32_t CLKCR;
+    volatile uint32_t ARG;
+    volatile uint32_t CMD;
+    volatile uint32_t RESPCMD;
+    volatile uint32_t RESP[4];
+    volatile uint32_t DTIMER;
+    volatile uint32_t DLEN;
+    volatile uint32_t DCTRL;
+    volatile uint32_t DCOUNT;
+    volatile uint32_t STA;
+    volatile uint32_t ICR;
+    volatile uint32_t MASK;
+    volatile uint32_t RESERVED0[2];
+    volatile uint32_t FIFOCNT;
+    volatile uint32_t RESERVED1[13];
+    volatile uint32_t FIFO;
+} SDIO_Reg_TypeDef;
+
+// STA flags (the first 11 are static, cleared through ICR)
+#define SDIO_STA_CCRCFAIL (0x01U << 0)
+#define SDIO_STA_DCRCFAIL (0x01U << 1)
+#define SDIO_STA_CTIMEOUT (0x01U << 2)
+#define SDIO_STA_DTIMEOUT (0x01U << 3)
+#define SDIO_STA_TXUNDERR (0x01U << 4)
+#define SDIO_STA_RXOVERR (0x01U << 5)
+#define SDIO_STA_CMDREND (0x01U << 6)
+#define SDIO_STA_CMDSENT (0x01U << 7)
+#define SDIO_STA_DATAEND (0x01U << 8)
+#define SDIO_STA_STBITERR (0x01U << 9)
+#define SDIO_STA_DBCKEND (0x01U << 10)
+#define SDIO_STA_CMDACT (0x01U << 11)
+#define SDIO_STA_TXACT (0x01U << 12)
+#define SDIO_STA_RXACT (0x01U << 13)
+#define SDIO_STA_STATIC 0x00C007FFU
+#define SDIO_STA_DATA_ERRORS (SDIO_STA_DCRCFAIL | SDIO_STA_DTIMEOUT | SDIO_STA_TXUNDERR | SDIO_STA_RXOVERR | SDIO_STA_STBITERR)
+
+
+// SDIO Config Types ==============================================================
+/**
+ * SDIOCLK source. The 48MHz clock needs the PLL (PLL48CLK), SYSCLK works straight out of reset (HSI)
+ */
+typedef enum {
+    SDIO_CLOCK_48MHZ = 0x00U,
+    SDIO_CLOCK_SYSCLK = 0x01U
+} SDIO_Clock_Source;
+
+typedef enum {
+    SDIO_BUS_1BIT = 0x00U,
+    SDIO_BUS_4BIT = 0x01U
+} SDIO_Bus_Width;
+
+/**
+ * NO_CRC is for R3 (OCR), which has no CRC, so the CRC fail flag the hardware raises for it is ignored
+ */
+typedef enum {
+    SDIO_RESPONSE_NONE = 0x00U,
+    SDIO_RESPONSE_SHORT = 0x01U,
+    SDIO_RESPONSE_SHORT_NO_CRC = 0x02U,
+    SDIO_RESPONSE_LONG = 0x03U
+} SDIO_Response;
+
+typedef enum {
+    SDIO_DIR_WRITE = 0x00U, // host to card
+    SDIO_DIR_READ = 0x01U // card to host
+} SDIO_Direction;
+
+typedef enum {
+    SDIO_DATA_IDLE = 0x00U, // finished (or nothing started)
+    SDIO_DATA_BUSY = 0x01U,
+    SDIO_DATA_ERROR = 0x02U
+} SDIO_Data_State;
+
+/**
+ * clock_source - what feeds SDIOCLK
+ * clock_frequency - SDIOCLK in Hz (HSI_FREQ for SYSCLK straight out of reset, 48000000 for PLL48CLK)
+ */
+typedef struct {
+    SDIO_Clock_Source clock_source;
+    uint32_t clock_frequency;
+} SDIO_Init_TypeDef;
+
+
+// HAL FUNCTIONS ==============================================================
+/**
+ * @brief Enables the SDIO, GPIOC/D and DMA2 clocks, sets up the pins, powers the card bus on
+ * 		  and starts the card clock at 400kHz (or below) on a 1 bit bus, ready for card identification
+ *
+ * @param init_struct
+ * @return HAL_Status - HAL_ERROR if the clock settings are invalid
+ */
+HAL_Status SDIO_init(const SDIO_Init_TypeDef* init_struct);
+
+/**
+ * @brief Sets the card clock to the fastest SDIOCLK / (div + 2) (or SDIOCLK itself with the divider bypassed)
+ * 		  that doesn't go over max_hz
+ *
+ * @param max_hz
+ * @return uint32_t - the clock actually set in Hz, 0 if max_hz is below what the divider can reach
+ */
+uint32_t SDIO_set_clock(uint32_t max_hz);
+
+/**
+ * @brief Switches the host between 1 and 4 data lines. The card has to be switched first (ACMD6)
+ *
+ * @param width
+ * @return HAL_Status
+ */
+HAL_Status SDIO_set_bus_width(SDIO_Bus_Width width);
+
+/**
+ * @brief Sends a command and waits for its response (or for it to be sent if it has none)
+ *
+ * @param index - command index, 0 to 63
+ * @param arg - 32 bit argument
+ * @param response - response type expected
+ * @param resp - filled with RESP1 for short responses, RESP1-RESP4 for long ones (can be NULL)
+ * @return HAL_Status - HAL_ERROR on timeout, CRC failure or a response to the wrong command
+ */
+HAL_Status SDIO_send_command(uint8_t index, uint32_t arg, SDIO_Response response, uint32_t* resp);
+
+/**
+ * @brief Starts moving len bytes of data in blocks of block_size through the DMA, and returns straight away.
+ * 		  For reads call this BEFORE sending the read command, for writes AFTER the write command's response
+ *
+ * @param direction
+ * @param buffer - word aligned, must stay valid until SDIO_data_poll() stops returning SDIO_DATA_BUSY
+ * @param len - bytes, a multiple of block_size, below 32M
+ * @param block_size - power of 2 from 1 to 16384
+ * @param timeout_ms - longest the card may take to send or accept a block
+ * @return HAL_Status - HAL_ERROR on invalid arguments or if a transfer is still running
+ */
+HAL_Status SDIO_start_data(SDIO_Direction direction, void* buffer, uint32_t len, uint32_t block_size, uint32_t timeout_ms);
+
+/**
+ * @brief Checks on the transfer started by SDIO_start_data(). Once it reports IDLE the buffer can be reused.
+ * 		  On ERROR the transfer has already been stopped
+ *
+ * @return SDIO_Data_State
+ */
+SDIO_Data_State SDIO_data_poll(void);
+
+/**
+ * @brief Stops the data path and both DMA streams, e.g. after the card reported an error
+ */
+void SDIO_abort_data(void);
+
+#endif
@@ -0,0 +1,423 @@
+/*
+ * timer_driver.h
+ *
+ * Header file for timer_driver.c
+ * Contains function prototypes, register struct definitions, macros for the general purpose (TIM2-5, TIM9-14),
+ * basic (TIM6/7) and advanced (TIM1/8) timers
+ *
+ * PWM duty updates always go through the CCR preload (shadow) registers, so a new duty only takes effect at
+ * the next update event and a period is never cut short or doubled (glitch free)
+ *
+ *  Written by Ryan Wong
+ */
+
+#ifndef TIMER_DRIVER_H_
+#define TIMER_DRIVER_H_
+
+#include <stdint.h>
+#include "drivers/types.h"
+#include "drivers/dma_driver.h"
+
+
+// REGISTERS ==============================================================
+#define TIM1 ((TIM_Reg_TypeDef*)0x40010000U)
+#define TIM2 ((TIM_Reg_TypeDef*)0x40000000U)
+#define TIM3 ((TIM_Reg_TypeDef*)0x40000400U)
+#define TIM4 ((TIM_Reg_TypeDef*)0x40000800U)
+#define TIM5 ((TIM_Reg_TypeDef*)0x40000C00U)
+#define TIM6 ((TIM_Reg_TypeDef*)0x40001000U)
+#define TIM7 ((TIM_Reg_TypeDef*)0x40001400U)
+#define TIM8 ((TIM_Reg_TypeDef*)0x40010400U)
+#define TIM9 ((TIM_Reg_TypeDef*)0x40014000U)
+#define TIM10 ((TIM_Reg_TypeDef*)0x40014400U)
+#define TIM11 ((TIM_Reg_TypeDef*)0x40014800U)
+#define TIM12 ((TIM_Reg_TypeDef*)0x40001800U)
+#define TIM13 ((TIM_Reg_TypeDef*)0x40001C00U)
+#define TIM14 ((TIM_Reg_TypeDef*)0x40002000U)
+
+// Superset of every timer's registers, the ones a timer doesn't have just read as 0
+typedef struct {
+    volatile uint32_t CR1;
+    volatile uint32_t CR2;
+    volatile uint32_t SMCR;
+    volatile uint32_t DIER;
+    volatile uint32_t SR;
+    volatile uint32_t EGR;
+    volatile uint32_t CCMR1;
+    volatile uint32_t CCMR2;
+    volatile uint32_t CCER;
+    volatile uint32_t CNT;
+    volatile uint32_t PSC;
+    volatile uint32_t ARR;
+    volatile uint32_t RCR;
+    volatile uint32_t CCR1;
+    volatile uint32_t CCR2;
+    volatile uint32_t CCR3;
+    volatile uint32_t CCR4;
+    volatile uint32_t BDTR;
+    volatile uint32_t DCR;
+    volatile uint32_t DMAR;
+    volatile uint32_t OR;
+} TIM_Reg_TypeDef;
+
+
+// TIM Config Types ==============================================================
+typedef enum {
+    TIM_CHANNEL_1 = 0x00U,
+    TIM_CHANNEL_2 = 0x01U,
+    TIM_CHANNEL_3 = 0x02U,
+    TIM_CHANNEL_4 = 0x03U
+} TIM_Channel;
+
+// Center aligned modes halve the PWM frequency for the same ARR, TIM_init() accounts for this
+typedef enum {
+    TIM_COUNT_UP = 0x00U,
+    TIM_COUNT_DOWN = 0x01U,
+    TIM_COUNT_CENTER = 0x02U
+} TIM_CountMode;
+
+typedef enum {
+    TIM_PWM_MODE_1 = 0x06U, // Output active while CNT < CCR
+    TIM_PWM_MODE_2 = 0x07U // Output inactive while CNT < CCR
+} TIM_PWM_Mode;
+
+typedef enum {
+    TIM_POLARITY_HIGH = 0x00U, // Active high
+    TIM_POLARITY_LOW = 0x01U // Active low
+} TIM_Polarity;
+
+/**
+ * Index of the first register a DMA burst writes, it's just the register's offset / 4
+ */
+typedef enum {
+    TIM_DMA_BASE_CR1 = 0x00U,
+    TIM_DMA_BASE_ARR = 0x0BU,
+    TIM_DMA_BASE_RCR = 0x0CU,
+    TIM_DMA_BASE_CCR1 = 0x0DU,
+    TIM_DMA_BASE_CCR2 = 0x0EU,
+    TIM_DMA_BASE_CCR3 = 0x0FU,
+    TIM_DMA_BASE_CCR4 = 0x10U
+} TIM_DMA_Base;
+
+#define TIM_DMA_BURST_END 0x12U // DCR, a burst has to stop before it (CR1-BDTR are the registers DMAR can reach)
+
+/**
+ * make sure to use the above enums when setting this init struct
+ *
+ * frequency - desired update (overflow) frequency in Hz, which is also the PWM frequency.
+ *             PSC/ARR are computed from the RCC timer clock to give the largest ARR (best duty resolution)
+ * count_mode - up/down/center aligned
+ */
+typedef struct {
+    uint32_t frequency;
+    TIM_CountMode count_mode;
+} TIM_Init_TypeDef;
+
+/**
+ * mode - PWM1/PWM2
+ * polarity - active high/low output
+ * pulse - initial compare value (0 to TIM_get_period()), duty = pulse / period
+ */
+typedef struct {
+    TIM_PWM_Mode mode;
+    TIM_Polarity polarity;
+    uint32_t pulse;
+} TIM_PWM_Init_TypeDef;
+
+/**
+ * Describes a DMA burst: on every update event the timer requests `length` transfers
+ * which are written through DMAR into consecutive registers starting at `base`.
+ * Check RM0390 tables 28/29 for the TIMx_UP stream/channel, e.g.
+ * TIM1_UP: DMA2 stream 5 ch 6, TIM2_UP: DMA1 stream 1/7 ch 3, TIM3_UP: DMA1 stream 2 ch 5,
+ * TIM4_UP: DMA1 stream 6 ch 2, TIM5_UP: DMA1 stream 0/6 ch 6, TIM8_UP: DMA2 stream 1 ch 7
+ *
+ * stream/channel - DMA stream wired to this timer's update request (its controller's clock must be enabled)
+ * base - first register written each burst
+ * length - registers written per burst, base + length can't go past TIM_DMA_BURST_END
+ */
+typedef struct {
+    DMA_Stream_TypeDef* stream;
+    DMA_Channel channel;
+    TIM_DMA_Base base;
+    uint8_t length;
+} TIM_Burst_TypeDef;
+
+// Input capture edge. BOTH timestamps rising and falling edges (for pulse width measurements)
+typedef enum {
+    TIM_IC_RISING = 0x00U,
+    TIM_IC_FALLING = 0x01U,
+    TIM_IC_BOTH = 0x02U
+} TIM_IC_Polarity;
+
+// Capture every 1st/2nd/4th/8th edge
+typedef enum {
+    TIM_IC_DIV_1 = 0x00U,
+    TIM_IC_DIV_2 = 0x01U,
+    TIM_IC_DIV_4 = 0x02U,
+    TIM_IC_DIV_8 = 0x03U
+} TIM_IC_Prescaler;
+
+/**
+ * polarity - which edge(s) to capture
+ * prescaler - capture every Nth edge
+ * filter - 0 to 15, digital filter length on the input (0 = none, see ICxF in RM0390)
+ */
+typedef struct {
+    TIM_IC_Polarity polarity;
+    TIM_IC_Prescaler prescaler;
+    uint8_t filter;
+} TIM_IC_Init_TypeDef;
+
+/**
+ * Describes where captured CCR values are streamed to. The DMA runs circularly, so `buffer` always
+ * holds the most recent `length` timestamps. Entries are uint16_t for 16 bit timers and uint32_t for TIM2/TIM5.
+ * Check RM0390 tables 28/29 for the TIMx_CHy stream/channel, e.g.
+ * TIM1_CH1: DMA2 stream 1/3 ch 6, TIM2_CH1: DMA1 stream 5 ch 3, TIM3_CH1: DMA1 stream 4 ch 5,
+ * TIM5_CH1: DMA1 stream 2 ch 6
+ *
+ * stream/channel - DMA stream wired to this channel's capture request (its controller's clock must be enabled)
+ * buffer - capture buffer, must stay valid until TIM_IC_stop_dma() is called
+ * length - number of entries in buffer
+ */
+typedef struct {
+    DMA_Stream_TypeDef* stream;
+    DMA_Channel channel;
+    void* buffer;
+    uint16_t length;
+} TIM_Capture_TypeDef;
+
+// Value written to SMCR.SMS. X4 counts every edge of both inputs
+typedef enum {
+    TIM_ENCODER_X2_TI1 = 0x01U,
+    TIM_ENCODER_X2_TI2 = 0x02U,
+    TIM_ENCODER_X4 = 0x03U
+} TIM_Encoder_Mode;
+
+/**
+ * mode - which edges are counted
+ * polarity - TIM_POLARITY_LOW inverts TI1, which reverses the count direction
+ * filter - 0 to 15, digital filter on both inputs (useful for noisy mechanical encoders)
+ */
+typedef struct {
+    TIM_Encoder_Mode mode;
+    TIM_Polarity polarity;
+    uint8_t filter;
+} TIM_Encoder_Init_TypeDef;
+
+/**
+ * Software state that extends the hardware count to 64 bits. Don't modify the fields directly
+ */
+typedef struct {
+    TIM_Reg_TypeDef* tim;
+    uint32_t last_count;
+    int64_t position;
+    uint8_t is_32bit;
+} TIM_Encoder_HandleTypeDef;
+
+
+// HAL FUNCTIONS ==============================================================
+/**
+ * @brief enables the APB1/APB2 peripheral clock for the given timer
+ *
+ * @param tim - TIM1 to TIM14
+ * @return HAL_Status - HAL_OK or HAL_ERROR
+ */
+HAL_Status TIM_enable_clock(TIM_Reg_TypeDef* tim);
+
+/**
+ * @brief Configures the time base (PSC/ARR) for the requested frequency with ARR preload enabled.
+ * 		  The timer is left stopped, call TIM_start() once the channels are set up.
+ * 		  Call this again if the APB prescalers are changed, as the timer clock changes with them
+ *
+ * @param tim - TIM1 to TIM14
+ * @param init_struct - pointer to init struct which contains the time base config
+ * @return HAL_Status - HAL_ERROR if the frequency can't be reached from the timer clock
+ */
+HAL_Status TIM_init(TIM_Reg_TypeDef* tim, const TIM_Init_TypeDef* init_struct);
+
+/**
+ * @brief Returns the number of counter ticks per period (ARR + 1), use this to convert duty to a pulse value
+ *
+ * @param tim
+ * @return uint32_t - ticks per period (0 if tim is invalid)
+ */
+uint32_t TIM_get_period(TIM_Reg_TypeDef* tim);
+
+/**
+ * @brief Starts the counter
+ *
+ * @param tim
+ * @return HAL_Status
+ */
+HAL_Status TIM_start(TIM_Reg_TypeDef* tim);
+
+/**
+ * @brief Stops the counter (the count is kept)
+ *
+ * @param tim
+ * @return HAL_Status
+ */
+HAL_Status TIM_stop(TIM_Reg_TypeDef* tim);
+
+/**
+ * @brief Enables the update (overflow) interrupt, for periodic ticks. The NVIC IRQ must be enabled separately
+ * 		  and the handler must call TIM_clear_update_flag()
+ *
+ * @param tim
+ * @return HAL_Status
+ */
+HAL_Status TIM_enable_update_irq(TIM_Reg_TypeDef* tim);
+
+/**
+ * @brief Clears the update interrupt flag, call this at the start of the timer's IRQ handler
+ *
+ * @param tim
+ * @return HAL_Status
+ */
+HAL_Status TIM_clear_update_flag(TIM_Reg_TypeDef* tim);
+
+/**
+ * @brief Configures a channel as a PWM output with CCR preload enabled.
+ * 		  The pin must be set up separately with GPIO_init() in GPIO_MODE_AF with the timer's AF
+ * 		  (AF1 for TIM1/2, AF2 for TIM3-5, AF3 for TIM8-11, AF9 for TIM12-14)
+ *
+ * @param tim - a timer with capture/compare channels (not TIM6/7)
+ * @param channel - TIM_CHANNEL_1 to 4 (not all timers have 4)
+ * @param init_struct - pointer to PWM config
+ * @return HAL_Status - HAL_OK or HAL_ERROR
+ */
+HAL_Status TIM_PWM_init(TIM_Reg_TypeDef* tim, TIM_Channel channel, const TIM_PWM_Init_TypeDef* init_struct);
+
+/**
+ * @brief Writes a new compare value. It goes into the preload register and is applied at the next update,
+ * 		  so it's safe to call at any point in the period
+ *
+ * @param tim
+ * @param channel
+ * @param pulse - 0 to TIM_get_period() (period = 100% duty)
+ * @return HAL_Status
+ */
+HAL_Status TIM_PWM_set_pulse(TIM_Reg_TypeDef* tim, TIM_Channel channel, uint32_t pulse);
+
+/**
+ * @brief Starts a circular DMA burst which reloads `burst->length` registers from `buffer` on every update event.
+ * 		  `buffer` holds `periods` bursts back to back (periods * length words) and is replayed forever,
+ * 		  so e.g. base = CCR1 and length = 4 updates all four duties every period with no CPU involvement.
+ * 		  The buffer may be modified while running, use the DMA HT/TC flags to refill the half not being read.
+ * 		  The buffer must stay valid until TIM_DMA_burst_stop() is called
+ *
+ * @param tim - a timer with an update DMA request (TIM1-8)
+ * @param burst - DMA burst description
+ * @param buffer - burst data, written to the registers in order
+ * @param periods - number of bursts in the buffer, periods * length must be <= 65535
+ * @return HAL_Status - HAL_OK or HAL_ERROR
+ */
+HAL_Status TIM_DMA_burst_start(TIM_Reg_TypeDef* tim, const TIM_Burst_TypeDef* burst, const uint32_t* buffer, uint16_t periods);
+
+/**
+ * @brief Stops the update DMA requests and the DMA stream. Register values from the last burst are kept
+ *
+ * @param tim
+ * @param burst - same burst description passed to TIM_DMA_burst_start()
+ * @return HAL_Status
+ */
+HAL_Status TIM_DMA_burst_stop(TIM_Reg_TypeDef* tim, const TIM_Burst_TypeDef* burst);
+
+/**
+ * @brief Configures the time base as a free running counter (ARR at its maximum) ticking at tick_frequency.
+ * 		  Use this instead of TIM_init() for input capture, so differences between timestamps are valid across wraps
+ *
+ * @param tim - TIM1 to TIM14
+ * @param tick_frequency - counter tick rate in Hz, must divide the timer clock reasonably (PSC = clk / tick - 1)
+ * @return HAL_Status - HAL_ERROR if tick_frequency is above the timer clock or needs PSC > 65535
+ */
+HAL_Status TIM_init_counter(TIM_Reg_TypeDef* tim, uint32_t tick_frequency);
+
+/**
+ * @brief Returns the actual counter tick rate (timer clock / (PSC + 1)) to convert captured ticks to time
+ *
+ * @param tim
+ * @return uint32_t - ticks per second (0 if tim is invalid)
+ */
+uint32_t TIM_get_tick_frequency(TIM_Reg_TypeDef* tim);
+
+/**
+ * @brief Configures a channel as an input capture directly mapped to its own pin (TIx -> ICx).
+ * 		  The pin must be set up separately with GPIO_init() in GPIO_MODE_AF with the timer's AF
+ *
+ * @param tim - a timer with capture/compare channels (not TIM6/7)
+ * @param channel - TIM_CHANNEL_1 to 4 (not all timers have 4)
+ * @param init_struct - pointer to capture config
+ * @return HAL_Status - HAL_OK or HAL_ERROR
+ */
+HAL_Status TIM_IC_init(TIM_Reg_TypeDef* tim, TIM_Channel channel, const TIM_IC_Init_TypeDef* init_struct);
+
+/**
+ * @brief Starts streaming every capture on the channel into capture->buffer with a circular DMA.
+ * 		  No interrupt is taken per edge, so this keeps working at capture rates of hundreds of kHz
+ *
+ * @param tim - a timer with capture DMA requests (TIM1-5, TIM8)
+ * @param channel - channel configured with TIM_IC_init()
+ * @param capture - DMA and buffer description
+ * @return HAL_Status - HAL_OK or HAL_ERROR
+ */
+HAL_Status TIM_IC_start_dma(TIM_Reg_TypeDef* tim, TIM_Channel channel, const TIM_Capture_TypeDef* capture);
+
+/**
+ * @brief Stops the capture DMA requests and the DMA stream
+ *
+ * @param tim
+ * @param channel
+ * @param capture - same description passed to TIM_IC_start_dma()
+ * @return HAL_Status
+ */
+HAL_Status TIM_IC_stop_dma(TIM_Reg_TypeDef* tim, TIM_Channel channel, const TIM_Capture_TypeDef* capture);
+
+/**
+ * @brief Returns the buffer index the DMA will write next. The newest timestamp is at (index - 1) mod length
+ *
+ * @param capture
+ * @return uint16_t - index 0 to length - 1
+ */
+uint16_t TIM_IC_get_write_index(const TIM_Capture_TypeDef* capture);
+
+/**
+ * @brief Returns the number of ticks between the two most recent captures (i.e. the signal period when
+ * 		  capturing one edge type). Divide TIM_get_tick_frequency() by this to get the signal frequency
+ *
+ * @param tim
+ * @param capture
+ * @return uint32_t - ticks between the last two captures (only meaningful once 2 captures have happened)
+ */
+uint32_t TIM_IC_get_last_period(TIM_Reg_TypeDef* tim, const TIM_Capture_TypeDef* capture);
+
+/**
+ * @brief Puts the timer in hardware quadrature encoder mode on CH1/CH2 and starts it.
+ * 		  The pins must be set up separately with GPIO_init() in GPIO_MODE_AF with the timer's AF
+ *
+ * @param handle - encoder state, filled in by this function
+ * @param tim - a timer with an encoder interface (TIM1-5, TIM8)
+ * @param init_struct - pointer to encoder config
+ * @return HAL_Status - HAL_OK or HAL_ERROR
+ */
+HAL_Status TIM_encoder_init(TIM_Encoder_HandleTypeDef* handle, TIM_Reg_TypeDef* tim, const TIM_Encoder_Init_TypeDef* init_struct);
+
+/**
+ * @brief Reads the hardware count once and folds the change since the last call into the 64 bit position.
+ * 		  MUST be called at least once every 32768 counts on 16 bit timers (2^31 on TIM2/TIM5),
+ * 		  e.g. from the control loop tick. Calling it at a fixed rate makes the return value the speed
+ *
+ * @param handle - encoder state from TIM_encoder_init()
+ * @return int32_t - signed counts since the previous call
+ */
+int32_t TIM_encoder_update(TIM_Encoder_HandleTypeDef* handle);
+
+/**
+ * @brief Updates and returns the 64 bit position
+ *
+ * @param handle - encoder state from TIM_encoder_init()
+ * @return int64_t - counts since TIM_encoder_init()
+ */
+int64_t TIM_encoder_get_position(TIM_Encoder_HandleTypeDef* handle);
+
+#endif
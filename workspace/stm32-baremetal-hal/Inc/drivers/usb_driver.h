@@ -0,0 +1,224 @@
+/*
+ * usb_driver.h
+ *
+ * Header file for usb_driver.c
+ * Contains function prototypes, register struct definitions, macros for the USB OTG FS core in device mode.
+ * Like sdio_driver.h, this is just the controller: endpoints, transfers and bus events. Requests, descriptors and
+ * classes live in utils/usb_cdc.h, which gets the events through the USB_Callbacks given to USB_init()
+ *
+ * Things to keep in mind:
+ * - The core needs a 48MHz clock: start the PLL with RCC_enable_PLL() first (Q output = 48MHz), and HCLK must
+ *   be at least 14.2MHz
+ * - Pins are fixed: PA11 = DM, PA12 = DP (AF10). VBUS sensing is off (the B session valid signal is forced),
+ *   so PA9 stays free and the device assumes it's always plugged in. The Nucleo has no USB connector on these
+ *   pins, wire one up through the morpho header
+ * - Transfers are interrupt driven (OTG_FS_IRQHandler is in usb_driver.c). The callbacks run in that interrupt,
+ *   and the USB_ep_* functions must only be called from them or with the OTG_FS IRQ masked
+ * - The FS core has no DMA: IN data is copied by the CPU from the caller's buffer straight into the endpoint's
+ *   TX FIFO as space frees up, so there's no intermediate copy, but the buffer must stay untouched until the
+ *   transfer completes
+ *
+ *  Written by Ryan Wong
+ */
+
+#ifndef USB_DRIVER_H_
+#define USB_DRIVER_H_
+
+#include <stdint.h>
+#include "drivers/types.h"
+
+
+// REGISTERS ==============================================================
+#define USB_OTG_FS_BASE 0x50000000U
+#define USB_OTG_FS ((USB_Global_Reg_TypeDef*)USB_OTG_FS_BASE)
+#define USB_DEVICE ((USB_Device_Reg_TypeDef*)(USB_OTG_FS_BASE + 0x800U))
+#define USB_IN_EP(n) ((USB_IN_EP_Reg_TypeDef*)(USB_OTG_FS_BASE + 0x900U + 0x20U * (n)))
+#define USB_OUT_EP(n) ((USB_OUT_EP_Reg_TypeDef*)(USB_OTG_FS_BASE + 0xB00U + 0x20U * (n)))
+#define USB_PCGCCTL (*(volatile uint32_t*)(USB_OTG_FS_BASE + 0xE00U))
+// Every endpoint's FIFO is a single word register, pushes and pops go to the same address
+#define USB_FIFO(n) (*(volatile uint32_t*)(USB_OTG_FS_BASE + 0x1000U * ((n) + 1U)))
+
+typedef struct {
+    volatile uint32_t GOTGCTL;
+    volatile uint32_t GOTGINT;
+    volatile uint32_t GAHBCFG;
+    volatile uint32_t GUSBCFG;
+    volatile uint32_t GRSTCTL;
+    volatile uint32_t GINTSTS;
+    volatile uint32_t GINTMSK;
+    volatile uint32_t GRXSTSR;
+    volatile uint32_t GRXSTSP;
+    volatile uint32_t GRXFSIZ;
+    volatile uint32_t DIEPTXF0;
+    volatile uint32_t GNPTXSTS;
+    uint32_t reserved0[2];
+    volatile uint32_t GCCFG;
+    volatile uint32_t CID;
+    uint32_t reserved1[48];
+    volatile uint32_t HPTXFSIZ;
+    volatile uint32_t DIEPTXF[5]; // endpoints 1-5
+} USB_Global_Reg_TypeDef;
+
+typedef struct {
+    volatile uint32_t DCFG;
+    volatile uint32_t DCTL;
+    volatile uint32_t DSTS;
+    uint32_t reserved0;
+    volatile uint32_t DIEPMSK;
+    volatile uint32_t DOEPMSK;
+    volatile uint32_t DAINT;
+    volatile uint32_t DAINTMSK;
+    uint32_t reserved1[2];
+    volatile uint32_t DVBUSDIS;
+    volatile uint32_t DVBUSPULSE;
+    uint32_t reserved2;
+    volatile uint32_t DIEPEMPMSK;
+} USB_Device_Reg_TypeDef;
+
+typedef struct {
+    volatile uint32_t DIEPCTL;
+    uint32_t reserved0;
+    volatile uint32_t DIEPINT;
+    uint32_t reserved1;
+    volatile uint32_t DIEPTSIZ;
+    uint32_t reserved2;
+    volatile uint32_t DTXFSTS;
+    uint32_t reserved3;
+} USB_IN_EP_Reg_TypeDef;
+
+typedef struct {
+    volatile uint32_t DOEPCTL;
+    uint32_t reserved0;
+    volatile uint32_t DOEPINT;
+    uint32_t reserved1;
+    volatile uint32_t DOEPTSIZ;
+    uint32_t reserved2[3];
+} USB_OUT_EP_Reg_TypeDef;
+
+#define USB_NUM_ENDPOINTS 6U
+#define USB_FIFO_WORDS 320U // 1.25KB shared by the RX FIFO and every TX FIFO
+#define USB_FIFO_MIN_WORDS 16U
+#define USB_EP0_SIZE 64U
+#define USB_MIN_HCLK 14200000U
+
+
+// USB Config Types ==============================================================
+/**
+ * Same values as the transfer type in an endpoint descriptor's bmAttributes
+ */
+typedef enum {
+    USB_EP_CONTROL = 0x00U,
+    USB_EP_ISOCHRONOUS = 0x01U,
+    USB_EP_BULK = 0x02U,
+    USB_EP_INTERRUPT = 0x03U
+} USB_EP_Type;
+
+/**
+ * Bus events, all called from OTG_FS_IRQHandler
+ *
+ * reset - bus reset: every endpoint but 0 is closed, every transfer dropped, and the address is back to 0
+ * setup - a SETUP packet (8 bytes) arrived on endpoint 0. Endpoint 0 stalls are cleared
+ * complete - a transfer started with USB_ep_transmit() (ep_addr has bit 7 set) or USB_ep_receive() finished,
+ * 			  len is how many bytes were sent/received
+ */
+typedef struct {
+    void (*reset)(void);
+    void (*setup)(const uint8_t* packet);
+    void (*complete)(uint8_t ep_addr, uint32_t len);
+} USB_Callbacks;
+
+/**
+ * callbacks - bus events, must stay valid while the core is running
+ * rx_fifo_words - shared by every OUT endpoint, at least (max packet / 4) + 13 words for SETUPs and status
+ * tx_fifo_words - per IN endpoint, 0 for unused ones (except endpoint 0). A few packets' worth keeps a bulk
+ * 				   endpoint busy while the CPU refills it. Everything has to fit in USB_FIFO_WORDS
+ * irq_priority - OTG_FS interrupt priority, 0 to 15
+ */
+typedef struct {
+    const USB_Callbacks* callbacks;
+    uint16_t rx_fifo_words;
+    uint16_t tx_fifo_words[USB_NUM_ENDPOINTS];
+    uint8_t irq_priority;
+} USB_Init_TypeDef;
+
+
+// HAL FUNCTIONS ==============================================================
+/**
+ * @brief Enables the OTG FS clock and pins, resets the core into device mode, splits up the FIFO RAM and
+ * 		  enables the interrupt. The device stays disconnected until USB_connect()
+ *
+ * @param init_struct
+ * @return HAL_Status - HAL_ERROR if the 48MHz clock isn't running, HCLK is too slow, the FIFOs don't fit or the
+ * 						core doesn't come out of reset
+ */
+HAL_Status USB_init(const USB_Init_TypeDef* init_struct);
+
+/**
+ * @brief Turns the DP pull up on, so the host sees the device and resets it
+ */
+void USB_connect(void);
+
+/**
+ * @brief Turns the DP pull up off, the host sees the device unplugged
+ */
+void USB_disconnect(void);
+
+/**
+ * @brief Sets the device address. Call it as soon as SET_ADDRESS arrives, before its status stage:
+ * 		  the core finishes the status stage on the old address by itself
+ *
+ * @param address - 0 to 127
+ */
+void USB_set_address(uint8_t address);
+
+/**
+ * @brief Activates an endpoint after SET_CONFIGURATION (endpoint 0 is always active), with its data toggle at DATA0
+ *
+ * @param ep_addr - endpoint number, bit 7 set for IN
+ * @param type
+ * @param max_packet - up to 64 bytes (1023 for isochronous)
+ * @return HAL_Status - HAL_ERROR for an endpoint the core doesn't have or an IN endpoint with no TX FIFO
+ */
+HAL_Status USB_ep_open(uint8_t ep_addr, USB_EP_Type type, uint16_t max_packet);
+
+/**
+ * @brief Starts sending len bytes on an IN endpoint, split into max packet sized packets (the last one short).
+ * 		  len = 0 sends a zero length packet. The complete callback runs once the host has taken all of it
+ *
+ * @param ep_addr - bit 7 set
+ * @param buffer - read straight into the TX FIFO while the transfer runs, any alignment. May be NULL if len is 0
+ * @param len
+ * @return HAL_Status - HAL_ERROR if the endpoint isn't open or already has a transfer running
+ */
+HAL_Status USB_ep_transmit(uint8_t ep_addr, const void* buffer, uint32_t len);
+
+/**
+ * @brief Lets an OUT endpoint take up to len bytes. The transfer completes on a short packet or once len bytes
+ * 		  have arrived. Until then the endpoint NAKs anything that doesn't fit
+ *
+ * @param ep_addr - bit 7 clear
+ * @param buffer - may be NULL if len is 0 (e.g. a control status stage)
+ * @param len
+ * @return HAL_Status - HAL_ERROR if the endpoint isn't open or already has a transfer running
+ */
+HAL_Status USB_ep_receive(uint8_t ep_addr, void* buffer, uint32_t len);
+
+/**
+ * @brief Drops an IN endpoint's transfer without running the complete callback. Packets already in its TX FIFO
+ * 		  are flushed, the host gets whatever was sent before
+ *
+ * @param ep_addr - bit 7 set
+ * @return HAL_Status
+ */
+HAL_Status USB_ep_abort(uint8_t ep_addr);
+
+/**
+ * @brief Stalls an endpoint, or clears the stall (which also resets its data toggle to DATA0)
+ *
+ * @param ep_addr
+ * @param stall - 1 to stall, 0 to clear
+ * @return HAL_Status
+ */
+HAL_Status USB_ep_stall(uint8_t ep_addr, uint8_t stall);
+
+#endif
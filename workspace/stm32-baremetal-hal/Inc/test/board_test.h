@@ -0,0 +1,14 @@
+/**
+ * Header file containing function prototypes of the self-checking tests and benchmarks for the board pin map
+ * Like the gpio_driver tests, these run against RAM backed fake ports. See test_runner.h
+ * 
+ * Written by Ryan Wong
+ */
+
+#ifndef BOARD_TEST_H_
+#define BOARD_TEST_H_
+
+void BOARD_run_tests();
+void BOARD_run_benchmarks();
+
+#endif
\ No newline at end of file
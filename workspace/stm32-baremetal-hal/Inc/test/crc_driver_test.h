@@ -0,0 +1,39 @@
+/**
+ * Header file containing function prototypes of the tests for crc_driver
+ * Results are left in the CRC_test_* variables so they can be watched with the debugger's live expressions
+ * 
+ * Written by Ryan Wong
+ */
+
+#ifndef CRC_DRIVER_TEST_H_
+#define CRC_DRIVER_TEST_H_
+
+#include <stdint.h>
+
+/**
+ * check_value - standard CRC of "123456789", should be 0xCBF43926
+ * passed - 1 if the check value, the chunked/unaligned checksum and the DMA checksum all matched
+ * software_cycles - bitwise software CRC-32 of CRC_TEST_BLOCK_SIZE bytes
+ * standard_cycles - CRC_compute() in standard mode over the same block
+ * native_cycles - CRC_compute() in native mode over the same block
+ * dma_cycles - CRC_update_dma() until CRC_dma_poll() reports done
+ * dma_submit_cycles - just the CRC_update_dma() call, i.e. what the CPU actually pays
+ */
+typedef struct {
+    uint32_t check_value;
+    uint8_t passed;
+    uint32_t software_cycles;
+    uint32_t standard_cycles;
+    uint32_t native_cycles;
+    uint32_t dma_cycles;
+    uint32_t dma_submit_cycles;
+} CRC_Test_Result;
+
+#define CRC_TEST_BLOCK_SIZE 4096U
+
+extern volatile CRC_Test_Result CRC_test_result;
+
+void CRC_test_init();
+void CRC_test();
+
+#endif
\ No newline at end of file
@@ -0,0 +1,14 @@
+/**
+ * Header file containing function prototypes of simple tests for the deferred_log utility
+ * as of now, they are not automated and don't use a testing framework, just visual inspection
+ * 
+ * Written by Ryan Wong
+ */
+
+#ifndef DEFERRED_LOG_TEST_H_
+#define DEFERRED_LOG_TEST_H_
+
+void DLOG_test_init();
+void DLOG_test();
+
+#endif
\ No newline at end of file
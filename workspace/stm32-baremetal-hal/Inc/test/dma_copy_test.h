@@ -0,0 +1,38 @@
+/**
+ * Header file containing function prototypes of the throughput benchmark for the dma_copy utility
+ * Results are left in DMA_copy_test_results so they can be watched with the debugger's live expressions
+ * 
+ * Written by Ryan Wong
+ */
+
+#ifndef DMA_COPY_TEST_H_
+#define DMA_COPY_TEST_H_
+
+#include <stdint.h>
+
+/**
+ * One row per block size, all in DWT cycles
+ * cpu_memcpy_cycles - plain memcpy() of the block
+ * dma_memcpy_cycles - dma_memcpy() submit until the handle reports done
+ * dma_submit_cycles - just the dma_memcpy() call, i.e. what the CPU actually pays
+ * cpu_memset_cycles / dma_memset_cycles - same for a fill
+ * verified - 1 if the DMA copied data matched the source
+ */
+typedef struct {
+    uint32_t block_size;
+    uint32_t cpu_memcpy_cycles;
+    uint32_t dma_memcpy_cycles;
+    uint32_t dma_submit_cycles;
+    uint32_t cpu_memset_cycles;
+    uint32_t dma_memset_cycles;
+    uint8_t verified;
+} DMA_Copy_Test_Result;
+
+#define DMA_COPY_TEST_NUM_SIZES 5U
+
+extern volatile DMA_Copy_Test_Result DMA_copy_test_results[DMA_COPY_TEST_NUM_SIZES];
+
+void DMA_copy_test_init();
+void DMA_copy_test();
+
+#endif
\ No newline at end of file
@@ -0,0 +1,40 @@
+/**
+ * Header file containing function prototypes of the ISR latency measurement harness for the fpu_driver
+ * Results are left in FPU_test_results so they can be watched with the debugger's live expressions
+ *
+ * Written by Ryan Wong
+ */
+
+#ifndef FPU_TEST_H_
+#define FPU_TEST_H_
+
+#include <stdint.h>
+#include "drivers/fpu_driver.h"
+
+// Latency budget (in cycles) for entering/leaving an integer-only control loop ISR
+#define FPU_TEST_INT_ISR_BUDGET 24U
+
+/**
+ * One row per (stacking mode, ISR type) combination
+ * entry_cycles - pend request -> first instruction of the handler
+ * body_cycles - first -> last timestamp inside the handler (includes any lazy FP save)
+ * exit_cycles - last instruction of the handler -> back in thread mode
+ */
+typedef struct {
+    FPU_Stacking mode;
+    uint8_t float_isr;
+    uint32_t entry_cycles;
+    uint32_t body_cycles;
+    uint32_t exit_cycles;
+} FPU_Test_Result;
+
+#define FPU_TEST_NUM_RESULTS 5U
+
+extern volatile FPU_Test_Result FPU_test_results[FPU_TEST_NUM_RESULTS];
+// 1 if every integer ISR measurement stayed within FPU_TEST_INT_ISR_BUDGET for entry and exit
+extern volatile uint8_t FPU_test_passed;
+
+void FPU_test_init();
+void FPU_test();
+
+#endif
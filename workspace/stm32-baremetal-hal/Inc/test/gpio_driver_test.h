@@ -1,6 +1,7 @@
 /**
- * Header file containing function prototypes of simple tests for the gpio_driver HAL
- * as of now, they are not automated and don't use a testing framework, just visual inspection
+ * Header file containing function prototypes of the self-checking tests and benchmarks for the gpio_driver HAL
+ * The tests run against RAM backed fake ports, so every register write can be checked (and so they run under
+ * an emulator that doesn't model the GPIO peripheral). See test_runner.h
  * 
  * Written by Ryan Wong
  */
@@ -8,7 +9,7 @@
  #ifndef GPIO_DRIVER_TEST_H_
  #define GPIO_DRIVER_TEST_H_
 
-void GPIO_test_init();
-void GPIO_test();
+void GPIO_run_tests();
+void GPIO_run_benchmarks();
 
-#endif
\ No newline at end of file
+#endif
\ No newline at end of file
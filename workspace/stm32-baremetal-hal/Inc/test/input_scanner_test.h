@@ -0,0 +1,14 @@
+/**
+ * Header file containing function prototypes of simple tests for the input_scanner
+ * as of now, they are not automated and don't use a testing framework, just visual inspection
+ * 
+ * Written by Ryan Wong
+ */
+
+#ifndef INPUT_SCANNER_TEST_H_
+#define INPUT_SCANNER_TEST_H_
+
+void SCAN_test_init();
+void SCAN_test();
+
+#endif
\ No newline at end of file
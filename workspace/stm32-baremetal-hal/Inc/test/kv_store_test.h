@@ -0,0 +1,25 @@
+/**
+ * Header file containing function prototypes of the tests for the flash driver and kv_store
+ * Results are left in the KV_test_* variables so they can be watched with the debugger's live expressions
+ * 
+ * Written by Ryan Wong
+ */
+
+#ifndef KV_STORE_TEST_H_
+#define KV_STORE_TEST_H_
+
+#include <stdint.h>
+
+// Number of times the board has booted, kept in the store. Should go up by one every reset
+extern volatile uint32_t KV_test_boot_count;
+// KV_init() (index rebuild), one KV_set() append and one KV_get(), in DWT cycles
+extern volatile uint32_t KV_test_mount_cycles;
+extern volatile uint32_t KV_test_set_cycles;
+extern volatile uint32_t KV_test_get_cycles;
+// 1 if the values written read back correctly
+extern volatile uint8_t KV_test_passed;
+
+void KV_test_init();
+void KV_test();
+
+#endif
\ No newline at end of file
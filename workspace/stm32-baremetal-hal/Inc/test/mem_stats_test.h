@@ -0,0 +1,13 @@
+/**
+ * Header file containing function prototypes of the self-checking tests for mem_stats
+ * Run these last, so the stack and heap numbers they report cover all the other tests. See test_runner.h
+ * 
+ * Written by Ryan Wong
+ */
+
+#ifndef MEM_STATS_TEST_H_
+#define MEM_STATS_TEST_H_
+
+void MEM_run_tests();
+
+#endif
\ No newline at end of file
@@ -0,0 +1,36 @@
+/**
+ * Header file containing function prototypes of the tests for the QUADSPI driver and qspi_flash
+ * Results are left in the QSPI_test_* variables so they can be watched with the debugger's live expressions
+ * 
+ * WARNING: this erases and rewrites the last 64KB of the external flash. Needs a W25Q style chip wired to the
+ * QUADSPI pins (see drivers/qspi_driver.h), and shares PC8-PC10 with the SDIO test
+ * 
+ * Written by Ryan Wong
+ */
+
+#ifndef QSPI_FLASH_TEST_H_
+#define QSPI_FLASH_TEST_H_
+
+#include <stdint.h>
+
+// What QSPI_flash_init() found, only valid if QSPI_test_init_ok is 1
+extern volatile uint8_t QSPI_test_init_ok;
+extern volatile uint32_t QSPI_test_id;
+extern volatile uint32_t QSPI_test_size;
+// Sequential memcpy out of the memory mapped window vs out of internal flash, and indirect mode reads, in kB/s
+extern volatile uint32_t QSPI_test_mapped_kbps;
+extern volatile uint32_t QSPI_test_internal_kbps;
+extern volatile uint32_t QSPI_test_indirect_kbps;
+// Random 4 byte reads from the mapped window vs internal flash, average DWT cycles per read
+extern volatile uint32_t QSPI_test_mapped_random_cycles;
+extern volatile uint32_t QSPI_test_internal_random_cycles;
+// 1 if the erased, programmed pattern read back correctly through both the mapped window and indirect reads
+extern volatile uint8_t QSPI_test_passed;
+// 1 if a QSPI_CONST table and a QSPI_CODE function ran in place from the flash. Only built with QSPI_XIP_DEMO
+// defined, and only tried if the .qspi image has been programmed
+extern volatile uint8_t QSPI_test_xip_ok;
+
+void QSPI_test_init();
+void QSPI_test();
+
+#endif
\ No newline at end of file
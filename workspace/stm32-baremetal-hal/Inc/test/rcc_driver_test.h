@@ -0,0 +1,14 @@
+/**
+ * Header file containing function prototypes of the self-checking tests and benchmarks for the rcc_driver HAL
+ * Every test puts the prescalers and the frequency globals back the way it found them. See test_runner.h
+ * 
+ * Written by Ryan Wong
+ */
+
+#ifndef RCC_DRIVER_TEST_H_
+#define RCC_DRIVER_TEST_H_
+
+void RCC_run_tests();
+void RCC_run_benchmarks();
+
+#endif
\ No newline at end of file
@@ -0,0 +1,28 @@
+/**
+ * Header file containing function prototypes of the SDIO driver and sd_card streaming benchmark
+ * Results are left in the SD_test_* variables so they can be watched with the debugger's live expressions
+ * 
+ * WARNING: this overwrites 4MB in the middle of the card, use a scratch card
+ * 
+ * Written by Ryan Wong
+ */
+
+#ifndef SD_CARD_TEST_H_
+#define SD_CARD_TEST_H_
+
+#include <stdint.h>
+#include "utils/sd_card.h"
+
+// What SD_init() found, only valid if SD_test_init_ok is 1
+extern volatile uint8_t SD_test_init_ok;
+extern SD_Card_Info SD_test_info;
+// Double buffered streaming write of SD_TEST_BYTES and multi block read back, in kB/s (1kB = 1000 bytes)
+extern volatile uint32_t SD_test_write_kbps;
+extern volatile uint32_t SD_test_read_kbps;
+// 1 if everything read back matched what was streamed
+extern volatile uint8_t SD_test_passed;
+
+void SD_test_init();
+void SD_test();
+
+#endif
\ No newline at end of file
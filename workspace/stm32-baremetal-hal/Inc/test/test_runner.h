@@ -0,0 +1,109 @@
+/**
+ * Header file for the self-checking test and benchmark runner
+ * 
+ * Test suites call TEST_run() for each test function, and use the TEST_ASSERT macros inside them.
+ * Benchmarks are timed with SysTick (DWT isn't modelled by QEMU), so the numbers are CPU cycles on the board,
+ * and deterministic virtual time (proportional to instructions executed) under QEMU with -icount.
+ * With -icount shift=0 one tick is 1000 / 168 ~= 5.95 instructions (1ns per instruction, SysTick on the 168MHz
+ * netduinoplus2 SYSCLK), tools/check_bench.py prints the instruction counts. QEMU can't give cycle counts, it
+ * doesn't model pipeline or wait state timing, so those only come from running the same build on the board.
+ * 
+ * When built with HAL_AUTOTEST defined, every result is written over semihosting to the console and as JSON lines
+ * to TEST_RESULTS_FILE, and TEST_end() exits the emulator with a pass/fail status.
+ * See tools/run_emulator_tests.sh. Without HAL_AUTOTEST nothing is printed (semihosting would fault without a
+ * debugger attached), the counts are just left in TEST_summary for the live expressions
+ * 
+ * Written by Ryan Wong
+ */
+
+#ifndef TEST_RUNNER_H_
+#define TEST_RUNNER_H_
+
+#include <stdint.h>
+#include "drivers/gpio_driver.h"
+
+#define TEST_RESULTS_FILE "test_results.jsonl"
+#define TEST_BENCH_ITERATIONS 1000U
+
+typedef struct {
+    uint32_t passed;
+    uint32_t failed;
+    uint32_t skipped;
+    uint32_t benchmarks;
+} TEST_Summary;
+
+extern volatile TEST_Summary TEST_summary;
+
+#define TEST_ASSERT(condition) TEST_check((condition) != 0, #condition, __FILE__, __LINE__)
+#define TEST_ASSERT_EQUAL(expected, actual) TEST_check_equal((uint32_t)(expected), (uint32_t)(actual), #actual, __FILE__, __LINE__)
+
+/**
+ * Times TEST_BENCH_ITERATIONS runs of statement and records the average per call, with the loop's own
+ * overhead taken off. The empty asm stops the compiler hoisting the statement out of the loop
+ */
+#define TEST_BENCH(name, statement) do { \
+    uint32_t bench_start = TEST_ticks(); \
+    for (uint32_t bench_i = 0; bench_i < TEST_BENCH_ITERATIONS; bench_i++) { \
+        statement; \
+        __asm volatile ("" ::: "memory"); \
+    } \
+    TEST_record_bench((name), TEST_elapsed(bench_start)); \
+} while (0)
+
+/**
+ * @brief Starts SysTick as a free running 24 bit counter, calibrates the benchmark loop overhead,
+ * 		  and opens the results file (HAL_AUTOTEST only)
+ */
+void TEST_begin(void);
+
+/**
+ * @brief Runs one test and records whether any of its assertions failed
+ * 
+ * @param name - test name in the results
+ * @param test - test function
+ */
+void TEST_run(const char* name, void (*test)(void));
+
+/**
+ * @brief Marks the running test as skipped (e.g. the emulator doesn't model the peripheral). Return straight after
+ * 
+ * @param reason 
+ */
+void TEST_skip(const char* reason);
+
+void TEST_check(uint8_t passed, const char* expression, const char* file, uint32_t line);
+void TEST_check_equal(uint32_t expected, uint32_t actual, const char* expression, const char* file, uint32_t line);
+void TEST_record_bench(const char* name, uint32_t ticks);
+
+/**
+ * @brief Records a measurement that isn't a benchmark (e.g. stack high water mark), reported but not checked
+ * 
+ * @param name 
+ * @param value 
+ */
+void TEST_record_metric(const char* name, uint32_t value);
+
+/**
+ * @brief Sets up a RAM GPIO_Reg_TypeDef for driver tests: the configuration registers to pattern (so a field
+ * 		  that isn't touched shows up, and one that's written has to clear the pattern's bits first), the data and
+ * 		  lock registers to 0
+ *
+ * @param port - fake port in RAM
+ * @param pattern
+ */
+void TEST_reset_port(GPIO_Reg_TypeDef* port, uint32_t pattern);
+
+/**
+ * @brief SysTick counts DOWN, so use TEST_elapsed() rather than subtracting directly
+ */
+uint32_t TEST_ticks(void);
+uint32_t TEST_elapsed(uint32_t start);
+
+/**
+ * @brief Writes the summary and closes the results file. With HAL_AUTOTEST this exits the emulator and doesn't return
+ * 
+ * @return int - number of failed tests
+ */
+int TEST_end(void);
+
+#endif
\ No newline at end of file
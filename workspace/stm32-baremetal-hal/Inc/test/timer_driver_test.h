@@ -0,0 +1,14 @@
+/**
+ * Header file containing function prototypes of simple tests for the timer_driver HAL
+ * as of now, they are not automated and don't use a testing framework, just visual inspection
+ * 
+ * Written by Ryan Wong
+ */
+
+#ifndef TIMER_DRIVER_TEST_H_
+#define TIMER_DRIVER_TEST_H_
+
+void TIM_test_init();
+void TIM_test();
+
+#endif
\ No newline at end of file
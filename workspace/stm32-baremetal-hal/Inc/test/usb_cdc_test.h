@@ -0,0 +1,29 @@
+/**
+ * Header file containing function prototypes of the tests for the OTG FS driver and usb_cdc
+ * Results are left in the USB_test_* variables so they can be watched with the debugger's live expressions
+ * 
+ * Needs a USB connector wired to PA11 (DM) and PA12 (DP), see drivers/usb_driver.h. Open the port in any
+ * terminal program: printf output shows up there, followed by a 1MB stream and its throughput
+ * 
+ * Written by Ryan Wong
+ */
+
+#ifndef USB_CDC_TEST_H_
+#define USB_CDC_TEST_H_
+
+#include <stdint.h>
+
+// 1 once the PLL is locked and the device is on the bus
+extern volatile uint8_t USB_test_init_ok;
+// Times a program on the PC has opened the port
+extern volatile uint32_t USB_test_opens;
+// Last stream: bytes sent and kB/s (1.216MB/s is the full speed bulk limit)
+extern volatile uint32_t USB_test_bytes;
+extern volatile uint32_t USB_test_kbps;
+// 1 if the last stream went out completely, 0 if the port closed or the bus reset in the middle
+extern volatile uint8_t USB_test_passed;
+
+void USB_test_init();
+void USB_test();
+
+#endif
\ No newline at end of file
@@ -0,0 +1,172 @@
+/*
+ * board.h
+ *
+ * Header file for board.c
+ * Declarative pin map for the board. Every pin the application uses is one line of BOARD_PIN_MAP, and the
+ * preprocessor folds the table into the final MODER/OTYPER/OSPEEDR/PUPDR/AFRL/AFRH values (plus masks) for
+ * each port, so BOARD_apply() is just a handful of register writes per port instead of one GPIO_init() per pin.
+ * Two lines claiming the same pin fail the build (_Static_assert in board.c).
+ *
+ * Things to keep in mind:
+ * - Only the pins in the map are touched, everything else on the port (e.g. PA13/PA14, the debugger's SWD
+ *   pins) keeps its reset/current setting
+ * - Drivers with fixed pins (SDIO) still set their own up, they don't need to be in the map
+ * - The fold macros take the map as a parameter, so other tables (e.g. the tests') go through the same code
+ *
+ *  Written by Ryan Wong
+ */
+
+#ifndef BOARD_H_
+#define BOARD_H_
+
+#include <stdint.h>
+#include "drivers/types.h"
+#include "drivers/gpio_driver.h"
+
+
+// BOARD PIN MAP ==============================================================
+/**
+ * One PIN(arg, port, pin, mode, otype, ospeed, pupd, af, init) line per pin. arg is for the fold macros, just
+ * pass it through. The rest are the GPIO_Init_TypeDef fields without their enum prefixes:
+ * port - A to H
+ * pin - 0 to 15
+ * mode - INPUT, OUTPUT, AF, ANALOG
+ * otype - PP, OD
+ * ospeed - LOW, MED, FAST, HIGH
+ * pupd - NONE, PU, PD
+ * af - 0 to 15, only used in AF mode
+ * init - 0 or 1, starting output level, only used in OUTPUT mode
+ *
+ * Nucleo-F446RE, set up for the on-board demos in main.c
+ */
+#define BOARD_PIN_MAP(PIN, arg) \
+    PIN(arg, A, 0, AF, PP, LOW, PD, 2, 0)       /* TIM5_CH1 input capture (timer_driver_test.c) */ \
+    PIN(arg, A, 5, AF, PP, LOW, NONE, 1, 0)     /* LD2 user LED as TIM2_CH1 PWM */ \
+    PIN(arg, C, 13, INPUT, PP, LOW, NONE, 0, 0) /* B1 user button, external pull up */
+
+
+// FOLDING ==============================================================
+#define BOARD_NUM_PORTS 8U
+
+#define BOARD_PORT_A 0U
+#define BOARD_PORT_B 1U
+#define BOARD_PORT_C 2U
+#define BOARD_PORT_D 3U
+#define BOARD_PORT_E 4U
+#define BOARD_PORT_F 5U
+#define BOARD_PORT_G 6U
+#define BOARD_PORT_H 7U
+
+/**
+ * Final register values for one port, and which bits of each register the map owns
+ * pins - pins the map owns, 1 bit each (OTYPER mask)
+ * out_pins - owned pins in OUTPUT mode, odr is their starting level
+ * mask2 - 2 bit fields of the owned pins (MODER/OSPEEDR/PUPDR mask)
+ * afrl_mask, afrh_mask - 4 bit fields of the owned AF mode pins
+ */
+typedef struct {
+    uint16_t pins;
+    uint16_t out_pins;
+    uint16_t odr;
+    uint32_t mask2;
+    uint32_t afrl_mask;
+    uint32_t afrh_mask;
+    uint32_t moder;
+    uint32_t otyper;
+    uint32_t ospeedr;
+    uint32_t pupdr;
+    uint32_t afrl;
+    uint32_t afrh;
+} BOARD_Port_Config;
+
+// One term per map line, each only counts towards port p
+#define BOARD_ON(p, port) (BOARD_PORT_##port == (p))
+#define BOARD_IS_AF(mode) (GPIO_MODE_##mode == GPIO_MODE_AF)
+#define BOARD_IS_OUT(mode) (GPIO_MODE_##mode == GPIO_MODE_OUTPUT)
+
+#define BOARD_PINS_TERM(p, port, pin, mode, otype, ospeed, pupd, af, init) \
+    | (BOARD_ON(p, port) ? (0x01U << (pin)) : 0U)
+#define BOARD_PIN_SUM_TERM(p, port, pin, mode, otype, ospeed, pupd, af, init) \
+    + (BOARD_ON(p, port) ? (0x01U << (pin)) : 0U)
+#define BOARD_OUT_PINS_TERM(p, port, pin, mode, otype, ospeed, pupd, af, init) \
+    | ((BOARD_ON(p, port) && BOARD_IS_OUT(mode)) ? (0x01U << (pin)) : 0U)
+#define BOARD_ODR_TERM(p, port, pin, mode, otype, ospeed, pupd, af, init) \
+    | ((BOARD_ON(p, port) && BOARD_IS_OUT(mode) && (init)) ? (0x01U << (pin)) : 0U)
+#define BOARD_MASK2_TERM(p, port, pin, mode, otype, ospeed, pupd, af, init) \
+    | (BOARD_ON(p, port) ? (0x03U << ((pin) * 2U)) : 0U)
+#define BOARD_MODER_TERM(p, port, pin, mode, otype, ospeed, pupd, af, init) \
+    | (BOARD_ON(p, port) ? ((uint32_t)GPIO_MODE_##mode << ((pin) * 2U)) : 0U)
+#define BOARD_OTYPER_TERM(p, port, pin, mode, otype, ospeed, pupd, af, init) \
+    | (BOARD_ON(p, port) ? ((uint32_t)GPIO_OTYPE_##otype << (pin)) : 0U)
+#define BOARD_OSPEEDR_TERM(p, port, pin, mode, otype, ospeed, pupd, af, init) \
+    | (BOARD_ON(p, port) ? ((uint32_t)GPIO_OSPEED_##ospeed << ((pin) * 2U)) : 0U)
+#define BOARD_PUPDR_TERM(p, port, pin, mode, otype, ospeed, pupd, af, init) \
+    | (BOARD_ON(p, port) ? ((uint32_t)GPIO_PUPD_##pupd << ((pin) * 2U)) : 0U)
+#define BOARD_AFRL_MASK_TERM(p, port, pin, mode, otype, ospeed, pupd, af, init) \
+    | ((BOARD_ON(p, port) && BOARD_IS_AF(mode) && (pin) < 8U) ? (0x0FU << (((pin) % 8U) * 4U)) : 0U)
+#define BOARD_AFRH_MASK_TERM(p, port, pin, mode, otype, ospeed, pupd, af, init) \
+    | ((BOARD_ON(p, port) && BOARD_IS_AF(mode) && (pin) >= 8U) ? (0x0FU << (((pin) % 8U) * 4U)) : 0U)
+#define BOARD_AFRL_TERM(p, port, pin, mode, otype, ospeed, pupd, af, init) \
+    | ((BOARD_ON(p, port) && BOARD_IS_AF(mode) && (pin) < 8U) ? ((uint32_t)(af) << (((pin) % 8U) * 4U)) : 0U)
+#define BOARD_AFRH_TERM(p, port, pin, mode, otype, ospeed, pupd, af, init) \
+    | ((BOARD_ON(p, port) && BOARD_IS_AF(mode) && (pin) >= 8U) ? ((uint32_t)(af) << (((pin) % 8U) * 4U)) : 0U)
+#define BOARD_CLOCK_TERM(p, port, pin, mode, otype, ospeed, pupd, af, init) \
+    | (0x01U << BOARD_PORT_##port)
+#define BOARD_INVALID_TERM(p, port, pin, mode, otype, ospeed, pupd, af, init) \
+    || (pin) > 15U || (af) > 15U || (init) > 1U
+
+/**
+ * BOARD_Port_Config initialiser for port index p of a map
+ */
+#define BOARD_PORT_CONFIG(MAP, p) { \
+    .pins = (uint16_t)(0U MAP(BOARD_PINS_TERM, p)), \
+    .out_pins = (uint16_t)(0U MAP(BOARD_OUT_PINS_TERM, p)), \
+    .odr = (uint16_t)(0U MAP(BOARD_ODR_TERM, p)), \
+    .mask2 = 0U MAP(BOARD_MASK2_TERM, p), \
+    .afrl_mask = 0U MAP(BOARD_AFRL_MASK_TERM, p), \
+    .afrh_mask = 0U MAP(BOARD_AFRH_MASK_TERM, p), \
+    .moder = 0U MAP(BOARD_MODER_TERM, p), \
+    .otyper = 0U MAP(BOARD_OTYPER_TERM, p), \
+    .ospeedr = 0U MAP(BOARD_OSPEEDR_TERM, p), \
+    .pupdr = 0U MAP(BOARD_PUPDR_TERM, p), \
+    .afrl = 0U MAP(BOARD_AFRL_TERM, p), \
+    .afrh = 0U MAP(BOARD_AFRH_TERM, p) \
+}
+
+// 1 if two lines of the map claim the same pin of port p (their bits add up differently than they OR)
+#define BOARD_PORT_HAS_DUPLICATES(MAP, p) ((0U MAP(BOARD_PIN_SUM_TERM, p)) != (0U MAP(BOARD_PINS_TERM, p)))
+#define BOARD_MAP_HAS_DUPLICATES(MAP) ( \
+    BOARD_PORT_HAS_DUPLICATES(MAP, 0U) || BOARD_PORT_HAS_DUPLICATES(MAP, 1U) || \
+    BOARD_PORT_HAS_DUPLICATES(MAP, 2U) || BOARD_PORT_HAS_DUPLICATES(MAP, 3U) || \
+    BOARD_PORT_HAS_DUPLICATES(MAP, 4U) || BOARD_PORT_HAS_DUPLICATES(MAP, 5U) || \
+    BOARD_PORT_HAS_DUPLICATES(MAP, 6U) || BOARD_PORT_HAS_DUPLICATES(MAP, 7U))
+#define BOARD_MAP_IS_INVALID(MAP) (0 MAP(BOARD_INVALID_TERM, 0U))
+
+// AHB1ENR bits of every port the map uses
+#define BOARD_CLOCK_MASK(MAP) (0U MAP(BOARD_CLOCK_TERM, 0U))
+
+// BOARD_PIN_MAP folded, indexed by port (A = 0)
+extern const BOARD_Port_Config BOARD_ports[BOARD_NUM_PORTS];
+
+
+// HAL FUNCTIONS ==============================================================
+/**
+ * @brief Enables the clocks of every port in BOARD_PIN_MAP (one AHB1ENR write) and applies the map to each port.
+ * 		  Call once at boot, before anything uses the pins
+ *
+ * @return HAL_Status
+ */
+HAL_Status BOARD_apply(void);
+
+/**
+ * @brief Writes a folded config to one port. Each register is written once, only touching the bits in the
+ * 		  config's masks: output levels first (BSRR), MODER last, so a pin only starts driving once its type,
+ * 		  speed, pull and AF are in place. The port's clock must already be on
+ *
+ * @param port
+ * @param config
+ * @return HAL_Status
+ */
+HAL_Status BOARD_apply_port(GPIO_Reg_TypeDef* port, const BOARD_Port_Config* config);
+
+#endif
@@ -0,0 +1,108 @@
+/*
+ * deferred_log.h
+ *
+ * Header file for deferred_log.c
+ * Binary "deferred" logging: a log call doesn't format anything on the target. It stores a compact record
+ * (format string ID, cycle count timestamp, raw 32 bit arguments) in a RAM ring buffer, which is drained later
+ * over any byte sink (ITM, UART, USB...). tools/dlog_decode.py rebuilds the text on the PC from the ELF.
+ *
+ * The format strings live in the .dlog_fmt section, which the linker script keeps in the ELF but never
+ * loads to flash, so they cost no target memory at all. A string's address in that section is its ID
+ *
+ * Usage:
+ *     DLOG("adc=%u temp=%f", adc_raw, DLOG_FLOAT(temp));
+ * - Up to DLOG_MAX_ARGS arguments, each is passed as a raw uint32_t
+ * - Floats MUST be wrapped in DLOG_FLOAT() (otherwise they are converted to an integer)
+ * - %s is not supported, the string wouldn't exist anymore by the time the log is drained
+ * - Safe to call from any ISR and from thread mode at the same time
+ *
+ * Record layout in the stream (little endian 32 bit words):
+ *     word 0: [31:24] DLOG_SYNC, [23:20] number of args, [19:0] format string ID
+ *     word 1: DWT cycle count
+ *     word 2..: args
+ *
+ *  Written by Ryan Wong
+ */
+
+#ifndef DEFERRED_LOG_H_
+#define DEFERRED_LOG_H_
+
+#include <stdint.h>
+#include "drivers/types.h"
+
+// Ring buffer size in bytes, must be a power of 2
+#define DLOG_BUFFER_SIZE 2048U
+#define DLOG_MAX_ARGS 4U
+
+#define DLOG_SYNC 0xD1U
+// Format ID reserved for the "records were dropped" marker, its single argument is the number dropped
+#define DLOG_ID_DROPPED 0xFFFFFU
+
+/**
+ * Byte sink the log is drained into. Must return how many of the len bytes it accepted (0 to len),
+ * anything not accepted is offered again on the next drain
+ */
+typedef int (*DLOG_Sink)(const uint8_t* data, uint32_t len);
+
+
+// LOGGING MACROS ==============================================================
+#define DLOG_NARGS_(_0, _1, _2, _3, _4, N, ...) N
+#define DLOG_NARGS(...) DLOG_NARGS_(_0, ##__VA_ARGS__, 4, 3, 2, 1, 0)
+#define DLOG_CAT_(a, b) a##b
+#define DLOG_CAT(a, b) DLOG_CAT_(a, b)
+
+// Reinterprets a float's bits as a uint32_t so it survives the trip through the log unchanged
+#define DLOG_FLOAT(x) (((union { float f; uint32_t u; }){ .f = (float)(x) }).u)
+
+/**
+ * Logs a record. The format string is given a unique address in .dlog_fmt at compile time,
+ * so at runtime this is one call with the ID and args in registers
+ */
+#define DLOG(fmt, ...) do { \
+    static const char DLOG_fmt_[] __attribute__((section(".dlog_fmt"), used)) = fmt; \
+    DLOG_CAT(DLOG_write, DLOG_NARGS(__VA_ARGS__))((uint32_t)DLOG_fmt_, ##__VA_ARGS__); \
+} while (0)
+
+
+// HAL FUNCTIONS ==============================================================
+/**
+ * @brief Empties the ring buffer and starts the DWT cycle counter used for timestamps
+ *
+ */
+void DLOG_init(void);
+
+/**
+ * @brief Record writers, use the DLOG() macro instead of calling these directly
+ *
+ */
+void DLOG_write0(uint32_t id);
+void DLOG_write1(uint32_t id, uint32_t a0);
+void DLOG_write2(uint32_t id, uint32_t a0, uint32_t a1);
+void DLOG_write3(uint32_t id, uint32_t a0, uint32_t a1, uint32_t a2);
+void DLOG_write4(uint32_t id, uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3);
+
+/**
+ * @brief Pushes buffered log bytes into the sink, straight out of the ring buffer (no copy).
+ * 		  Call from the main loop or a low priority interrupt, never from inside a DLOG() call path
+ *
+ * @param sink - byte sink to write into
+ * @param max_bytes - upper limit on bytes handed to the sink in this call (0 for no limit)
+ * @return uint32_t - number of bytes the sink accepted
+ */
+uint32_t DLOG_drain(DLOG_Sink sink, uint32_t max_bytes);
+
+/**
+ * @brief Returns the number of bytes waiting to be drained
+ *
+ * @return uint32_t
+ */
+uint32_t DLOG_pending(void);
+
+/**
+ * @brief Returns the total number of records dropped because the buffer was full
+ *
+ * @return uint32_t
+ */
+uint32_t DLOG_get_dropped(void);
+
+#endif
@@ -0,0 +1,104 @@
+/*
+ * dma_copy.h
+ *
+ * Header file for dma_copy.c
+ * Asynchronous memcpy/memset on DMA2 stream 0 (only DMA2 can do memory to memory on the F4).
+ * Requests are queued and run back to back from the DMA interrupt, so the CPU only pays for
+ * queueing a request and one interrupt per 64K items, instead of touching every byte itself.
+ *
+ * Things to keep in mind:
+ * - This module owns DMA2 stream 0 and defines DMA2_Stream0_IRQHandler
+ * - Buffers must stay valid (and not be touched) until the request's handle reports done
+ * - Requests under DMA_COPY_THRESHOLD bytes are done with the CPU straight away, as setting
+ *   up the DMA costs more than copying them
+ * - Word transfers (and 4 word bursts) are used when the addresses and length allow it,
+ *   otherwise the DMA falls back to byte transfers which are ~4x slower
+ *
+ *  Written by Ryan Wong
+ */
+
+#ifndef DMA_COPY_H_
+#define DMA_COPY_H_
+
+#include <stdint.h>
+#include "drivers/types.h"
+
+#define DMA_COPY_QUEUE_SIZE 8U
+#define DMA_COPY_THRESHOLD 64U
+#define DMA_COPY_IRQ_PRIORITY 8U
+
+typedef void (*DMA_Copy_Callback)(void* context);
+
+/**
+ * Completion handle for one request. Set callback/context (or leave callback NULL) before submitting,
+ * done and status are filled in by the driver
+ *
+ * done - 0 while the request is queued/running, 1 once it has finished
+ * status - HAL_OK, or HAL_ERROR if the DMA reported a transfer error
+ * callback - called from the DMA interrupt when the request finishes (can be NULL)
+ * context - passed to the callback
+ */
+typedef struct {
+    volatile uint8_t done;
+    volatile HAL_Status status;
+    DMA_Copy_Callback callback;
+    void* context;
+} DMA_Copy_Handle;
+
+
+// HAL FUNCTIONS ==============================================================
+/**
+ * @brief Enables the DMA2 clock and the stream 0 interrupt and empties the queue
+ *
+ * @return HAL_Status
+ */
+HAL_Status DMA_copy_init(void);
+
+/**
+ * @brief Queues a copy of len bytes from src to dst and returns immediately.
+ * 		  Below DMA_COPY_THRESHOLD the copy is done before returning (and the callback is called from here)
+ *
+ * @param dst - destination, must not overlap src
+ * @param src - source (RAM or flash)
+ * @param len - number of bytes
+ * @param handle - completion handle, or NULL if the caller doesn't need to know
+ * @return HAL_Status - HAL_ERROR if the queue is full or the arguments are invalid, the handle isn't touched then
+ */
+HAL_Status dma_memcpy(void* dst, const void* src, uint32_t len, DMA_Copy_Handle* handle);
+
+/**
+ * @brief Queues filling len bytes at dst with value and returns immediately.
+ * 		  Below DMA_COPY_THRESHOLD the fill is done before returning (and the callback is called from here)
+ *
+ * @param dst - destination
+ * @param value - byte to fill with
+ * @param len - number of bytes
+ * @param handle - completion handle, or NULL if the caller doesn't need to know
+ * @return HAL_Status - HAL_ERROR if the queue is full or the arguments are invalid, the handle isn't touched then
+ */
+HAL_Status dma_memset(void* dst, uint8_t value, uint32_t len, DMA_Copy_Handle* handle);
+
+/**
+ * @brief Polls a handle
+ *
+ * @param handle
+ * @return uint8_t - 1 if the request has finished
+ */
+uint8_t DMA_copy_is_done(const DMA_Copy_Handle* handle);
+
+/**
+ * @brief Spins until the request has finished
+ *
+ * @param handle
+ * @return HAL_Status - the request's final status
+ */
+HAL_Status DMA_copy_wait(const DMA_Copy_Handle* handle);
+
+/**
+ * @brief Returns the number of requests queued or running
+ *
+ * @return uint32_t
+ */
+uint32_t DMA_copy_pending(void);
+
+#endif
@@ -0,0 +1,143 @@
+/*
+ * kv_store.h
+ *
+ * Header file for kv_store.c
+ * Log-structured key/value store for calibration data, counters etc. in flash sectors reserved for it.
+ *
+ * How it works:
+ * - Every set/delete is an append to the current "head" sector, so a word is never programmed twice and
+ *   nothing is erased on the write path. The newest record for a key wins
+ * - When the head is full, the spare sector with the fewest erases becomes the new head (wear leveling),
+ *   and once no spare is left, the oldest sector is compacted: its still-live records are copied to the
+ *   head a few at a time from KV_service(), then it is erased and becomes the spare
+ * - A RAM hash index maps each key to its newest record, so reads never scan flash. KV_init() rebuilds it
+ *   by walking the record headers of each sector once (checksums are checked on the way)
+ * - Each record is committed by programming its checksum last, so a record torn by a power cut is ignored.
+ *   Sector headers are programmed once each in a fixed order, so KV_init() can always tell what step
+ *   was interrupted and finish or undo it
+ *
+ * Limits: all live data (plus one record) has to fit in a single sector, as compaction copies a whole sector's
+ * live data into the head. The store itself only talks to flash through KV_Flash_Ops, so it also runs
+ * on the PC against the simulator in tools/kv_sim
+ *
+ *  Written by Ryan Wong
+ */
+
+#ifndef KV_STORE_H_
+#define KV_STORE_H_
+
+#include <stdint.h>
+#include "drivers/types.h"
+
+#define KV_MAX_SECTORS 4U
+#define KV_MAX_KEYS 64U
+#define KV_INDEX_SIZE 128U // power of 2, at least 2x KV_MAX_KEYS so probes stay short
+#define KV_MAX_VALUE_SIZE 1024U
+#define KV_KEY_INVALID 0xFFFFU
+
+/**
+ * Flash backend. Sectors are numbered 0 to num_sectors - 1 within the store
+ *
+ * num_sectors - 2 to KV_MAX_SECTORS, all the same size
+ * sector_size - in bytes, multiple of 4, at most 256K
+ * address - returns where the sector can be read directly (memory mapped)
+ * erase - sets every byte of the sector to 0xFF
+ * program - programs one word (bits can only go from 1 to 0)
+ */
+typedef struct {
+    uint32_t num_sectors;
+    uint32_t sector_size;
+    const uint32_t* (*address)(uint32_t sector);
+    HAL_Status (*erase)(uint32_t sector);
+    HAL_Status (*program)(uint32_t sector, uint32_t word_offset, uint32_t value);
+} KV_Flash_Ops;
+
+typedef struct {
+    uint32_t keys;
+    uint32_t live_bytes; // flash used by the newest record of every key
+    uint32_t capacity_bytes; // live_bytes can't go past this
+    uint32_t head_free_bytes;
+    uint32_t sectors_in_use;
+    uint32_t min_erase_count;
+    uint32_t max_erase_count;
+    uint8_t compacting;
+} KV_Stats;
+
+// Backend for flash sectors 2 and 3 (0x08008000, 2x16K), see kv_store_flash.c and the linker script
+extern const KV_Flash_Ops KV_flash_ops;
+
+
+// HAL FUNCTIONS ==============================================================
+/**
+ * @brief Mounts the store: finishes anything a power cut interrupted, formats blank/corrupt sectors
+ * 		  and rebuilds the RAM index
+ *
+ * @param ops - flash backend
+ * @return HAL_Status - HAL_ERROR if the backend is invalid or flash operations fail
+ */
+HAL_Status KV_init(const KV_Flash_Ops* ops);
+
+/**
+ * @brief Stores a value. Nothing is written if the stored value is already identical.
+ * 		  Normally just an append, but can run (and block on) a compaction and a sector erase
+ * 		  if KV_service() hasn't been keeping up
+ *
+ * @param key - any value except KV_KEY_INVALID
+ * @param value
+ * @param len - bytes, up to KV_MAX_VALUE_SIZE (0 is allowed)
+ * @return HAL_Status - HAL_ERROR if the store is full, there are too many keys, or flash operations fail
+ */
+HAL_Status KV_set(uint16_t key, const void* value, uint32_t len);
+
+/**
+ * @brief Copies a value out of the store
+ *
+ * @param key
+ * @param buffer - where to copy the value
+ * @param size - size of buffer, at most this many bytes are copied
+ * @return int32_t - full length of the stored value, or -1 if the key doesn't exist
+ */
+int32_t KV_get(uint16_t key, void* buffer, uint32_t size);
+
+/**
+ * @brief Returns a pointer straight to the value in flash (no copy).
+ * 		  Only valid until the next KV_set(), KV_delete() or KV_service() call
+ *
+ * @param key
+ * @param len - set to the value's length
+ * @return const void* - NULL if the key doesn't exist
+ */
+const void* KV_get_ptr(uint16_t key, uint32_t* len);
+
+/**
+ * @brief Deletes a key (appends a tombstone). Deleting a key that doesn't exist does nothing
+ *
+ * @param key
+ * @return HAL_Status
+ */
+HAL_Status KV_delete(uint16_t key);
+
+/**
+ * @brief Background work: copies up to max_records records out of the sector being compacted, and erases it
+ * 		  once it's empty. Call from the main loop. The erase blocks for as long as the backend takes
+ *
+ * @param max_records - records to look at in this call
+ * @return uint8_t - 1 if there is still compaction work left
+ */
+uint8_t KV_service(uint32_t max_records);
+
+/**
+ * @brief Erases every sector and starts an empty store (erase counts are kept)
+ *
+ * @return HAL_Status
+ */
+HAL_Status KV_format(void);
+
+/**
+ * @brief Fills in usage and wear statistics
+ *
+ * @param stats
+ */
+void KV_get_stats(KV_Stats* stats);
+
+#endif
@@ -0,0 +1,102 @@
+/*
+ * mem_stats.h
+ *
+ * Header file for mem_stats.c
+ * Measures how much RAM the stack and heap really use, rather than trusting _Min_Stack_Size/_Min_Heap_Size.
+ *
+ * How it works:
+ * - SystemInit() calls MEM_paint_stack() last, after the FPU and flash setup and before .data/.bss are initialised
+ *   or main() runs. It fills all the RAM between the end of .bss (_end) and the stack pointer with
+ *   MEM_PAINT_PATTERN, and the deepest the stack has ever been is then the lowest word that no longer holds it.
+ *   The calls before it must not keep anything in RAM below the stack pointer: their frames are painted over
+ *   once they've returned, which is fine, but nothing else down there survives
+ * - _sbrk() (sysmem.c) reports every time the heap grows or a request fails, so the heap's high water mark
+ *   and any out of memory failures are kept too
+ * - .data/.bss sizes come from the linker symbols. tools/ram_report.py breaks them down per module from
+ *   the map file
+ *
+ * Things to keep in mind:
+ * - A stack frame that is reserved but never written (e.g. a big buffer only partly used) still looks unused,
+ *   so leave some headroom on top of the measured stack high water mark
+ * - Finding the stack high water mark scans up from the top of the heap, so it takes longer the more unused RAM
+ *   there is (~1ms worst case at 16MHz). Don't call it from time critical code
+ *
+ *  Written by Ryan Wong
+ */
+
+#ifndef MEM_STATS_H_
+#define MEM_STATS_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "drivers/types.h"
+
+#define MEM_PAINT_PATTERN 0xC5C5C5C5U
+#define MEM_PAINT_MARGIN 64U // bytes below the stack pointer left unpainted, for the painting code's own frame
+
+/**
+ * All sizes in bytes
+ *
+ * data_bytes, bss_bytes - static RAM from the linker script
+ * heap_reserved, stack_reserved - _Min_Heap_Size and _Min_Stack_Size, what the linker checked for at build time
+ * heap_high_water - furthest _sbrk() has moved the heap past _end
+ * heap_in_use - handed out by malloc right now (heap_high_water - heap_in_use is free or fragmented)
+ * sbrk_failures - times _sbrk() refused to grow the heap (malloc returned NULL)
+ * largest_failed_request - biggest _sbrk() request refused
+ * stack_high_water - deepest the main stack has been since reset
+ * stack_current - main stack in use at the point MEM_get_stats() was called
+ * unused_bytes - RAM between the heap and the stack that has never been touched. This is the real headroom,
+ * 				  0 means the stack and heap have met (or the stack overflowed into the heap)
+ */
+typedef struct {
+    uint32_t data_bytes;
+    uint32_t bss_bytes;
+    uint32_t heap_reserved;
+    uint32_t heap_high_water;
+    uint32_t heap_in_use;
+    uint32_t sbrk_failures;
+    uint32_t largest_failed_request;
+    uint32_t stack_reserved;
+    uint32_t stack_high_water;
+    uint32_t stack_current;
+    uint32_t unused_bytes;
+} MEM_Stats;
+
+
+// HAL FUNCTIONS ==============================================================
+/**
+ * @brief Fills the free RAM between _end and the stack pointer with MEM_PAINT_PATTERN.
+ * 		  Only call this from SystemInit() - it doesn't touch any globals, as .data and .bss aren't set up yet,
+ * 		  and painting later would wipe out the heap
+ */
+void MEM_paint_stack(void);
+
+/**
+ * @brief Deepest the main stack has been since reset
+ *
+ * @return uint32_t - bytes below _estack
+ */
+uint32_t MEM_stack_high_water(void);
+
+/**
+ * @brief Fills in static, heap and stack usage
+ *
+ * @param stats
+ */
+void MEM_get_stats(MEM_Stats* stats);
+
+/**
+ * @brief Called by _sbrk() after it moves the end of the heap
+ *
+ * @param heap_end - new end of the heap
+ */
+void MEM_record_sbrk(const void* heap_end);
+
+/**
+ * @brief Called by _sbrk() when it refuses a request
+ *
+ * @param incr - bytes that were asked for
+ */
+void MEM_record_sbrk_failure(ptrdiff_t incr);
+
+#endif
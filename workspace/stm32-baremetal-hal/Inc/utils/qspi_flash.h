@@ -0,0 +1,113 @@
+/*
+ * qspi_flash.h
+ *
+ * Header file for qspi_flash.c
+ * External serial NOR flash on the QUADSPI (drivers/qspi_driver.h): identification, quad mode, indirect
+ * read/program/erase, and execute in place through the memory mapped window.
+ *
+ * Execute in place / constants in external flash:
+ * - QSPI_CONST puts a constant in .qspi_rodata, QSPI_CODE puts a function in .qspi_text. Both are linked into the
+ *   QSPI region of STM32F446RETX_FLASH.ld (0x90000000) and read straight from the flash once it's mapped, no copy
+ * - Once anything uses them the ELF has a loadable .qspi section at 0x90000000, which the ST-LINK download can't
+ *   program without an external loader for the chip (add its .stldr under External Loaders in the debug
+ *   configuration), and which makes a plain objcopy -O binary span 0x08000000-0x90000000. So build the images
+ *   separately: arm-none-eabi-objcopy -O binary -R .qspi <elf> internal.bin for internal flash, and
+ *   arm-none-eabi-objcopy -O binary -j .qspi <elf> qspi.bin written at offset 0 of the QSPI flash
+ *   (e.g. STM32CubeProgrammer with the external loader)
+ * - With no QSPI_CONST/QSPI_CODE anywhere the section is empty and the ELF downloads as usual. The tree only uses
+ *   them in the XIP demo of Test/qspi_flash_test.c, built with QSPI_XIP_DEMO defined
+ * - Nothing in the QSPI region may be used before QSPI_flash_init(), or while QSPI_flash_write()/erase() run
+ *   (they leave memory mapped mode). So no QSPI_CODE in interrupt handlers that can fire during those, and
+ *   anything that writes the flash must itself live in internal flash
+ * - QSPI_CODE functions are long_call: they're >16MB away from internal flash, out of reach of a plain BL
+ *
+ * Written for Winbond W25Q style chips (JEDEC ID, QE bit in status register 2, 0xEB quad I/O read, 0x32 quad
+ * page program), 3 byte addresses so at most 16MB is used
+ *
+ *  Written by Ryan Wong
+ */
+
+#ifndef QSPI_FLASH_H_
+#define QSPI_FLASH_H_
+
+#include <stdint.h>
+#include "drivers/types.h"
+#include "drivers/qspi_driver.h"
+
+#define QSPI_FLASH_PAGE_SIZE 256U
+#define QSPI_FLASH_SECTOR_SIZE 4096U
+#define QSPI_FLASH_BLOCK_SIZE 65536U
+#define QSPI_FLASH_MAX_SIZE 0x1000000U // 3 byte addressing
+#define QSPI_FLASH_MAX_CLOCK 80000000U
+
+#define QSPI_CONST __attribute__((section(".qspi_rodata")))
+#define QSPI_CODE __attribute__((section(".qspi_text"), long_call, noinline))
+
+// Start and end of what the linker put in the QSPI region, as addresses in the mapped window
+extern const uint8_t _qspi_start[];
+extern const uint8_t _qspi_end[];
+
+
+// HAL FUNCTIONS ==============================================================
+/**
+ * @brief Sets up the QUADSPI, resets and identifies the flash, enables its quad mode, then maps it at
+ * 		  QSPI_MEMORY_BASE
+ *
+ * @param max_clock_hz - fastest flash clock to use (the chip's limit for 0xEB reads), at most QSPI_FLASH_MAX_CLOCK
+ * @return HAL_Status - HAL_ERROR if no flash answers or it can't be put in quad mode
+ */
+HAL_Status QSPI_flash_init(uint32_t max_clock_hz);
+
+/**
+ * @brief JEDEC ID read at init: manufacturer << 16 | memory type << 8 | capacity
+ *
+ * @return uint32_t
+ */
+uint32_t QSPI_flash_id(void);
+
+/**
+ * @brief Usable size in bytes (capped at QSPI_FLASH_MAX_SIZE), 0 before QSPI_flash_init()
+ *
+ * @return uint32_t
+ */
+uint32_t QSPI_flash_size(void);
+
+/**
+ * @brief Reads through indirect mode. Leaves memory mapped mode while it runs, and restores it after
+ *
+ * @param address - offset into the flash
+ * @param buffer
+ * @param len
+ * @return HAL_Status
+ */
+HAL_Status QSPI_flash_read(uint32_t address, void* buffer, uint32_t len);
+
+/**
+ * @brief Programs any range, split at page boundaries. The range must be erased first (programming only clears bits).
+ * 		  Leaves memory mapped mode while it runs, and restores it after
+ *
+ * @param address
+ * @param buffer
+ * @param len
+ * @return HAL_Status
+ */
+HAL_Status QSPI_flash_write(uint32_t address, const void* buffer, uint32_t len);
+
+/**
+ * @brief Erases [address, address + len), using 64KB block erases where they fit and 4KB sector erases elsewhere.
+ * 		  Leaves memory mapped mode while it runs, and restores it after
+ *
+ * @param address - multiple of QSPI_FLASH_SECTOR_SIZE
+ * @param len - multiple of QSPI_FLASH_SECTOR_SIZE
+ * @return HAL_Status
+ */
+HAL_Status QSPI_flash_erase(uint32_t address, uint32_t len);
+
+/**
+ * @brief Maps the flash at QSPI_MEMORY_BASE (QSPI_flash_init() already does this)
+ *
+ * @return HAL_Status
+ */
+HAL_Status QSPI_flash_map(void);
+
+#endif
@@ -0,0 +1,182 @@
+/*
+ * sd_card.h
+ *
+ * Header file for sd_card.c
+ * SD card protocol on top of a 4 bit SD bus host: card identification, switching to a 4 bit bus and high speed,
+ * block reads/writes, and streaming writes for data logging.
+ *
+ * How streaming works:
+ * - SD_stream_begin() sends one open ended multi block write (CMD25), optionally telling the card how much is
+ *   coming first (ACMD23) so it can pre-erase
+ * - Each SD_stream_write() hands over a buffer, which goes to the card as the next blocks of that same write.
+ *   Up to SD_STREAM_QUEUE_SIZE buffers can be queued, so the caller fills one buffer while the previous one is
+ *   on its way to the card, without paying the card's command and programming overhead for every buffer
+ * - SD_stream_end() waits for everything queued, stops the write (CMD12) and waits for the card to finish
+ *   programming
+ *
+ * Nothing here touches hardware directly, it all goes through SD_Host_Ops (like kv_store's KV_Flash_Ops),
+ * so it also runs on the PC against the card model in tools/sd_model. SD_sdio_ops (sd_card_sdio.c)
+ * is the backend for the SDIO peripheral
+ *
+ * Limits: SD v1.x (byte addressed) and v2.0+ SDSC/SDHC/SDXC cards, not MMC. One card, no hot plug detection
+ *
+ *  Written by Ryan Wong
+ */
+
+#ifndef SD_CARD_H_
+#define SD_CARD_H_
+
+#include <stdint.h>
+#include "drivers/types.h"
+
+#define SD_BLOCK_SIZE 512U
+#define SD_STREAM_QUEUE_SIZE 4U
+#define SD_MAX_TRANSFER_BLOCKS 0xFFFFU // per buffer, the SDIO data length register is 25 bits
+
+#define SD_IDENT_CLOCK 400000U
+#define SD_DEFAULT_SPEED_CLOCK 25000000U
+#define SD_HIGH_SPEED_CLOCK 50000000U
+
+#define SD_INIT_RETRIES 2000U // ACMD41 attempts, ~1s at 400kHz
+#define SD_BUSY_RETRIES 100000U // CMD13 attempts while the card programs, ~1s at 16MHz
+#define SD_READ_TIMEOUT_MS 100U
+#define SD_WRITE_TIMEOUT_MS 500U
+
+/**
+ * Response formats, the backend maps them to what its hardware needs
+ * R1B is R1 where the card may then hold D0 low while busy (this layer polls CMD13 for that)
+ */
+typedef enum {
+    SD_RESPONSE_NONE = 0x00U,
+    SD_RESPONSE_R1 = 0x01U,
+    SD_RESPONSE_R1B = 0x02U,
+    SD_RESPONSE_R2 = 0x03U, // 128 bit CID/CSD
+    SD_RESPONSE_R3 = 0x04U, // OCR, no CRC
+    SD_RESPONSE_R6 = 0x05U, // published RCA
+    SD_RESPONSE_R7 = 0x06U // interface condition
+} SD_Response;
+
+typedef enum {
+    SD_DATA_IDLE = 0x00U,
+    SD_DATA_BUSY = 0x01U,
+    SD_DATA_ERROR = 0x02U
+} SD_Data_State;
+
+/**
+ * Bus host backend
+ *
+ * send_command - sends a command and waits for the response. resp gets 1 word, or 4 for R2 (bits 127:96 first)
+ * set_clock - sets the fastest bus clock up to max_hz, returns what it set (0 on failure)
+ * set_bus_width - 1 or 4 data lines
+ * start_data - starts moving len bytes in blocks of block_size, and returns without waiting.
+ * 				Reads are started before their command, writes after it
+ * data_poll - state of the transfer started last. Must only report IDLE for a write once the card has
+ * 			   released the bus after its last block
+ * abort_data - stops a transfer early
+ */
+typedef struct {
+    HAL_Status (*send_command)(uint8_t index, uint32_t arg, SD_Response response, uint32_t* resp);
+    uint32_t (*set_clock)(uint32_t max_hz);
+    HAL_Status (*set_bus_width)(uint8_t width);
+    HAL_Status (*start_data)(uint8_t read, void* buffer, uint32_t len, uint32_t block_size, uint32_t timeout_ms);
+    SD_Data_State (*data_poll)(void);
+    void (*abort_data)(void);
+} SD_Host_Ops;
+
+/**
+ * high_capacity - SDHC/SDXC (block addressed), 0 for SDSC
+ * high_speed - 1 if the card switched to high speed (50MHz) mode
+ * bus_width - 1 or 4
+ * rca - relative card address
+ * block_count - capacity in SD_BLOCK_SIZE blocks
+ * clock_hz - bus clock in use
+ * cid, csd - raw card registers, bits 127:96 in [0]
+ */
+typedef struct {
+    uint8_t high_capacity;
+    uint8_t high_speed;
+    uint8_t bus_width;
+    uint16_t rca;
+    uint32_t block_count;
+    uint32_t clock_hz;
+    uint32_t cid[4];
+    uint32_t csd[4];
+} SD_Card_Info;
+
+// Backend for the SDIO peripheral (drivers/sdio_driver.h), see sd_card_sdio.c. Call SDIO_init() before SD_init()
+extern const SD_Host_Ops SD_sdio_ops;
+
+
+// HAL FUNCTIONS ==============================================================
+/**
+ * @brief Identifies and selects the card, then moves it to a 4 bit bus and high speed if it supports them
+ *
+ * @param ops - bus host backend
+ * @return HAL_Status - HAL_ERROR if there's no card, it isn't supported or it stops responding
+ */
+HAL_Status SD_init(const SD_Host_Ops* ops);
+
+/**
+ * @brief Fills in what SD_init() found out about the card
+ *
+ * @param info
+ * @return HAL_Status - HAL_ERROR if no card has been initialised
+ */
+HAL_Status SD_get_info(SD_Card_Info* info);
+
+/**
+ * @brief Reads blocks, waiting until they have arrived
+ *
+ * @param block - first block number (always in blocks, even for byte addressed cards)
+ * @param buffer - count * SD_BLOCK_SIZE bytes, word aligned
+ * @param count - 1 to SD_MAX_TRANSFER_BLOCKS
+ * @return HAL_Status
+ */
+HAL_Status SD_read_blocks(uint32_t block, void* buffer, uint32_t count);
+
+/**
+ * @brief Writes blocks, waiting until the card has finished programming them
+ *
+ * @param block - first block number
+ * @param buffer - count * SD_BLOCK_SIZE bytes, word aligned
+ * @param count - 1 to SD_MAX_TRANSFER_BLOCKS
+ * @return HAL_Status
+ */
+HAL_Status SD_write_blocks(uint32_t block, const void* buffer, uint32_t count);
+
+/**
+ * @brief Starts a streaming write. No other card access is allowed until SD_stream_end()
+ *
+ * @param block - first block number
+ * @param expected_blocks - roughly how many blocks will be written, so the card can pre-erase (0 if unknown)
+ * @return HAL_Status
+ */
+HAL_Status SD_stream_begin(uint32_t block, uint32_t expected_blocks);
+
+/**
+ * @brief Queues a buffer to be written as the next blocks of the stream. If the queue is full, this waits for
+ * 		  the oldest buffer to finish first. The buffer must not be touched until SD_stream_pending() shows it's done
+ *
+ * @param buffer - blocks * SD_BLOCK_SIZE bytes, word aligned
+ * @param blocks - 1 to SD_MAX_TRANSFER_BLOCKS
+ * @return HAL_Status - HAL_ERROR if the stream isn't open or a previous buffer failed
+ */
+HAL_Status SD_stream_write(const void* buffer, uint32_t blocks);
+
+/**
+ * @brief Moves the stream along (starts the next buffer if the last one finished) and returns how many
+ * 		  queued buffers haven't been written yet. Buffers finish in the order they were queued, so with two
+ * 		  buffers, pending <= 1 after queueing B means A can be refilled
+ *
+ * @return uint32_t
+ */
+uint32_t SD_stream_pending(void);
+
+/**
+ * @brief Waits for every queued buffer, ends the write and waits for the card to finish programming
+ *
+ * @return HAL_Status - HAL_ERROR if any buffer of the stream failed
+ */
+HAL_Status SD_stream_end(void);
+
+#endif
@@ -0,0 +1,171 @@
+/*
+ * usb_cdc.h
+ *
+ * Header file for usb_cdc.c
+ * USB device stack with one CDC-ACM (virtual COM port) function: enumeration, the standard and CDC class
+ * requests on endpoint 0, and a bulk IN/OUT data pipe. Shows up as a serial port on the PC (usbser on Windows,
+ * /dev/ttyACM* on Linux), the baud rate the PC picks doesn't matter, data always moves at full USB speed.
+ *
+ * How streaming works:
+ * - CDC_transmit() queues an application buffer for the bulk IN endpoint without copying it. The controller
+ *   reads it straight from there while the transfer runs, so the buffer must stay untouched until it's off the
+ *   queue (CDC_tx_pending() drops). Up to CDC_TX_QUEUE_SIZE buffers can be queued, and the next one starts from
+ *   the completion event, so the endpoint never idles between buffers while the queue is fed
+ * - When the queue runs dry after a transfer that ended on a full packet, a zero length packet is sent so the
+ *   PC's read returns instead of waiting for more
+ * - Full speed bulk tops out at 19 packets of 64 bytes per 1ms frame (1.216MB/s), less whatever else is on the bus
+ *
+ * Nothing here touches hardware directly, it all goes through CDC_Device_Ops (like sd_card's SD_Host_Ops), so it
+ * also runs on the PC against the host model in tools/usb_model. CDC_otg_ops (usb_cdc_otg.c) is the backend for
+ * the OTG FS core. The backend reports bus events by calling CDC_on_reset(), CDC_on_setup() and CDC_on_complete()
+ *
+ *  Written by Ryan Wong
+ */
+
+#ifndef USB_CDC_H_
+#define USB_CDC_H_
+
+#include <stdint.h>
+#include "drivers/types.h"
+
+#define CDC_PACKET_SIZE 64U
+#define CDC_NOTIFY_PACKET_SIZE 16U
+#define CDC_TX_QUEUE_SIZE 4U
+#define CDC_WRITE_RETRIES 2000000U // ops->poll() calls CDC_write() waits for at most, ~1s at 16MHz
+
+#define CDC_EP_DATA_OUT 0x01U
+#define CDC_EP_DATA_IN 0x81U
+#define CDC_EP_NOTIFY 0x82U
+
+// ST's virtual COM port IDs, swap in your own before shipping anything
+#define CDC_VENDOR_ID 0x0483U
+#define CDC_PRODUCT_ID 0x5740U
+
+/**
+ * Device controller backend. Everything but poll() is only called from the bus event handlers or between
+ * lock() and unlock()
+ *
+ * connect - turns the pull up on, the host resets and enumerates the device from there
+ * set_address - called as soon as SET_ADDRESS arrives, before its status stage. Applying it after the status
+ * 				 stage (if the hardware needs that) is up to the backend
+ * ep_open - activates an endpoint with its data toggle at DATA0. type is the descriptor's transfer type
+ * 			 (2 bulk, 3 interrupt)
+ * ep_transmit - starts an IN transfer of len bytes (0 = zero length packet), reading from buffer until it completes
+ * ep_receive - lets an OUT endpoint take up to len bytes, completes on a short packet or once len bytes arrived
+ * ep_abort - drops an IN transfer without its completion event
+ * ep_stall - stalls (1) or clears the stall (0) and resets the data toggle. Endpoint 0's stall ends on the next SETUP
+ * lock, unlock - keep the bus events out while the stack updates state it shares with them
+ * poll - called while CDC_write() waits. Interrupt driven backends do nothing, a polled one services the bus
+ */
+typedef struct {
+    HAL_Status (*connect)(void);
+    void (*set_address)(uint8_t address);
+    HAL_Status (*ep_open)(uint8_t ep_addr, uint8_t type, uint16_t max_packet);
+    HAL_Status (*ep_transmit)(uint8_t ep_addr, const void* buffer, uint32_t len);
+    HAL_Status (*ep_receive)(uint8_t ep_addr, void* buffer, uint32_t len);
+    void (*ep_abort)(uint8_t ep_addr);
+    void (*ep_stall)(uint8_t ep_addr, uint8_t stall);
+    void (*lock)(void);
+    void (*unlock)(void);
+    void (*poll)(void);
+} CDC_Device_Ops;
+
+/**
+ * What the PC's terminal program asked for (SET_LINE_CODING). Only informational, nothing here is a real UART
+ * baud - bits per second
+ * stop_bits - 0 = 1, 1 = 1.5, 2 = 2
+ * parity - 0 none, 1 odd, 2 even, 3 mark, 4 space
+ * data_bits - 5, 6, 7, 8 or 16
+ */
+typedef struct {
+    uint32_t baud;
+    uint8_t stop_bits;
+    uint8_t parity;
+    uint8_t data_bits;
+} CDC_Line_Coding;
+
+// Backend for the OTG FS core (drivers/usb_driver.h), see usb_cdc_otg.c. Start the PLL first (RCC_enable_PLL())
+extern const CDC_Device_Ops CDC_otg_ops;
+
+
+// HAL FUNCTIONS ==============================================================
+/**
+ * @brief Resets the stack and connects to the bus. Enumeration carries on in the bus events
+ *
+ * @param ops - device controller backend
+ * @return HAL_Status
+ */
+HAL_Status CDC_init(const CDC_Device_Ops* ops);
+
+/**
+ * @brief 1 once the host has set the configuration (the data endpoints are open)
+ *
+ * @return uint8_t
+ */
+uint8_t CDC_is_configured(void);
+
+/**
+ * @brief 1 while a program on the PC has the port open (DTR set by SET_CONTROL_LINE_STATE)
+ *
+ * @return uint8_t
+ */
+uint8_t CDC_is_open(void);
+
+/**
+ * @brief Last line coding the host set (115200 8N1 until it sets one)
+ *
+ * @param coding
+ * @return HAL_Status
+ */
+HAL_Status CDC_get_line_coding(CDC_Line_Coding* coding);
+
+/**
+ * @brief Queues a buffer for the bulk IN endpoint without copying it, and returns straight away
+ *
+ * @param buffer - must stay valid and untouched until CDC_tx_pending() shows it's been sent, any alignment
+ * @param len - 1 or more bytes
+ * @return HAL_Status - HAL_ERROR if the device isn't configured or the queue is full
+ */
+HAL_Status CDC_transmit(const void* buffer, uint32_t len);
+
+/**
+ * @brief Number of queued buffers that haven't been completely sent yet
+ *
+ * @return uint32_t
+ */
+uint32_t CDC_tx_pending(void);
+
+/**
+ * @brief Blocking write for stdout (_write() in syscalls.c) and other small writes: queues the data behind
+ * 		  whatever is already queued and waits until it has been sent. Drops the data if no program on the PC
+ * 		  has the port open, so printf never blocks without a terminal. Don't call it from an interrupt that can
+ * 		  preempt the bus events
+ *
+ * @param buffer
+ * @param len
+ * @return int - len once sent, 0 if it was dropped, -1 on timeout or a bus reset. The buffer is free either way:
+ * 				a timeout takes only this write off the queue and leaves buffers queued with CDC_transmit() in
+ * 				place, a bus reset drops the whole queue
+ */
+int CDC_write(const void* buffer, uint32_t len);
+
+/**
+ * @brief Copies out whatever the host has sent, without waiting
+ *
+ * @param buffer
+ * @param max - most bytes to copy
+ * @return uint32_t - bytes copied, 0 if nothing has arrived
+ */
+uint32_t CDC_read(void* buffer, uint32_t max);
+
+/**
+ * @brief Bus events, called by the backend (from its interrupt, or from poll())
+ * CDC_on_reset - bus reset, everything back to the default state and the transmit queue dropped
+ * CDC_on_setup - SETUP packet on endpoint 0, 8 bytes
+ * CDC_on_complete - transfer finished on ep_addr (bit 7 set for IN), len bytes moved
+ */
+void CDC_on_reset(void);
+void CDC_on_setup(const uint8_t* packet);
+void CDC_on_complete(uint8_t ep_addr, uint32_t len);
+
+#endif
@@ -0,0 +1,208 @@
+/*
+ * crc_driver.c
+ *
+ * implementation file for crc_driver.h
+ *
+ *  Written by Ryan Wong
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "drivers/crc_driver.h"
+#include "drivers/rcc_driver.h"
+#include "drivers/dma_driver.h"
+
+#define CRC_DMA_STREAM DMA2_STREAM1
+
+// Only one DMA update can run at a time, as there's one CRC unit
+static CRC_Context* dma_owner = NULL;
+
+static uint32_t reverse_bits(uint32_t value);
+static uint32_t unstep32(uint32_t value);
+static void restore_state(uint32_t value);
+
+// HAL FUNCTIONS ==============================================================
+/**
+ * CRCEN is bit 12 of AHB1ENR, DMA2EN is bit 22
+ */
+HAL_Status CRC_enable_clock(void) {
+    RCC_AHB1ENR |= (0x01U << 12);
+    return DMA_enable_clock(DMA2);
+}
+
+HAL_Status CRC_begin(CRC_Context* ctx, CRC_Mode mode) {
+    if (
+        ctx == NULL ||
+        mode > CRC_MODE_NATIVE
+    ) return HAL_ERROR;
+
+    ctx->mode = mode;
+    ctx->state = CRC_INIT;
+    ctx->dma_busy = 0;
+    ctx->failed = 0;
+    return HAL_OK;
+}
+
+/**
+ * Standard mode keeps the state in the reflected (LSB first) domain, and the hardware register is always
+ * reverse_bits(state): reversing both the state and each input word turns the LSB first update into the
+ * hardware's MSB first one. Words are loaded with memcpy so unaligned buffers are fine (the M4 handles
+ * unaligned LDRs), and the 0-3 leftover bytes use the classic bitwise reflected loop
+ */
+HAL_Status CRC_update(CRC_Context* ctx, const void* data, uint32_t len) {
+    if (
+        ctx == NULL ||
+        (data == NULL && len != 0) ||
+        ctx->failed ||
+        (ctx->mode == CRC_MODE_NATIVE && (len & 0x03U)) ||
+        dma_owner != NULL
+    ) return HAL_ERROR;
+
+    const uint8_t* bytes = (const uint8_t*)data;
+    uint32_t word;
+
+    if (ctx->mode == CRC_MODE_NATIVE) {
+        restore_state(ctx->state);
+        for (; len >= 4U; len -= 4U, bytes += 4) {
+            memcpy(&word, bytes, 4);
+            CRC->DR = word;
+        }
+        ctx->state = CRC->DR;
+        return HAL_OK;
+    }
+
+    uint32_t state = ctx->state;
+    if (len >= 4U) {
+        restore_state(reverse_bits(state));
+        for (; len >= 4U; len -= 4U, bytes += 4) {
+            memcpy(&word, bytes, 4);
+            CRC->DR = reverse_bits(word);
+        }
+        state = reverse_bits(CRC->DR);
+    }
+    while (len--) {
+        state ^= *bytes++;
+        for (uint32_t bit = 0; bit < 8U; bit++) {
+            state = (state >> 1) ^ (CRC_POLY_REFLECTED & (0U - (state & 0x01U)));
+        }
+    }
+    ctx->state = state;
+    return HAL_OK;
+}
+
+/**
+ * Memory to memory with the destination address fixed on CRC->DR, so each word the DMA reads
+ * is written straight into the unit. Nothing runs on the CPU until the transfer is done
+ */
+HAL_Status CRC_update_dma(CRC_Context* ctx, const void* data, uint32_t len) {
+    if (
+        ctx == NULL ||
+        data == NULL ||
+        ctx->failed ||
+        ctx->mode != CRC_MODE_NATIVE ||
+        len == 0 ||
+        (len & 0x03U) ||
+        ((uint32_t)data & 0x03U) ||
+        len / 4U > 0xFFFFU ||
+        dma_owner != NULL
+    ) return HAL_ERROR;
+
+    DMA_Init_TypeDef init;
+    init.channel = DMA_CHANNEL_0;
+    init.direction = DMA_DIR_M2M;
+    init.psize = DMA_SIZE_WORD;
+    init.msize = DMA_SIZE_WORD;
+    init.pinc = 1;
+    init.minc = 0;
+    init.circular = 0;
+    init.priority = DMA_PRIORITY_MED;
+    init.fifo_enable = 1;
+    init.fifo_threshold = DMA_FIFO_FULL;
+    init.pburst = DMA_BURST_SINGLE;
+    init.mburst = DMA_BURST_SINGLE;
+    init.irq_enable = 0;
+    init.periph_flow = 0;
+    if (DMA_init(CRC_DMA_STREAM, &init) != HAL_OK) return HAL_ERROR;
+
+    restore_state(ctx->state);
+    dma_owner = ctx;
+    ctx->dma_busy = 1;
+    if (DMA_start(CRC_DMA_STREAM, (uint32_t)data, (uint32_t)&CRC->DR, (uint16_t)(len / 4U)) != HAL_OK) {
+        dma_owner = NULL;
+        ctx->dma_busy = 0;
+        return HAL_ERROR;
+    }
+    return HAL_OK;
+}
+
+/**
+ * On a transfer error the stream has already stopped, but some words never reached the unit,
+ * so CRC->DR isn't a checksum of anything and isn't saved
+ */
+CRC_DMA_State CRC_dma_poll(CRC_Context* ctx) {
+    if (ctx == NULL) return CRC_DMA_IDLE;
+    if (!ctx->dma_busy) return ctx->failed ? CRC_DMA_ERROR : CRC_DMA_IDLE;
+
+    uint32_t flags = DMA_get_flags(CRC_DMA_STREAM);
+    if (!(flags & (DMA_FLAG_TC | DMA_FLAG_TE))) return CRC_DMA_BUSY;
+
+    DMA_clear_flags(CRC_DMA_STREAM, DMA_FLAG_ALL);
+    if (flags & DMA_FLAG_TE) {
+        ctx->failed = 1;
+    } else {
+        ctx->state = CRC->DR;
+    }
+    ctx->dma_busy = 0;
+    dma_owner = NULL;
+    return ctx->failed ? CRC_DMA_ERROR : CRC_DMA_IDLE;
+}
+
+uint32_t CRC_finish(const CRC_Context* ctx) {
+    if (ctx == NULL || ctx->failed) return 0;
+
+    if (ctx->mode == CRC_MODE_STANDARD) {
+        return ~ctx->state;
+    }
+    return ctx->state;
+}
+
+uint32_t CRC_compute(CRC_Mode mode, const void* data, uint32_t len) {
+    CRC_Context ctx;
+    if (CRC_begin(&ctx, mode) != HAL_OK) return 0;
+    if (CRC_update(&ctx, data, len) != HAL_OK) return 0;
+    return CRC_finish(&ctx);
+}
+
+// HELPER FUNCTIONS ==============================================================
+static uint32_t reverse_bits(uint32_t value) {
+    uint32_t result;
+    __asm ("rbit %0, %1" : "=r" (result) : "r" (value));
+    return result;
+}
+
+/**
+ * Undoes 32 steps of the hardware's shift register. Each step is x -> (x << 1) ^ (MSB ? POLY : 0),
+ * and since POLY has bit 0 set, the LSB of the result tells us whether the MSB was set
+ */
+static uint32_t unstep32(uint32_t value) {
+    for (uint32_t i = 0; i < 32U; i++) {
+        if (value & 0x01U) {
+            value = ((value ^ CRC_POLY) >> 1) | 0x80000000U;
+        } else {
+            value >>= 1;
+        }
+    }
+    return value;
+}
+
+/**
+ * Feeding word W into the unit gives step32(DR ^ W). After a reset DR = 0xFFFFFFFF,
+ * so feeding W = unstep32(value) ^ 0xFFFFFFFF leaves exactly `value` in DR
+ */
+static void restore_state(uint32_t value) {
+    if (CRC->DR == value) return;
+
+    CRC->CR = 0x01U;
+    CRC->DR = unstep32(value) ^ CRC_INIT;
+}
@@ -0,0 +1,183 @@
+/*
+ * dma_driver.c
+ *
+ * implementation file for dma_driver.h
+ *
+ *  Written by Ryan Wong
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "drivers/dma_driver.h"
+#include "drivers/rcc_driver.h"
+
+static DMA_Reg_TypeDef* get_controller(DMA_Stream_TypeDef* stream);
+static uint32_t get_stream_number(DMA_Stream_TypeDef* stream);
+static uint32_t get_flag_shift(uint32_t stream_number);
+
+// HAL FUNCTIONS ==============================================================
+/**
+ * DMA1EN is bit 21 and DMA2EN is bit 22 of AHB1ENR
+ */
+HAL_Status DMA_enable_clock(DMA_Reg_TypeDef* dma) {
+    if (dma == DMA1) {
+        RCC_AHB1ENR |= (0x01U << 21);
+    } else if (dma == DMA2) {
+        RCC_AHB1ENR |= (0x01U << 22);
+    } else {
+        return HAL_ERROR;
+    }
+    return HAL_OK;
+}
+
+/**
+ * CR can only be written while EN reads 0, so the stream is stopped first.
+ * The error interrupts are always enabled alongside TC when irq_enable is set,
+ * otherwise an error would silently stall whoever is waiting on the transfer
+ */
+HAL_Status DMA_init(DMA_Stream_TypeDef* stream, const DMA_Init_TypeDef* init_struct) {
+    DMA_Reg_TypeDef* dma = get_controller(stream);
+    if (
+        dma == NULL ||
+        init_struct == NULL ||
+        init_struct->channel > DMA_CHANNEL_7 ||
+        init_struct->direction > DMA_DIR_M2M ||
+        init_struct->psize > DMA_SIZE_WORD ||
+        init_struct->msize > DMA_SIZE_WORD ||
+        init_struct->priority > DMA_PRIORITY_VERY_HIGH ||
+        init_struct->fifo_threshold > DMA_FIFO_FULL ||
+        init_struct->pburst > DMA_BURST_INC16 ||
+        init_struct->mburst > DMA_BURST_INC16
+    ) return HAL_ERROR;
+
+    // Memory to memory only exists on DMA2, can't be circular and can't use direct mode
+    if (init_struct->direction == DMA_DIR_M2M) {
+        if (dma != DMA2 || init_struct->circular || !init_struct->fifo_enable) return HAL_ERROR;
+    }
+    // The peripheral can only end the transfer if it's the one moving data to or from memory
+    if (init_struct->periph_flow && (init_struct->direction == DMA_DIR_M2M || init_struct->circular)) {
+        return HAL_ERROR;
+    }
+    // Bursts need the FIFO
+    if (!init_struct->fifo_enable && (init_struct->pburst != DMA_BURST_SINGLE || init_struct->mburst != DMA_BURST_SINGLE)) {
+        return HAL_ERROR;
+    }
+
+    DMA_stop(stream);
+    DMA_clear_flags(stream, DMA_FLAG_ALL);
+
+    uint32_t cr = 0;
+    cr |= (uint32_t)init_struct->channel << 25;
+    cr |= (uint32_t)init_struct->mburst << 23;
+    cr |= (uint32_t)init_struct->pburst << 21;
+    cr |= (uint32_t)init_struct->priority << 16;
+    cr |= (uint32_t)init_struct->msize << 13;
+    cr |= (uint32_t)init_struct->psize << 11;
+    cr |= (init_struct->minc ? 0x01U : 0x00U) << 10;
+    cr |= (init_struct->pinc ? 0x01U : 0x00U) << 9;
+    cr |= (init_struct->circular ? 0x01U : 0x00U) << 8;
+    cr |= (uint32_t)init_struct->direction << 6;
+    cr |= (init_struct->periph_flow ? 0x01U : 0x00U) << 5;
+    if (init_struct->irq_enable) {
+        // TCIE, TEIE, DMEIE
+        cr |= (0x01U << 4) | (0x01U << 2) | (0x01U << 1);
+    }
+    stream->CR = cr;
+
+    // DMDIS (bit 2) turns the FIFO on, FTH is only meaningful with the FIFO on
+    if (init_struct->fifo_enable) {
+        stream->FCR = (0x01U << 2) | (uint32_t)init_struct->fifo_threshold;
+    } else {
+        stream->FCR = 0;
+    }
+    return HAL_OK;
+}
+
+HAL_Status DMA_start(DMA_Stream_TypeDef* stream, uint32_t periph_addr, uint32_t mem_addr, uint16_t count) {
+    if (
+        get_controller(stream) == NULL ||
+        count == 0
+    ) return HAL_ERROR;
+
+    // Stream still running, the caller has to wait or stop it first
+    if (stream->CR & 0x01U) {
+        return HAL_ERROR;
+    }
+
+    stream->PAR = periph_addr;
+    stream->M0AR = mem_addr;
+    stream->NDTR = count;
+    DMA_clear_flags(stream, DMA_FLAG_ALL);
+    stream->CR |= 0x01U;
+    return HAL_OK;
+}
+
+/**
+ * Clearing EN doesn't stop the stream instantly, the current transfer is finished first
+ * so we spin until the hardware clears EN itself
+ */
+HAL_Status DMA_stop(DMA_Stream_TypeDef* stream) {
+    if (
+        get_controller(stream) == NULL
+    ) return HAL_ERROR;
+
+    stream->CR &= ~0x01U;
+    while (stream->CR & 0x01U);
+    return HAL_OK;
+}
+
+/**
+ * The flags for 4 streams are packed into each of LISR/HISR, 6 bits each at shifts 0, 6, 16, 22
+ */
+uint32_t DMA_get_flags(DMA_Stream_TypeDef* stream) {
+    DMA_Reg_TypeDef* dma = get_controller(stream);
+    if (dma == NULL) return 0;
+
+    uint32_t n = get_stream_number(stream);
+    uint32_t isr = (n < 4) ? dma->LISR : dma->HISR;
+    return (isr >> get_flag_shift(n)) & DMA_FLAG_ALL;
+}
+
+HAL_Status DMA_clear_flags(DMA_Stream_TypeDef* stream, uint32_t flags) {
+    DMA_Reg_TypeDef* dma = get_controller(stream);
+    if (dma == NULL) return HAL_ERROR;
+
+    // IFCR registers are write 1 to clear, so no read-modify-write
+    uint32_t n = get_stream_number(stream);
+    uint32_t mask = (flags & DMA_FLAG_ALL) << get_flag_shift(n);
+    if (n < 4) {
+        dma->LIFCR = mask;
+    } else {
+        dma->HIFCR = mask;
+    }
+    return HAL_OK;
+}
+
+uint16_t DMA_get_remaining(DMA_Stream_TypeDef* stream) {
+    if (get_controller(stream) == NULL) return 0;
+    return (uint16_t)(stream->NDTR & 0xFFFFU);
+}
+
+// HELPER FUNCTIONS ==============================================================
+/**
+ * Similar trick to GPIO_enable_clock - both controllers are 0x400 aligned and all their
+ * streams sit inside that 0x400 block, so masking off the low bits gives the controller
+ */
+static DMA_Reg_TypeDef* get_controller(DMA_Stream_TypeDef* stream) {
+    uint32_t addr = (uint32_t)stream;
+    uint32_t base = addr & ~0x3FFU;
+    uint32_t offset = addr & 0x3FFU;
+
+    if (base != DMA1_BASE && base != DMA2_BASE) return NULL;
+    if (offset < 0x10U || offset > 0xB8U || (offset - 0x10U) % 0x18U != 0) return NULL;
+    return (DMA_Reg_TypeDef*)base;
+}
+
+static uint32_t get_stream_number(DMA_Stream_TypeDef* stream) {
+    return (((uint32_t)stream & 0x3FFU) - 0x10U) / 0x18U;
+}
+
+static uint32_t get_flag_shift(uint32_t stream_number) {
+    static const uint8_t shifts[4] = {0U, 6U, 16U, 22U};
+    return shifts[stream_number & 0x03U];
+}
@@ -0,0 +1,38 @@
+/*
+ * dwt_driver.c
+ *
+ * implementation file for dwt_driver.h
+ *
+ *  Written by Ryan Wong
+ */
+
+#include <stdint.h>
+#include "drivers/dwt_driver.h"
+#include "drivers/rcc_driver.h"
+
+// HAL FUNCTIONS ==============================================================
+/**
+ * DWT_CTRL bit 25 (NOCYCCNT) is set by cores without a cycle counter,
+ * emulators in particular tend to leave it out
+ */
+HAL_Status DWT_init(void) {
+    // TRCENA must be set before any DWT register can be written
+    DWT_DEMCR |= (0x01U << 24);
+
+    if (DWT_CTRL & (0x01U << 25)) {
+        return HAL_ERROR;
+    }
+
+    DWT_CYCCNT = 0;
+    DWT_CTRL |= 0x01U;
+    return HAL_OK;
+}
+
+uint32_t DWT_get_cycles(void) {
+    return DWT_CYCCNT;
+}
+
+uint32_t DWT_to_kbps(uint32_t bytes, uint32_t cycles) {
+    if (cycles == 0) return 0;
+    return (uint32_t)(((uint64_t)bytes * HCLK_frequency) / ((uint64_t)cycles * 1000U));
+}
@@ -0,0 +1,182 @@
+/*
+ * flash_driver.c
+ *
+ * implementation file for flash_driver.h
+ *
+ *  Written by Ryan Wong
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "drivers/flash_driver.h"
+
+#define FLASH_KEY1 0x45670123U
+#define FLASH_KEY2 0xCDEF89ABU
+
+// ACR bits
+#define FLASH_ACR_LATENCY 0x0FU
+#define FLASH_ACR_PRFTEN (0x01U << 8)
+#define FLASH_ACR_ICEN (0x01U << 9)
+#define FLASH_ACR_DCEN (0x01U << 10)
+#define FLASH_ACR_ICRST (0x01U << 11)
+#define FLASH_ACR_DCRST (0x01U << 12)
+
+// SR bits (errors are cleared by writing 1)
+#define FLASH_SR_EOP (0x01U << 0)
+#define FLASH_SR_OPERR (0x01U << 1)
+#define FLASH_SR_WRPERR (0x01U << 4)
+#define FLASH_SR_PGAERR (0x01U << 5)
+#define FLASH_SR_PGPERR (0x01U << 6)
+#define FLASH_SR_PGSERR (0x01U << 7)
+#define FLASH_SR_RDERR (0x01U << 8)
+#define FLASH_SR_BSY (0x01U << 16)
+#define FLASH_SR_ERRORS (FLASH_SR_OPERR | FLASH_SR_WRPERR | FLASH_SR_PGAERR | FLASH_SR_PGPERR | FLASH_SR_PGSERR | FLASH_SR_RDERR)
+
+// CR bits
+#define FLASH_CR_PG (0x01U << 0)
+#define FLASH_CR_SER (0x01U << 1)
+#define FLASH_CR_SNB_POS 3U
+#define FLASH_CR_PSIZE_X32 (0x02U << 8)
+#define FLASH_CR_PSIZE_MASK (0x03U << 8)
+#define FLASH_CR_STRT (0x01U << 16)
+#define FLASH_CR_LOCK (0x01U << 31)
+
+static HAL_Status wait_for_operation(void);
+
+// HAL FUNCTIONS ==============================================================
+/**
+ * The number of wait states goes up by one for every 30MHz of HCLK (at 2.7-3.6V), so 16MHz HSI needs 0
+ * and 180MHz needs 5. The new latency must be read back before the clock can be raised (RM0390 3.5.1)
+ */
+HAL_Status FLASH_set_latency(uint32_t hclk) {
+    if (
+        hclk == 0 ||
+        hclk > FLASH_WS_STEP * (FLASH_MAX_LATENCY + 1U)
+    ) return HAL_ERROR;
+
+    uint32_t latency = (hclk - 1U) / FLASH_WS_STEP;
+
+    uint32_t acr = FLASH->ACR & ~FLASH_ACR_LATENCY;
+    FLASH->ACR = acr | latency | FLASH_ACR_PRFTEN | FLASH_ACR_ICEN | FLASH_ACR_DCEN;
+    while ((FLASH->ACR & FLASH_ACR_LATENCY) != latency);
+    return HAL_OK;
+}
+
+HAL_Status FLASH_unlock(void) {
+    if (FLASH->CR & FLASH_CR_LOCK) {
+        FLASH->KEYR = FLASH_KEY1;
+        FLASH->KEYR = FLASH_KEY2;
+    }
+
+    if (FLASH->CR & FLASH_CR_LOCK) return HAL_ERROR;
+    return HAL_OK;
+}
+
+void FLASH_lock(void) {
+    FLASH->CR |= FLASH_CR_LOCK;
+}
+
+HAL_Status FLASH_erase_sector(uint32_t sector) {
+    if (
+        sector >= FLASH_NUM_SECTORS ||
+        (FLASH->CR & FLASH_CR_LOCK)
+    ) return HAL_ERROR;
+
+    // Anything left in SR is from an earlier operation, wait_for_operation() clears it
+    wait_for_operation();
+
+    FLASH->CR &= ~(FLASH_CR_PSIZE_MASK | (0x0FU << FLASH_CR_SNB_POS) | FLASH_CR_PG);
+    FLASH->CR |= FLASH_CR_PSIZE_X32 | (sector << FLASH_CR_SNB_POS) | FLASH_CR_SER;
+    FLASH->CR |= FLASH_CR_STRT;
+
+    HAL_Status status = wait_for_operation();
+    FLASH->CR &= ~(FLASH_CR_SER | (0x0FU << FLASH_CR_SNB_POS));
+    FLASH_flush_caches();
+    return status;
+}
+
+/**
+ * Setting PG turns the next write to main memory into a program operation,
+ * so the word is programmed by just storing it to its address
+ */
+HAL_Status FLASH_program_word(uint32_t address, uint32_t value) {
+    if (
+        (address & 0x03U) ||
+        address < FLASH_MAIN_BASE ||
+        address >= FLASH_get_sector_address(FLASH_NUM_SECTORS - 1U) + FLASH_get_sector_size(FLASH_NUM_SECTORS - 1U) ||
+        (FLASH->CR & FLASH_CR_LOCK)
+    ) return HAL_ERROR;
+
+    // Anything left in SR is from an earlier operation, wait_for_operation() clears it
+    wait_for_operation();
+
+    FLASH->CR &= ~(FLASH_CR_PSIZE_MASK | FLASH_CR_SER);
+    FLASH->CR |= FLASH_CR_PSIZE_X32 | FLASH_CR_PG;
+
+    *(volatile uint32_t*)address = value;
+    __asm volatile ("dsb");
+
+    HAL_Status status = wait_for_operation();
+    FLASH->CR &= ~FLASH_CR_PG;
+    FLASH_flush_caches();
+    return status;
+}
+
+HAL_Status FLASH_program(uint32_t address, const uint32_t* data, uint32_t count) {
+    if (data == NULL && count != 0) return HAL_ERROR;
+
+    for (uint32_t i = 0; i < count; i++) {
+        if (FLASH_program_word(address + i * 4U, data[i]) != HAL_OK) return HAL_ERROR;
+    }
+    return HAL_OK;
+}
+
+/**
+ * Sectors 0-3 are 16K, sector 4 is 64K and sectors 5-7 are 128K
+ */
+uint32_t FLASH_get_sector_address(uint32_t sector) {
+    if (sector >= FLASH_NUM_SECTORS) return 0;
+
+    if (sector < 4U) {
+        return FLASH_MAIN_BASE + sector * 0x4000U;
+    } else if (sector == 4U) {
+        return FLASH_MAIN_BASE + 0x10000U;
+    }
+    return FLASH_MAIN_BASE + 0x20000U + (sector - 5U) * 0x20000U;
+}
+
+uint32_t FLASH_get_sector_size(uint32_t sector) {
+    if (sector >= FLASH_NUM_SECTORS) return 0;
+
+    if (sector < 4U) {
+        return 0x4000U;
+    } else if (sector == 4U) {
+        return 0x10000U;
+    }
+    return 0x20000U;
+}
+
+/**
+ * The caches can only be reset while they're disabled. The previous enable state is put back afterwards
+ */
+void FLASH_flush_caches(void) {
+    uint32_t enabled = FLASH->ACR & (FLASH_ACR_ICEN | FLASH_ACR_DCEN);
+
+    FLASH->ACR &= ~(FLASH_ACR_ICEN | FLASH_ACR_DCEN);
+    FLASH->ACR |= FLASH_ACR_ICRST | FLASH_ACR_DCRST;
+    FLASH->ACR &= ~(FLASH_ACR_ICRST | FLASH_ACR_DCRST);
+    FLASH->ACR |= enabled;
+}
+
+// HELPER FUNCTIONS ==============================================================
+/**
+ * Waits for BSY to clear, then reports (and clears) any error flags left by the operation
+ */
+static HAL_Status wait_for_operation(void) {
+    while (FLASH->SR & FLASH_SR_BSY);
+
+    uint32_t sr = FLASH->SR;
+    FLASH->SR = FLASH_SR_EOP | FLASH_SR_ERRORS;
+    if (sr & FLASH_SR_ERRORS) return HAL_ERROR;
+    return HAL_OK;
+}
@@ -0,0 +1,68 @@
+/*
+ * fpu_driver.c
+ *
+ * implementation file for fpu_driver.h
+ * NOTE: FPU_enable() and FPU_set_stacking() are called from SystemInit, before .data/.bss are initialised,
+ * so nothing in here may rely on global variables
+ *
+ *  Written by Ryan Wong
+ */
+
+#include <stdint.h>
+#include "drivers/fpu_driver.h"
+
+// HAL FUNCTIONS ==============================================================
+/**
+ * Sets CP10 and CP11 to full access (bits 20-23). The barriers make sure the
+ * new access rights are in place before any following instruction is an FP one
+ */
+void FPU_enable(void) {
+    FPU_CPACR |= (3UL << 20) | (3UL << 22);
+    __asm volatile ("dsb\n\tisb" ::: "memory");
+}
+
+/**
+ * ASPEN and LSPEN are the only two bits we touch, the rest of FPCCR is status
+ */
+HAL_Status FPU_set_stacking(FPU_Stacking mode) {
+    if (
+        mode > FPU_STACKING_LAZY
+    ) return HAL_ERROR;
+
+    uint32_t fpccr = FPU_FPCCR & ~(FPU_FPCCR_ASPEN | FPU_FPCCR_LSPEN);
+    if (mode == FPU_STACKING_ALWAYS) {
+        fpccr |= FPU_FPCCR_ASPEN;
+    } else if (mode == FPU_STACKING_LAZY) {
+        fpccr |= FPU_FPCCR_ASPEN | FPU_FPCCR_LSPEN;
+    }
+    FPU_FPCCR = fpccr;
+    __asm volatile ("dsb\n\tisb" ::: "memory");
+    return HAL_OK;
+}
+
+/**
+ * ASPEN = 0 with LSPEN = 1 isn't a mode we ever set, but it behaves like NONE so report it as that
+ */
+FPU_Stacking FPU_get_stacking(void) {
+    uint32_t fpccr = FPU_FPCCR;
+    if (!(fpccr & FPU_FPCCR_ASPEN)) {
+        return FPU_STACKING_NONE;
+    }
+    if (fpccr & FPU_FPCCR_LSPEN) {
+        return FPU_STACKING_LAZY;
+    }
+    return FPU_STACKING_ALWAYS;
+}
+
+/**
+ * FPCA is bit 2 of CONTROL. The ISB makes sure the next exception sees the new value
+ */
+void FPU_discard_context(void) {
+    __asm volatile (
+        "mrs r0, control\n\t"
+        "bic r0, r0, #4\n\t"
+        "msr control, r0\n\t"
+        "isb"
+        ::: "r0", "memory"
+    );
+}
@@ -115,6 +115,21 @@ HAL_Status GPIO_write_port(GPIO_Reg_TypeDef* port, uint16_t val) {
     return HAL_OK;
 }
 
+/**
+ * Same idea as GPIO_write_port, but set/reset bits are only generated for pins in the mask,
+ * so other pins on the port (and whatever an ISR is doing to them) are left alone
+ */
+HAL_Status GPIO_write_port_masked(GPIO_Reg_TypeDef* port, uint16_t mask, uint16_t val) {
+    if (
+        port == NULL
+    ) return HAL_ERROR;
+
+    uint16_t set = val & mask;
+    uint16_t reset = (uint16_t)~val & mask;
+    port->BSRR = (uint32_t)set | ((uint32_t)reset << 16);
+    return HAL_OK;
+}
+
 /**
  * Instead of XOR toggling the ODR reg, I try to read from it, 
  * and set the relevant bit in BSRR to prevent interrupt race conditions
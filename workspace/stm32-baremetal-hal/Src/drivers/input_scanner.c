@@ -0,0 +1,143 @@
+/*
+ * input_scanner.c
+ *
+ * implementation file for input_scanner.h
+ *
+ *  Written by Ryan Wong
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "drivers/input_scanner.h"
+#include "drivers/nvic_driver.h"
+
+static void drive_row(SCAN_Matrix* matrix);
+
+// HAL FUNCTIONS ==============================================================
+/**
+ * Vertical counter debounce (4 samples). For every bit where the sample differs from the debounced state,
+ * the (cnt1, cnt0) counter steps 00 -> 01 -> 10 -> 11 -> 00, and the state toggles as it wraps back to 00.
+ * Any bit whose sample agrees with the state gets its counter reset to 00 by the "& delta"
+ */
+void SCAN_debounce(SCAN_Lane* lane, uint16_t sample) {
+    uint16_t delta = sample ^ lane->state;
+    lane->cnt1 = (lane->cnt1 ^ lane->cnt0) & delta;
+    lane->cnt0 = (uint16_t)~lane->cnt0 & delta;
+
+    uint16_t toggle = delta & (uint16_t)~(lane->cnt0 | lane->cnt1);
+    lane->state ^= toggle;
+    lane->pressed |= toggle & lane->state;
+    lane->released |= toggle & (uint16_t)~lane->state;
+}
+
+HAL_Status SCAN_port_init(SCAN_Port* scan, GPIO_Reg_TypeDef* port, uint16_t mask, uint16_t invert) {
+    if (
+        scan == NULL ||
+        port == NULL
+    ) return HAL_ERROR;
+
+    uint16_t raw;
+    if (GPIO_read_port(port, &raw) != HAL_OK) return HAL_ERROR;
+
+    scan->port = port;
+    scan->mask = mask;
+    scan->invert = invert & mask;
+    scan->lane.state = (raw ^ scan->invert) & mask;
+    scan->lane.cnt0 = 0;
+    scan->lane.cnt1 = 0;
+    scan->lane.pressed = 0;
+    scan->lane.released = 0;
+    return HAL_OK;
+}
+
+HAL_Status SCAN_port_tick(SCAN_Port* scan) {
+    if (scan == NULL) return HAL_ERROR;
+
+    uint16_t raw;
+    if (GPIO_read_port(scan->port, &raw) != HAL_OK) return HAL_ERROR;
+
+    SCAN_debounce(&scan->lane, (raw ^ scan->invert) & scan->mask);
+    return HAL_OK;
+}
+
+/**
+ * The row pin numbers are pulled out of row_mask once here so the tick doesn't have to search for set bits
+ */
+HAL_Status SCAN_matrix_init(SCAN_Matrix* matrix, GPIO_Reg_TypeDef* row_port, uint16_t row_mask, GPIO_Reg_TypeDef* col_port, uint16_t col_mask) {
+    if (
+        matrix == NULL ||
+        row_port == NULL ||
+        col_port == NULL ||
+        row_mask == 0
+    ) return HAL_ERROR;
+
+    uint8_t rows = 0;
+    for (uint8_t pin = 0; pin < 16U; pin++) {
+        if (row_mask & (0x01U << pin)) {
+            if (rows >= SCAN_MATRIX_MAX_ROWS) return HAL_ERROR;
+            matrix->row_pins[rows++] = pin;
+        }
+    }
+
+    matrix->row_port = row_port;
+    matrix->row_mask = row_mask;
+    matrix->col_port = col_port;
+    matrix->col_mask = col_mask;
+    matrix->num_rows = rows;
+    matrix->current_row = 0;
+    for (uint8_t r = 0; r < rows; r++) {
+        matrix->lanes[r].state = 0;
+        matrix->lanes[r].cnt0 = 0;
+        matrix->lanes[r].cnt1 = 0;
+        matrix->lanes[r].pressed = 0;
+        matrix->lanes[r].released = 0;
+    }
+
+    drive_row(matrix);
+    return HAL_OK;
+}
+
+/**
+ * Columns idle high through their pull ups, so a pressed key reads as 0 - invert before debouncing
+ */
+HAL_Status SCAN_matrix_tick(SCAN_Matrix* matrix) {
+    if (matrix == NULL || matrix->num_rows == 0) return HAL_ERROR;
+
+    uint16_t raw;
+    if (GPIO_read_port(matrix->col_port, &raw) != HAL_OK) return HAL_ERROR;
+    SCAN_debounce(&matrix->lanes[matrix->current_row], (uint16_t)~raw & matrix->col_mask);
+
+    matrix->current_row++;
+    if (matrix->current_row >= matrix->num_rows) {
+        matrix->current_row = 0;
+    }
+    drive_row(matrix);
+    return HAL_OK;
+}
+
+/**
+ * The tick ISR can OR new edges in at any time, so the read and clear have to happen together
+ */
+HAL_Status SCAN_get_events(SCAN_Lane* lane, uint16_t* pressed, uint16_t* released) {
+    if (lane == NULL) return HAL_ERROR;
+
+    uint32_t primask = NVIC_enter_critical();
+    uint16_t p = lane->pressed;
+    uint16_t r = lane->released;
+    lane->pressed = 0;
+    lane->released = 0;
+    NVIC_exit_critical(primask);
+
+    if (pressed != NULL) *pressed = p;
+    if (released != NULL) *released = r;
+    return HAL_OK;
+}
+
+// HELPER FUNCTIONS ==============================================================
+/**
+ * Current row low, every other row high, in one BSRR write that doesn't touch the rest of the port
+ */
+static void drive_row(SCAN_Matrix* matrix) {
+    uint16_t active = (uint16_t)(0x01U << matrix->row_pins[matrix->current_row]);
+    GPIO_write_port_masked(matrix->row_port, matrix->row_mask, (uint16_t)~active);
+}
@@ -0,0 +1,80 @@
+/*
+ * nvic_driver.c
+ *
+ * implementation file for nvic_driver.h
+ *
+ *  Written by Ryan Wong
+ */
+
+#include <stdint.h>
+#include "drivers/nvic_driver.h"
+
+// HAL FUNCTIONS ==============================================================
+/**
+ * ISER/ICER/ISPR/ICPR are all write 1 to take effect, writing 0 does nothing
+ * so there is no need to read-modify-write here
+ */
+HAL_Status NVIC_enable_irq(NVIC_IRQn irq) {
+    if (
+        irq > NVIC_IRQ_MAX
+    ) return HAL_ERROR;
+
+    NVIC_ISER[(uint32_t)irq >> 5] = 0x01U << ((uint32_t)irq & 0x1FU);
+    return HAL_OK;
+}
+
+HAL_Status NVIC_disable_irq(NVIC_IRQn irq) {
+    if (
+        irq > NVIC_IRQ_MAX
+    ) return HAL_ERROR;
+
+    NVIC_ICER[(uint32_t)irq >> 5] = 0x01U << ((uint32_t)irq & 0x1FU);
+    // Make sure the disable has taken effect before we return (ARM recommends this after ICER writes)
+    __asm volatile ("dsb\n\tisb" ::: "memory");
+    return HAL_OK;
+}
+
+HAL_Status NVIC_set_pending(NVIC_IRQn irq) {
+    if (
+        irq > NVIC_IRQ_MAX
+    ) return HAL_ERROR;
+
+    NVIC_ISPR[(uint32_t)irq >> 5] = 0x01U << ((uint32_t)irq & 0x1FU);
+    return HAL_OK;
+}
+
+HAL_Status NVIC_clear_pending(NVIC_IRQn irq) {
+    if (
+        irq > NVIC_IRQ_MAX
+    ) return HAL_ERROR;
+
+    NVIC_ICPR[(uint32_t)irq >> 5] = 0x01U << ((uint32_t)irq & 0x1FU);
+    return HAL_OK;
+}
+
+/**
+ * Only the top NVIC_PRIO_BITS of each IPR byte are implemented, so the priority is shifted up
+ */
+HAL_Status NVIC_set_priority(NVIC_IRQn irq, uint8_t priority) {
+    if (
+        irq > NVIC_IRQ_MAX ||
+        priority > NVIC_MAX_PRIORITY
+    ) return HAL_ERROR;
+
+    NVIC_IPR[(uint32_t)irq] = (uint8_t)(priority << (8U - NVIC_PRIO_BITS));
+    return HAL_OK;
+}
+
+/**
+ * Saving and restoring PRIMASK (instead of blindly enabling on exit) means
+ * this is safe to call from inside an ISR or an already critical section
+ */
+uint32_t NVIC_enter_critical(void) {
+    uint32_t primask;
+    __asm volatile ("mrs %0, primask\n\tcpsid i" : "=r" (primask) :: "memory");
+    return primask;
+}
+
+void NVIC_exit_critical(uint32_t primask) {
+    __asm volatile ("msr primask, %0" :: "r" (primask) : "memory");
+}
@@ -0,0 +1,280 @@
+/*
+ * qspi_driver.c
+ *
+ * implementation file for qspi_driver.h
+ *
+ *  Written by Ryan Wong
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "drivers/qspi_driver.h"
+#include "drivers/rcc_driver.h"
+#include "drivers/gpio_driver.h"
+
+#define QSPI_CR_EN (0x01U << 0)
+#define QSPI_CR_ABORT (0x01U << 1)
+#define QSPI_CR_SSHIFT (0x01U << 4)
+#define QSPI_CR_APMS (0x01U << 22)
+#define QSPI_FMODE_WRITE 0x00U
+#define QSPI_FMODE_READ 0x01U
+#define QSPI_FMODE_POLL 0x02U
+#define QSPI_FMODE_MAPPED 0x03U
+#define QSPI_FLAGS (QSPI_SR_TEF | QSPI_SR_TCF | QSPI_SR_SMF | QSPI_SR_TOF)
+#define QSPI_TIMEOUT_MS 100U
+#define QSPI_POLL_INTERVAL 16U // flash clocks between auto poll reads
+
+static uint32_t flash_clock = 0;
+static uint8_t mapped = 0;
+
+static void init_pin(GPIO_Reg_TypeDef* port, GPIO_Pin pin, GPIO_AFx af, GPIO_Pupd pupd);
+static uint8_t command_valid(const QSPI_Command_TypeDef* command, uint8_t needs_data);
+static uint32_t command_ccr(const QSPI_Command_TypeDef* command, uint32_t fmode);
+static HAL_Status start(const QSPI_Command_TypeDef* command, uint32_t fmode, uint32_t len);
+static HAL_Status wait_flag(uint32_t flag, uint32_t timeout_ms);
+static uint32_t fifo_level(void);
+
+// HAL FUNCTIONS ==============================================================
+/**
+ * QSPIEN is bit 1 of AHB3ENR. FSIZE is log2(size) - 1, CSHT the NCS high time in clocks - 1.
+ * Sample shift delays sampling by half a clock, which gives the flash's output delay some room
+ */
+HAL_Status QSPI_init(const QSPI_Init_TypeDef* init_struct) {
+    if (
+        init_struct == NULL ||
+        init_struct->clock_frequency == 0 ||
+        init_struct->flash_size_log2 < 1U ||
+        init_struct->flash_size_log2 > 28U // the mapped window is 256MB
+    ) return HAL_ERROR;
+
+    RCC_AHB3ENR |= (0x01U << 1);
+
+    GPIO_enable_clock(GPIOA);
+    GPIO_enable_clock(GPIOB);
+    GPIO_enable_clock(GPIOC);
+    init_pin(GPIOB, GPIO_PIN_2, GPIO_AF9, GPIO_PUPD_NONE); // CLK
+    init_pin(GPIOB, GPIO_PIN_6, GPIO_AF10, GPIO_PUPD_PU); // NCS, held high while the pins switch over
+    init_pin(GPIOC, GPIO_PIN_9, GPIO_AF9, GPIO_PUPD_NONE); // IO0
+    init_pin(GPIOC, GPIO_PIN_10, GPIO_AF9, GPIO_PUPD_NONE); // IO1
+    init_pin(GPIOC, GPIO_PIN_8, GPIO_AF9, GPIO_PUPD_PU); // IO2 (/WP)
+    init_pin(GPIOA, GPIO_PIN_1, GPIO_AF9, GPIO_PUPD_PU); // IO3 (/HOLD)
+
+    uint32_t prescaler = (HCLK_frequency + init_struct->clock_frequency - 1U) / init_struct->clock_frequency;
+    prescaler = (prescaler == 0) ? 0U : prescaler - 1U;
+    if (prescaler > 0xFFU) prescaler = 0xFFU;
+    flash_clock = HCLK_frequency / (prescaler + 1U);
+
+    uint32_t cs_high = (uint32_t)(((uint64_t)init_struct->cs_high_ns * flash_clock + 999999999U) / 1000000000U);
+    if (cs_high < 1U) cs_high = 1U;
+    if (cs_high > 8U) cs_high = 8U;
+
+    QUADSPI->CR = 0;
+    QUADSPI->FCR = QSPI_FLAGS;
+    QUADSPI->DCR = ((uint32_t)(init_struct->flash_size_log2 - 1U) << 16) | ((cs_high - 1U) << 8);
+    QUADSPI->CR = (prescaler << 24) | (0x03U << 8) | QSPI_CR_SSHIFT | QSPI_CR_EN; // FIFO threshold 4 bytes
+    mapped = 0;
+    return HAL_OK;
+}
+
+uint32_t QSPI_get_clock(void) {
+    return flash_clock;
+}
+
+HAL_Status QSPI_command(const QSPI_Command_TypeDef* command) {
+    if (!command_valid(command, 0)) return HAL_ERROR;
+
+    QSPI_Command_TypeDef no_data = *command;
+    no_data.data_lines = QSPI_LINES_NONE;
+    if (start(&no_data, QSPI_FMODE_WRITE, 0) != HAL_OK) return HAL_ERROR;
+
+    HAL_Status status = wait_flag(QSPI_SR_TCF, QSPI_TIMEOUT_MS);
+    QUADSPI->FCR = QSPI_SR_TCF;
+    return status;
+}
+
+/**
+ * Words are popped while at least 4 bytes are waiting, single bytes (8 bit accesses to DR) otherwise
+ */
+HAL_Status QSPI_read(const QSPI_Command_TypeDef* command, void* buffer, uint32_t len) {
+    if (
+        !command_valid(command, 1) ||
+        buffer == NULL ||
+        len == 0
+    ) return HAL_ERROR;
+
+    if (start(command, QSPI_FMODE_READ, len) != HAL_OK) return HAL_ERROR;
+
+    uint8_t* dst = buffer;
+    while (len > 0) {
+        uint32_t level = fifo_level();
+        if (level == 0) {
+            if (QUADSPI->SR & QSPI_SR_TEF) break;
+            continue;
+        }
+        if (len >= 4U && level >= 4U) {
+            uint32_t word = QUADSPI->DR;
+            memcpy(dst, &word, 4U);
+            dst += 4;
+            len -= 4U;
+        } else {
+            *dst++ = *(volatile uint8_t*)&QUADSPI->DR;
+            len--;
+        }
+    }
+
+    HAL_Status status = (len == 0) ? wait_flag(QSPI_SR_TCF, QSPI_TIMEOUT_MS) : HAL_ERROR;
+    QUADSPI->FCR = QSPI_SR_TCF;
+    return status;
+}
+
+HAL_Status QSPI_write(const QSPI_Command_TypeDef* command, const void* buffer, uint32_t len) {
+    if (
+        !command_valid(command, 1) ||
+        buffer == NULL ||
+        len == 0
+    ) return HAL_ERROR;
+
+    if (start(command, QSPI_FMODE_WRITE, len) != HAL_OK) return HAL_ERROR;
+
+    const uint8_t* src = buffer;
+    while (len > 0) {
+        uint32_t space = QSPI_FIFO_SIZE - fifo_level();
+        if (QUADSPI->SR & QSPI_SR_TEF) break;
+        if (len >= 4U && space >= 4U) {
+            uint32_t word;
+            memcpy(&word, src, 4U);
+            QUADSPI->DR = word;
+            src += 4;
+            len -= 4U;
+        } else if (space > 0) {
+            *(volatile uint8_t*)&QUADSPI->DR = *src++;
+            len--;
+        }
+    }
+
+    HAL_Status status = (len == 0) ? wait_flag(QSPI_SR_TCF, QSPI_TIMEOUT_MS) : HAL_ERROR;
+    QUADSPI->FCR = QSPI_SR_TCF;
+    return status;
+}
+
+/**
+ * APMS stops the polling on the first match, so the controller is idle again once SMF is set
+ */
+HAL_Status QSPI_auto_poll(const QSPI_Command_TypeDef* command, uint8_t match, uint8_t mask, uint32_t timeout_ms) {
+    if (!command_valid(command, 1)) return HAL_ERROR;
+
+    QUADSPI->PSMKR = mask;
+    QUADSPI->PSMAR = match;
+    QUADSPI->PIR = QSPI_POLL_INTERVAL;
+    QUADSPI->CR |= QSPI_CR_APMS;
+    if (start(command, QSPI_FMODE_POLL, 1U) != HAL_OK) return HAL_ERROR;
+
+    if (wait_flag(QSPI_SR_SMF, timeout_ms) != HAL_OK) {
+        QSPI_abort();
+        return HAL_ERROR;
+    }
+    QUADSPI->FCR = QSPI_SR_SMF;
+    return HAL_OK;
+}
+
+/**
+ * Writing CCR is what switches the mode, there's no address or data to kick off
+ */
+HAL_Status QSPI_memory_mapped(const QSPI_Command_TypeDef* command) {
+    if (!command_valid(command, 1)) return HAL_ERROR;
+
+    if (start(command, QSPI_FMODE_MAPPED, 0) != HAL_OK) return HAL_ERROR;
+    mapped = 1;
+    return HAL_OK;
+}
+
+uint8_t QSPI_is_memory_mapped(void) {
+    return mapped;
+}
+
+/**
+ * ABORT clears itself once the controller has stopped
+ */
+HAL_Status QSPI_abort(void) {
+    QUADSPI->CR |= QSPI_CR_ABORT;
+    mapped = 0;
+
+    uint32_t limit = (HCLK_frequency / 4000U) * QSPI_TIMEOUT_MS;
+    for (uint32_t i = 0; i < limit; i++) {
+        if (!(QUADSPI->CR & QSPI_CR_ABORT) && !(QUADSPI->SR & QSPI_SR_BUSY)) {
+            QUADSPI->FCR = QSPI_FLAGS;
+            return HAL_OK;
+        }
+    }
+    return HAL_ERROR;
+}
+
+// HELPER FUNCTIONS ==============================================================
+static void init_pin(GPIO_Reg_TypeDef* port, GPIO_Pin pin, GPIO_AFx af, GPIO_Pupd pupd) {
+    GPIO_Init_TypeDef init;
+    init.mode = GPIO_MODE_AF;
+    init.otype = GPIO_OTYPE_PP;
+    init.ospeed = GPIO_OSPEED_HIGH;
+    init.pupd = pupd;
+    init.afx = af;
+    init.init_out_state = PIN_RESET;
+    GPIO_init(port, pin, &init);
+}
+
+static uint8_t command_valid(const QSPI_Command_TypeDef* command, uint8_t needs_data) {
+    return command != NULL &&
+           command->instruction_lines <= QSPI_LINES_4 &&
+           command->address_lines <= QSPI_LINES_4 &&
+           command->address_size <= QSPI_ADDRESS_32BIT &&
+           command->alt_lines <= QSPI_LINES_4 &&
+           command->data_lines <= QSPI_LINES_4 &&
+           command->dummy_cycles <= 31U &&
+           (!needs_data || command->data_lines != QSPI_LINES_NONE);
+}
+
+/**
+ * ABSIZE is left at 0 (one alternate byte)
+ */
+static uint32_t command_ccr(const QSPI_Command_TypeDef* command, uint32_t fmode) {
+    return (uint32_t)command->instruction |
+           ((uint32_t)command->instruction_lines << 8) |
+           ((uint32_t)command->address_lines << 10) |
+           ((uint32_t)command->address_size << 12) |
+           ((uint32_t)command->alt_lines << 14) |
+           ((uint32_t)command->dummy_cycles << 18) |
+           ((uint32_t)command->data_lines << 24) |
+           (fmode << 26);
+}
+
+/**
+ * Leaves memory mapped mode if needed, then programs the command. The transfer starts on the CCR write if there's
+ * no address phase, otherwise on the AR write, so AR goes last. Memory mapped mode never writes AR
+ */
+static HAL_Status start(const QSPI_Command_TypeDef* command, uint32_t fmode, uint32_t len) {
+    if ((mapped || (QUADSPI->SR & QSPI_SR_BUSY)) && QSPI_abort() != HAL_OK) return HAL_ERROR;
+
+    QUADSPI->FCR = QSPI_FLAGS;
+    if (len > 0) QUADSPI->DLR = len - 1U;
+    if (command->alt_lines != QSPI_LINES_NONE) QUADSPI->ABR = command->alt_byte;
+    QUADSPI->CCR = command_ccr(command, fmode);
+    if (command->address_lines != QSPI_LINES_NONE && fmode != QSPI_FMODE_MAPPED) QUADSPI->AR = command->address;
+    return HAL_OK;
+}
+
+/**
+ * Each pass reads SR over the AHB, so this loop takes at least 4 cycles per pass
+ */
+static HAL_Status wait_flag(uint32_t flag, uint32_t timeout_ms) {
+    uint32_t limit = (HCLK_frequency / 4000U) * timeout_ms;
+    for (uint32_t i = 0; i < limit; i++) {
+        uint32_t sr = QUADSPI->SR;
+        if (sr & QSPI_SR_TEF) return HAL_ERROR;
+        if (sr & flag) return HAL_OK;
+    }
+    return HAL_ERROR;
+}
+
+static uint32_t fifo_level(void) {
+    return (QUADSPI->SR >> 8) & 0x3FU;
+}
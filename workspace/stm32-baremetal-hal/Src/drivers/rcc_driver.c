@@ -7,13 +7,25 @@
  */
 
 #include <stdint.h>
+#include <stdlib.h>
 #include "drivers/rcc_driver.h"
 
+#define RCC_CR_PLLON (0x01U << 24)
+#define RCC_CR_PLLRDY (0x01U << 25)
+#define RCC_PLL_LOCK_TIMEOUT 100000U // RCC_CR reads, the PLL locks in well under 1ms
+
 static uint32_t get_prescaler_from_ppre(uint32_t ppre);
+static void update_pclk();
+static uint32_t get_pll_vco();
+static uint8_t pll_config_valid(const RCC_PLL_Config* config);
 
 // Global variable specifying HCLK frequency
 volatile uint32_t HCLK_frequency = HSI_FREQ;
 
+// Global variables specifying PCLK1/PCLK2 frequencies (both prescalers are 1 out of reset)
+volatile uint32_t PCLK1_frequency = HSI_FREQ;
+volatile uint32_t PCLK2_frequency = HSI_FREQ;
+
 
 // HAL FUNCTIONS ==============================================================
 /**
@@ -43,7 +55,32 @@ void update_hclk() {
     } else if (clk_src == 0x01) {
         // HSE selected
         // do nothing for now because HSE switching is not implemented
+    } else if (clk_src == 0x02) {
+        // PLL selected, PLLP is (p / 2) - 1
+        HCLK_frequency = get_pll_vco() / ((((RCC_PLLCFGR >> 16) & 0x03U) + 1U) * 2U) / divisor;
     }
+
+    // The APB clocks are derived from HCLK so they have to follow it
+    update_pclk();
+}
+
+/**
+ * If the APB prescaler is anything other than 1, the timers on that bus get double the bus clock
+ */
+uint32_t RCC_get_APB1_timer_clock() {
+    uint32_t ppre1 = (RCC_CFGR & (0x07U << 10)) >> 10;
+    if (get_prescaler_from_ppre(ppre1) == 1) {
+        return PCLK1_frequency;
+    }
+    return PCLK1_frequency * 2U;
+}
+
+uint32_t RCC_get_APB2_timer_clock() {
+    uint32_t ppre2 = (RCC_CFGR & (0x07U << 13)) >> 13;
+    if (get_prescaler_from_ppre(ppre2) == 1) {
+        return PCLK2_frequency;
+    }
+    return PCLK2_frequency * 2U;
 }
 
 /**
@@ -79,6 +116,7 @@ HAL_Status RCC_set_APB1_prescaler(RCC_APB_Prescaler div) {
     RCC_CFGR &= ~(0x07U << 10);
     RCC_CFGR |= div << 10;
 
+    update_pclk();
     return HAL_OK;
 }
 
@@ -99,10 +137,88 @@ HAL_Status RCC_set_APB2_prescaler(RCC_APB_Prescaler div) {
     RCC_CFGR &= ~(0x07U << 13);
     RCC_CFGR |= div << 13;
 
+    update_pclk();
     return HAL_OK; 
 }
 
+/**
+ * PLLCFGR can only be written while the PLL is off, so a running PLL is stopped first (unless it's SYSCLK).
+ * PLLSRC (bit 22) = 0 picks HSI, CK48MSEL (bit 27 of DCKCFGR2) = 0 picks the Q output for the 48MHz domain
+ */
+HAL_Status RCC_enable_PLL(const RCC_PLL_Config* config) {
+    if (
+        !pll_config_valid(config) ||
+        ((RCC_CFGR >> 2) & 0x03U) == 0x02U
+    ) return HAL_ERROR;
+
+    RCC_CR &= ~RCC_CR_PLLON;
+    uint32_t i = 0;
+    while ((RCC_CR & RCC_CR_PLLRDY) && i < RCC_PLL_LOCK_TIMEOUT) i++;
+    if (i == RCC_PLL_LOCK_TIMEOUT) return HAL_ERROR;
+
+    uint32_t pllcfgr = RCC_PLLCFGR;
+    pllcfgr &= ~((0x3FU << 0) | (0x1FFU << 6) | (0x03U << 16) | (0x01U << 22) | (0x0FU << 24));
+    pllcfgr |= (uint32_t)config->m |
+               ((uint32_t)config->n << 6) |
+               ((uint32_t)(config->p / 2U - 1U) << 16) |
+               ((uint32_t)config->q << 24);
+    RCC_PLLCFGR = pllcfgr;
+    RCC_DCKCFGR2 &= ~(0x01U << 27);
+
+    RCC_CR |= RCC_CR_PLLON;
+    for (i = 0; i < RCC_PLL_LOCK_TIMEOUT; i++) {
+        if (RCC_CR & RCC_CR_PLLRDY) return HAL_OK;
+    }
+    RCC_CR &= ~RCC_CR_PLLON;
+    return HAL_ERROR;
+}
+
+uint32_t RCC_get_PLL48_clock() {
+    if (!(RCC_CR & RCC_CR_PLLRDY) || (RCC_DCKCFGR2 & (0x01U << 27))) return 0;
+
+    uint32_t q = (RCC_PLLCFGR >> 24) & 0x0FU;
+    if (q < 2U) return 0;
+    return get_pll_vco() / q;
+}
+
 // HELPER FUNCTIONS ==============================================================
+/**
+ * VCO output from PLLM/PLLN, assuming HSI as the source (HSE isn't supported yet)
+ */
+static uint32_t get_pll_vco() {
+    uint32_t m = RCC_PLLCFGR & 0x3FU;
+    uint32_t n = (RCC_PLLCFGR >> 6) & 0x1FFU;
+    if (m < 2U) return 0;
+    return HSI_FREQ / m * n;
+}
+
+static uint8_t pll_config_valid(const RCC_PLL_Config* config) {
+    if (
+        config == NULL ||
+        config->m < 2U || config->m > 63U ||
+        config->n < 50U || config->n > 432U ||
+        config->p < 2U || config->p > 8U || (config->p % 2U) ||
+        config->q < 2U || config->q > 15U
+    ) return 0;
+
+    uint32_t vco_in = HSI_FREQ / config->m;
+    uint32_t vco = vco_in * config->n;
+    return vco_in >= 1000000U && vco_in <= 2000000U &&
+           vco >= 100000000U && vco <= 432000000U &&
+           vco / config->p <= 180000000U &&
+           vco / config->q <= RCC_PLL48_FREQ;
+}
+
+/**
+ * Recomputes PCLK1/PCLK2 from HCLK and the current PPRE1/PPRE2 bits
+ */
+static void update_pclk() {
+    uint32_t ppre1 = (RCC_CFGR & (0x07U << 10)) >> 10;
+    uint32_t ppre2 = (RCC_CFGR & (0x07U << 13)) >> 13;
+    PCLK1_frequency = HCLK_frequency / get_prescaler_from_ppre(ppre1);
+    PCLK2_frequency = HCLK_frequency / get_prescaler_from_ppre(ppre2);
+}
+
 static uint32_t get_prescaler_from_ppre(uint32_t ppre) {
     if (!((uint32_t)ppre & (0x01U << 2))) {
         // If bit 2 is not set - prescaler will always be 1
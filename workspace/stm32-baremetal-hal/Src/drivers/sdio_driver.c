@@ -0,0 +1,263 @@
+/*
+ * sdio_driver.c
+ *
+ * implementation file for sdio_driver.h
+ *
+ *  Written by Ryan Wong
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "drivers/sdio_driver.h"
+#include "drivers/rcc_driver.h"
+#include "drivers/gpio_driver.h"
+#include "drivers/dma_driver.h"
+
+#define SDIO_RX_STREAM DMA2_STREAM3
+#define SDIO_TX_STREAM DMA2_STREAM6
+#define SDIO_IDENT_CLOCK 400000U
+#define SDIO_MAX_DATA_LEN 0x2000000U // DLEN is 25 bits
+#define SDIO_CMD_FLAGS (SDIO_STA_CCRCFAIL | SDIO_STA_CTIMEOUT | SDIO_STA_CMDREND | SDIO_STA_CMDSENT)
+
+static uint32_t sdioclk_frequency = 0;
+static uint32_t card_clock = 0;
+static volatile uint8_t data_active = 0;
+static SDIO_Direction data_direction = SDIO_DIR_WRITE;
+
+static void init_pin(GPIO_Reg_TypeDef* port, GPIO_Pin pin, GPIO_Pupd pupd);
+static void wait_ms(uint32_t ms);
+static uint32_t log2_block_size(uint32_t block_size);
+
+// HAL FUNCTIONS ==============================================================
+/**
+ * SDIOEN is bit 11 of APB2ENR, SDIOSEL is bit 28 of DCKCFGR2.
+ * The card needs its supply to settle and at least 74 clocks before the first command,
+ * which the 2ms wait at 400kHz covers
+ */
+HAL_Status SDIO_init(const SDIO_Init_TypeDef* init_struct) {
+    if (
+        init_struct == NULL ||
+        init_struct->clock_source > SDIO_CLOCK_SYSCLK ||
+        init_struct->clock_frequency == 0
+    ) return HAL_ERROR;
+
+    RCC_APB2ENR |= (0x01U << 11);
+    if (init_struct->clock_source == SDIO_CLOCK_SYSCLK) {
+        RCC_DCKCFGR2 |= (0x01U << 28);
+    } else {
+        RCC_DCKCFGR2 &= ~(0x01U << 28);
+    }
+    sdioclk_frequency = init_struct->clock_frequency;
+
+    GPIO_enable_clock(GPIOC);
+    GPIO_enable_clock(GPIOD);
+    init_pin(GPIOC, GPIO_PIN_8, GPIO_PUPD_PU);
+    init_pin(GPIOC, GPIO_PIN_9, GPIO_PUPD_PU);
+    init_pin(GPIOC, GPIO_PIN_10, GPIO_PUPD_PU);
+    init_pin(GPIOC, GPIO_PIN_11, GPIO_PUPD_PU);
+    init_pin(GPIOC, GPIO_PIN_12, GPIO_PUPD_NONE);
+    init_pin(GPIOD, GPIO_PIN_2, GPIO_PUPD_PU);
+
+    DMA_enable_clock(DMA2);
+    SDIO_abort_data();
+
+    SDIO->POWER = 0;
+    SDIO->CLKCR = 0;
+    SDIO->MASK = 0;
+    SDIO->ICR = SDIO_STA_STATIC;
+    if (SDIO_set_clock(SDIO_IDENT_CLOCK) == 0) return HAL_ERROR;
+
+    SDIO->POWER = 0x03U;
+    wait_ms(2U);
+    return HAL_OK;
+}
+
+/**
+ * The SDIO needs PCLK2 >= 3/8 of the card clock to keep up, so that caps the card clock too
+ */
+uint32_t SDIO_set_clock(uint32_t max_hz) {
+    if (max_hz == 0 || sdioclk_frequency == 0) return 0;
+
+    uint32_t pclk_limit = (uint32_t)(((uint64_t)PCLK2_frequency * 8U) / 3U);
+    if (max_hz > pclk_limit) max_hz = pclk_limit;
+
+    uint32_t clkcr = SDIO->CLKCR & (0x03U << 11); // keep WIDBUS
+    clkcr |= (0x01U << 8); // CLKEN
+
+    if (sdioclk_frequency <= max_hz) {
+        clkcr |= (0x01U << 10); // BYPASS
+        card_clock = sdioclk_frequency;
+    } else {
+        uint32_t div = (sdioclk_frequency + max_hz - 1U) / max_hz;
+        div = (div < 2U) ? 0U : div - 2U;
+        if (div > 0xFFU) return 0;
+        clkcr |= div;
+        card_clock = sdioclk_frequency / (div + 2U);
+    }
+    SDIO->CLKCR = clkcr;
+    return card_clock;
+}
+
+HAL_Status SDIO_set_bus_width(SDIO_Bus_Width width) {
+    if (width > SDIO_BUS_4BIT) return HAL_ERROR;
+
+    SDIO->CLKCR = (SDIO->CLKCR & ~(0x03U << 11)) | ((uint32_t)width << 11);
+    return HAL_OK;
+}
+
+/**
+ * WAITRESP is 00 for none, 01 for short and 11 for long. The CPSM always ends with one of
+ * CMDSENT/CMDREND/CTIMEOUT/CCRCFAIL (the response timeout is fixed at 64 card clocks), so the spin is bounded.
+ * Long responses and R3 report 0x3F in RESPCMD instead of the command index, so only R1/R6/R7 are checked
+ */
+HAL_Status SDIO_send_command(uint8_t index, uint32_t arg, SDIO_Response response, uint32_t* resp) {
+    if (
+        index > 63U ||
+        response > SDIO_RESPONSE_LONG
+    ) return HAL_ERROR;
+
+    static const uint8_t waitresp[4] = {0x00U, 0x01U, 0x01U, 0x03U};
+    SDIO->ICR = SDIO_CMD_FLAGS;
+    SDIO->ARG = arg;
+    SDIO->CMD = (uint32_t)index | ((uint32_t)waitresp[response] << 6) | (0x01U << 10);
+
+    uint32_t done = (response == SDIO_RESPONSE_NONE) ? SDIO_STA_CMDSENT : (SDIO_STA_CMDREND | SDIO_STA_CTIMEOUT | SDIO_STA_CCRCFAIL);
+    uint32_t sta;
+    while (!((sta = SDIO->STA) & done));
+    SDIO->ICR = SDIO_CMD_FLAGS;
+
+    if (response == SDIO_RESPONSE_NONE) return HAL_OK;
+    if (sta & SDIO_STA_CTIMEOUT) return HAL_ERROR;
+    if ((sta & SDIO_STA_CCRCFAIL) && response != SDIO_RESPONSE_SHORT_NO_CRC) return HAL_ERROR;
+    if (response == SDIO_RESPONSE_SHORT && (SDIO->RESPCMD & 0x3FU) != index) return HAL_ERROR;
+
+    if (resp != NULL) {
+        resp[0] = SDIO->RESP[0];
+        if (response == SDIO_RESPONSE_LONG) {
+            resp[1] = SDIO->RESP[1];
+            resp[2] = SDIO->RESP[2];
+            resp[3] = SDIO->RESP[3];
+        }
+    }
+    return HAL_OK;
+}
+
+/**
+ * The SDIO is the flow controller, so NDTR doesn't matter and the DMA stops when the data path says the
+ * last word has gone. Bursts of 4 words match the SDIO's own DMA requests. The memory side only bursts
+ * when the buffer is 16 byte aligned, as a burst isn't allowed to cross a 1K boundary
+ */
+HAL_Status SDIO_start_data(SDIO_Direction direction, void* buffer, uint32_t len, uint32_t block_size, uint32_t timeout_ms) {
+    uint32_t size_code = log2_block_size(block_size);
+    if (
+        direction > SDIO_DIR_READ ||
+        buffer == NULL ||
+        ((uint32_t)buffer & 0x03U) ||
+        len == 0 ||
+        len >= SDIO_MAX_DATA_LEN ||
+        size_code > 14U ||
+        len % block_size != 0 ||
+        timeout_ms == 0 ||
+        data_active
+    ) return HAL_ERROR;
+
+    DMA_Stream_TypeDef* stream = (direction == SDIO_DIR_READ) ? SDIO_RX_STREAM : SDIO_TX_STREAM;
+    DMA_Init_TypeDef init;
+    init.channel = DMA_CHANNEL_4;
+    init.direction = (direction == SDIO_DIR_READ) ? DMA_DIR_P2M : DMA_DIR_M2P;
+    init.psize = DMA_SIZE_WORD;
+    init.msize = DMA_SIZE_WORD;
+    init.pinc = 0;
+    init.minc = 1;
+    init.circular = 0;
+    init.priority = DMA_PRIORITY_VERY_HIGH;
+    init.fifo_enable = 1;
+    init.fifo_threshold = DMA_FIFO_FULL;
+    init.pburst = DMA_BURST_INC4;
+    init.mburst = ((uint32_t)buffer & 0x0FU) ? DMA_BURST_SINGLE : DMA_BURST_INC4;
+    init.irq_enable = 0;
+    init.periph_flow = 1;
+    if (DMA_init(stream, &init) != HAL_OK) return HAL_ERROR;
+
+    SDIO->ICR = SDIO_STA_DATA_ERRORS | SDIO_STA_DATAEND | SDIO_STA_DBCKEND;
+    uint64_t timeout = ((uint64_t)card_clock / 1000U) * timeout_ms;
+    SDIO->DTIMER = (timeout > 0xFFFFFFFFU) ? 0xFFFFFFFFU : (uint32_t)timeout;
+    SDIO->DLEN = len;
+
+    if (DMA_start(stream, (uint32_t)&SDIO->FIFO, (uint32_t)buffer, 0xFFFFU) != HAL_OK) return HAL_ERROR;
+    data_direction = direction;
+    data_active = 1;
+
+    // DTEN, DTDIR, block mode, DMAEN, DBLOCKSIZE
+    SDIO->DCTRL = 0x01U | ((uint32_t)direction << 1) | (0x01U << 3) | (size_code << 4);
+    return HAL_OK;
+}
+
+/**
+ * DATAEND only means the data counter hit 0. For a read the DMA may still be emptying the FIFO,
+ * so it's done once the DMA says so too. For a write the data path stays active (TXACT) while the card
+ * holds D0 low after the last block, and a new transfer can't start until the card lets go
+ */
+SDIO_Data_State SDIO_data_poll(void) {
+    if (!data_active) return SDIO_DATA_IDLE;
+
+    DMA_Stream_TypeDef* stream = (data_direction == SDIO_DIR_READ) ? SDIO_RX_STREAM : SDIO_TX_STREAM;
+    uint32_t sta = SDIO->STA;
+    uint32_t dma_flags = DMA_get_flags(stream);
+
+    if ((sta & SDIO_STA_DATA_ERRORS) || (dma_flags & (DMA_FLAG_TE | DMA_FLAG_DME))) {
+        SDIO_abort_data();
+        return SDIO_DATA_ERROR;
+    }
+    if (!(sta & SDIO_STA_DATAEND)) return SDIO_DATA_BUSY;
+    if (data_direction == SDIO_DIR_READ && !(dma_flags & DMA_FLAG_TC)) return SDIO_DATA_BUSY;
+    if (data_direction == SDIO_DIR_WRITE && (sta & SDIO_STA_TXACT)) return SDIO_DATA_BUSY;
+
+    SDIO->ICR = SDIO_STA_DATAEND | SDIO_STA_DBCKEND;
+    DMA_clear_flags(stream, DMA_FLAG_ALL);
+    data_active = 0;
+    return SDIO_DATA_IDLE;
+}
+
+void SDIO_abort_data(void) {
+    SDIO->DCTRL = 0;
+    DMA_stop(SDIO_RX_STREAM);
+    DMA_stop(SDIO_TX_STREAM);
+    DMA_clear_flags(SDIO_RX_STREAM, DMA_FLAG_ALL);
+    DMA_clear_flags(SDIO_TX_STREAM, DMA_FLAG_ALL);
+    SDIO->ICR = SDIO_STA_DATA_ERRORS | SDIO_STA_DATAEND | SDIO_STA_DBCKEND;
+    data_active = 0;
+}
+
+// HELPER FUNCTIONS ==============================================================
+static void init_pin(GPIO_Reg_TypeDef* port, GPIO_Pin pin, GPIO_Pupd pupd) {
+    GPIO_Init_TypeDef init;
+    init.mode = GPIO_MODE_AF;
+    init.otype = GPIO_OTYPE_PP;
+    init.ospeed = GPIO_OSPEED_HIGH;
+    init.pupd = pupd;
+    init.afx = GPIO_AF12;
+    init.init_out_state = PIN_RESET;
+    GPIO_init(port, pin, &init);
+}
+
+/**
+ * Only used once at power up, so a rough delay loop is fine (each iteration takes at least 4 cycles)
+ */
+static void wait_ms(uint32_t ms) {
+    for (volatile uint32_t i = 0; i < (HCLK_frequency / 4000U) * ms; i++);
+}
+
+/**
+ * Returns 0xFF if block_size isn't a power of 2
+ */
+static uint32_t log2_block_size(uint32_t block_size) {
+    if (block_size == 0 || (block_size & (block_size - 1U))) return 0xFFU;
+
+    uint32_t code = 0;
+    while (block_size > 1U) {
+        block_size >>= 1;
+        code++;
+    }
+    return code;
+}
@@ -0,0 +1,505 @@
+/*
+ * timer_driver.c
+ *
+ * implementation file for timer_driver.h
+ *
+ *  Written by Ryan Wong
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "drivers/timer_driver.h"
+#include "drivers/rcc_driver.h"
+
+/**
+ * The timers are scattered over APB1/APB2 with different widths and features,
+ * so instead of address arithmetic (like the GPIO driver) each one is described by a table entry
+ */
+typedef struct {
+    uint32_t base;
+    uint8_t apb; // 1 or 2
+    uint8_t enable_bit; // bit in RCC_APBxENR
+    uint8_t channels; // number of capture/compare channels
+    uint8_t is_32bit; // TIM2 and TIM5 have 32 bit CNT/ARR/CCR
+    uint8_t is_advanced; // TIM1 and TIM8 need MOE set for outputs to work
+    uint8_t has_dma; // has DCR/DMAR, update/capture DMA requests and the encoder interface
+} TIM_Info;
+
+static const TIM_Info tim_info[] = {
+    {0x40010000U, 2, 0, 4, 0, 1, 1}, // TIM1
+    {0x40000000U, 1, 0, 4, 1, 0, 1}, // TIM2
+    {0x40000400U, 1, 1, 4, 0, 0, 1}, // TIM3
+    {0x40000800U, 1, 2, 4, 0, 0, 1}, // TIM4
+    {0x40000C00U, 1, 3, 4, 1, 0, 1}, // TIM5
+    {0x40001000U, 1, 4, 0, 0, 0, 0}, // TIM6
+    {0x40001400U, 1, 5, 0, 0, 0, 0}, // TIM7
+    {0x40010400U, 2, 1, 4, 0, 1, 1}, // TIM8
+    {0x40014000U, 2, 16, 2, 0, 0, 0}, // TIM9
+    {0x40014400U, 2, 17, 1, 0, 0, 0}, // TIM10
+    {0x40014800U, 2, 18, 1, 0, 0, 0}, // TIM11
+    {0x40001800U, 1, 6, 2, 0, 0, 0}, // TIM12
+    {0x40001C00U, 1, 7, 1, 0, 0, 0}, // TIM13
+    {0x40002000U, 1, 8, 1, 0, 0, 0}, // TIM14
+};
+
+static const TIM_Info* get_tim_info(TIM_Reg_TypeDef* tim);
+static volatile uint32_t* get_ccr(TIM_Reg_TypeDef* tim, TIM_Channel channel);
+static uint32_t get_timer_clock(const TIM_Info* info);
+
+// HAL FUNCTIONS ==============================================================
+HAL_Status TIM_enable_clock(TIM_Reg_TypeDef* tim) {
+    const TIM_Info* info = get_tim_info(tim);
+    if (info == NULL) return HAL_ERROR;
+
+    if (info->apb == 1) {
+        RCC_APB1ENR |= 0x01U << info->enable_bit;
+    } else {
+        RCC_APB2ENR |= 0x01U << info->enable_bit;
+    }
+    return HAL_OK;
+}
+
+/**
+ * Picks the smallest prescaler that lets ARR fit in the counter width, which leaves ARR as large
+ * as possible and gives the finest duty cycle resolution.
+ * URS is set so only real overflows raise update interrupts/DMA requests, not the UG we use to load PSC
+ */
+HAL_Status TIM_init(TIM_Reg_TypeDef* tim, const TIM_Init_TypeDef* init_struct) {
+    const TIM_Info* info = get_tim_info(tim);
+    if (
+        info == NULL ||
+        init_struct == NULL ||
+        init_struct->frequency == 0 ||
+        init_struct->count_mode > TIM_COUNT_CENTER
+    ) return HAL_ERROR;
+
+    uint32_t clk = get_timer_clock(info);
+
+    // Center aligned counts up AND down each period, so it needs half the ticks
+    uint32_t ticks = clk / init_struct->frequency;
+    if (init_struct->count_mode == TIM_COUNT_CENTER) {
+        ticks /= 2U;
+    }
+    if (ticks < 2U) return HAL_ERROR;
+
+    uint32_t psc = 0;
+    if (!info->is_32bit) {
+        psc = (ticks - 1U) / 0x10000U;
+        if (psc > 0xFFFFU) return HAL_ERROR;
+    }
+    uint32_t arr = ticks / (psc + 1U) - 1U;
+
+    uint32_t cr1 = (0x01U << 7) | (0x01U << 2); // ARPE, URS
+    if (init_struct->count_mode == TIM_COUNT_DOWN) {
+        cr1 |= (0x01U << 4); // DIR
+    } else if (init_struct->count_mode == TIM_COUNT_CENTER) {
+        cr1 |= (0x03U << 5); // CMS = 11, compare flags set counting both up and down
+    }
+    tim->CR1 = cr1;
+    tim->PSC = psc;
+    tim->ARR = arr;
+    if (info->is_advanced) {
+        tim->RCR = 0;
+    }
+
+    // PSC is always buffered, generate an update so it (and ARR) are loaded before the first period
+    tim->EGR = 0x01U;
+    return HAL_OK;
+}
+
+uint32_t TIM_get_period(TIM_Reg_TypeDef* tim) {
+    if (get_tim_info(tim) == NULL) return 0;
+    return tim->ARR + 1U;
+}
+
+HAL_Status TIM_start(TIM_Reg_TypeDef* tim) {
+    if (get_tim_info(tim) == NULL) return HAL_ERROR;
+
+    tim->CR1 |= 0x01U;
+    return HAL_OK;
+}
+
+HAL_Status TIM_stop(TIM_Reg_TypeDef* tim) {
+    if (get_tim_info(tim) == NULL) return HAL_ERROR;
+
+    tim->CR1 &= ~0x01U;
+    return HAL_OK;
+}
+
+HAL_Status TIM_enable_update_irq(TIM_Reg_TypeDef* tim) {
+    if (get_tim_info(tim) == NULL) return HAL_ERROR;
+
+    tim->DIER |= 0x01U;
+    return HAL_OK;
+}
+
+/**
+ * SR flags are rc_w0 - writing 1 leaves them alone, so write everything but UIF as 1
+ * instead of a read-modify-write (which could clear a flag set in between)
+ */
+HAL_Status TIM_clear_update_flag(TIM_Reg_TypeDef* tim) {
+    if (get_tim_info(tim) == NULL) return HAL_ERROR;
+
+    tim->SR = ~0x01U;
+    return HAL_OK;
+}
+
+/**
+ * Each channel owns one byte of CCMR1 (ch 1/2) or CCMR2 (ch 3/4) and one nibble of CCER
+ */
+HAL_Status TIM_PWM_init(TIM_Reg_TypeDef* tim, TIM_Channel channel, const TIM_PWM_Init_TypeDef* init_struct) {
+    const TIM_Info* info = get_tim_info(tim);
+    if (
+        info == NULL ||
+        init_struct == NULL ||
+        (uint32_t)channel >= info->channels ||
+        (init_struct->mode != TIM_PWM_MODE_1 && init_struct->mode != TIM_PWM_MODE_2) ||
+        init_struct->polarity > TIM_POLARITY_LOW
+    ) return HAL_ERROR;
+
+    volatile uint32_t* ccmr = ((uint32_t)channel < 2U) ? &tim->CCMR1 : &tim->CCMR2;
+    uint32_t ccmr_shift = ((uint32_t)channel & 0x01U) * 8U;
+    uint32_t ccer_shift = (uint32_t)channel * 4U;
+
+    // Disable the output while it's reconfigured
+    tim->CCER &= ~(0x0FU << ccer_shift);
+
+    // CCxS = 00 (output), OCxPE = 1 (preload), OCxM = PWM mode
+    *ccmr &= ~(0xFFU << ccmr_shift);
+    *ccmr |= (((uint32_t)init_struct->mode << 4) | (0x01U << 3)) << ccmr_shift;
+
+    *get_ccr(tim, channel) = init_struct->pulse;
+
+    // CCxE, CCxP
+    tim->CCER |= ((0x01U) | ((uint32_t)init_struct->polarity << 1)) << ccer_shift;
+
+    // Advanced timers gate all outputs with the main output enable
+    if (info->is_advanced) {
+        tim->BDTR |= (0x01U << 15);
+    }
+
+    // Load the preloaded CCR straight away if the timer isn't running yet
+    if (!(tim->CR1 & 0x01U)) {
+        tim->EGR = 0x01U;
+    }
+    return HAL_OK;
+}
+
+/**
+ * Written as (pulse - 1) > ARR so a 32 bit timer with ARR = 0xFFFFFFFF doesn't overflow the check
+ */
+HAL_Status TIM_PWM_set_pulse(TIM_Reg_TypeDef* tim, TIM_Channel channel, uint32_t pulse) {
+    const TIM_Info* info = get_tim_info(tim);
+    if (
+        info == NULL ||
+        (uint32_t)channel >= info->channels ||
+        (pulse != 0 && (pulse - 1U) > tim->ARR)
+    ) return HAL_ERROR;
+
+    *get_ccr(tim, channel) = pulse;
+    return HAL_OK;
+}
+
+/**
+ * DCR.DBA selects the first register and DCR.DBL the number of transfers - 1.
+ * Every update event raises one DMA request and the timer keeps re-requesting until DBL+1 writes
+ * to DMAR have arrived, each landing in the next register. As the CCRs are preloaded, values written
+ * right after update N are applied at update N+1, so the outputs never see a half-written set
+ */
+HAL_Status TIM_DMA_burst_start(TIM_Reg_TypeDef* tim, const TIM_Burst_TypeDef* burst, const uint32_t* buffer, uint16_t periods) {
+    const TIM_Info* info = get_tim_info(tim);
+    if (
+        info == NULL ||
+        !info->has_dma ||
+        burst == NULL ||
+        buffer == NULL ||
+        periods == 0 ||
+        burst->length == 0 ||
+        burst->base > TIM_DMA_BASE_CCR4 ||
+        (uint32_t)burst->base + burst->length > TIM_DMA_BURST_END ||
+        (uint32_t)periods * burst->length > 0xFFFFU
+    ) return HAL_ERROR;
+
+    DMA_Init_TypeDef dma_init;
+    dma_init.channel = burst->channel;
+    dma_init.direction = DMA_DIR_M2P;
+    dma_init.psize = DMA_SIZE_WORD;
+    dma_init.msize = DMA_SIZE_WORD;
+    dma_init.pinc = 0;
+    dma_init.minc = 1;
+    dma_init.circular = 1;
+    dma_init.priority = DMA_PRIORITY_HIGH;
+    dma_init.fifo_enable = 0;
+    dma_init.fifo_threshold = DMA_FIFO_1_4;
+    dma_init.pburst = DMA_BURST_SINGLE;
+    dma_init.mburst = DMA_BURST_SINGLE;
+    dma_init.irq_enable = 0;
+    dma_init.periph_flow = 0;
+    if (DMA_init(burst->stream, &dma_init) != HAL_OK) return HAL_ERROR;
+
+    tim->DIER &= ~(0x01U << 8);
+    tim->DCR = (((uint32_t)burst->length - 1U) << 8) | (uint32_t)burst->base;
+
+    if (DMA_start(burst->stream, (uint32_t)&tim->DMAR, (uint32_t)buffer, (uint16_t)(periods * burst->length)) != HAL_OK) {
+        return HAL_ERROR;
+    }
+
+    // UDE - request a burst on every update event
+    tim->DIER |= (0x01U << 8);
+    return HAL_OK;
+}
+
+HAL_Status TIM_DMA_burst_stop(TIM_Reg_TypeDef* tim, const TIM_Burst_TypeDef* burst) {
+    const TIM_Info* info = get_tim_info(tim);
+    if (
+        info == NULL ||
+        !info->has_dma ||
+        burst == NULL
+    ) return HAL_ERROR;
+
+    tim->DIER &= ~(0x01U << 8);
+    return DMA_stop(burst->stream);
+}
+
+/**
+ * Same register setup as TIM_init(), but ARR is pinned to the counter's maximum
+ * so timestamps can simply be subtracted (modulo the counter width)
+ */
+HAL_Status TIM_init_counter(TIM_Reg_TypeDef* tim, uint32_t tick_frequency) {
+    const TIM_Info* info = get_tim_info(tim);
+    if (
+        info == NULL ||
+        tick_frequency == 0
+    ) return HAL_ERROR;
+
+    uint32_t clk = get_timer_clock(info);
+    if (tick_frequency > clk) return HAL_ERROR;
+
+    uint32_t psc = clk / tick_frequency - 1U;
+    if (psc > 0xFFFFU) return HAL_ERROR;
+
+    tim->CR1 = (0x01U << 7) | (0x01U << 2); // ARPE, URS
+    tim->PSC = psc;
+    tim->ARR = info->is_32bit ? 0xFFFFFFFFU : 0xFFFFU;
+    if (info->is_advanced) {
+        tim->RCR = 0;
+    }
+    tim->EGR = 0x01U;
+    return HAL_OK;
+}
+
+uint32_t TIM_get_tick_frequency(TIM_Reg_TypeDef* tim) {
+    const TIM_Info* info = get_tim_info(tim);
+    if (info == NULL) return 0;
+    return get_timer_clock(info) / (tim->PSC + 1U);
+}
+
+/**
+ * CCxS = 01 maps ICx to its own TIx input. Edge selection is CCxP/CCxNP in CCER:
+ * 00 rising, 01 (CCxP) falling, 11 (both) both edges
+ */
+HAL_Status TIM_IC_init(TIM_Reg_TypeDef* tim, TIM_Channel channel, const TIM_IC_Init_TypeDef* init_struct) {
+    const TIM_Info* info = get_tim_info(tim);
+    if (
+        info == NULL ||
+        init_struct == NULL ||
+        (uint32_t)channel >= info->channels ||
+        init_struct->polarity > TIM_IC_BOTH ||
+        init_struct->prescaler > TIM_IC_DIV_8 ||
+        init_struct->filter > 0x0FU
+    ) return HAL_ERROR;
+
+    volatile uint32_t* ccmr = ((uint32_t)channel < 2U) ? &tim->CCMR1 : &tim->CCMR2;
+    uint32_t ccmr_shift = ((uint32_t)channel & 0x01U) * 8U;
+    uint32_t ccer_shift = (uint32_t)channel * 4U;
+
+    // CCxS can only be written while the channel is off
+    tim->CCER &= ~(0x0FU << ccer_shift);
+
+    *ccmr &= ~(0xFFU << ccmr_shift);
+    *ccmr |= (((uint32_t)init_struct->filter << 4) | ((uint32_t)init_struct->prescaler << 2) | 0x01U) << ccmr_shift;
+
+    uint32_t ccer = 0x01U; // CCxE
+    if (init_struct->polarity == TIM_IC_FALLING) {
+        ccer |= (0x01U << 1);
+    } else if (init_struct->polarity == TIM_IC_BOTH) {
+        ccer |= (0x01U << 1) | (0x01U << 3);
+    }
+    tim->CCER |= ccer << ccer_shift;
+    return HAL_OK;
+}
+
+/**
+ * CCxDE (DIER bit 9 + channel) raises a DMA request on every capture, the DMA then copies CCRx into
+ * the buffer. Transfer size follows the counter width so the buffer is a plain uint16_t/uint32_t array
+ */
+HAL_Status TIM_IC_start_dma(TIM_Reg_TypeDef* tim, TIM_Channel channel, const TIM_Capture_TypeDef* capture) {
+    const TIM_Info* info = get_tim_info(tim);
+    if (
+        info == NULL ||
+        !info->has_dma ||
+        (uint32_t)channel >= info->channels ||
+        capture == NULL ||
+        capture->buffer == NULL ||
+        capture->length == 0
+    ) return HAL_ERROR;
+
+    DMA_Size size = info->is_32bit ? DMA_SIZE_WORD : DMA_SIZE_HALFWORD;
+
+    DMA_Init_TypeDef dma_init;
+    dma_init.channel = capture->channel;
+    dma_init.direction = DMA_DIR_P2M;
+    dma_init.psize = size;
+    dma_init.msize = size;
+    dma_init.pinc = 0;
+    dma_init.minc = 1;
+    dma_init.circular = 1;
+    dma_init.priority = DMA_PRIORITY_HIGH;
+    dma_init.fifo_enable = 0;
+    dma_init.fifo_threshold = DMA_FIFO_1_4;
+    dma_init.pburst = DMA_BURST_SINGLE;
+    dma_init.mburst = DMA_BURST_SINGLE;
+    dma_init.irq_enable = 0;
+    dma_init.periph_flow = 0;
+    if (DMA_init(capture->stream, &dma_init) != HAL_OK) return HAL_ERROR;
+
+    if (DMA_start(capture->stream, (uint32_t)get_ccr(tim, channel), (uint32_t)capture->buffer, capture->length) != HAL_OK) {
+        return HAL_ERROR;
+    }
+    tim->DIER |= (0x01U << (9U + (uint32_t)channel));
+    return HAL_OK;
+}
+
+HAL_Status TIM_IC_stop_dma(TIM_Reg_TypeDef* tim, TIM_Channel channel, const TIM_Capture_TypeDef* capture) {
+    const TIM_Info* info = get_tim_info(tim);
+    if (
+        info == NULL ||
+        !info->has_dma ||
+        (uint32_t)channel >= info->channels ||
+        capture == NULL
+    ) return HAL_ERROR;
+
+    tim->DIER &= ~(0x01U << (9U + (uint32_t)channel));
+    return DMA_stop(capture->stream);
+}
+
+/**
+ * NDTR counts down from length and reloads in circular mode, so the next slot is length - NDTR
+ */
+uint16_t TIM_IC_get_write_index(const TIM_Capture_TypeDef* capture) {
+    if (capture == NULL || capture->length == 0) return 0;
+
+    uint16_t index = (uint16_t)(capture->length - DMA_get_remaining(capture->stream));
+    return (index >= capture->length) ? 0 : index;
+}
+
+/**
+ * Unsigned subtraction in the counter's width handles the counter wrapping between the two captures
+ */
+uint32_t TIM_IC_get_last_period(TIM_Reg_TypeDef* tim, const TIM_Capture_TypeDef* capture) {
+    const TIM_Info* info = get_tim_info(tim);
+    if (
+        info == NULL ||
+        capture == NULL ||
+        capture->buffer == NULL ||
+        capture->length < 2U
+    ) return 0;
+
+    uint16_t index = TIM_IC_get_write_index(capture);
+    uint16_t newest = (index == 0) ? (uint16_t)(capture->length - 1U) : (uint16_t)(index - 1U);
+    uint16_t previous = (newest == 0) ? (uint16_t)(capture->length - 1U) : (uint16_t)(newest - 1U);
+
+    if (info->is_32bit) {
+        const volatile uint32_t* buf = (const volatile uint32_t*)capture->buffer;
+        return buf[newest] - buf[previous];
+    }
+    const volatile uint16_t* buf = (const volatile uint16_t*)capture->buffer;
+    return (uint16_t)(buf[newest] - buf[previous]);
+}
+
+/**
+ * Encoder mode is slave mode 1/2/3 with both channels as direct inputs. The counter then moves up/down
+ * in hardware on every quadrature edge, so nothing runs per edge on the CPU
+ */
+HAL_Status TIM_encoder_init(TIM_Encoder_HandleTypeDef* handle, TIM_Reg_TypeDef* tim, const TIM_Encoder_Init_TypeDef* init_struct) {
+    const TIM_Info* info = get_tim_info(tim);
+    if (
+        handle == NULL ||
+        info == NULL ||
+        !info->has_dma ||
+        init_struct == NULL ||
+        init_struct->mode < TIM_ENCODER_X2_TI1 ||
+        init_struct->mode > TIM_ENCODER_X4 ||
+        init_struct->polarity > TIM_POLARITY_LOW ||
+        init_struct->filter > 0x0FU
+    ) return HAL_ERROR;
+
+    tim->CR1 = 0;
+    tim->CCER = 0;
+    tim->PSC = 0;
+    tim->ARR = info->is_32bit ? 0xFFFFFFFFU : 0xFFFFU;
+
+    // CC1S = 01, CC2S = 01 with the same filter on both inputs
+    uint32_t ic = ((uint32_t)init_struct->filter << 4) | 0x01U;
+    tim->CCMR1 = ic | (ic << 8);
+
+    // CC1E, CC2E, CC1P inverts TI1 which flips the direction
+    tim->CCER = (0x01U) | (0x01U << 4) | ((uint32_t)init_struct->polarity << 1);
+
+    tim->SMCR = (tim->SMCR & ~0x07U) | (uint32_t)init_struct->mode;
+    tim->EGR = 0x01U;
+    tim->CNT = 0;
+
+    handle->tim = tim;
+    handle->last_count = 0;
+    handle->position = 0;
+    handle->is_32bit = info->is_32bit;
+
+    tim->CR1 |= 0x01U;
+    return HAL_OK;
+}
+
+/**
+ * The difference is taken in the counter's own width and then sign extended,
+ * so a wrap from 0xFFFF to 0x0000 reads as +1 rather than -65535
+ */
+int32_t TIM_encoder_update(TIM_Encoder_HandleTypeDef* handle) {
+    if (handle == NULL || handle->tim == NULL) return 0;
+
+    uint32_t count = handle->tim->CNT;
+    int32_t delta;
+    if (handle->is_32bit) {
+        delta = (int32_t)(count - handle->last_count);
+    } else {
+        delta = (int32_t)(int16_t)(uint16_t)(count - handle->last_count);
+    }
+    handle->last_count = count;
+    handle->position += delta;
+    return delta;
+}
+
+int64_t TIM_encoder_get_position(TIM_Encoder_HandleTypeDef* handle) {
+    if (handle == NULL) return 0;
+
+    TIM_encoder_update(handle);
+    return handle->position;
+}
+
+// HELPER FUNCTIONS ==============================================================
+static const TIM_Info* get_tim_info(TIM_Reg_TypeDef* tim) {
+    for (uint32_t i = 0; i < sizeof(tim_info) / sizeof(tim_info[0]); i++) {
+        if (tim_info[i].base == (uint32_t)tim) {
+            return &tim_info[i];
+        }
+    }
+    return NULL;
+}
+
+static uint32_t get_timer_clock(const TIM_Info* info) {
+    return (info->apb == 1) ? RCC_get_APB1_timer_clock() : RCC_get_APB2_timer_clock();
+}
+
+// CCR1-4 are consecutive
+static volatile uint32_t* get_ccr(TIM_Reg_TypeDef* tim, TIM_Channel channel) {
+    return &tim->CCR1 + (uint32_t)channel;
+}
@@ -0,0 +1,555 @@
+/*
+ * usb_driver.c
+ *
+ * implementation file for usb_driver.h
+ * Device mode programming model from RM0390 (OTG_FS), slave mode (no DMA)
+ *
+ *  Written by Ryan Wong
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "drivers/usb_driver.h"
+#include "drivers/rcc_driver.h"
+#include "drivers/gpio_driver.h"
+#include "drivers/nvic_driver.h"
+
+#define USB_GRSTCTL_CSRST (0x01U << 0)
+#define USB_GRSTCTL_RXFFLSH (0x01U << 4)
+#define USB_GRSTCTL_TXFFLSH (0x01U << 5)
+#define USB_GRSTCTL_AHBIDL (0x01U << 31)
+#define USB_TXFNUM_ALL 0x10U
+
+#define USB_GINT_RXFLVL (0x01U << 4)
+#define USB_GINT_USBSUSP (0x01U << 11)
+#define USB_GINT_USBRST (0x01U << 12)
+#define USB_GINT_ENUMDNE (0x01U << 13)
+#define USB_GINT_IEPINT (0x01U << 18)
+#define USB_GINT_OEPINT (0x01U << 19)
+#define USB_GINT_WKUPINT (0x01U << 31)
+
+#define USB_DCTL_SDIS (0x01U << 1)
+#define USB_DCTL_CGINAK (0x01U << 8)
+
+#define USB_EPCTL_USBAEP (0x01U << 15)
+#define USB_EPCTL_STALL (0x01U << 21)
+#define USB_EPCTL_CNAK (0x01U << 26)
+#define USB_EPCTL_SNAK (0x01U << 27)
+#define USB_EPCTL_SD0PID (0x01U << 28)
+#define USB_EPCTL_EPDIS (0x01U << 30)
+#define USB_EPCTL_EPENA (0x01U << 31)
+
+#define USB_EPINT_XFRC (0x01U << 0)
+#define USB_DOEPINT_STUP (0x01U << 3)
+#define USB_DIEPINT_TXFE (0x01U << 7)
+
+#define USB_PKTSTS_OUT_DATA 0x02U
+#define USB_PKTSTS_SETUP_DATA 0x06U
+
+#define USB_MAX_PACKETS 1023U // PKTCNT is 10 bits (1 packet at a time on endpoint 0)
+#define USB_SETUP_COUNT (0x03U << 29) // back to back SETUPs endpoint 0 can take
+#define USB_RESET_TIMEOUT 200000U // GRSTCTL reads
+#define USB_MODE_SWITCH_MS 25U
+
+/**
+ * One transfer per endpoint. IN transfers are programmed into the core in chunks (queued), and copied into the
+ * TX FIFO a packet at a time as space frees up (written)
+ */
+typedef struct {
+    uint8_t* buffer;
+    uint32_t len;
+    uint32_t queued;
+    uint32_t written;
+    uint32_t done; // OUT: bytes received
+    uint32_t last_packet; // OUT: size of the last packet, a short one ends the transfer
+    uint16_t max_packet;
+    uint8_t open;
+    uint8_t busy;
+} Endpoint;
+
+static const USB_Callbacks* callbacks = NULL;
+static uint16_t tx_fifo_words[USB_NUM_ENDPOINTS];
+static Endpoint in_eps[USB_NUM_ENDPOINTS];
+static Endpoint out_eps[USB_NUM_ENDPOINTS];
+static uint32_t setup_packet[2];
+
+static void init_pin(GPIO_Pin pin);
+static HAL_Status wait_grstctl(uint32_t bits, uint32_t value);
+static HAL_Status flush_fifos(uint32_t tx_fifo);
+static uint32_t turnaround_time(uint32_t hclk);
+static void bus_reset(void);
+static void enumeration_done(void);
+static void read_rx_fifo(void);
+static void in_interrupts(void);
+static void out_interrupts(void);
+static void in_start(uint8_t n);
+static void in_fill(uint8_t n);
+static void out_start(uint8_t n);
+static void cancel_ep0(void);
+
+// HAL FUNCTIONS ==============================================================
+/**
+ * OTGFSEN is bit 7 of AHB2ENR. Forcing device mode (FDMOD) takes up to 25ms to apply.
+ * With VBUS sensing off, BVALOEN/BVALOVAL in GOTGCTL tell the core a session is always valid
+ */
+HAL_Status USB_init(const USB_Init_TypeDef* init_struct) {
+    if (
+        init_struct == NULL ||
+        init_struct->callbacks == NULL ||
+        init_struct->irq_priority > NVIC_MAX_PRIORITY ||
+        init_struct->rx_fifo_words < USB_FIFO_MIN_WORDS ||
+        init_struct->tx_fifo_words[0] < USB_FIFO_MIN_WORDS ||
+        HCLK_frequency < USB_MIN_HCLK ||
+        RCC_get_PLL48_clock() != RCC_PLL48_FREQ
+    ) return HAL_ERROR;
+
+    uint32_t total = init_struct->rx_fifo_words;
+    for (uint32_t n = 0; n < USB_NUM_ENDPOINTS; n++) {
+        uint32_t words = init_struct->tx_fifo_words[n];
+        if (words != 0 && words < USB_FIFO_MIN_WORDS) return HAL_ERROR;
+        total += words;
+    }
+    if (total > USB_FIFO_WORDS) return HAL_ERROR;
+
+    NVIC_disable_irq(NVIC_IRQ_OTG_FS);
+    callbacks = init_struct->callbacks;
+    memcpy(tx_fifo_words, init_struct->tx_fifo_words, sizeof(tx_fifo_words));
+
+    RCC_AHB2ENR |= (0x01U << 7);
+    GPIO_enable_clock(GPIOA);
+    init_pin(GPIO_PIN_11); // DM
+    init_pin(GPIO_PIN_12); // DP
+
+    if (wait_grstctl(USB_GRSTCTL_AHBIDL, USB_GRSTCTL_AHBIDL) != HAL_OK) return HAL_ERROR;
+    USB_OTG_FS->GRSTCTL |= USB_GRSTCTL_CSRST;
+    if (wait_grstctl(USB_GRSTCTL_CSRST, 0) != HAL_OK) return HAL_ERROR;
+    if (wait_grstctl(USB_GRSTCTL_AHBIDL, USB_GRSTCTL_AHBIDL) != HAL_OK) return HAL_ERROR;
+
+    USB_OTG_FS->GCCFG = (0x01U << 16); // PWRDWN: transceiver on, VBDEN off
+    uint32_t gusbcfg = USB_OTG_FS->GUSBCFG;
+    gusbcfg &= ~((0x01U << 29) | (0x0FU << 10));
+    gusbcfg |= (0x01U << 30) | (0x01U << 6) | (turnaround_time(HCLK_frequency) << 10);
+    USB_OTG_FS->GUSBCFG = gusbcfg;
+    for (volatile uint32_t i = 0; i < (HCLK_frequency / 4000U) * USB_MODE_SWITCH_MS; i++);
+
+    USB_OTG_FS->GOTGCTL |= (0x01U << 6) | (0x01U << 7);
+    USB_PCGCCTL = 0;
+    USB_DEVICE->DCFG = (USB_DEVICE->DCFG & ~((0x7FU << 4) | 0x03U)) | 0x03U; // full speed, internal PHY
+    USB_DEVICE->DCTL |= USB_DCTL_SDIS;
+
+    // FIFO RAM: RX first, then each IN endpoint's TX FIFO back to back
+    uint32_t address = init_struct->rx_fifo_words;
+    USB_OTG_FS->GRXFSIZ = init_struct->rx_fifo_words;
+    USB_OTG_FS->DIEPTXF0 = ((uint32_t)init_struct->tx_fifo_words[0] << 16) | address;
+    address += init_struct->tx_fifo_words[0];
+    for (uint32_t n = 1; n < USB_NUM_ENDPOINTS; n++) {
+        if (init_struct->tx_fifo_words[n] == 0) continue;
+        USB_OTG_FS->DIEPTXF[n - 1U] = ((uint32_t)init_struct->tx_fifo_words[n] << 16) | address;
+        address += init_struct->tx_fifo_words[n];
+    }
+    if (flush_fifos(USB_TXFNUM_ALL) != HAL_OK) return HAL_ERROR;
+
+    USB_DEVICE->DIEPMSK = 0;
+    USB_DEVICE->DOEPMSK = 0;
+    USB_DEVICE->DAINTMSK = 0;
+    USB_DEVICE->DIEPEMPMSK = 0;
+    for (uint32_t n = 0; n < USB_NUM_ENDPOINTS; n++) {
+        USB_IN_EP(n)->DIEPCTL = (USB_IN_EP(n)->DIEPCTL & USB_EPCTL_EPENA) ? (USB_EPCTL_EPDIS | USB_EPCTL_SNAK) : 0;
+        USB_IN_EP(n)->DIEPTSIZ = 0;
+        USB_IN_EP(n)->DIEPINT = 0xFFU;
+        USB_OUT_EP(n)->DOEPCTL = (USB_OUT_EP(n)->DOEPCTL & USB_EPCTL_EPENA) ? (USB_EPCTL_EPDIS | USB_EPCTL_SNAK) : 0;
+        USB_OUT_EP(n)->DOEPTSIZ = 0;
+        USB_OUT_EP(n)->DOEPINT = 0xFFU;
+    }
+    memset(in_eps, 0, sizeof(in_eps));
+    memset(out_eps, 0, sizeof(out_eps));
+
+    USB_OTG_FS->GINTSTS = 0xFFFFFFFFU;
+    USB_OTG_FS->GINTMSK = USB_GINT_RXFLVL | USB_GINT_USBSUSP | USB_GINT_USBRST | USB_GINT_ENUMDNE |
+                          USB_GINT_IEPINT | USB_GINT_OEPINT | USB_GINT_WKUPINT;
+    USB_OTG_FS->GAHBCFG = 0x01U; // GINTMSK, TXFE when the TX FIFO is half empty
+
+    NVIC_set_priority(NVIC_IRQ_OTG_FS, init_struct->irq_priority);
+    NVIC_enable_irq(NVIC_IRQ_OTG_FS);
+    return HAL_OK;
+}
+
+void USB_connect(void) {
+    USB_DEVICE->DCTL &= ~USB_DCTL_SDIS;
+}
+
+void USB_disconnect(void) {
+    USB_DEVICE->DCTL |= USB_DCTL_SDIS;
+}
+
+void USB_set_address(uint8_t address) {
+    USB_DEVICE->DCFG = (USB_DEVICE->DCFG & ~(0x7FU << 4)) | ((uint32_t)(address & 0x7FU) << 4);
+}
+
+/**
+ * Endpoint 0 is set up by the core on reset/enumeration, opening it just checks the size.
+ * TXFNUM of IN endpoint n is n, each one has its own TX FIFO
+ */
+HAL_Status USB_ep_open(uint8_t ep_addr, USB_EP_Type type, uint16_t max_packet) {
+    uint8_t n = ep_addr & 0x7FU;
+    uint8_t in = ep_addr & 0x80U;
+    if (
+        n >= USB_NUM_ENDPOINTS ||
+        type > USB_EP_INTERRUPT ||
+        max_packet == 0 ||
+        max_packet > ((type == USB_EP_ISOCHRONOUS) ? 1023U : 64U) ||
+        (in && tx_fifo_words[n] == 0)
+    ) return HAL_ERROR;
+
+    if (n == 0) return (type == USB_EP_CONTROL && max_packet == USB_EP0_SIZE) ? HAL_OK : HAL_ERROR;
+
+    uint32_t ctl = (uint32_t)max_packet | USB_EPCTL_USBAEP | ((uint32_t)type << 18) | USB_EPCTL_SD0PID | USB_EPCTL_SNAK;
+    Endpoint* ep = in ? &in_eps[n] : &out_eps[n];
+    memset(ep, 0, sizeof(*ep));
+    ep->max_packet = max_packet;
+    ep->open = 1;
+    if (in) {
+        USB_IN_EP(n)->DIEPCTL = ctl | ((uint32_t)n << 22);
+        USB_DEVICE->DAINTMSK |= (0x01U << n);
+    } else {
+        USB_OUT_EP(n)->DOEPCTL = ctl;
+        USB_DEVICE->DAINTMSK |= (0x01U << (16U + n));
+    }
+    return HAL_OK;
+}
+
+HAL_Status USB_ep_transmit(uint8_t ep_addr, const void* buffer, uint32_t len) {
+    uint8_t n = ep_addr & 0x7FU;
+    if (
+        !(ep_addr & 0x80U) ||
+        n >= USB_NUM_ENDPOINTS ||
+        (buffer == NULL && len != 0)
+    ) return HAL_ERROR;
+
+    Endpoint* ep = &in_eps[n];
+    if (!ep->open || ep->busy) return HAL_ERROR;
+
+    ep->buffer = (uint8_t*)buffer;
+    ep->len = len;
+    ep->queued = 0;
+    ep->written = 0;
+    ep->busy = 1;
+    in_start(n);
+    return HAL_OK;
+}
+
+HAL_Status USB_ep_receive(uint8_t ep_addr, void* buffer, uint32_t len) {
+    uint8_t n = ep_addr & 0x7FU;
+    if (
+        (ep_addr & 0x80U) ||
+        n >= USB_NUM_ENDPOINTS ||
+        (buffer == NULL && len != 0)
+    ) return HAL_ERROR;
+
+    Endpoint* ep = &out_eps[n];
+    if (!ep->open || ep->busy) return HAL_ERROR;
+
+    ep->buffer = buffer;
+    ep->len = len;
+    ep->done = 0;
+    ep->last_packet = 0;
+    ep->busy = 1;
+    out_start(n);
+    return HAL_OK;
+}
+
+HAL_Status USB_ep_abort(uint8_t ep_addr) {
+    uint8_t n = ep_addr & 0x7FU;
+    if (
+        !(ep_addr & 0x80U) ||
+        n >= USB_NUM_ENDPOINTS
+    ) return HAL_ERROR;
+
+    if (USB_IN_EP(n)->DIEPCTL & USB_EPCTL_EPENA) {
+        USB_IN_EP(n)->DIEPCTL |= USB_EPCTL_EPDIS | USB_EPCTL_SNAK;
+    }
+    USB_DEVICE->DIEPEMPMSK &= ~(0x01U << n);
+    in_eps[n].busy = 0;
+    return flush_fifos(n);
+}
+
+/**
+ * Stalling drops whatever the endpoint was doing. Clearing it puts the data toggle back to DATA0
+ * (SD0PID, not on endpoint 0, whose stall the core clears by itself on the next SETUP)
+ */
+HAL_Status USB_ep_stall(uint8_t ep_addr, uint8_t stall) {
+    uint8_t n = ep_addr & 0x7FU;
+    if (n >= USB_NUM_ENDPOINTS) return HAL_ERROR;
+
+    uint32_t clear = (n == 0) ? 0 : USB_EPCTL_SD0PID;
+    if (ep_addr & 0x80U) {
+        if (stall) {
+            uint32_t ctl = USB_IN_EP(n)->DIEPCTL;
+            USB_IN_EP(n)->DIEPCTL = ctl | USB_EPCTL_STALL | ((ctl & USB_EPCTL_EPENA) ? USB_EPCTL_EPDIS : 0);
+            USB_DEVICE->DIEPEMPMSK &= ~(0x01U << n);
+            in_eps[n].busy = 0;
+            flush_fifos(n);
+        } else {
+            USB_IN_EP(n)->DIEPCTL = (USB_IN_EP(n)->DIEPCTL & ~USB_EPCTL_STALL) | clear;
+        }
+    } else {
+        if (stall) {
+            USB_OUT_EP(n)->DOEPCTL |= USB_EPCTL_STALL;
+            out_eps[n].busy = 0;
+        } else {
+            USB_OUT_EP(n)->DOEPCTL = (USB_OUT_EP(n)->DOEPCTL & ~USB_EPCTL_STALL) | clear;
+        }
+    }
+    return HAL_OK;
+}
+
+/**
+ * RX FIFO entries are popped before the endpoint interrupts are looked at, so a transfer's data (or a SETUP)
+ * is always in place by the time its completion is handled
+ */
+void OTG_FS_IRQHandler(void) {
+    uint32_t status = USB_OTG_FS->GINTSTS & USB_OTG_FS->GINTMSK;
+
+    if (status & USB_GINT_USBRST) {
+        USB_OTG_FS->GINTSTS = USB_GINT_USBRST;
+        bus_reset();
+    }
+    if (status & USB_GINT_ENUMDNE) {
+        USB_OTG_FS->GINTSTS = USB_GINT_ENUMDNE;
+        enumeration_done();
+    }
+    if (status & USB_GINT_RXFLVL) {
+        USB_OTG_FS->GINTMSK &= ~USB_GINT_RXFLVL;
+        while (USB_OTG_FS->GINTSTS & USB_GINT_RXFLVL) read_rx_fifo();
+        USB_OTG_FS->GINTMSK |= USB_GINT_RXFLVL;
+    }
+    if (status & USB_GINT_OEPINT) out_interrupts();
+    if (status & USB_GINT_IEPINT) in_interrupts();
+    if (status & (USB_GINT_USBSUSP | USB_GINT_WKUPINT)) {
+        USB_OTG_FS->GINTSTS = status & (USB_GINT_USBSUSP | USB_GINT_WKUPINT);
+    }
+}
+
+// HELPER FUNCTIONS ==============================================================
+static void init_pin(GPIO_Pin pin) {
+    GPIO_Init_TypeDef init;
+    init.mode = GPIO_MODE_AF;
+    init.otype = GPIO_OTYPE_PP;
+    init.ospeed = GPIO_OSPEED_HIGH;
+    init.pupd = GPIO_PUPD_NONE;
+    init.afx = GPIO_AF10;
+    init.init_out_state = PIN_RESET;
+    GPIO_init(GPIOA, pin, &init);
+}
+
+static HAL_Status wait_grstctl(uint32_t bits, uint32_t value) {
+    for (uint32_t i = 0; i < USB_RESET_TIMEOUT; i++) {
+        if ((USB_OTG_FS->GRSTCTL & bits) == value) return HAL_OK;
+    }
+    return HAL_ERROR;
+}
+
+/**
+ * tx_fifo is a TX FIFO number or USB_TXFNUM_ALL. The RX FIFO is only flushed along with all of them
+ */
+static HAL_Status flush_fifos(uint32_t tx_fifo) {
+    USB_OTG_FS->GRSTCTL = (tx_fifo << 6) | USB_GRSTCTL_TXFFLSH;
+    if (wait_grstctl(USB_GRSTCTL_TXFFLSH, 0) != HAL_OK) return HAL_ERROR;
+    if (tx_fifo != USB_TXFNUM_ALL) return HAL_OK;
+
+    USB_OTG_FS->GRSTCTL = USB_GRSTCTL_RXFFLSH;
+    return wait_grstctl(USB_GRSTCTL_RXFFLSH, 0);
+}
+
+/**
+ * USB turnaround time in PHY clocks for a given AHB clock, from the TRDT table in the reference manual
+ */
+static uint32_t turnaround_time(uint32_t hclk) {
+    static const uint32_t min_hclk[] = {
+        32000000U, 27500000U, 24000000U, 21800000U, 20000000U, 18500000U, 17200000U, 16000000U, 15000000U
+    };
+    for (uint32_t i = 0; i < sizeof(min_hclk) / sizeof(min_hclk[0]); i++) {
+        if (hclk >= min_hclk[i]) return 0x06U + i;
+    }
+    return 0x0FU;
+}
+
+/**
+ * Everything goes back to NAK, endpoint 0 is ready for SETUPs again and only its interrupts stay unmasked
+ */
+static void bus_reset(void) {
+    USB_DEVICE->DIEPEMPMSK = 0;
+    for (uint32_t n = 0; n < USB_NUM_ENDPOINTS; n++) {
+        USB_IN_EP(n)->DIEPINT = 0xFFU;
+        USB_OUT_EP(n)->DOEPINT = 0xFFU;
+        if (n == 0) continue;
+        USB_IN_EP(n)->DIEPCTL = (USB_IN_EP(n)->DIEPCTL & USB_EPCTL_EPENA) ? (USB_EPCTL_EPDIS | USB_EPCTL_SNAK) : 0;
+        USB_OUT_EP(n)->DOEPCTL = (USB_OUT_EP(n)->DOEPCTL & USB_EPCTL_EPENA) ? (USB_EPCTL_EPDIS | USB_EPCTL_SNAK) : 0;
+    }
+    USB_OUT_EP(0)->DOEPCTL |= USB_EPCTL_SNAK;
+    flush_fifos(USB_TXFNUM_ALL);
+
+    USB_DEVICE->DAINTMSK = (0x01U << 16) | 0x01U;
+    USB_DEVICE->DOEPMSK = USB_DOEPINT_STUP | USB_EPINT_XFRC;
+    USB_DEVICE->DIEPMSK = USB_EPINT_XFRC;
+    USB_set_address(0);
+    USB_OUT_EP(0)->DOEPTSIZ = USB_SETUP_COUNT | (0x01U << 19) | USB_EP0_SIZE;
+
+    memset(in_eps, 0, sizeof(in_eps));
+    memset(out_eps, 0, sizeof(out_eps));
+    in_eps[0].max_packet = USB_EP0_SIZE;
+    in_eps[0].open = 1;
+    out_eps[0].max_packet = USB_EP0_SIZE;
+    out_eps[0].open = 1;
+    callbacks->reset();
+}
+
+/**
+ * MPSIZ of endpoint 0 is an encoding, 0 = 64 bytes
+ */
+static void enumeration_done(void) {
+    USB_IN_EP(0)->DIEPCTL &= ~0x03U;
+    USB_DEVICE->DCTL |= USB_DCTL_CGINAK;
+    USB_OTG_FS->GUSBCFG = (USB_OTG_FS->GUSBCFG & ~(0x0FU << 10)) | (turnaround_time(HCLK_frequency) << 10);
+}
+
+/**
+ * Pops one RX FIFO entry. Data that doesn't fit the receive buffer is still popped, just dropped
+ */
+static void read_rx_fifo(void) {
+    uint32_t status = USB_OTG_FS->GRXSTSP;
+    uint32_t n = status & 0x0FU;
+    uint32_t count = (status >> 4) & 0x7FFU;
+    uint32_t type = (status >> 17) & 0x0FU;
+    volatile uint32_t* fifo = &USB_FIFO(0);
+
+    if (type == USB_PKTSTS_SETUP_DATA) {
+        setup_packet[0] = *fifo;
+        setup_packet[1] = *fifo;
+    } else if (type == USB_PKTSTS_OUT_DATA && n < USB_NUM_ENDPOINTS) {
+        Endpoint* ep = &out_eps[n];
+        uint32_t room = ep->busy ? ep->len - ep->done : 0;
+        uint8_t* dst = ep->buffer + ep->done;
+        for (uint32_t i = 0; i < count; i += 4U) {
+            uint32_t word = *fifo;
+            uint32_t bytes = (count - i < 4U) ? count - i : 4U;
+            if (i >= room) continue;
+            memcpy(dst + i, &word, (room - i < bytes) ? room - i : bytes);
+        }
+        ep->done += (count < room) ? count : room;
+        ep->last_packet = count;
+    }
+}
+
+static void in_interrupts(void) {
+    uint32_t pending = USB_DEVICE->DAINT & USB_DEVICE->DAINTMSK & 0xFFFFU;
+    for (uint8_t n = 0; pending; n++, pending >>= 1) {
+        if (!(pending & 0x01U)) continue;
+
+        uint32_t enabled = USB_DEVICE->DIEPMSK | (((USB_DEVICE->DIEPEMPMSK >> n) & 0x01U) ? USB_DIEPINT_TXFE : 0);
+        uint32_t flags = USB_IN_EP(n)->DIEPINT & enabled;
+        USB_IN_EP(n)->DIEPINT = flags & ~USB_DIEPINT_TXFE;
+
+        Endpoint* ep = &in_eps[n];
+        if ((flags & USB_EPINT_XFRC) && ep->busy) {
+            if (ep->queued < ep->len) {
+                in_start(n);
+            } else {
+                ep->busy = 0;
+                callbacks->complete(0x80U | n, ep->len);
+            }
+        }
+        if ((flags & USB_DIEPINT_TXFE) && ep->busy) in_fill(n);
+    }
+}
+
+/**
+ * A transfer ends early on a short packet. Endpoint 0 takes one packet at a time, so a longer
+ * transfer there is restarted after every full packet
+ */
+static void out_interrupts(void) {
+    uint32_t pending = (USB_DEVICE->DAINT & USB_DEVICE->DAINTMSK) >> 16;
+    for (uint8_t n = 0; pending; n++, pending >>= 1) {
+        if (!(pending & 0x01U)) continue;
+
+        uint32_t flags = USB_OUT_EP(n)->DOEPINT & USB_DEVICE->DOEPMSK;
+        USB_OUT_EP(n)->DOEPINT = flags;
+
+        Endpoint* ep = &out_eps[n];
+        if ((flags & USB_EPINT_XFRC) && ep->busy) {
+            if (ep->last_packet == ep->max_packet && ep->done < ep->len) {
+                out_start(n);
+            } else {
+                ep->busy = 0;
+                callbacks->complete(n, ep->done);
+            }
+        }
+        if (n == 0 && (flags & USB_DOEPINT_STUP)) {
+            // A SETUP cancels whatever endpoint 0 was still doing
+            cancel_ep0();
+            USB_OUT_EP(0)->DOEPTSIZ = USB_SETUP_COUNT | (0x01U << 19) | USB_EP0_SIZE;
+            callbacks->setup((const uint8_t*)setup_packet);
+        }
+    }
+}
+
+static void in_start(uint8_t n) {
+    Endpoint* ep = &in_eps[n];
+    uint32_t chunk = ep->len - ep->queued;
+    uint32_t max = (n == 0) ? ep->max_packet : USB_MAX_PACKETS * ep->max_packet;
+    if (chunk > max) chunk = max;
+    uint32_t packets = (chunk == 0) ? 1U : (chunk + ep->max_packet - 1U) / ep->max_packet;
+
+    USB_IN_EP(n)->DIEPTSIZ = (packets << 19) | chunk;
+    USB_IN_EP(n)->DIEPCTL |= USB_EPCTL_CNAK | USB_EPCTL_EPENA;
+    ep->queued += chunk;
+    if (chunk > 0) USB_DEVICE->DIEPEMPMSK |= (0x01U << n);
+}
+
+/**
+ * Only whole packets go into the FIFO. Words are read from the buffer with memcpy, so it needn't be aligned
+ */
+static void in_fill(uint8_t n) {
+    Endpoint* ep = &in_eps[n];
+    volatile uint32_t* fifo = &USB_FIFO(n);
+
+    while (ep->written < ep->queued) {
+        uint32_t packet = ep->queued - ep->written;
+        if (packet > ep->max_packet) packet = ep->max_packet;
+        if ((USB_IN_EP(n)->DTXFSTS & 0xFFFFU) < (packet + 3U) / 4U) return;
+
+        const uint8_t* src = ep->buffer + ep->written;
+        uint32_t i = 0;
+        for (; i + 4U <= packet; i += 4U) {
+            uint32_t word;
+            memcpy(&word, src + i, 4U);
+            *fifo = word;
+        }
+        if (i < packet) {
+            uint32_t word = 0;
+            memcpy(&word, src + i, packet - i);
+            *fifo = word;
+        }
+        ep->written += packet;
+    }
+    USB_DEVICE->DIEPEMPMSK &= ~(0x01U << n);
+}
+
+static void out_start(uint8_t n) {
+    Endpoint* ep = &out_eps[n];
+    uint32_t packets = (ep->len - ep->done + ep->max_packet - 1U) / ep->max_packet;
+    if (packets == 0) packets = 1U;
+    if (packets > ((n == 0) ? 1U : USB_MAX_PACKETS)) packets = (n == 0) ? 1U : USB_MAX_PACKETS;
+
+    USB_OUT_EP(n)->DOEPTSIZ = ((n == 0) ? USB_SETUP_COUNT : 0) | (packets << 19) | (packets * ep->max_packet);
+    USB_OUT_EP(n)->DOEPCTL |= USB_EPCTL_CNAK | USB_EPCTL_EPENA;
+}
+
+/**
+ * Drops endpoint 0's transfers, disabling its IN side if a packet was still queued
+ */
+static void cancel_ep0(void) {
+    USB_ep_abort(0x80U);
+    out_eps[0].busy = 0;
+}
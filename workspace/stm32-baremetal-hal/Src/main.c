@@ -1,17 +1,79 @@
 /**
  * Main function containing tests for each bare-metal HAL driver
  *
+ * Build with HAL_AUTOTEST defined (-DHAL_AUTOTEST) for the self-checking test and benchmark firmware that runs
+ * under QEMU and reports over semihosting (see tools/run_emulator_tests.sh). Without it, the self-checking tests
+ * still run first (results in TEST_summary), followed by the on-board driver demos
+ *
  * Written by Ryan Wong
  */
 
 #include <stdint.h>
-#include "drivers/gpio_driver.h"
+#include "test/test_runner.h"
 #include "test/gpio_driver_test.h"
+#include "test/board_test.h"
+#include "test/rcc_driver_test.h"
+#include "test/mem_stats_test.h"
+#ifndef HAL_AUTOTEST
+#include "utils/board.h"
+#include "test/fpu_test.h"
+#include "test/timer_driver_test.h"
+#include "test/input_scanner_test.h"
+#include "test/deferred_log_test.h"
+#include "test/dma_copy_test.h"
+#include "test/crc_driver_test.h"
+#include "test/kv_store_test.h"
+#include "test/sd_card_test.h"
+#include "test/qspi_flash_test.h"
+#include "test/usb_cdc_test.h"
+#endif
+
+static int run_unit_tests(void);
 
+#ifdef HAL_AUTOTEST
 int main(void) {
-    GPIO_test_init();
+    // TEST_end() exits the emulator, this return is never reached
+    return run_unit_tests();
+}
+#else
+int main(void) {
+    BOARD_apply();
+    run_unit_tests();
+    FPU_test_init();
+    FPU_test();
+    TIM_test_init();
+    SCAN_test_init();
+    DLOG_test_init();
+    DMA_copy_test_init();
+    DMA_copy_test();
+    CRC_test_init();
+    CRC_test();
+    KV_test_init();
+    SD_test_init();
+    SD_test();
+    // Takes PC8-PC10 over from the SDIO, so it has to come after the SD test
+    QSPI_test_init();
+    QSPI_test();
+    USB_test_init();
     // MAIN LOOP --------------------------------------------
 	for(;;) {
-        GPIO_test();
+        TIM_test();
+        SCAN_test();
+        DLOG_test();
+        KV_test();
+        USB_test();
     }
+}
+#endif
+
+static int run_unit_tests(void) {
+    TEST_begin();
+    GPIO_run_tests();
+    BOARD_run_tests();
+    RCC_run_tests();
+    GPIO_run_benchmarks();
+    BOARD_run_benchmarks();
+    RCC_run_benchmarks();
+    MEM_run_tests();
+    return TEST_end();
 }
\ No newline at end of file
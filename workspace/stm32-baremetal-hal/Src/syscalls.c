@@ -34,6 +34,8 @@
 /* Variables */
 extern int __io_putchar(int ch) __attribute__((weak));
 extern int __io_getchar(void) __attribute__((weak));
+/* Whole-buffer stdout sink (e.g. USB CDC), ITM is used when nothing defines it */
+extern int __io_write(char *ptr, int len) __attribute__((weak));
 
 
 char *__env[1] = { 0 };
@@ -104,6 +106,11 @@ __attribute__((weak)) int _write(int file, char *ptr, int len)
   (void)file;
   int DataIdx;
 
+  if (__io_write)
+  {
+    return __io_write(ptr, len);
+  }
+
   for (DataIdx = 0; DataIdx < len; DataIdx++)
   {
     //__io_putchar(*ptr++);
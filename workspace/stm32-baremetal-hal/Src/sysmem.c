@@ -23,6 +23,7 @@
 /* Includes */
 #include <errno.h>
 #include <stdint.h>
+#include "utils/mem_stats.h"
 
 /**
  * Pointer to the current high watermark of the heap usage
@@ -68,12 +69,14 @@ void *_sbrk(ptrdiff_t incr)
   /* Protect heap from growing into the reserved MSP stack */
   if (__sbrk_heap_end + incr > max_heap)
   {
+    MEM_record_sbrk_failure(incr);
     errno = ENOMEM;
     return (void *)-1;
   }
 
   prev_heap_end = __sbrk_heap_end;
   __sbrk_heap_end += incr;
+  MEM_record_sbrk(__sbrk_heap_end);
 
   return (void *)prev_heap_end;
 }
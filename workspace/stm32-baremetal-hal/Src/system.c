@@ -1,10 +1,25 @@
 // Contains SystemInit() implementation called in startup_stm32f446retx.s startup file
+// NOTE: this runs BEFORE .data and .bss are initialised, so don't touch globals in here
 #include <stdint.h>
-
-#define FPU_CPACR (*(volatile uint32_t*)0xE000ED88)
+#include "drivers/fpu_driver.h"
+#include "drivers/flash_driver.h"
+#include "drivers/rcc_driver.h"
+#include "utils/mem_stats.h"
 
 void SystemInit(void) {
 	// Enable FPU in the coprocessor access control register (set bits 20-23)
-	FPU_CPACR |= (3UL << 20) | (3UL << 22);
+	FPU_enable();
+
+	// Be explicit about FP context stacking rather than relying on the FPCCR reset value.
+	// Lazy stacking keeps integer-only ISRs at the basic 12 cycle entry even when thread code uses floats
+	FPU_set_stacking(FPU_STACKING_LAZY);
+
+	// Wait states for the reset clock (HSI), plus the prefetch buffer and ART caches which are off out of reset
+	FLASH_set_latency(HSI_FREQ);
+
+	// Fill free RAM with a known pattern so MEM_get_stats() can find the deepest the stack has been.
+	// Has to happen here, before main() (or anything that mallocs) runs. Kept last so the frames of the
+	// calls above are painted over too, none of them may leave anything below the stack pointer
+	MEM_paint_stack();
 }
 
@@ -0,0 +1,66 @@
+/*
+ * board.c
+ *
+ * implementation file for board.h
+ * BOARD_ports is built entirely by the preprocessor, so it ends up as constant data in flash and
+ * BOARD_apply() never looks at the pin map itself
+ *
+ *  Written by Ryan Wong
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "utils/board.h"
+
+_Static_assert(!BOARD_MAP_HAS_DUPLICATES(BOARD_PIN_MAP), "BOARD_PIN_MAP assigns the same pin twice");
+_Static_assert(!BOARD_MAP_IS_INVALID(BOARD_PIN_MAP), "BOARD_PIN_MAP has a pin, AF or initial level out of range");
+
+const BOARD_Port_Config BOARD_ports[BOARD_NUM_PORTS] = {
+    BOARD_PORT_CONFIG(BOARD_PIN_MAP, 0U),
+    BOARD_PORT_CONFIG(BOARD_PIN_MAP, 1U),
+    BOARD_PORT_CONFIG(BOARD_PIN_MAP, 2U),
+    BOARD_PORT_CONFIG(BOARD_PIN_MAP, 3U),
+    BOARD_PORT_CONFIG(BOARD_PIN_MAP, 4U),
+    BOARD_PORT_CONFIG(BOARD_PIN_MAP, 5U),
+    BOARD_PORT_CONFIG(BOARD_PIN_MAP, 6U),
+    BOARD_PORT_CONFIG(BOARD_PIN_MAP, 7U)
+};
+
+// HAL FUNCTIONS ==============================================================
+/**
+ * Same 0x400 port spacing GPIO_enable_clock relies on. The read back makes sure the clocks are running
+ * before the first port write (the RCC needs a couple of cycles after an enable)
+ */
+HAL_Status BOARD_apply(void) {
+    RCC_AHB1ENR |= BOARD_CLOCK_MASK(BOARD_PIN_MAP);
+    (void)RCC_AHB1ENR;
+
+    HAL_Status status = HAL_OK;
+    for (uint32_t i = 0; i < BOARD_NUM_PORTS; i++) {
+        if (BOARD_ports[i].pins == 0) continue;
+        if (BOARD_apply_port((GPIO_Reg_TypeDef*)(GPIO_BASE + i * 0x400U), &BOARD_ports[i]) != HAL_OK) status = HAL_ERROR;
+    }
+    return status;
+}
+
+/**
+ * Registers whose mask is empty are skipped, so a port with no AF pins never touches AFRL/AFRH
+ */
+HAL_Status BOARD_apply_port(GPIO_Reg_TypeDef* port, const BOARD_Port_Config* config) {
+    if (
+        port == NULL ||
+        config == NULL
+    ) return HAL_ERROR;
+
+    if (config->out_pins) {
+        uint16_t reset = config->out_pins & (uint16_t)~config->odr;
+        port->BSRR = (uint32_t)config->odr | ((uint32_t)reset << 16);
+    }
+    port->OTYPER = (port->OTYPER & ~(uint32_t)config->pins) | config->otyper;
+    port->OSPEEDR = (port->OSPEEDR & ~config->mask2) | config->ospeedr;
+    port->PUPDR = (port->PUPDR & ~config->mask2) | config->pupdr;
+    if (config->afrl_mask) port->AFRL = (port->AFRL & ~config->afrl_mask) | config->afrl;
+    if (config->afrh_mask) port->AFRH = (port->AFRH & ~config->afrh_mask) | config->afrh;
+    port->MODER = (port->MODER & ~config->mask2) | config->moder;
+    return HAL_OK;
+}
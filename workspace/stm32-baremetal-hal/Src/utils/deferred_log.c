@@ -0,0 +1,146 @@
+/*
+ * deferred_log.c
+ *
+ * implementation file for deferred_log.h
+ *
+ *  Written by Ryan Wong
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "utils/deferred_log.h"
+#include "drivers/dwt_driver.h"
+#include "drivers/nvic_driver.h"
+
+#define DLOG_INDEX_MASK ((DLOG_BUFFER_SIZE / 4U) - 1U)
+#define DLOG_HEADER(id, nargs) (((uint32_t)DLOG_SYNC << 24) | ((uint32_t)(nargs) << 20) | ((uint32_t)(id) & 0xFFFFFU))
+
+/**
+ * head/tail are free running BYTE counters (they're only masked when indexing), so head - tail is always
+ * the number of unread bytes, even across the 2^32 wrap. head is only ever a multiple of 4,
+ * tail can stop mid-word if the sink only takes part of what it was offered
+ */
+static uint32_t ring[DLOG_BUFFER_SIZE / 4U];
+static volatile uint32_t head = 0;
+static volatile uint32_t tail = 0;
+static uint32_t dropped_total = 0;
+static uint32_t dropped_unreported = 0;
+
+static void write_record(uint32_t id, uint32_t nargs, const uint32_t* args);
+
+// HAL FUNCTIONS ==============================================================
+void DLOG_init(void) {
+    uint32_t primask = NVIC_enter_critical();
+    head = 0;
+    tail = 0;
+    dropped_total = 0;
+    dropped_unreported = 0;
+    NVIC_exit_critical(primask);
+
+    DWT_init();
+}
+
+void DLOG_write0(uint32_t id) {
+    write_record(id, 0, NULL);
+}
+
+void DLOG_write1(uint32_t id, uint32_t a0) {
+    uint32_t args[1] = {a0};
+    write_record(id, 1, args);
+}
+
+void DLOG_write2(uint32_t id, uint32_t a0, uint32_t a1) {
+    uint32_t args[2] = {a0, a1};
+    write_record(id, 2, args);
+}
+
+void DLOG_write3(uint32_t id, uint32_t a0, uint32_t a1, uint32_t a2) {
+    uint32_t args[3] = {a0, a1, a2};
+    write_record(id, 3, args);
+}
+
+void DLOG_write4(uint32_t id, uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3) {
+    uint32_t args[4] = {a0, a1, a2, a3};
+    write_record(id, 4, args);
+}
+
+/**
+ * The ring buffer is a plain uint32_t array, and the Cortex-M4 is little endian, so its bytes are already
+ * in stream order and can be handed to the sink directly. At most two sink calls are needed (before and
+ * after the wrap point)
+ */
+uint32_t DLOG_drain(DLOG_Sink sink, uint32_t max_bytes) {
+    if (sink == NULL) return 0;
+
+    uint32_t drained = 0;
+    for (uint32_t pass = 0; pass < 2U; pass++) {
+        uint32_t t = tail;
+        uint32_t available = head - t;
+        if (available == 0) break;
+
+        uint32_t offset = t & (DLOG_BUFFER_SIZE - 1U);
+        uint32_t chunk = DLOG_BUFFER_SIZE - offset;
+        if (chunk > available) chunk = available;
+        if (max_bytes != 0) {
+            if (drained >= max_bytes) break;
+            if (chunk > max_bytes - drained) chunk = max_bytes - drained;
+        }
+
+        int accepted = sink((const uint8_t*)ring + offset, chunk);
+        if (accepted <= 0) break;
+        if ((uint32_t)accepted > chunk) accepted = (int)chunk;
+
+        tail = t + (uint32_t)accepted;
+        drained += (uint32_t)accepted;
+        if ((uint32_t)accepted < chunk) break;
+    }
+    return drained;
+}
+
+uint32_t DLOG_pending(void) {
+    return head - tail;
+}
+
+uint32_t DLOG_get_dropped(void) {
+    return dropped_total;
+}
+
+// HELPER FUNCTIONS ==============================================================
+/**
+ * The whole record is reserved and written inside one short critical section, so records from
+ * different ISRs can never interleave. When records have been dropped, a DLOG_ID_DROPPED marker
+ * goes in ahead of the next record that fits, so the decoder can show where the gap was
+ */
+static void write_record(uint32_t id, uint32_t nargs, const uint32_t* args) {
+    uint32_t timestamp = DWT_CYCLES();
+    uint32_t words = 2U + nargs;
+
+    uint32_t primask = NVIC_enter_critical();
+    uint32_t h = head;
+    // A partially drained word is still occupied, so measure from the start of tail's word
+    uint32_t free_words = (DLOG_BUFFER_SIZE - (h - (tail & ~0x03U))) / 4U;
+    uint32_t needed = words + (dropped_unreported ? 3U : 0U);
+
+    if (free_words < needed) {
+        dropped_total++;
+        dropped_unreported++;
+        NVIC_exit_critical(primask);
+        return;
+    }
+
+    if (dropped_unreported) {
+        ring[(h >> 2) & DLOG_INDEX_MASK] = DLOG_HEADER(DLOG_ID_DROPPED, 1);
+        ring[((h >> 2) + 1U) & DLOG_INDEX_MASK] = timestamp;
+        ring[((h >> 2) + 2U) & DLOG_INDEX_MASK] = dropped_unreported;
+        h += 12U;
+        dropped_unreported = 0;
+    }
+
+    ring[(h >> 2) & DLOG_INDEX_MASK] = DLOG_HEADER(id, nargs);
+    ring[((h >> 2) + 1U) & DLOG_INDEX_MASK] = timestamp;
+    for (uint32_t i = 0; i < nargs; i++) {
+        ring[((h >> 2) + 2U + i) & DLOG_INDEX_MASK] = args[i];
+    }
+    head = h + words * 4U;
+    NVIC_exit_critical(primask);
+}
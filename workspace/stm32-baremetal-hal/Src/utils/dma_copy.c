@@ -0,0 +1,226 @@
+/*
+ * dma_copy.c
+ *
+ * implementation file for dma_copy.h
+ *
+ *  Written by Ryan Wong
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "utils/dma_copy.h"
+#include "drivers/dma_driver.h"
+#include "drivers/nvic_driver.h"
+
+#define DMA_COPY_STREAM DMA2_STREAM0
+// NDTR is 16 bits, and has to stay a multiple of the burst length when bursting
+#define DMA_COPY_MAX_ITEMS 65532U
+
+/**
+ * One queued request. For a fill, fill_word is the DMA source (fixed address), which is
+ * why it lives in the queue entry rather than on the caller's stack
+ */
+typedef struct {
+    uint32_t dst;
+    uint32_t src;
+    uint32_t remaining; // bytes left, including the chunk currently running
+    uint32_t chunk; // bytes in the chunk currently running
+    uint32_t fill_word;
+    uint8_t is_fill;
+    uint8_t use_words;
+    uint8_t use_burst;
+    DMA_Copy_Handle* handle;
+} DMA_Copy_Request;
+
+static DMA_Copy_Request queue[DMA_COPY_QUEUE_SIZE];
+static volatile uint32_t queue_head = 0; // next free slot
+static volatile uint32_t queue_tail = 0; // request currently running
+static volatile uint32_t queue_count = 0;
+
+static HAL_Status submit(uint32_t dst, uint32_t src, uint32_t len, uint8_t is_fill, uint8_t value, DMA_Copy_Handle* handle);
+static void start_chunk(DMA_Copy_Request* request);
+static void complete(DMA_Copy_Handle* handle, HAL_Status status);
+
+// HAL FUNCTIONS ==============================================================
+HAL_Status DMA_copy_init(void) {
+    if (DMA_enable_clock(DMA2) != HAL_OK) return HAL_ERROR;
+
+    DMA_stop(DMA_COPY_STREAM);
+    queue_head = 0;
+    queue_tail = 0;
+    queue_count = 0;
+
+    NVIC_set_priority(NVIC_IRQ_DMA2_STREAM0, DMA_COPY_IRQ_PRIORITY);
+    NVIC_enable_irq(NVIC_IRQ_DMA2_STREAM0);
+    return HAL_OK;
+}
+
+HAL_Status dma_memcpy(void* dst, const void* src, uint32_t len, DMA_Copy_Handle* handle) {
+    if (
+        dst == NULL ||
+        src == NULL
+    ) return HAL_ERROR;
+
+    if (len < DMA_COPY_THRESHOLD) {
+        memcpy(dst, src, len);
+        complete(handle, HAL_OK);
+        return HAL_OK;
+    }
+    return submit((uint32_t)dst, (uint32_t)src, len, 0, 0, handle);
+}
+
+HAL_Status dma_memset(void* dst, uint8_t value, uint32_t len, DMA_Copy_Handle* handle) {
+    if (
+        dst == NULL
+    ) return HAL_ERROR;
+
+    if (len < DMA_COPY_THRESHOLD) {
+        memset(dst, value, len);
+        complete(handle, HAL_OK);
+        return HAL_OK;
+    }
+    return submit((uint32_t)dst, 0, len, 1, value, handle);
+}
+
+uint8_t DMA_copy_is_done(const DMA_Copy_Handle* handle) {
+    if (handle == NULL) return 1;
+    return handle->done;
+}
+
+HAL_Status DMA_copy_wait(const DMA_Copy_Handle* handle) {
+    if (handle == NULL) return HAL_ERROR;
+
+    while (!handle->done);
+    return handle->status;
+}
+
+uint32_t DMA_copy_pending(void) {
+    return queue_count;
+}
+
+/**
+ * Runs once per chunk. A request bigger than one chunk just moves its addresses on and restarts,
+ * otherwise the request is completed and the next queued one is started straight from here
+ */
+void DMA2_Stream0_IRQHandler(void) {
+    uint32_t flags = DMA_get_flags(DMA_COPY_STREAM);
+    DMA_clear_flags(DMA_COPY_STREAM, DMA_FLAG_ALL);
+
+    if (queue_count == 0) return;
+    DMA_Copy_Request* request = &queue[queue_tail];
+
+    // FE is left out on purpose, it can be set by harmless FIFO underruns at the end of an M2M transfer
+    if (flags & (DMA_FLAG_TE | DMA_FLAG_DME)) {
+        DMA_stop(DMA_COPY_STREAM);
+        request->remaining = 0;
+        complete(request->handle, HAL_ERROR);
+    } else if (flags & DMA_FLAG_TC) {
+        request->remaining -= request->chunk;
+        request->dst += request->chunk;
+        if (!request->is_fill) {
+            request->src += request->chunk;
+        }
+
+        if (request->remaining != 0) {
+            start_chunk(request);
+            return;
+        }
+        complete(request->handle, HAL_OK);
+    } else {
+        return;
+    }
+
+    // Request finished (or failed), move on to the next one
+    queue_tail = (queue_tail + 1U) % DMA_COPY_QUEUE_SIZE;
+    queue_count--;
+    if (queue_count != 0) {
+        start_chunk(&queue[queue_tail]);
+    }
+}
+
+// HELPER FUNCTIONS ==============================================================
+/**
+ * Word transfers need both addresses and the length to be word aligned.
+ * 4 beat bursts additionally need 16 byte alignment so a burst can never cross a 1KB boundary,
+ * and a length that's a multiple of the burst
+ */
+static HAL_Status submit(uint32_t dst, uint32_t src, uint32_t len, uint8_t is_fill, uint8_t value, DMA_Copy_Handle* handle) {
+    uint32_t primask = NVIC_enter_critical();
+    if (queue_count >= DMA_COPY_QUEUE_SIZE) {
+        NVIC_exit_critical(primask);
+        return HAL_ERROR;
+    }
+
+    // Only once the request is sure to be queued, a rejected one leaves the handle as it was
+    if (handle != NULL) {
+        handle->done = 0;
+        handle->status = HAL_OK;
+    }
+
+    DMA_Copy_Request* request = &queue[queue_head];
+    request->dst = dst;
+    request->src = src;
+    request->remaining = len;
+    request->chunk = 0;
+    request->is_fill = is_fill;
+    request->fill_word = (uint32_t)value * 0x01010101U;
+    request->handle = handle;
+
+    uint32_t alignment = dst | len | (is_fill ? 0U : src);
+    request->use_words = (alignment & 0x03U) == 0;
+    request->use_burst = (alignment & 0x0FU) == 0;
+
+    queue_head = (queue_head + 1U) % DMA_COPY_QUEUE_SIZE;
+    queue_count++;
+
+    // Engine was idle, kick it off. Otherwise the ISR picks this up when the current request finishes
+    if (queue_count == 1U) {
+        start_chunk(request);
+    }
+    NVIC_exit_critical(primask);
+    return HAL_OK;
+}
+
+/**
+ * In M2M mode the "peripheral" port is the source (PAR) and the memory port is the destination (M0AR).
+ * A fill keeps the source address fixed on fill_word
+ */
+static void start_chunk(DMA_Copy_Request* request) {
+    uint32_t item_size = request->use_words ? 4U : 1U;
+    uint32_t items = request->remaining / item_size;
+    if (items > DMA_COPY_MAX_ITEMS) {
+        items = DMA_COPY_MAX_ITEMS;
+    }
+    request->chunk = items * item_size;
+
+    DMA_Init_TypeDef init;
+    init.channel = DMA_CHANNEL_0;
+    init.direction = DMA_DIR_M2M;
+    init.psize = request->use_words ? DMA_SIZE_WORD : DMA_SIZE_BYTE;
+    init.msize = init.psize;
+    init.pinc = request->is_fill ? 0 : 1;
+    init.minc = 1;
+    init.circular = 0;
+    init.priority = DMA_PRIORITY_LOW;
+    init.fifo_enable = 1;
+    init.fifo_threshold = DMA_FIFO_FULL;
+    init.pburst = (request->use_burst && !request->is_fill) ? DMA_BURST_INC4 : DMA_BURST_SINGLE;
+    init.mburst = request->use_burst ? DMA_BURST_INC4 : DMA_BURST_SINGLE;
+    init.irq_enable = 1;
+    init.periph_flow = 0;
+    DMA_init(DMA_COPY_STREAM, &init);
+
+    uint32_t src = request->is_fill ? (uint32_t)&request->fill_word : request->src;
+    DMA_start(DMA_COPY_STREAM, src, request->dst, (uint16_t)items);
+}
+
+static void complete(DMA_Copy_Handle* handle, HAL_Status status) {
+    if (handle == NULL) return;
+
+    handle->status = status;
+    handle->done = 1;
+    if (handle->callback != NULL) {
+        handle->callback(handle->context);
+    }
+}
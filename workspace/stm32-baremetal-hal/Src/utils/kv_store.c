@@ -0,0 +1,600 @@
+/*
+ * kv_store.c
+ *
+ * implementation file for kv_store.h
+ *
+ * Sector layout (words):
+ *   0: KV_SECTOR_MAGIC - programmed last when the sector is formatted, so a half formatted sector is never used
+ *   1: erase count
+ *   2: sequence number - programmed when the sector becomes the head, orders the sectors oldest to newest
+ *   3: obsolete marker - programmed to 0 once compaction has copied everything out, just before the erase
+ *   4...: records
+ *
+ * Record layout (words):
+ *   0: header - key (bits 0-15), length in bytes (bits 16-27, 0xFFF for a tombstone), check nibble (bits 28-31)
+ *   1: checksum of the header and value words - programmed LAST, this is what commits the record
+ *   2...: value, padded with 0xFF to a whole word
+ *
+ *  Written by Ryan Wong
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "utils/kv_store.h"
+
+#define KV_SECTOR_MAGIC 0x4B565331U
+#define KV_ERASED 0xFFFFFFFFU
+#define KV_HDR_MAGIC 0U
+#define KV_HDR_ERASE_COUNT 1U
+#define KV_HDR_SEQUENCE 2U
+#define KV_HDR_OBSOLETE 3U
+#define KV_FIRST_RECORD 4U
+
+#define KV_LEN_TOMBSTONE 0xFFFU
+#define KV_TOMBSTONE_WORDS 2U
+#define KV_REC_KEY(header) ((header) & 0xFFFFU)
+#define KV_REC_LEN(header) (((header) >> 16) & 0xFFFU)
+
+#define KV_INDEX_EMPTY KV_KEY_INVALID
+
+typedef enum {
+    KV_SECTOR_DIRTY = 0x00U, // needs an erase and format
+    KV_SECTOR_SPARE = 0x01U,
+    KV_SECTOR_IN_USE = 0x02U
+} KV_Sector_State;
+
+/**
+ * Where the newest record of a key is. len is kept here so the live byte counts can be
+ * updated without reading the old record back from flash
+ */
+typedef struct {
+    uint16_t key;
+    uint16_t word;
+    uint16_t len;
+    uint8_t sector;
+} KV_Index_Entry;
+
+static const KV_Flash_Ops* flash = NULL;
+static uint32_t sector_words = 0;
+
+static KV_Index_Entry index_table[KV_INDEX_SIZE];
+static uint32_t key_count = 0;
+static uint32_t live_words = 0;
+static uint32_t sector_live[KV_MAX_SECTORS]; // live words per sector
+
+static KV_Sector_State sector_state[KV_MAX_SECTORS];
+static uint32_t erase_count[KV_MAX_SECTORS];
+static uint8_t order[KV_MAX_SECTORS]; // in use sectors, oldest first. The last one is the head
+static uint32_t in_use = 0;
+static uint32_t head_offset = 0; // next free word in the head
+static uint32_t next_sequence = 1;
+
+static uint8_t compacting = 0; // order[0] is being copied out
+static uint32_t compact_offset = 0;
+
+static uint32_t record_words(uint32_t len);
+static uint32_t make_header(uint16_t key, uint32_t len);
+static uint8_t header_valid(uint32_t header);
+static uint32_t checksum_add(uint32_t sum, uint32_t word);
+static uint32_t checksum_final(uint32_t sum);
+static uint8_t record_committed(const uint32_t* record);
+static int32_t index_find(uint16_t key);
+static HAL_Status index_put(uint16_t key, uint8_t sector, uint16_t word, uint16_t len);
+static void index_remove(uint16_t key);
+static void index_clear(void);
+static HAL_Status append(uint16_t key, const uint8_t* value, uint32_t len);
+static HAL_Status ensure_space(uint32_t words);
+static HAL_Status open_head(void);
+static HAL_Status compact_step(void);
+static HAL_Status finish_compaction(void);
+static HAL_Status format_sector(uint32_t sector, uint32_t count);
+static void scan_sector(uint32_t sector);
+static uint32_t spare_count(void);
+static uint8_t sector_blank(uint32_t sector);
+
+// HAL FUNCTIONS ==============================================================
+/**
+ * Classifies every sector from its header words, erases whatever was left half done, then replays the
+ * in use sectors oldest to newest into the index, so later records overwrite earlier ones
+ */
+HAL_Status KV_init(const KV_Flash_Ops* ops) {
+    if (
+        ops == NULL ||
+        ops->address == NULL ||
+        ops->erase == NULL ||
+        ops->program == NULL ||
+        ops->num_sectors < 2U ||
+        ops->num_sectors > KV_MAX_SECTORS ||
+        (ops->sector_size & 0x03U) ||
+        ops->sector_size / 4U <= KV_FIRST_RECORD ||
+        ops->sector_size / 4U > 0x10000U
+    ) return HAL_ERROR;
+
+    flash = ops;
+    sector_words = ops->sector_size / 4U;
+    index_clear();
+    in_use = 0;
+    next_sequence = 1;
+    compacting = 0;
+
+    uint32_t max_erases = 0;
+    uint32_t sequence[KV_MAX_SECTORS];
+    for (uint32_t s = 0; s < flash->num_sectors; s++) {
+        const uint32_t* base = flash->address(s);
+        erase_count[s] = 0;
+        sector_state[s] = KV_SECTOR_DIRTY;
+        if (base[KV_HDR_MAGIC] != KV_SECTOR_MAGIC) continue;
+
+        erase_count[s] = base[KV_HDR_ERASE_COUNT];
+        if (erase_count[s] > max_erases) max_erases = erase_count[s];
+
+        if (base[KV_HDR_OBSOLETE] != KV_ERASED) continue;
+        if (base[KV_HDR_SEQUENCE] == KV_ERASED) {
+            // A sector gets its sequence number before its first record, so anything here means it's not really spare
+            if (base[KV_FIRST_RECORD] == KV_ERASED) sector_state[s] = KV_SECTOR_SPARE;
+            continue;
+        }
+
+        // Insertion sort into order[] by sequence number
+        sequence[s] = base[KV_HDR_SEQUENCE];
+        uint32_t i = in_use;
+        while (i > 0 && sequence[order[i - 1U]] > sequence[s]) {
+            order[i] = order[i - 1U];
+            i--;
+        }
+        order[i] = (uint8_t)s;
+        in_use++;
+        sector_state[s] = KV_SECTOR_IN_USE;
+        if (sequence[s] >= next_sequence) next_sequence = sequence[s] + 1U;
+    }
+
+    for (uint32_t s = 0; s < flash->num_sectors; s++) {
+        if (sector_state[s] != KV_SECTOR_DIRTY) continue;
+
+        // If the magic was lost the count went with it, so assume the most worn count seen
+        const uint32_t* base = flash->address(s);
+        uint32_t count = (base[KV_HDR_MAGIC] == KV_SECTOR_MAGIC) ? erase_count[s] : max_erases;
+        if (!sector_blank(s)) {
+            if (flash->erase(s) != HAL_OK) return HAL_ERROR;
+            count++;
+        }
+        if (format_sector(s, count) != HAL_OK) return HAL_ERROR;
+    }
+
+    for (uint32_t i = 0; i < in_use; i++) {
+        scan_sector(order[i]);
+    }
+
+    if (in_use == 0) {
+        return open_head();
+    }
+    if (spare_count() == 0 && in_use > 1U) {
+        compacting = 1;
+        compact_offset = KV_FIRST_RECORD;
+    }
+    return HAL_OK;
+}
+
+/**
+ * The capacity check keeps room for the new record plus a tombstone on top of everything live,
+ * which is what guarantees a compaction can always finish (and a delete can always be written)
+ */
+HAL_Status KV_set(uint16_t key, const void* value, uint32_t len) {
+    if (
+        flash == NULL ||
+        key == KV_KEY_INVALID ||
+        len > KV_MAX_VALUE_SIZE ||
+        (value == NULL && len != 0)
+    ) return HAL_ERROR;
+
+    int32_t slot = index_find(key);
+    if (slot >= 0) {
+        uint32_t current_len;
+        const void* current = KV_get_ptr(key, &current_len);
+        if (current_len == len && (len == 0 || memcmp(current, value, len) == 0)) return HAL_OK;
+    } else if (key_count >= KV_MAX_KEYS) {
+        return HAL_ERROR;
+    }
+
+    uint32_t words = record_words(len);
+    if (live_words + words + KV_TOMBSTONE_WORDS > sector_words - KV_FIRST_RECORD) return HAL_ERROR;
+
+    if (ensure_space(words) != HAL_OK) return HAL_ERROR;
+    return append(key, (const uint8_t*)value, len);
+}
+
+int32_t KV_get(uint16_t key, void* buffer, uint32_t size) {
+    uint32_t len;
+    const void* value = KV_get_ptr(key, &len);
+    if (value == NULL) return -1;
+
+    if (buffer != NULL) {
+        memcpy(buffer, value, (len < size) ? len : size);
+    }
+    return (int32_t)len;
+}
+
+const void* KV_get_ptr(uint16_t key, uint32_t* len) {
+    if (flash == NULL) return NULL;
+
+    int32_t slot = index_find(key);
+    if (slot < 0) return NULL;
+
+    const KV_Index_Entry* entry = &index_table[slot];
+    if (len != NULL) *len = entry->len;
+    return flash->address(entry->sector) + entry->word + 2U;
+}
+
+HAL_Status KV_delete(uint16_t key) {
+    if (
+        flash == NULL ||
+        key == KV_KEY_INVALID
+    ) return HAL_ERROR;
+
+    if (index_find(key) < 0) return HAL_OK;
+    if (ensure_space(KV_TOMBSTONE_WORDS) != HAL_OK) return HAL_ERROR;
+    return append(key, NULL, KV_LEN_TOMBSTONE);
+}
+
+uint8_t KV_service(uint32_t max_records) {
+    while (compacting && max_records--) {
+        if (compact_step() != HAL_OK) break;
+    }
+    return compacting;
+}
+
+HAL_Status KV_format(void) {
+    if (flash == NULL) return HAL_ERROR;
+
+    for (uint32_t s = 0; s < flash->num_sectors; s++) {
+        if (flash->erase(s) != HAL_OK) return HAL_ERROR;
+        if (format_sector(s, erase_count[s] + 1U) != HAL_OK) return HAL_ERROR;
+    }
+    index_clear();
+    in_use = 0;
+    compacting = 0;
+    return open_head();
+}
+
+void KV_get_stats(KV_Stats* stats) {
+    if (stats == NULL || flash == NULL) return;
+
+    stats->keys = key_count;
+    stats->live_bytes = live_words * 4U;
+    stats->capacity_bytes = (sector_words - KV_FIRST_RECORD - KV_TOMBSTONE_WORDS) * 4U;
+    stats->head_free_bytes = (sector_words - head_offset) * 4U;
+    stats->sectors_in_use = in_use;
+    stats->compacting = compacting;
+    stats->min_erase_count = 0xFFFFFFFFU;
+    stats->max_erase_count = 0;
+    for (uint32_t s = 0; s < flash->num_sectors; s++) {
+        if (erase_count[s] < stats->min_erase_count) stats->min_erase_count = erase_count[s];
+        if (erase_count[s] > stats->max_erase_count) stats->max_erase_count = erase_count[s];
+    }
+}
+
+// HELPER FUNCTIONS ==============================================================
+static uint32_t record_words(uint32_t len) {
+    if (len == KV_LEN_TOMBSTONE) return KV_TOMBSTONE_WORDS;
+    return 2U + (len + 3U) / 4U;
+}
+
+/**
+ * The check nibble is 0xA XOR every other nibble, so a header that was only partly programmed
+ * (some bits still 1) is almost always caught before its length is trusted
+ */
+static uint32_t make_header(uint16_t key, uint32_t len) {
+    uint32_t header = ((len & 0xFFFU) << 16) | key;
+    uint32_t check = 0x0AU;
+    for (uint32_t i = 0; i < 7U; i++) {
+        check ^= (header >> (i * 4U)) & 0x0FU;
+    }
+    return header | (check << 28);
+}
+
+static uint8_t header_valid(uint32_t header) {
+    uint32_t len = KV_REC_LEN(header);
+    return KV_REC_KEY(header) != KV_KEY_INVALID &&
+           (len <= KV_MAX_VALUE_SIZE || len == KV_LEN_TOMBSTONE) &&
+           make_header((uint16_t)KV_REC_KEY(header), len) == header;
+}
+
+/**
+ * FNV-1a, but a word at a time (one multiply per word), which is plenty to catch torn writes
+ */
+static uint32_t checksum_add(uint32_t sum, uint32_t word) {
+    return (sum ^ word) * 16777619U;
+}
+
+// 0xFFFFFFFF means "not committed yet", so it can't be a valid checksum
+static uint32_t checksum_final(uint32_t sum) {
+    return (sum == KV_ERASED) ? 0U : sum;
+}
+
+static uint8_t record_committed(const uint32_t* record) {
+    uint32_t header = record[0];
+    uint32_t words = record_words(KV_REC_LEN(header));
+    uint32_t sum = checksum_add(2166136261U, header);
+    for (uint32_t i = 2; i < words; i++) {
+        sum = checksum_add(sum, record[i]);
+    }
+    return record[1] == checksum_final(sum);
+}
+
+/**
+ * Open addressing with linear probing. The table is never more than half full, so probes are short
+ */
+static int32_t index_find(uint16_t key) {
+    uint32_t slot = (((uint32_t)key * 2654435761U) >> 16) & (KV_INDEX_SIZE - 1U);
+    while (index_table[slot].key != KV_INDEX_EMPTY) {
+        if (index_table[slot].key == key) return (int32_t)slot;
+        slot = (slot + 1U) & (KV_INDEX_SIZE - 1U);
+    }
+    return -1;
+}
+
+static HAL_Status index_put(uint16_t key, uint8_t sector, uint16_t word, uint16_t len) {
+    int32_t found = index_find(key);
+    uint32_t slot;
+    if (found >= 0) {
+        slot = (uint32_t)found;
+        uint32_t old_words = record_words(index_table[slot].len);
+        live_words -= old_words;
+        sector_live[index_table[slot].sector] -= old_words;
+    } else {
+        if (key_count >= KV_MAX_KEYS) return HAL_ERROR;
+        slot = (((uint32_t)key * 2654435761U) >> 16) & (KV_INDEX_SIZE - 1U);
+        while (index_table[slot].key != KV_INDEX_EMPTY) {
+            slot = (slot + 1U) & (KV_INDEX_SIZE - 1U);
+        }
+        key_count++;
+    }
+
+    index_table[slot].key = key;
+    index_table[slot].sector = sector;
+    index_table[slot].word = word;
+    index_table[slot].len = len;
+    live_words += record_words(len);
+    sector_live[sector] += record_words(len);
+    return HAL_OK;
+}
+
+/**
+ * Backward shift deletion: entries after the hole that would no longer be reachable
+ * from their home slot are moved into it, so no "deleted" markers are needed
+ */
+static void index_remove(uint16_t key) {
+    int32_t found = index_find(key);
+    if (found < 0) return;
+
+    uint32_t hole = (uint32_t)found;
+    uint32_t old_words = record_words(index_table[hole].len);
+    live_words -= old_words;
+    sector_live[index_table[hole].sector] -= old_words;
+    key_count--;
+
+    uint32_t slot = hole;
+    for (;;) {
+        slot = (slot + 1U) & (KV_INDEX_SIZE - 1U);
+        if (index_table[slot].key == KV_INDEX_EMPTY) break;
+
+        uint32_t home = (((uint32_t)index_table[slot].key * 2654435761U) >> 16) & (KV_INDEX_SIZE - 1U);
+        // Move it if its home isn't cyclically between the hole and its current slot
+        if (((slot - home) & (KV_INDEX_SIZE - 1U)) >= ((slot - hole) & (KV_INDEX_SIZE - 1U))) {
+            index_table[hole] = index_table[slot];
+            hole = slot;
+        }
+    }
+    index_table[hole].key = KV_INDEX_EMPTY;
+}
+
+static void index_clear(void) {
+    for (uint32_t i = 0; i < KV_INDEX_SIZE; i++) {
+        index_table[i].key = KV_INDEX_EMPTY;
+    }
+    for (uint32_t s = 0; s < KV_MAX_SECTORS; s++) {
+        sector_live[s] = 0;
+    }
+    key_count = 0;
+    live_words = 0;
+}
+
+/**
+ * The space is claimed before programming starts, so if anything fails half way
+ * the torn record is simply skipped, exactly like after a power cut.
+ * Words that would be programmed to 0xFFFFFFFF (value padding) are skipped
+ */
+static HAL_Status append(uint16_t key, const uint8_t* value, uint32_t len) {
+    uint32_t sector = order[in_use - 1U];
+    uint32_t start = head_offset;
+    uint32_t words = record_words(len);
+    head_offset += words;
+
+    uint32_t header = make_header(key, len);
+    if (flash->program(sector, start, header) != HAL_OK) {
+        // The header word is all that can be damaged, give the rest back
+        head_offset = start + 1U;
+        return HAL_ERROR;
+    }
+
+    uint32_t sum = checksum_add(2166136261U, header);
+    for (uint32_t i = 2; i < words; i++) {
+        uint32_t word = KV_ERASED;
+        uint32_t offset = (i - 2U) * 4U;
+        memcpy(&word, value + offset, (len - offset < 4U) ? len - offset : 4U);
+        sum = checksum_add(sum, word);
+        if (word != KV_ERASED && flash->program(sector, start + i, word) != HAL_OK) return HAL_ERROR;
+    }
+    if (flash->program(sector, start + 1U, checksum_final(sum)) != HAL_OK) return HAL_ERROR;
+
+    if (len == KV_LEN_TOMBSTONE) {
+        index_remove(key);
+        return HAL_OK;
+    }
+    return index_put(key, (uint8_t)sector, (uint16_t)start, (uint16_t)len);
+}
+
+/**
+ * While a compaction is running, the head always keeps enough room to take the rest of the
+ * sector being compacted. If a write would break that, the compaction is finished first
+ */
+static HAL_Status ensure_space(uint32_t words) {
+    for (uint32_t attempt = 0; attempt < 2U * KV_MAX_SECTORS + 2U; attempt++) {
+        uint32_t reserve = compacting ? sector_live[order[0]] : 0U;
+        if (sector_words - head_offset >= words + reserve) return HAL_OK;
+
+        if (compacting) {
+            if (finish_compaction() != HAL_OK) return HAL_ERROR;
+        } else if (open_head() != HAL_OK) {
+            return HAL_ERROR;
+        }
+    }
+    return HAL_ERROR;
+}
+
+/**
+ * Picks the least worn spare, so erases spread over all the sectors
+ */
+static HAL_Status open_head(void) {
+    uint32_t best = KV_MAX_SECTORS;
+    for (uint32_t s = 0; s < flash->num_sectors; s++) {
+        if (sector_state[s] != KV_SECTOR_SPARE) continue;
+        if (best == KV_MAX_SECTORS || erase_count[s] < erase_count[best]) best = s;
+    }
+    if (best == KV_MAX_SECTORS) return HAL_ERROR;
+
+    if (flash->program(best, KV_HDR_SEQUENCE, next_sequence) != HAL_OK) return HAL_ERROR;
+    next_sequence++;
+    sector_state[best] = KV_SECTOR_IN_USE;
+    order[in_use++] = (uint8_t)best;
+    head_offset = KV_FIRST_RECORD;
+
+    if (spare_count() == 0 && in_use > 1U) {
+        compacting = 1;
+        compact_offset = KV_FIRST_RECORD;
+    }
+    return HAL_OK;
+}
+
+/**
+ * Looks at one record of the oldest sector and copies it to the head if the index still points at it.
+ * When the end of the sector is reached it's marked obsolete, erased and reformatted as a spare
+ */
+static HAL_Status compact_step(void) {
+    uint32_t sector = order[0];
+    const uint32_t* base = flash->address(sector);
+
+    if (compact_offset < sector_words && sector_live[sector] != 0) {
+        uint32_t header = base[compact_offset];
+        uint32_t words = record_words(KV_REC_LEN(header));
+        if (header != KV_ERASED && !header_valid(header)) {
+            // Torn header, see scan_sector()
+            compact_offset++;
+            return HAL_OK;
+        }
+        if (header != KV_ERASED && compact_offset + words <= sector_words) {
+            int32_t slot = index_find((uint16_t)KV_REC_KEY(header));
+            if (
+                slot >= 0 &&
+                index_table[slot].sector == sector &&
+                index_table[slot].word == compact_offset
+            ) {
+                if (sector_words - head_offset < words) return HAL_ERROR;
+                if (append((uint16_t)KV_REC_KEY(header), (const uint8_t*)&base[compact_offset + 2U], KV_REC_LEN(header)) != HAL_OK) {
+                    return HAL_ERROR;
+                }
+            }
+            compact_offset += words;
+            return HAL_OK;
+        }
+    }
+
+    // Nothing live left in here
+    if (flash->program(sector, KV_HDR_OBSOLETE, 0U) != HAL_OK) return HAL_ERROR;
+    if (flash->erase(sector) != HAL_OK) return HAL_ERROR;
+    if (format_sector(sector, erase_count[sector] + 1U) != HAL_OK) return HAL_ERROR;
+
+    in_use--;
+    for (uint32_t i = 0; i < in_use; i++) {
+        order[i] = order[i + 1U];
+    }
+    compacting = 0;
+    if (spare_count() == 0 && in_use > 1U) {
+        compacting = 1;
+        compact_offset = KV_FIRST_RECORD;
+    }
+    return HAL_OK;
+}
+
+static HAL_Status finish_compaction(void) {
+    uint32_t sector = order[0];
+    while (compacting && order[0] == sector) {
+        if (compact_step() != HAL_OK) return HAL_ERROR;
+    }
+    return HAL_OK;
+}
+
+/**
+ * The erase count goes in first and the magic last, so a sector is only ever seen as formatted once it really is
+ */
+static HAL_Status format_sector(uint32_t sector, uint32_t count) {
+    if (flash->program(sector, KV_HDR_ERASE_COUNT, count) != HAL_OK) return HAL_ERROR;
+    if (flash->program(sector, KV_HDR_MAGIC, KV_SECTOR_MAGIC) != HAL_OK) return HAL_ERROR;
+    erase_count[sector] = count;
+    sector_live[sector] = 0;
+    sector_state[sector] = KV_SECTOR_SPARE;
+    return HAL_OK;
+}
+
+/**
+ * Walks the record headers of one sector. A torn record (checksum never programmed) is skipped using its length.
+ * A header that fails its check was torn itself, and as headers are programmed first, nothing after it was
+ * ever written, so only that one word is skipped
+ */
+static void scan_sector(uint32_t sector) {
+    const uint32_t* base = flash->address(sector);
+    uint32_t offset = KV_FIRST_RECORD;
+
+    while (offset < sector_words) {
+        uint32_t header = base[offset];
+        if (header == KV_ERASED) break;
+
+        if (!header_valid(header)) {
+            offset++;
+            continue;
+        }
+
+        uint32_t words = record_words(KV_REC_LEN(header));
+        if (offset + words > sector_words) {
+            offset = sector_words;
+            break;
+        }
+
+        if (record_committed(&base[offset])) {
+            if (KV_REC_LEN(header) == KV_LEN_TOMBSTONE) {
+                index_remove((uint16_t)KV_REC_KEY(header));
+            } else {
+                index_put((uint16_t)KV_REC_KEY(header), (uint8_t)sector, (uint16_t)offset, (uint16_t)KV_REC_LEN(header));
+            }
+        }
+        offset += words;
+    }
+    head_offset = offset;
+}
+
+static uint32_t spare_count(void) {
+    uint32_t count = 0;
+    for (uint32_t s = 0; s < flash->num_sectors; s++) {
+        if (sector_state[s] == KV_SECTOR_SPARE) count++;
+    }
+    return count;
+}
+
+static uint8_t sector_blank(uint32_t sector) {
+    const uint32_t* base = flash->address(sector);
+    for (uint32_t i = 0; i < sector_words; i++) {
+        if (base[i] != KV_ERASED) return 0;
+    }
+    return 1;
+}
@@ -0,0 +1,61 @@
+/*
+ * kv_store_flash.c
+ *
+ * KV store backend for the internal flash. The store gets sectors 2 and 3 (0x08008000 - 0x0800FFFF),
+ * which STM32F446RETX_FLASH.ld keeps free of code with its KV memory region
+ *
+ *  Written by Ryan Wong
+ */
+
+#include <stdint.h>
+#include "utils/kv_store.h"
+#include "drivers/flash_driver.h"
+
+#define KV_FLASH_FIRST_SECTOR 2U
+#define KV_FLASH_NUM_SECTORS 2U
+#define KV_FLASH_SECTOR_SIZE 0x4000U
+
+static const uint32_t* flash_address(uint32_t sector);
+static HAL_Status flash_erase(uint32_t sector);
+static HAL_Status flash_program(uint32_t sector, uint32_t word_offset, uint32_t value);
+
+const KV_Flash_Ops KV_flash_ops = {
+    .num_sectors = KV_FLASH_NUM_SECTORS,
+    .sector_size = KV_FLASH_SECTOR_SIZE,
+    .address = flash_address,
+    .erase = flash_erase,
+    .program = flash_program
+};
+
+// HELPER FUNCTIONS ==============================================================
+static const uint32_t* flash_address(uint32_t sector) {
+    return (const uint32_t*)FLASH_get_sector_address(KV_FLASH_FIRST_SECTOR + sector);
+}
+
+/**
+ * The interface is only unlocked for the duration of each operation,
+ * so a stray write anywhere else in flash can't program anything
+ */
+static HAL_Status flash_erase(uint32_t sector) {
+    if (sector >= KV_FLASH_NUM_SECTORS) return HAL_ERROR;
+    if (FLASH_unlock() != HAL_OK) return HAL_ERROR;
+
+    HAL_Status status = FLASH_erase_sector(KV_FLASH_FIRST_SECTOR + sector);
+    FLASH_lock();
+    return status;
+}
+
+static HAL_Status flash_program(uint32_t sector, uint32_t word_offset, uint32_t value) {
+    if (
+        sector >= KV_FLASH_NUM_SECTORS ||
+        word_offset >= KV_FLASH_SECTOR_SIZE / 4U
+    ) return HAL_ERROR;
+    if (FLASH_unlock() != HAL_OK) return HAL_ERROR;
+
+    HAL_Status status = FLASH_program_word((uint32_t)(flash_address(sector) + word_offset), value);
+    FLASH_lock();
+
+    // Programming can only clear bits, so read it back to catch a word that wasn't erased
+    if (status == HAL_OK && flash_address(sector)[word_offset] != value) return HAL_ERROR;
+    return status;
+}
@@ -0,0 +1,108 @@
+/*
+ * mem_stats.c
+ *
+ * implementation file for mem_stats.h
+ *
+ *  Written by Ryan Wong
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <malloc.h>
+#include "utils/mem_stats.h"
+
+// Linker script symbols, only their addresses mean anything
+extern uint32_t _sdata;
+extern uint32_t _edata;
+extern uint32_t _sbss;
+extern uint32_t _ebss;
+extern uint32_t _end;
+extern uint32_t _estack;
+extern uint32_t _Min_Heap_Size;
+extern uint32_t _Min_Stack_Size;
+
+static const uint8_t* heap_high_water = NULL;
+static uint32_t sbrk_failures = 0;
+static uint32_t largest_failed_request = 0;
+
+static uint32_t read_sp(void);
+static const uint32_t* lowest_stack_word(void);
+
+// HAL FUNCTIONS ==============================================================
+/**
+ * Runs from SystemInit() with the stack pointer just under _estack, so this paints almost all of RAM.
+ * Nothing here can use a global (they'd be overwritten by the .data copy and .bss zeroing straight after)
+ */
+void MEM_paint_stack(void) {
+    uint32_t* word = &_end;
+    uint32_t* stop = (uint32_t*)((read_sp() - MEM_PAINT_MARGIN) & ~0x03U);
+
+    while (word < stop) {
+        *word++ = MEM_PAINT_PATTERN;
+    }
+}
+
+uint32_t MEM_stack_high_water(void) {
+    return (uint32_t)&_estack - (uint32_t)lowest_stack_word();
+}
+
+void MEM_get_stats(MEM_Stats* stats) {
+    if (stats == NULL) return;
+
+    const uint8_t* heap_start = (const uint8_t*)&_end;
+    const uint32_t* lowest = lowest_stack_word();
+    uint32_t heap_end = (heap_high_water != NULL) ? (uint32_t)heap_high_water : (uint32_t)heap_start;
+    struct mallinfo info = mallinfo();
+
+    stats->data_bytes = (uint32_t)&_edata - (uint32_t)&_sdata;
+    stats->bss_bytes = (uint32_t)&_ebss - (uint32_t)&_sbss;
+    stats->heap_reserved = (uint32_t)&_Min_Heap_Size;
+    stats->heap_high_water = heap_end - (uint32_t)heap_start;
+    stats->heap_in_use = (uint32_t)info.uordblks;
+    stats->sbrk_failures = sbrk_failures;
+    stats->largest_failed_request = largest_failed_request;
+    stats->stack_reserved = (uint32_t)&_Min_Stack_Size;
+    stats->stack_high_water = (uint32_t)&_estack - (uint32_t)lowest;
+    stats->stack_current = (uint32_t)&_estack - read_sp();
+    stats->unused_bytes = ((uint32_t)lowest > heap_end) ? (uint32_t)lowest - heap_end : 0U;
+}
+
+/**
+ * The heap only grows in practice (newlib nano never gives memory back), but _sbrk() takes negative
+ * increments too, so only keep the highest end seen
+ */
+void MEM_record_sbrk(const void* heap_end) {
+    if ((const uint8_t*)heap_end > heap_high_water) {
+        heap_high_water = (const uint8_t*)heap_end;
+    }
+}
+
+void MEM_record_sbrk_failure(ptrdiff_t incr) {
+    sbrk_failures++;
+    if (incr > 0 && (uint32_t)incr > largest_failed_request) {
+        largest_failed_request = (uint32_t)incr;
+    }
+}
+
+// HELPER FUNCTIONS ==============================================================
+static uint32_t read_sp(void) {
+    uint32_t sp;
+    __asm volatile ("mov %0, sp" : "=r" (sp));
+    return sp;
+}
+
+/**
+ * Walks up from the top of the heap to the first word that isn't paint. Scanning from below rather than
+ * down from the stack pointer means a hole in a stack frame (a local that was never written) can't be
+ * mistaken for the end of the stack
+ */
+static const uint32_t* lowest_stack_word(void) {
+    const uint32_t* word = (heap_high_water != NULL) ? (const uint32_t*)(((uint32_t)heap_high_water + 3U) & ~0x03U) : &_end;
+    const uint32_t* top = (const uint32_t*)read_sp();
+
+    while (word < top && *word == MEM_PAINT_PATTERN) {
+        word++;
+    }
+    return word;
+}
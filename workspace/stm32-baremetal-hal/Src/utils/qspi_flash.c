@@ -0,0 +1,257 @@
+/*
+ * qspi_flash.c
+ *
+ * implementation file for qspi_flash.h
+ * Command set and timings are from the Winbond W25Q128JV datasheet
+ *
+ *  Written by Ryan Wong
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "utils/qspi_flash.h"
+
+#define FLASH_CMD_WRITE_ENABLE 0x06U
+#define FLASH_CMD_READ_SR1 0x05U
+#define FLASH_CMD_READ_SR2 0x35U
+#define FLASH_CMD_WRITE_SR 0x01U
+#define FLASH_CMD_READ_ID 0x9FU
+#define FLASH_CMD_RESET_ENABLE 0x66U
+#define FLASH_CMD_RESET 0x99U
+#define FLASH_CMD_QUAD_IO_READ 0xEBU
+#define FLASH_CMD_QUAD_PROGRAM 0x32U
+#define FLASH_CMD_SECTOR_ERASE 0x20U
+#define FLASH_CMD_BLOCK_ERASE 0xD8U
+
+#define FLASH_SR1_BUSY 0x01U
+#define FLASH_SR1_WEL 0x02U
+#define FLASH_SR2_QE 0x02U
+
+#define FLASH_CS_HIGH_NS 50U
+#define FLASH_RESET_TIMEOUT_MS 1U
+#define FLASH_SR_TIMEOUT_MS 15U
+#define FLASH_PAGE_TIMEOUT_MS 5U
+#define FLASH_SECTOR_TIMEOUT_MS 400U
+#define FLASH_BLOCK_TIMEOUT_MS 2000U
+
+// 0xEB: address, mode byte and data on 4 lines, 4 dummy clocks. Mode byte 0xFF keeps continuous read mode off,
+// so every access sends the instruction and an abort never leaves the chip waiting for an address
+static const QSPI_Command_TypeDef quad_read = {
+    .instruction = FLASH_CMD_QUAD_IO_READ,
+    .instruction_lines = QSPI_LINES_1,
+    .address_lines = QSPI_LINES_4,
+    .address_size = QSPI_ADDRESS_24BIT,
+    .address = 0,
+    .alt_lines = QSPI_LINES_4,
+    .alt_byte = 0xFFU,
+    .dummy_cycles = 4U,
+    .data_lines = QSPI_LINES_4
+};
+
+static uint32_t flash_id = 0;
+static uint32_t flash_size = 0;
+
+static HAL_Status instruction(uint8_t command);
+static HAL_Status read_register(uint8_t command, uint8_t* value);
+static HAL_Status write_enable(void);
+static HAL_Status wait_ready(uint32_t timeout_ms);
+static uint8_t range_valid(uint32_t address, uint32_t len);
+
+// HAL FUNCTIONS ==============================================================
+/**
+ * The software reset (0x66, 0x99) gets the chip out of whatever mode a previous run left it in.
+ * The capacity byte of the JEDEC ID is log2 of the size in bytes
+ */
+HAL_Status QSPI_flash_init(uint32_t max_clock_hz) {
+    if (
+        max_clock_hz == 0 ||
+        max_clock_hz > QSPI_FLASH_MAX_CLOCK
+    ) return HAL_ERROR;
+
+    flash_id = 0;
+    flash_size = 0;
+    QSPI_Init_TypeDef init = {
+        .clock_frequency = max_clock_hz,
+        .flash_size_log2 = 24U,
+        .cs_high_ns = FLASH_CS_HIGH_NS
+    };
+    if (QSPI_init(&init) != HAL_OK) return HAL_ERROR;
+
+    if (instruction(FLASH_CMD_RESET_ENABLE) != HAL_OK || instruction(FLASH_CMD_RESET) != HAL_OK) return HAL_ERROR;
+    if (wait_ready(FLASH_RESET_TIMEOUT_MS) != HAL_OK) return HAL_ERROR;
+
+    QSPI_Command_TypeDef read_id = {
+        .instruction = FLASH_CMD_READ_ID,
+        .instruction_lines = QSPI_LINES_1,
+        .data_lines = QSPI_LINES_1
+    };
+    uint8_t id[3];
+    if (QSPI_read(&read_id, id, sizeof(id)) != HAL_OK) return HAL_ERROR;
+    flash_id = ((uint32_t)id[0] << 16) | ((uint32_t)id[1] << 8) | id[2];
+    if (flash_id == 0 || flash_id == 0xFFFFFFU || id[2] < 16U || id[2] > 31U) return HAL_ERROR;
+    flash_size = (id[2] >= 24U) ? QSPI_FLASH_MAX_SIZE : (0x01U << id[2]);
+
+    // QE is non volatile, so this only writes the status register the first time a chip is used
+    uint8_t sr1, sr2;
+    if (read_register(FLASH_CMD_READ_SR2, &sr2) != HAL_OK) return HAL_ERROR;
+    if (!(sr2 & FLASH_SR2_QE)) {
+        if (read_register(FLASH_CMD_READ_SR1, &sr1) != HAL_OK) return HAL_ERROR;
+        uint8_t status[2] = {sr1, (uint8_t)(sr2 | FLASH_SR2_QE)};
+        QSPI_Command_TypeDef write_sr = {
+            .instruction = FLASH_CMD_WRITE_SR,
+            .instruction_lines = QSPI_LINES_1,
+            .data_lines = QSPI_LINES_1
+        };
+        if (write_enable() != HAL_OK) return HAL_ERROR;
+        if (QSPI_write(&write_sr, status, sizeof(status)) != HAL_OK) return HAL_ERROR;
+        if (wait_ready(FLASH_SR_TIMEOUT_MS) != HAL_OK) return HAL_ERROR;
+        if (read_register(FLASH_CMD_READ_SR2, &sr2) != HAL_OK || !(sr2 & FLASH_SR2_QE)) return HAL_ERROR;
+    }
+    return QSPI_flash_map();
+}
+
+uint32_t QSPI_flash_id(void) {
+    return flash_id;
+}
+
+uint32_t QSPI_flash_size(void) {
+    return flash_size;
+}
+
+HAL_Status QSPI_flash_read(uint32_t address, void* buffer, uint32_t len) {
+    if (
+        buffer == NULL ||
+        !range_valid(address, len)
+    ) return HAL_ERROR;
+
+    uint8_t was_mapped = QSPI_is_memory_mapped();
+    QSPI_Command_TypeDef command = quad_read;
+    command.address = address;
+    HAL_Status status = QSPI_read(&command, buffer, len);
+    if (was_mapped && QSPI_flash_map() != HAL_OK) status = HAL_ERROR;
+    return status;
+}
+
+/**
+ * A page program wraps around inside its 256 byte page, so each chunk stops at the page boundary
+ */
+HAL_Status QSPI_flash_write(uint32_t address, const void* buffer, uint32_t len) {
+    if (
+        buffer == NULL ||
+        !range_valid(address, len)
+    ) return HAL_ERROR;
+
+    uint8_t was_mapped = QSPI_is_memory_mapped();
+    QSPI_Command_TypeDef command = {
+        .instruction = FLASH_CMD_QUAD_PROGRAM,
+        .instruction_lines = QSPI_LINES_1,
+        .address_lines = QSPI_LINES_1,
+        .address_size = QSPI_ADDRESS_24BIT,
+        .data_lines = QSPI_LINES_4
+    };
+
+    HAL_Status status = HAL_OK;
+    const uint8_t* src = buffer;
+    while (len > 0 && status == HAL_OK) {
+        uint32_t chunk = QSPI_FLASH_PAGE_SIZE - (address % QSPI_FLASH_PAGE_SIZE);
+        if (chunk > len) chunk = len;
+
+        command.address = address;
+        if (
+            write_enable() != HAL_OK ||
+            QSPI_write(&command, src, chunk) != HAL_OK ||
+            wait_ready(FLASH_PAGE_TIMEOUT_MS) != HAL_OK
+        ) status = HAL_ERROR;
+
+        address += chunk;
+        src += chunk;
+        len -= chunk;
+    }
+    if (was_mapped && QSPI_flash_map() != HAL_OK) status = HAL_ERROR;
+    return status;
+}
+
+HAL_Status QSPI_flash_erase(uint32_t address, uint32_t len) {
+    if (
+        address % QSPI_FLASH_SECTOR_SIZE ||
+        len % QSPI_FLASH_SECTOR_SIZE ||
+        !range_valid(address, len)
+    ) return HAL_ERROR;
+
+    uint8_t was_mapped = QSPI_is_memory_mapped();
+    QSPI_Command_TypeDef command = {
+        .instruction_lines = QSPI_LINES_1,
+        .address_lines = QSPI_LINES_1,
+        .address_size = QSPI_ADDRESS_24BIT
+    };
+
+    HAL_Status status = HAL_OK;
+    while (len > 0 && status == HAL_OK) {
+        uint8_t block = (address % QSPI_FLASH_BLOCK_SIZE == 0) && len >= QSPI_FLASH_BLOCK_SIZE;
+        uint32_t size = block ? QSPI_FLASH_BLOCK_SIZE : QSPI_FLASH_SECTOR_SIZE;
+
+        command.instruction = block ? FLASH_CMD_BLOCK_ERASE : FLASH_CMD_SECTOR_ERASE;
+        command.address = address;
+        if (
+            write_enable() != HAL_OK ||
+            QSPI_command(&command) != HAL_OK ||
+            wait_ready(block ? FLASH_BLOCK_TIMEOUT_MS : FLASH_SECTOR_TIMEOUT_MS) != HAL_OK
+        ) status = HAL_ERROR;
+
+        address += size;
+        len -= size;
+    }
+    if (was_mapped && QSPI_flash_map() != HAL_OK) status = HAL_ERROR;
+    return status;
+}
+
+HAL_Status QSPI_flash_map(void) {
+    if (flash_size == 0) return HAL_ERROR;
+
+    return QSPI_memory_mapped(&quad_read);
+}
+
+// HELPER FUNCTIONS ==============================================================
+static HAL_Status instruction(uint8_t command) {
+    QSPI_Command_TypeDef cmd = {
+        .instruction = command,
+        .instruction_lines = QSPI_LINES_1
+    };
+    return QSPI_command(&cmd);
+}
+
+static HAL_Status read_register(uint8_t command, uint8_t* value) {
+    QSPI_Command_TypeDef cmd = {
+        .instruction = command,
+        .instruction_lines = QSPI_LINES_1,
+        .data_lines = QSPI_LINES_1
+    };
+    return QSPI_read(&cmd, value, 1U);
+}
+
+/**
+ * Program, erase and status writes are ignored unless WEL is set, so wait until the chip shows it
+ */
+static HAL_Status write_enable(void) {
+    if (instruction(FLASH_CMD_WRITE_ENABLE) != HAL_OK) return HAL_ERROR;
+
+    QSPI_Command_TypeDef poll = {
+        .instruction = FLASH_CMD_READ_SR1,
+        .instruction_lines = QSPI_LINES_1,
+        .data_lines = QSPI_LINES_1
+    };
+    return QSPI_auto_poll(&poll, FLASH_SR1_WEL, FLASH_SR1_WEL, FLASH_SR_TIMEOUT_MS);
+}
+
+static HAL_Status wait_ready(uint32_t timeout_ms) {
+    QSPI_Command_TypeDef poll = {
+        .instruction = FLASH_CMD_READ_SR1,
+        .instruction_lines = QSPI_LINES_1,
+        .data_lines = QSPI_LINES_1
+    };
+    return QSPI_auto_poll(&poll, 0, FLASH_SR1_BUSY, timeout_ms);
+}
+
+static uint8_t range_valid(uint32_t address, uint32_t len) {
+    return len > 0 && address < flash_size && len <= flash_size - address;
+}
@@ -0,0 +1,413 @@
+/*
+ * sd_card.c
+ *
+ * implementation file for sd_card.h
+ * Command numbers and register layouts are from the SD Physical Layer Simplified Specification
+ *
+ *  Written by Ryan Wong
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "utils/sd_card.h"
+
+#define SD_CMD_GO_IDLE 0U
+#define SD_CMD_ALL_SEND_CID 2U
+#define SD_CMD_SEND_RCA 3U
+#define SD_CMD_SWITCH_FUNC 6U
+#define SD_CMD_SELECT 7U
+#define SD_CMD_SEND_IF_COND 8U
+#define SD_CMD_SEND_CSD 9U
+#define SD_CMD_STOP 12U
+#define SD_CMD_SEND_STATUS 13U
+#define SD_CMD_SET_BLOCKLEN 16U
+#define SD_CMD_READ_SINGLE 17U
+#define SD_CMD_READ_MULTIPLE 18U
+#define SD_CMD_WRITE_SINGLE 24U
+#define SD_CMD_WRITE_MULTIPLE 25U
+#define SD_CMD_APP 55U
+#define SD_ACMD_BUS_WIDTH 6U
+#define SD_ACMD_PRE_ERASE 23U
+#define SD_ACMD_SEND_OP_COND 41U
+#define SD_ACMD_SEND_SCR 51U
+
+#define SD_IF_COND_ARG 0x1AAU // 2.7-3.6V, check pattern 0xAA
+#define SD_OCR_VOLTAGES 0x00FF8000U // 2.7-3.6V
+#define SD_OCR_HCS (0x01U << 30)
+#define SD_OCR_READY (0x01U << 31)
+#define SD_SWITCH_HIGH_SPEED 0x80FFFFF1U // set mode, function group 1 = high speed, leave the rest
+#define SD_R1_ERRORS 0xFDFFE008U
+#define SD_R1_READY_FOR_DATA (0x01U << 8)
+#define SD_STATE_TRAN 4U
+
+typedef struct {
+    const void* buffer;
+    uint32_t blocks;
+} SD_Stream_Entry;
+
+static const SD_Host_Ops* host = NULL;
+static SD_Card_Info card;
+static uint8_t card_ready = 0;
+
+// Oldest buffer at stream_head, it's the one on the bus whenever stream_running is set
+static SD_Stream_Entry stream_queue[SD_STREAM_QUEUE_SIZE];
+static uint32_t stream_head = 0;
+static uint32_t stream_count = 0;
+static uint32_t stream_next_block = 0;
+static uint8_t stream_open = 0;
+static uint8_t stream_running = 0;
+static uint8_t stream_failed = 0;
+
+// SCR and switch status replies, the DMA wants these aligned
+static uint8_t control_buffer[64] __attribute__((aligned(16)));
+
+static HAL_Status command(uint8_t index, uint32_t arg, SD_Response response, uint32_t* resp);
+static HAL_Status app_command(uint8_t index, uint32_t arg, SD_Response response, uint32_t* resp);
+static HAL_Status read_control(uint8_t app, uint8_t index, uint32_t arg, uint32_t len);
+static HAL_Status wait_data(void);
+static HAL_Status wait_ready(void);
+static void stream_service(void);
+static uint32_t card_address(uint32_t block);
+static uint8_t range_valid(uint32_t block, uint32_t count);
+static uint32_t get_bits(const uint32_t* reg, uint32_t msb, uint32_t lsb);
+static uint32_t csd_block_count(const uint32_t* csd);
+
+// HAL FUNCTIONS ==============================================================
+/**
+ * Identification runs at 400kHz on 1 line. CMD8 only gets an answer from v2.0+ cards, and only those
+ * can be high capacity. ACMD41 is repeated until the card finishes powering up
+ */
+HAL_Status SD_init(const SD_Host_Ops* ops) {
+    if (
+        ops == NULL ||
+        ops->send_command == NULL ||
+        ops->set_clock == NULL ||
+        ops->set_bus_width == NULL ||
+        ops->start_data == NULL ||
+        ops->data_poll == NULL ||
+        ops->abort_data == NULL
+    ) return HAL_ERROR;
+
+    host = ops;
+    card_ready = 0;
+    stream_open = 0;
+    memset(&card, 0, sizeof(card));
+
+    if (host->set_bus_width(1U) != HAL_OK) return HAL_ERROR;
+    if (host->set_clock(SD_IDENT_CLOCK) == 0) return HAL_ERROR;
+    host->send_command(SD_CMD_GO_IDLE, 0, SD_RESPONSE_NONE, NULL);
+
+    uint32_t resp[4];
+    uint8_t v2 = 0;
+    if (host->send_command(SD_CMD_SEND_IF_COND, SD_IF_COND_ARG, SD_RESPONSE_R7, resp) == HAL_OK) {
+        if ((resp[0] & 0xFFFU) != SD_IF_COND_ARG) return HAL_ERROR;
+        v2 = 1;
+    }
+
+    uint32_t ocr = 0;
+    for (uint32_t i = 0; i < SD_INIT_RETRIES && !(ocr & SD_OCR_READY); i++) {
+        if (app_command(SD_ACMD_SEND_OP_COND, SD_OCR_VOLTAGES | (v2 ? SD_OCR_HCS : 0U), SD_RESPONSE_R3, &ocr) != HAL_OK) {
+            return HAL_ERROR;
+        }
+    }
+    if (!(ocr & SD_OCR_READY)) return HAL_ERROR;
+    card.high_capacity = (v2 && (ocr & SD_OCR_HCS)) ? 1U : 0U;
+
+    if (command(SD_CMD_ALL_SEND_CID, 0, SD_RESPONSE_R2, card.cid) != HAL_OK) return HAL_ERROR;
+    if (command(SD_CMD_SEND_RCA, 0, SD_RESPONSE_R6, resp) != HAL_OK) return HAL_ERROR;
+    card.rca = (uint16_t)(resp[0] >> 16);
+    if (command(SD_CMD_SEND_CSD, (uint32_t)card.rca << 16, SD_RESPONSE_R2, card.csd) != HAL_OK) return HAL_ERROR;
+    card.block_count = csd_block_count(card.csd);
+    if (card.block_count == 0) return HAL_ERROR;
+
+    if (command(SD_CMD_SELECT, (uint32_t)card.rca << 16, SD_RESPONSE_R1B, resp) != HAL_OK) return HAL_ERROR;
+    if (wait_ready() != HAL_OK) return HAL_ERROR;
+    card.clock_hz = host->set_clock(SD_DEFAULT_SPEED_CLOCK);
+    card.bus_width = 1;
+
+    // SCR byte 0 low nibble is SD_SPEC (CMD6 exists from 1.10 on), byte 1 low nibble the supported bus widths
+    if (read_control(1, SD_ACMD_SEND_SCR, 0, 8U) != HAL_OK) return HAL_ERROR;
+    uint8_t sd_spec = control_buffer[0] & 0x0FU;
+    if (control_buffer[1] & 0x04U) {
+        if (app_command(SD_ACMD_BUS_WIDTH, 0x02U, SD_RESPONSE_R1, resp) != HAL_OK) return HAL_ERROR;
+        if (host->set_bus_width(4U) != HAL_OK) return HAL_ERROR;
+        card.bus_width = 4;
+    }
+
+    // Byte 16 low nibble of the switch status is the function group 1 result, 1 if high speed was selected
+    if (sd_spec >= 1U && read_control(0, SD_CMD_SWITCH_FUNC, SD_SWITCH_HIGH_SPEED, 64U) == HAL_OK) {
+        if ((control_buffer[16] & 0x0FU) == 0x01U) {
+            card.high_speed = 1;
+            card.clock_hz = host->set_clock(SD_HIGH_SPEED_CLOCK);
+        }
+    }
+
+    // SDHC/SDXC blocks are always 512 bytes, SDSC cards have to be told
+    if (!card.high_capacity) {
+        if (command(SD_CMD_SET_BLOCKLEN, SD_BLOCK_SIZE, SD_RESPONSE_R1, resp) != HAL_OK) return HAL_ERROR;
+    }
+    card_ready = 1;
+    return HAL_OK;
+}
+
+HAL_Status SD_get_info(SD_Card_Info* info) {
+    if (info == NULL || !card_ready) return HAL_ERROR;
+
+    *info = card;
+    return HAL_OK;
+}
+
+HAL_Status SD_read_blocks(uint32_t block, void* buffer, uint32_t count) {
+    if (
+        !card_ready ||
+        stream_open ||
+        buffer == NULL ||
+        count == 0 ||
+        count > SD_MAX_TRANSFER_BLOCKS ||
+        !range_valid(block, count)
+    ) return HAL_ERROR;
+
+    if (host->start_data(1U, buffer, count * SD_BLOCK_SIZE, SD_BLOCK_SIZE, SD_READ_TIMEOUT_MS) != HAL_OK) return HAL_ERROR;
+
+    uint32_t resp;
+    uint8_t index = (count == 1U) ? SD_CMD_READ_SINGLE : SD_CMD_READ_MULTIPLE;
+    if (command(index, card_address(block), SD_RESPONSE_R1, &resp) != HAL_OK) {
+        host->abort_data();
+        return HAL_ERROR;
+    }
+
+    HAL_Status status = wait_data();
+    if (count > 1U && command(SD_CMD_STOP, 0, SD_RESPONSE_R1B, &resp) != HAL_OK) status = HAL_ERROR;
+    if (wait_ready() != HAL_OK) status = HAL_ERROR;
+    return status;
+}
+
+/**
+ * Multiple blocks go through the streaming path with a single buffer, which also gets the pre-erase hint
+ */
+HAL_Status SD_write_blocks(uint32_t block, const void* buffer, uint32_t count) {
+    if (
+        !card_ready ||
+        stream_open ||
+        buffer == NULL ||
+        count == 0 ||
+        count > SD_MAX_TRANSFER_BLOCKS ||
+        !range_valid(block, count)
+    ) return HAL_ERROR;
+
+    if (count > 1U) {
+        if (SD_stream_begin(block, count) != HAL_OK) return HAL_ERROR;
+        HAL_Status status = SD_stream_write(buffer, count);
+        if (SD_stream_end() != HAL_OK) status = HAL_ERROR;
+        return status;
+    }
+
+    uint32_t resp;
+    if (command(SD_CMD_WRITE_SINGLE, card_address(block), SD_RESPONSE_R1, &resp) != HAL_OK) return HAL_ERROR;
+    if (host->start_data(0U, (void*)buffer, SD_BLOCK_SIZE, SD_BLOCK_SIZE, SD_WRITE_TIMEOUT_MS) != HAL_OK) return HAL_ERROR;
+
+    HAL_Status status = wait_data();
+    if (wait_ready() != HAL_OK) status = HAL_ERROR;
+    return status;
+}
+
+/**
+ * ACMD23 only lasts for the next CMD25, and is just a hint: the card still takes more or fewer blocks
+ */
+HAL_Status SD_stream_begin(uint32_t block, uint32_t expected_blocks) {
+    if (
+        !card_ready ||
+        stream_open ||
+        !range_valid(block, 1U)
+    ) return HAL_ERROR;
+
+    uint32_t resp;
+    if (expected_blocks > 0) {
+        if (expected_blocks > 0x7FFFFFU) expected_blocks = 0x7FFFFFU;
+        if (app_command(SD_ACMD_PRE_ERASE, expected_blocks, SD_RESPONSE_R1, &resp) != HAL_OK) return HAL_ERROR;
+    }
+    if (command(SD_CMD_WRITE_MULTIPLE, card_address(block), SD_RESPONSE_R1, &resp) != HAL_OK) return HAL_ERROR;
+
+    stream_head = 0;
+    stream_count = 0;
+    stream_next_block = block;
+    stream_running = 0;
+    stream_failed = 0;
+    stream_open = 1;
+    return HAL_OK;
+}
+
+HAL_Status SD_stream_write(const void* buffer, uint32_t blocks) {
+    if (
+        !stream_open ||
+        stream_failed ||
+        buffer == NULL ||
+        blocks == 0 ||
+        blocks > SD_MAX_TRANSFER_BLOCKS ||
+        !range_valid(stream_next_block, blocks)
+    ) return HAL_ERROR;
+
+    while (stream_count == SD_STREAM_QUEUE_SIZE) {
+        stream_service();
+        if (stream_failed) return HAL_ERROR;
+    }
+
+    SD_Stream_Entry* entry = &stream_queue[(stream_head + stream_count) % SD_STREAM_QUEUE_SIZE];
+    entry->buffer = buffer;
+    entry->blocks = blocks;
+    stream_count++;
+    stream_next_block += blocks;
+
+    stream_service();
+    return stream_failed ? HAL_ERROR : HAL_OK;
+}
+
+uint32_t SD_stream_pending(void) {
+    if (!stream_open) return 0;
+
+    stream_service();
+    return stream_count;
+}
+
+/**
+ * CMD12 is sent even after a failure, it's what gets the card out of the receive state
+ */
+HAL_Status SD_stream_end(void) {
+    if (!stream_open) return HAL_ERROR;
+
+    while (stream_count > 0 && !stream_failed) {
+        stream_service();
+    }
+    if (stream_failed) host->abort_data();
+    stream_open = 0;
+
+    uint32_t resp;
+    HAL_Status status = stream_failed ? HAL_ERROR : HAL_OK;
+    if (command(SD_CMD_STOP, 0, SD_RESPONSE_R1B, &resp) != HAL_OK) status = HAL_ERROR;
+    if (wait_ready() != HAL_OK) status = HAL_ERROR;
+    return status;
+}
+
+// HELPER FUNCTIONS ==============================================================
+/**
+ * R1 carries the card's error bits, so a command the card accepted but didn't like fails here too
+ */
+static HAL_Status command(uint8_t index, uint32_t arg, SD_Response response, uint32_t* resp) {
+    if (host->send_command(index, arg, response, resp) != HAL_OK) return HAL_ERROR;
+
+    if ((response == SD_RESPONSE_R1 || response == SD_RESPONSE_R1B) && index != SD_CMD_STOP && (resp[0] & SD_R1_ERRORS)) {
+        return HAL_ERROR;
+    }
+    return HAL_OK;
+}
+
+static HAL_Status app_command(uint8_t index, uint32_t arg, SD_Response response, uint32_t* resp) {
+    uint32_t status;
+    if (command(SD_CMD_APP, (uint32_t)card.rca << 16, SD_RESPONSE_R1, &status) != HAL_OK) return HAL_ERROR;
+    return command(index, arg, response, resp);
+}
+
+/**
+ * Short reads that come back on the data lines (SCR, switch status), len is also the block size
+ */
+static HAL_Status read_control(uint8_t app, uint8_t index, uint32_t arg, uint32_t len) {
+    if (host->start_data(1U, control_buffer, len, len, SD_READ_TIMEOUT_MS) != HAL_OK) return HAL_ERROR;
+
+    uint32_t resp;
+    HAL_Status status = app ? app_command(index, arg, SD_RESPONSE_R1, &resp) : command(index, arg, SD_RESPONSE_R1, &resp);
+    if (status != HAL_OK) {
+        host->abort_data();
+        return HAL_ERROR;
+    }
+    return wait_data();
+}
+
+/**
+ * Can't spin forever, the host's data timeout turns a card that never answers into SD_DATA_ERROR
+ */
+static HAL_Status wait_data(void) {
+    SD_Data_State state;
+    while ((state = host->data_poll()) == SD_DATA_BUSY);
+    return (state == SD_DATA_IDLE) ? HAL_OK : HAL_ERROR;
+}
+
+/**
+ * The card is done programming (and back to listening) once it reports the transfer state
+ * with READY_FOR_DATA set
+ */
+static HAL_Status wait_ready(void) {
+    uint32_t status;
+    for (uint32_t i = 0; i < SD_BUSY_RETRIES; i++) {
+        if (command(SD_CMD_SEND_STATUS, (uint32_t)card.rca << 16, SD_RESPONSE_R1, &status) != HAL_OK) return HAL_ERROR;
+        if (((status >> 9) & 0x0FU) == SD_STATE_TRAN && (status & SD_R1_READY_FOR_DATA)) return HAL_OK;
+    }
+    return HAL_ERROR;
+}
+
+/**
+ * Retires the buffer on the bus if it's finished and starts the next one straight away.
+ * After a failure nothing else is started and the rest of the queue is dropped
+ */
+static void stream_service(void) {
+    while (stream_count > 0 && !stream_failed) {
+        if (stream_running) {
+            SD_Data_State state = host->data_poll();
+            if (state == SD_DATA_BUSY) return;
+
+            stream_running = 0;
+            if (state == SD_DATA_ERROR) {
+                stream_failed = 1;
+                stream_count = 0;
+                return;
+            }
+            stream_head = (stream_head + 1U) % SD_STREAM_QUEUE_SIZE;
+            stream_count--;
+            continue;
+        }
+
+        SD_Stream_Entry* entry = &stream_queue[stream_head];
+        if (host->start_data(0U, (void*)entry->buffer, entry->blocks * SD_BLOCK_SIZE, SD_BLOCK_SIZE, SD_WRITE_TIMEOUT_MS) != HAL_OK) {
+            stream_failed = 1;
+            stream_count = 0;
+            return;
+        }
+        stream_running = 1;
+        return;
+    }
+}
+
+static uint32_t card_address(uint32_t block) {
+    return card.high_capacity ? block : block * SD_BLOCK_SIZE;
+}
+
+static uint8_t range_valid(uint32_t block, uint32_t count) {
+    return block < card.block_count && count <= card.block_count - block;
+}
+
+/**
+ * Pulls bits msb:lsb out of a 128 bit card register stored bits 127:96 first
+ */
+static uint32_t get_bits(const uint32_t* reg, uint32_t msb, uint32_t lsb) {
+    uint32_t value = 0;
+    for (uint32_t bit = msb + 1U; bit-- > lsb;) {
+        value = (value << 1) | ((reg[3U - bit / 32U] >> (bit % 32U)) & 0x01U);
+    }
+    return value;
+}
+
+/**
+ * CSD v2.0 (SDHC/SDXC): (C_SIZE + 1) * 512K. CSD v1.0: (C_SIZE + 1) * 2^(C_SIZE_MULT + 2) blocks of 2^READ_BL_LEN
+ */
+static uint32_t csd_block_count(const uint32_t* csd) {
+    uint32_t structure = get_bits(csd, 127U, 126U);
+    if (structure == 1U) {
+        return (get_bits(csd, 69U, 48U) + 1U) * 1024U;
+    }
+    if (structure == 0U) {
+        uint32_t read_bl_len = get_bits(csd, 83U, 80U);
+        if (read_bl_len < 9U || read_bl_len > 11U) return 0;
+        return ((get_bits(csd, 73U, 62U) + 1U) << (get_bits(csd, 49U, 47U) + 2U)) << (read_bl_len - 9U);
+    }
+    return 0;
+}
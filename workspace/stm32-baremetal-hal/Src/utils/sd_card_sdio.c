@@ -0,0 +1,72 @@
+/*
+ * sd_card_sdio.c
+ *
+ * SD card backend for the SDIO peripheral (drivers/sdio_driver.h). Just maps the card layer's
+ * response formats and data states onto the driver's
+ *
+ *  Written by Ryan Wong
+ */
+
+#include <stdint.h>
+#include "utils/sd_card.h"
+#include "drivers/sdio_driver.h"
+
+static HAL_Status sdio_send_command(uint8_t index, uint32_t arg, SD_Response response, uint32_t* resp);
+static uint32_t sdio_set_clock(uint32_t max_hz);
+static HAL_Status sdio_set_bus_width(uint8_t width);
+static HAL_Status sdio_start_data(uint8_t read, void* buffer, uint32_t len, uint32_t block_size, uint32_t timeout_ms);
+static SD_Data_State sdio_data_poll(void);
+static void sdio_abort_data(void);
+
+const SD_Host_Ops SD_sdio_ops = {
+    .send_command = sdio_send_command,
+    .set_clock = sdio_set_clock,
+    .set_bus_width = sdio_set_bus_width,
+    .start_data = sdio_start_data,
+    .data_poll = sdio_data_poll,
+    .abort_data = sdio_abort_data
+};
+
+// HELPER FUNCTIONS ==============================================================
+/**
+ * R1, R1B, R6 and R7 are all 48 bit responses with a CRC. R1B's busy is left to the card layer,
+ * which polls CMD13 after every R1B command
+ */
+static HAL_Status sdio_send_command(uint8_t index, uint32_t arg, SD_Response response, uint32_t* resp) {
+    static const SDIO_Response map[] = {
+        SDIO_RESPONSE_NONE,
+        SDIO_RESPONSE_SHORT,
+        SDIO_RESPONSE_SHORT,
+        SDIO_RESPONSE_LONG,
+        SDIO_RESPONSE_SHORT_NO_CRC,
+        SDIO_RESPONSE_SHORT,
+        SDIO_RESPONSE_SHORT
+    };
+    if (response > SD_RESPONSE_R7) return HAL_ERROR;
+    return SDIO_send_command(index, arg, map[response], resp);
+}
+
+static uint32_t sdio_set_clock(uint32_t max_hz) {
+    return SDIO_set_clock(max_hz);
+}
+
+static HAL_Status sdio_set_bus_width(uint8_t width) {
+    if (width == 1U) return SDIO_set_bus_width(SDIO_BUS_1BIT);
+    if (width == 4U) return SDIO_set_bus_width(SDIO_BUS_4BIT);
+    return HAL_ERROR;
+}
+
+static HAL_Status sdio_start_data(uint8_t read, void* buffer, uint32_t len, uint32_t block_size, uint32_t timeout_ms) {
+    return SDIO_start_data(read ? SDIO_DIR_READ : SDIO_DIR_WRITE, buffer, len, block_size, timeout_ms);
+}
+
+static SD_Data_State sdio_data_poll(void) {
+    SDIO_Data_State state = SDIO_data_poll();
+    if (state == SDIO_DATA_BUSY) return SD_DATA_BUSY;
+    if (state == SDIO_DATA_ERROR) return SD_DATA_ERROR;
+    return SD_DATA_IDLE;
+}
+
+static void sdio_abort_data(void) {
+    SDIO_abort_data();
+}
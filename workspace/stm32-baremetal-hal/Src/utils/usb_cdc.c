@@ -0,0 +1,629 @@
+/*
+ * usb_cdc.c
+ *
+ * implementation file for usb_cdc.h
+ * Requests and descriptors follow USB 2.0 chapter 9, and the CDC 1.10 PSTN subclass for the ACM parts
+ *
+ *  Written by Ryan Wong
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "utils/usb_cdc.h"
+
+#define REQUEST_GET_STATUS 0x00U
+#define REQUEST_CLEAR_FEATURE 0x01U
+#define REQUEST_SET_FEATURE 0x03U
+#define REQUEST_SET_ADDRESS 0x05U
+#define REQUEST_GET_DESCRIPTOR 0x06U
+#define REQUEST_GET_CONFIGURATION 0x08U
+#define REQUEST_SET_CONFIGURATION 0x09U
+#define REQUEST_GET_INTERFACE 0x0AU
+#define REQUEST_SET_INTERFACE 0x0BU
+#define REQUEST_SET_LINE_CODING 0x20U
+#define REQUEST_GET_LINE_CODING 0x21U
+#define REQUEST_SET_CONTROL_LINE_STATE 0x22U
+#define REQUEST_SEND_BREAK 0x23U
+
+#define REQUEST_DIR_IN 0x80U
+#define REQUEST_TYPE_STANDARD 0x00U
+#define REQUEST_TYPE_CLASS 0x01U
+#define RECIPIENT_DEVICE 0x00U
+#define RECIPIENT_INTERFACE 0x01U
+#define RECIPIENT_ENDPOINT 0x02U
+
+#define DESCRIPTOR_DEVICE 0x01U
+#define DESCRIPTOR_CONFIGURATION 0x02U
+#define DESCRIPTOR_STRING 0x03U
+#define FEATURE_ENDPOINT_HALT 0x00U
+
+#define EP_TYPE_BULK 0x02U
+#define EP_TYPE_INTERRUPT 0x03U
+#define LINE_CODING_SIZE 7U
+#define NUM_INTERFACES 2U
+#define NUM_STRINGS 4U // language IDs, manufacturer, product, serial
+#define CONFIG_DESCRIPTOR_SIZE 67U
+
+typedef enum {
+    CONTROL_IDLE,
+    CONTROL_DATA_IN,
+    CONTROL_DATA_OUT,
+    CONTROL_STATUS_IN,
+    CONTROL_STATUS_OUT
+} Control_Stage;
+
+typedef struct {
+    uint8_t request_type;
+    uint8_t request;
+    uint16_t value;
+    uint16_t index;
+    uint16_t length;
+} Setup_Packet;
+
+typedef struct {
+    const uint8_t* buffer;
+    uint32_t len;
+} TX_Entry;
+
+static const uint8_t device_descriptor[18] = {
+    18, DESCRIPTOR_DEVICE,
+    0x00, 0x02, // USB 2.0
+    0x02, 0x00, 0x00, // CDC, class/protocol are per interface
+    64, // endpoint 0 max packet
+    CDC_VENDOR_ID & 0xFFU, CDC_VENDOR_ID >> 8,
+    CDC_PRODUCT_ID & 0xFFU, CDC_PRODUCT_ID >> 8,
+    0x00, 0x02, // device release 2.00
+    1, 2, 3, // manufacturer, product, serial strings
+    1 // configurations
+};
+
+/**
+ * Communication interface (0) with the notification endpoint and the ACM functional descriptors,
+ * data interface (1) with the bulk pair
+ */
+static const uint8_t config_descriptor[CONFIG_DESCRIPTOR_SIZE] = {
+    9, DESCRIPTOR_CONFIGURATION, CONFIG_DESCRIPTOR_SIZE, 0, NUM_INTERFACES, 1, 0, 0x80, 50, // bus powered, 100mA
+    9, 0x04, 0, 0, 1, 0x02, 0x02, 0x01, 0, // CDC, ACM, AT commands
+    5, 0x24, 0x00, 0x10, 0x01, // header, CDC 1.10
+    5, 0x24, 0x01, 0x00, 1, // call management: none, data interface 1
+    4, 0x24, 0x02, 0x02, // ACM: line coding and control line state requests
+    5, 0x24, 0x06, 0, 1, // union: interface 0 controls interface 1
+    7, 0x05, CDC_EP_NOTIFY, EP_TYPE_INTERRUPT, CDC_NOTIFY_PACKET_SIZE, 0, 16, // every 16ms
+    9, 0x04, 1, 0, 2, 0x0A, 0x00, 0x00, 0, // CDC data
+    7, 0x05, CDC_EP_DATA_OUT, EP_TYPE_BULK, CDC_PACKET_SIZE, 0, 0,
+    7, 0x05, CDC_EP_DATA_IN, EP_TYPE_BULK, CDC_PACKET_SIZE, 0, 0
+};
+
+static const char* const strings[NUM_STRINGS] = {NULL, "Ryan Wong", "STM32F446 bare-metal CDC serial", "0001"};
+
+static const CDC_Device_Ops* ops = NULL;
+static Setup_Packet setup;
+static Control_Stage stage = CONTROL_IDLE;
+static uint8_t control_zlp = 0;
+static uint8_t ep0_buffer[CDC_PACKET_SIZE];
+static volatile uint8_t configuration = 0;
+static volatile uint8_t dtr = 0;
+static uint16_t halted = 0; // bit n = OUT endpoint n, bit 8 + n = IN endpoint n
+static CDC_Line_Coding line_coding = {.baud = 115200U, .stop_bits = 0, .parity = 0, .data_bits = 8};
+
+static TX_Entry tx_queue[CDC_TX_QUEUE_SIZE];
+static volatile uint32_t tx_tail = 0;
+static volatile uint32_t tx_count = 0;
+static volatile uint8_t tx_busy = 0; // a transfer (or the ZLP) is on the endpoint
+static volatile uint8_t tx_zlp = 0;
+static volatile uint32_t tx_sent = 0; // entries taken off the head so far, numbers the queue for CDC_write()
+static volatile uint32_t tx_flushes = 0; // times the whole queue was dropped
+
+static uint8_t rx_buffer[CDC_PACKET_SIZE];
+static volatile uint32_t rx_len = 0; // 0 while the endpoint is armed
+static volatile uint32_t rx_pos = 0;
+
+static HAL_Status standard_request(void);
+static HAL_Status class_request(void);
+static HAL_Status get_descriptor(void);
+static HAL_Status set_configuration(uint8_t value);
+static HAL_Status set_halt(uint8_t ep_addr, uint8_t halt);
+static uint8_t endpoint_valid(uint8_t ep_addr);
+static uint16_t halt_bit(uint8_t ep_addr);
+static void control_in(const void* data, uint32_t len);
+static void control_out(void* buffer, uint32_t len);
+static void control_status(void);
+static void control_out_done(uint32_t len);
+static void tx_start(void);
+static void tx_complete(void);
+static void tx_reset(void);
+static HAL_Status tx_push(const void* buffer, uint32_t len, uint32_t* number);
+static uint8_t write_done(uint32_t number, uint32_t flushes);
+static void write_abort(uint32_t number, uint32_t flushes);
+static void rx_arm(void);
+
+// HAL FUNCTIONS ==============================================================
+HAL_Status CDC_init(const CDC_Device_Ops* device_ops) {
+    if (
+        device_ops == NULL ||
+        device_ops->connect == NULL ||
+        device_ops->ep_abort == NULL ||
+        device_ops->lock == NULL ||
+        device_ops->unlock == NULL ||
+        device_ops->poll == NULL
+    ) return HAL_ERROR;
+
+    ops = device_ops;
+    CDC_on_reset();
+    tx_sent = 0;
+    return ops->connect();
+}
+
+uint8_t CDC_is_configured(void) {
+    return configuration != 0;
+}
+
+uint8_t CDC_is_open(void) {
+    return configuration != 0 && dtr;
+}
+
+HAL_Status CDC_get_line_coding(CDC_Line_Coding* coding) {
+    if (coding == NULL) return HAL_ERROR;
+
+    *coding = line_coding;
+    return HAL_OK;
+}
+
+HAL_Status CDC_transmit(const void* buffer, uint32_t len) {
+    if (
+        ops == NULL ||
+        buffer == NULL ||
+        len == 0
+    ) return HAL_ERROR;
+
+    uint32_t number;
+    return tx_push(buffer, len, &number);
+}
+
+uint32_t CDC_tx_pending(void) {
+    return tx_count;
+}
+
+/**
+ * Queued like any other buffer, so it goes out in order with whatever was already queued, and only waits for
+ * its own entry. A bus reset drops the queue, which would otherwise look like the data was sent. On a timeout
+ * only this entry is taken off the queue (the transfer is aborted if it's the one running), the controller must
+ * not be reading the caller's buffer once this returns but other callers' buffers stay queued
+ */
+int CDC_write(const void* buffer, uint32_t len) {
+    if (ops == NULL || buffer == NULL) return -1;
+    if (len == 0 || !CDC_is_open()) return 0;
+
+    uint32_t flushes = tx_flushes;
+    uint32_t number;
+    uint32_t retries = 0;
+    while (tx_push(buffer, len, &number) != HAL_OK) {
+        if (!CDC_is_configured() || tx_flushes != flushes) return -1;
+        if (++retries > CDC_WRITE_RETRIES) return -1;
+        ops->poll();
+    }
+    while (!write_done(number, flushes)) {
+        if (tx_flushes != flushes) return -1;
+        if (++retries > CDC_WRITE_RETRIES) {
+            write_abort(number, flushes);
+            return -1;
+        }
+        ops->poll();
+    }
+    return (int)len;
+}
+
+uint32_t CDC_read(void* buffer, uint32_t max) {
+    if (
+        ops == NULL ||
+        buffer == NULL ||
+        configuration == 0 ||
+        rx_len == 0
+    ) return 0;
+
+    uint32_t count = rx_len - rx_pos;
+    if (count > max) count = max;
+    memcpy(buffer, rx_buffer + rx_pos, count);
+    rx_pos += count;
+
+    if (rx_pos == rx_len) {
+        ops->lock();
+        rx_arm();
+        ops->unlock();
+    }
+    return count;
+}
+
+void CDC_on_reset(void) {
+    stage = CONTROL_IDLE;
+    control_zlp = 0;
+    configuration = 0;
+    dtr = 0;
+    halted = 0;
+    tx_reset();
+    rx_len = 0;
+    rx_pos = 0;
+}
+
+/**
+ * Anything that isn't supported stalls endpoint 0, which the host sees as a request error
+ */
+void CDC_on_setup(const uint8_t* packet) {
+    setup.request_type = packet[0];
+    setup.request = packet[1];
+    setup.value = (uint16_t)(packet[2] | (packet[3] << 8));
+    setup.index = (uint16_t)(packet[4] | (packet[5] << 8));
+    setup.length = (uint16_t)(packet[6] | (packet[7] << 8));
+    stage = CONTROL_IDLE;
+    control_zlp = 0;
+
+    uint8_t type = (setup.request_type >> 5) & 0x03U;
+    uint8_t recipient = setup.request_type & 0x1FU;
+    HAL_Status status = HAL_ERROR;
+    if (type == REQUEST_TYPE_STANDARD) {
+        status = standard_request();
+    } else if (type == REQUEST_TYPE_CLASS && recipient == RECIPIENT_INTERFACE && setup.index == 0) {
+        status = class_request();
+    }
+
+    if (status != HAL_OK) {
+        stage = CONTROL_IDLE;
+        ops->ep_stall(0x80U, 1);
+        ops->ep_stall(0x00U, 1);
+    }
+}
+
+/**
+ * Control transfers: data stage (split into packets by the backend, plus a ZLP if the data ends on a full
+ * packet short of what the host asked for), then a zero length status stage the other way
+ */
+void CDC_on_complete(uint8_t ep_addr, uint32_t len) {
+    if (ep_addr == 0x80U) {
+        if (stage == CONTROL_DATA_IN) {
+            if (control_zlp) {
+                control_zlp = 0;
+                ops->ep_transmit(0x80U, NULL, 0);
+                return;
+            }
+            stage = CONTROL_STATUS_OUT;
+            ops->ep_receive(0x00U, NULL, 0);
+        } else if (stage == CONTROL_STATUS_IN) {
+            stage = CONTROL_IDLE;
+        }
+    } else if (ep_addr == 0x00U) {
+        if (stage == CONTROL_DATA_OUT) {
+            control_out_done(len);
+        } else if (stage == CONTROL_STATUS_OUT) {
+            stage = CONTROL_IDLE;
+        }
+    } else if (ep_addr == CDC_EP_DATA_IN) {
+        tx_complete();
+    } else if (ep_addr == CDC_EP_DATA_OUT) {
+        // A ZLP carries nothing, keep listening
+        rx_pos = 0;
+        rx_len = len;
+        if (len == 0) rx_arm();
+    }
+}
+
+// HELPER FUNCTIONS ==============================================================
+static HAL_Status standard_request(void) {
+    uint8_t recipient = setup.request_type & 0x1FU;
+    uint8_t in = setup.request_type & REQUEST_DIR_IN;
+
+    switch (setup.request) {
+        case REQUEST_GET_STATUS:
+            if (!in || setup.length < 2U) return HAL_ERROR;
+            ep0_buffer[0] = 0; // bus powered, no remote wakeup
+            ep0_buffer[1] = 0;
+            if (recipient == RECIPIENT_INTERFACE) {
+                if (configuration == 0 || setup.index >= NUM_INTERFACES) return HAL_ERROR;
+            } else if (recipient == RECIPIENT_ENDPOINT) {
+                if (!endpoint_valid((uint8_t)setup.index)) return HAL_ERROR;
+                ep0_buffer[0] = (halted & halt_bit((uint8_t)setup.index)) ? 1U : 0;
+            } else if (recipient != RECIPIENT_DEVICE) {
+                return HAL_ERROR;
+            }
+            control_in(ep0_buffer, 2U);
+            return HAL_OK;
+
+        case REQUEST_CLEAR_FEATURE:
+        case REQUEST_SET_FEATURE:
+            if (in || recipient != RECIPIENT_ENDPOINT || setup.value != FEATURE_ENDPOINT_HALT) return HAL_ERROR;
+            if (set_halt((uint8_t)setup.index, setup.request == REQUEST_SET_FEATURE) != HAL_OK) return HAL_ERROR;
+            control_status();
+            return HAL_OK;
+
+        case REQUEST_SET_ADDRESS:
+            if (in || recipient != RECIPIENT_DEVICE || setup.value > 127U || setup.length != 0) return HAL_ERROR;
+            ops->set_address((uint8_t)setup.value);
+            control_status();
+            return HAL_OK;
+
+        case REQUEST_GET_DESCRIPTOR:
+            if (!in) return HAL_ERROR;
+            return get_descriptor();
+
+        case REQUEST_GET_CONFIGURATION:
+            if (!in || recipient != RECIPIENT_DEVICE) return HAL_ERROR;
+            ep0_buffer[0] = configuration;
+            control_in(ep0_buffer, 1U);
+            return HAL_OK;
+
+        case REQUEST_SET_CONFIGURATION:
+            if (in || recipient != RECIPIENT_DEVICE || setup.value > 1U) return HAL_ERROR;
+            if (set_configuration((uint8_t)setup.value) != HAL_OK) return HAL_ERROR;
+            control_status();
+            return HAL_OK;
+
+        case REQUEST_GET_INTERFACE:
+            if (!in || recipient != RECIPIENT_INTERFACE || configuration == 0 || setup.index >= NUM_INTERFACES) return HAL_ERROR;
+            ep0_buffer[0] = 0;
+            control_in(ep0_buffer, 1U);
+            return HAL_OK;
+
+        case REQUEST_SET_INTERFACE:
+            // Neither interface has alternate settings
+            if (in || recipient != RECIPIENT_INTERFACE || configuration == 0 || setup.index >= NUM_INTERFACES || setup.value != 0) return HAL_ERROR;
+            control_status();
+            return HAL_OK;
+
+        default:
+            return HAL_ERROR;
+    }
+}
+
+/**
+ * Line coding is stored and reported back but changes nothing, the data rate is the USB's
+ */
+static HAL_Status class_request(void) {
+    uint8_t in = setup.request_type & REQUEST_DIR_IN;
+
+    switch (setup.request) {
+        case REQUEST_SET_LINE_CODING:
+            if (in || setup.length != LINE_CODING_SIZE) return HAL_ERROR;
+            control_out(ep0_buffer, LINE_CODING_SIZE);
+            return HAL_OK;
+
+        case REQUEST_GET_LINE_CODING:
+            if (!in) return HAL_ERROR;
+            ep0_buffer[0] = (uint8_t)line_coding.baud;
+            ep0_buffer[1] = (uint8_t)(line_coding.baud >> 8);
+            ep0_buffer[2] = (uint8_t)(line_coding.baud >> 16);
+            ep0_buffer[3] = (uint8_t)(line_coding.baud >> 24);
+            ep0_buffer[4] = line_coding.stop_bits;
+            ep0_buffer[5] = line_coding.parity;
+            ep0_buffer[6] = line_coding.data_bits;
+            control_in(ep0_buffer, LINE_CODING_SIZE);
+            return HAL_OK;
+
+        case REQUEST_SET_CONTROL_LINE_STATE:
+            // Bit 0 is DTR, terminal programs set it when they open the port
+            if (in || setup.length != 0) return HAL_ERROR;
+            dtr = setup.value & 0x01U;
+            control_status();
+            return HAL_OK;
+
+        case REQUEST_SEND_BREAK:
+            if (in || setup.length != 0) return HAL_ERROR;
+            control_status();
+            return HAL_OK;
+
+        default:
+            return HAL_ERROR;
+    }
+}
+
+/**
+ * String descriptors are built in ep0_buffer: ASCII widened to UTF-16LE
+ */
+static HAL_Status get_descriptor(void) {
+    uint8_t type = setup.value >> 8;
+    uint8_t index = setup.value & 0xFFU;
+
+    if (type == DESCRIPTOR_DEVICE && index == 0) {
+        control_in(device_descriptor, sizeof(device_descriptor));
+        return HAL_OK;
+    }
+    if (type == DESCRIPTOR_CONFIGURATION && index == 0) {
+        control_in(config_descriptor, sizeof(config_descriptor));
+        return HAL_OK;
+    }
+    if (type != DESCRIPTOR_STRING || index >= NUM_STRINGS) return HAL_ERROR;
+
+    ep0_buffer[1] = DESCRIPTOR_STRING;
+    if (index == 0) {
+        ep0_buffer[0] = 4U;
+        ep0_buffer[2] = 0x09U; // English (US)
+        ep0_buffer[3] = 0x04U;
+    } else {
+        uint32_t len = strlen(strings[index]);
+        if (len > (sizeof(ep0_buffer) - 2U) / 2U) len = (sizeof(ep0_buffer) - 2U) / 2U;
+        ep0_buffer[0] = (uint8_t)(2U + len * 2U);
+        for (uint32_t i = 0; i < len; i++) {
+            ep0_buffer[2U + i * 2U] = (uint8_t)strings[index][i];
+            ep0_buffer[3U + i * 2U] = 0;
+        }
+    }
+    control_in(ep0_buffer, ep0_buffer[0]);
+    return HAL_OK;
+}
+
+/**
+ * Setting configuration 1 again (e.g. after a port reopen) reopens the endpoints, putting their toggles back to DATA0
+ */
+static HAL_Status set_configuration(uint8_t value) {
+    tx_reset();
+    rx_len = 0;
+    rx_pos = 0;
+    halted = 0;
+    dtr = 0;
+    configuration = 0;
+    if (value == 0) return HAL_OK;
+
+    if (
+        ops->ep_open(CDC_EP_NOTIFY, EP_TYPE_INTERRUPT, CDC_NOTIFY_PACKET_SIZE) != HAL_OK ||
+        ops->ep_open(CDC_EP_DATA_OUT, EP_TYPE_BULK, CDC_PACKET_SIZE) != HAL_OK ||
+        ops->ep_open(CDC_EP_DATA_IN, EP_TYPE_BULK, CDC_PACKET_SIZE) != HAL_OK
+    ) return HAL_ERROR;
+    configuration = value;
+    rx_arm();
+    return HAL_OK;
+}
+
+/**
+ * Halting a data endpoint drops what it was doing: the transmit queue for IN (new buffers queue up and start
+ * when the halt is cleared), the armed receive for OUT (rearmed when the halt is cleared)
+ */
+static HAL_Status set_halt(uint8_t ep_addr, uint8_t halt) {
+    if (!endpoint_valid(ep_addr)) return HAL_ERROR;
+    if ((ep_addr & 0x7FU) == 0) return HAL_OK;
+
+    ops->ep_stall(ep_addr, halt);
+    if (halt) {
+        halted |= halt_bit(ep_addr);
+        if (ep_addr == CDC_EP_DATA_IN) tx_reset();
+    } else {
+        halted &= ~halt_bit(ep_addr);
+        if (ep_addr == CDC_EP_DATA_IN) tx_start();
+        if (ep_addr == CDC_EP_DATA_OUT && rx_len == 0) rx_arm();
+    }
+    return HAL_OK;
+}
+
+static uint8_t endpoint_valid(uint8_t ep_addr) {
+    if ((ep_addr & 0x7FU) == 0) return 1;
+    return configuration != 0 &&
+           (ep_addr == CDC_EP_DATA_IN || ep_addr == CDC_EP_DATA_OUT || ep_addr == CDC_EP_NOTIFY);
+}
+
+static uint16_t halt_bit(uint8_t ep_addr) {
+    return (uint16_t)(0x01U << ((ep_addr & 0x07U) + ((ep_addr & 0x80U) ? 8U : 0U)));
+}
+
+static void control_in(const void* data, uint32_t len) {
+    if (len > setup.length) len = setup.length;
+    control_zlp = len < setup.length && len != 0 && (len % CDC_PACKET_SIZE) == 0;
+    stage = CONTROL_DATA_IN;
+    ops->ep_transmit(0x80U, data, len);
+}
+
+static void control_out(void* buffer, uint32_t len) {
+    stage = CONTROL_DATA_OUT;
+    ops->ep_receive(0x00U, buffer, len);
+}
+
+static void control_status(void) {
+    stage = CONTROL_STATUS_IN;
+    ops->ep_transmit(0x80U, NULL, 0);
+}
+
+static void control_out_done(uint32_t len) {
+    if (setup.request != REQUEST_SET_LINE_CODING || len != LINE_CODING_SIZE) {
+        stage = CONTROL_IDLE;
+        ops->ep_stall(0x80U, 1);
+        ops->ep_stall(0x00U, 1);
+        return;
+    }
+    line_coding.baud = (uint32_t)ep0_buffer[0] | ((uint32_t)ep0_buffer[1] << 8) |
+                       ((uint32_t)ep0_buffer[2] << 16) | ((uint32_t)ep0_buffer[3] << 24);
+    line_coding.stop_bits = ep0_buffer[4];
+    line_coding.parity = ep0_buffer[5];
+    line_coding.data_bits = ep0_buffer[6];
+    control_status();
+}
+
+static void tx_start(void) {
+    if (tx_busy || tx_count == 0 || (halted & halt_bit(CDC_EP_DATA_IN))) return;
+
+    tx_busy = 1;
+    if (ops->ep_transmit(CDC_EP_DATA_IN, tx_queue[tx_tail].buffer, tx_queue[tx_tail].len) != HAL_OK) tx_busy = 0;
+}
+
+/**
+ * Runs from the completion event, so the next buffer starts without waiting for the application
+ */
+static void tx_complete(void) {
+    tx_busy = 0;
+    if (tx_zlp) {
+        tx_zlp = 0;
+    } else if (tx_count != 0) {
+        uint32_t len = tx_queue[tx_tail].len;
+        tx_tail = (tx_tail + 1U) % CDC_TX_QUEUE_SIZE;
+        tx_count--;
+        tx_sent++;
+
+        if (tx_count == 0 && (len % CDC_PACKET_SIZE) == 0) {
+            tx_zlp = 1;
+            tx_busy = 1;
+            if (ops->ep_transmit(CDC_EP_DATA_IN, NULL, 0) != HAL_OK) {
+                tx_zlp = 0;
+                tx_busy = 0;
+            }
+            return;
+        }
+    }
+    tx_start();
+}
+
+static void tx_reset(void) {
+    tx_tail = 0;
+    tx_count = 0;
+    tx_busy = 0;
+    tx_zlp = 0;
+    tx_flushes++;
+}
+
+/**
+ * number - position of the entry counted from the first one ever queued, so CDC_write() can tell when it's
+ * 			been sent without holding a slot index that gets reused
+ */
+static HAL_Status tx_push(const void* buffer, uint32_t len, uint32_t* number) {
+    HAL_Status status = HAL_ERROR;
+    ops->lock();
+    if (configuration != 0 && tx_count < CDC_TX_QUEUE_SIZE) {
+        TX_Entry* entry = &tx_queue[(tx_tail + tx_count) % CDC_TX_QUEUE_SIZE];
+        entry->buffer = buffer;
+        entry->len = len;
+        *number = tx_sent + tx_count;
+        tx_count++;
+        tx_start();
+        status = HAL_OK;
+    }
+    ops->unlock();
+    return status;
+}
+
+static uint8_t write_done(uint32_t number, uint32_t flushes) {
+    return tx_flushes == flushes && (int32_t)(tx_sent - number) > 0;
+}
+
+/**
+ * Takes just this entry off the queue, everything queued around it still goes out in order. Entries behind it
+ * move up a slot, tx_sent isn't counted up since nothing was sent
+ */
+static void write_abort(uint32_t number, uint32_t flushes) {
+    ops->lock();
+    if (tx_flushes == flushes && (int32_t)(tx_sent - number) <= 0) {
+        uint32_t position = number - tx_sent;
+        if (position == 0 && tx_busy && !tx_zlp) {
+            ops->ep_abort(CDC_EP_DATA_IN);
+            tx_busy = 0;
+        }
+        for (uint32_t i = position; i + 1U < tx_count; i++) {
+            tx_queue[(tx_tail + i) % CDC_TX_QUEUE_SIZE] = tx_queue[(tx_tail + i + 1U) % CDC_TX_QUEUE_SIZE];
+        }
+        tx_count--;
+        tx_start();
+    }
+    ops->unlock();
+}
+
+static void rx_arm(void) {
+    rx_len = 0;
+    rx_pos = 0;
+    if (configuration != 0 && !(halted & halt_bit(CDC_EP_DATA_OUT))) {
+        ops->ep_receive(CDC_EP_DATA_OUT, rx_buffer, CDC_PACKET_SIZE);
+    }
+}
@@ -0,0 +1,100 @@
+/*
+ * usb_cdc_otg.c
+ *
+ * CDC backend for the OTG FS core (drivers/usb_driver.h). The bus events come straight from the driver's
+ * interrupt, so lock() just masks it
+ *
+ *  Written by Ryan Wong
+ */
+
+#include <stdint.h>
+#include "utils/usb_cdc.h"
+#include "drivers/usb_driver.h"
+#include "drivers/nvic_driver.h"
+
+#define OTG_IRQ_PRIORITY 6U
+
+static HAL_Status otg_connect(void);
+static void otg_set_address(uint8_t address);
+static HAL_Status otg_ep_open(uint8_t ep_addr, uint8_t type, uint16_t max_packet);
+static HAL_Status otg_ep_transmit(uint8_t ep_addr, const void* buffer, uint32_t len);
+static HAL_Status otg_ep_receive(uint8_t ep_addr, void* buffer, uint32_t len);
+static void otg_ep_abort(uint8_t ep_addr);
+static void otg_ep_stall(uint8_t ep_addr, uint8_t stall);
+static void otg_lock(void);
+static void otg_unlock(void);
+static void otg_poll(void);
+
+const CDC_Device_Ops CDC_otg_ops = {
+    .connect = otg_connect,
+    .set_address = otg_set_address,
+    .ep_open = otg_ep_open,
+    .ep_transmit = otg_ep_transmit,
+    .ep_receive = otg_ep_receive,
+    .ep_abort = otg_ep_abort,
+    .ep_stall = otg_ep_stall,
+    .lock = otg_lock,
+    .unlock = otg_unlock,
+    .poll = otg_poll
+};
+
+static const USB_Callbacks callbacks = {
+    .reset = CDC_on_reset,
+    .setup = CDC_on_setup,
+    .complete = CDC_on_complete
+};
+
+// HELPER FUNCTIONS ==============================================================
+/**
+ * FIFO RAM (320 words): RX gets room for two bulk packets plus SETUPs, the notification endpoint and
+ * endpoint 0 one packet each, and the rest (13 packets) goes to bulk IN so the core always has the next
+ * packets ready while the interrupt refills it
+ */
+static HAL_Status otg_connect(void) {
+    USB_Init_TypeDef init = {
+        .callbacks = &callbacks,
+        .rx_fifo_words = 80U,
+        .tx_fifo_words = {16U, 208U, 16U, 0, 0, 0},
+        .irq_priority = OTG_IRQ_PRIORITY
+    };
+    if (USB_init(&init) != HAL_OK) return HAL_ERROR;
+
+    USB_connect();
+    return HAL_OK;
+}
+
+static void otg_set_address(uint8_t address) {
+    USB_set_address(address);
+}
+
+static HAL_Status otg_ep_open(uint8_t ep_addr, uint8_t type, uint16_t max_packet) {
+    if (type > USB_EP_INTERRUPT) return HAL_ERROR;
+    return USB_ep_open(ep_addr, (USB_EP_Type)type, max_packet);
+}
+
+static HAL_Status otg_ep_transmit(uint8_t ep_addr, const void* buffer, uint32_t len) {
+    return USB_ep_transmit(ep_addr, buffer, len);
+}
+
+static HAL_Status otg_ep_receive(uint8_t ep_addr, void* buffer, uint32_t len) {
+    return USB_ep_receive(ep_addr, buffer, len);
+}
+
+static void otg_ep_abort(uint8_t ep_addr) {
+    USB_ep_abort(ep_addr);
+}
+
+static void otg_ep_stall(uint8_t ep_addr, uint8_t stall) {
+    USB_ep_stall(ep_addr, stall);
+}
+
+static void otg_lock(void) {
+    NVIC_disable_irq(NVIC_IRQ_OTG_FS);
+}
+
+static void otg_unlock(void) {
+    NVIC_enable_irq(NVIC_IRQ_OTG_FS);
+}
+
+static void otg_poll(void) {
+}
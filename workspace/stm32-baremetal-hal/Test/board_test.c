@@ -0,0 +1,151 @@
+/**
+ * Source file containing the self-checking tests and benchmarks for the board pin map
+ * TEST_MAP covers every mode on one port, and is applied both folded (BOARD_apply_port) and one pin at a time
+ * (GPIO_init) to fake ports filled with the same pattern: the registers have to come out identical
+ * 
+ * Written by Ryan Wong
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include "test/board_test.h"
+#include "test/test_runner.h"
+#include "utils/board.h"
+
+#define BOARD_TEST_PATTERN 0xA5A5A5A5U
+
+#define TEST_MAP(PIN, arg) \
+    PIN(arg, A, 1, OUTPUT, PP, LOW, NONE, 0, 1) \
+    PIN(arg, A, 2, OUTPUT, OD, FAST, PU, 0, 0) \
+    PIN(arg, A, 3, AF, PP, HIGH, NONE, 7, 0) \
+    PIN(arg, A, 4, ANALOG, PP, LOW, NONE, 0, 0) \
+    PIN(arg, A, 9, AF, OD, MED, PU, 4, 0) \
+    PIN(arg, A, 12, INPUT, PP, LOW, PD, 0, 0) \
+    PIN(arg, A, 15, AF, PP, HIGH, PD, 12, 1)
+
+#define DUPLICATE_MAP(PIN, arg) \
+    PIN(arg, B, 3, OUTPUT, PP, LOW, NONE, 0, 0) \
+    PIN(arg, C, 3, OUTPUT, PP, LOW, NONE, 0, 0) \
+    PIN(arg, B, 3, AF, PP, LOW, NONE, 5, 0)
+
+#define INVALID_MAP(PIN, arg) \
+    PIN(arg, B, 16, OUTPUT, PP, LOW, NONE, 0, 0)
+
+// The same map through GPIO_init, for comparison
+#define GPIO_INIT_TERM(fake, port, pin, mode, otype, ospeed, pupd, af, init) { \
+    GPIO_Init_TypeDef pin_init = {GPIO_MODE_##mode, GPIO_OTYPE_##otype, GPIO_OSPEED_##ospeed, GPIO_PUPD_##pupd, (GPIO_AFx)(af), (PIN_State)(init)}; \
+    GPIO_init((fake), (GPIO_Pin)(pin), &pin_init); \
+}
+
+_Static_assert(!BOARD_MAP_HAS_DUPLICATES(TEST_MAP), "TEST_MAP has duplicates");
+
+static const BOARD_Port_Config test_config = BOARD_PORT_CONFIG(TEST_MAP, BOARD_PORT_A);
+static const BOARD_Port_Config empty_config = BOARD_PORT_CONFIG(TEST_MAP, BOARD_PORT_B);
+static GPIO_Reg_TypeDef fake_port;
+static GPIO_Reg_TypeDef reference_port;
+
+static void init_with_gpio(GPIO_Reg_TypeDef* port);
+static void test_matches_gpio_init(void);
+static void test_output_levels(void);
+static void test_empty_port(void);
+static void test_duplicates(void);
+static void test_board_map(void);
+static void test_invalid(void);
+
+void BOARD_run_tests() {
+    TEST_run("board_matches_gpio_init", test_matches_gpio_init);
+    TEST_run("board_output_levels", test_output_levels);
+    TEST_run("board_empty_port", test_empty_port);
+    TEST_run("board_duplicates", test_duplicates);
+    TEST_run("board_map", test_board_map);
+    TEST_run("board_invalid", test_invalid);
+}
+
+/**
+ * 7 pins either way, so the two numbers compare directly
+ */
+void BOARD_run_benchmarks() {
+    TEST_reset_port(&fake_port, BOARD_TEST_PATTERN);
+    TEST_BENCH("BOARD_apply_port", BOARD_apply_port(&fake_port, &test_config));
+    TEST_BENCH("GPIO_init_x7", init_with_gpio(&fake_port));
+}
+
+// HELPER FUNCTIONS ==============================================================
+static void init_with_gpio(GPIO_Reg_TypeDef* port) {
+    TEST_MAP(GPIO_INIT_TERM, port)
+}
+
+static void test_matches_gpio_init(void) {
+    TEST_reset_port(&fake_port, BOARD_TEST_PATTERN);
+    TEST_reset_port(&reference_port, BOARD_TEST_PATTERN);
+    TEST_ASSERT_EQUAL(HAL_OK, BOARD_apply_port(&fake_port, &test_config));
+    init_with_gpio(&reference_port);
+
+    TEST_ASSERT_EQUAL(reference_port.MODER, fake_port.MODER);
+    TEST_ASSERT_EQUAL(reference_port.OTYPER, fake_port.OTYPER);
+    TEST_ASSERT_EQUAL(reference_port.OSPEEDR, fake_port.OSPEEDR);
+    TEST_ASSERT_EQUAL(reference_port.PUPDR, fake_port.PUPDR);
+    TEST_ASSERT_EQUAL(reference_port.AFRL, fake_port.AFRL);
+    TEST_ASSERT_EQUAL(reference_port.AFRH, fake_port.AFRH);
+}
+
+/**
+ * All output levels go out in one BSRR write, and only for output pins (PA15's init = 1 is AF, so ignored)
+ */
+static void test_output_levels(void) {
+    TEST_ASSERT_EQUAL((0x01U << 1) | (0x01U << 2), test_config.out_pins);
+    TEST_ASSERT_EQUAL(0x01U << 1, test_config.odr);
+
+    TEST_reset_port(&fake_port, BOARD_TEST_PATTERN);
+    BOARD_apply_port(&fake_port, &test_config);
+    TEST_ASSERT_EQUAL((0x01U << 1) | (0x01U << (2 + 16)), fake_port.BSRR);
+}
+
+static void test_empty_port(void) {
+    TEST_ASSERT_EQUAL(0, empty_config.pins);
+    TEST_ASSERT_EQUAL(0, empty_config.mask2);
+
+    TEST_reset_port(&fake_port, BOARD_TEST_PATTERN);
+    TEST_ASSERT_EQUAL(HAL_OK, BOARD_apply_port(&fake_port, &empty_config));
+    TEST_ASSERT_EQUAL(BOARD_TEST_PATTERN, fake_port.MODER);
+    TEST_ASSERT_EQUAL(BOARD_TEST_PATTERN, fake_port.OTYPER);
+    TEST_ASSERT_EQUAL(BOARD_TEST_PATTERN, fake_port.PUPDR);
+    TEST_ASSERT_EQUAL(BOARD_TEST_PATTERN, fake_port.AFRL);
+    TEST_ASSERT_EQUAL(0, fake_port.BSRR);
+}
+
+/**
+ * The real map is checked by a _Static_assert in board.c, this checks the check
+ */
+static void test_duplicates(void) {
+    TEST_ASSERT(BOARD_MAP_HAS_DUPLICATES(DUPLICATE_MAP));
+    TEST_ASSERT(BOARD_PORT_HAS_DUPLICATES(DUPLICATE_MAP, BOARD_PORT_B));
+    TEST_ASSERT(!BOARD_PORT_HAS_DUPLICATES(DUPLICATE_MAP, BOARD_PORT_C));
+    TEST_ASSERT(!BOARD_MAP_HAS_DUPLICATES(TEST_MAP));
+    TEST_ASSERT(BOARD_MAP_IS_INVALID(INVALID_MAP));
+    TEST_ASSERT(!BOARD_MAP_IS_INVALID(TEST_MAP));
+}
+
+/**
+ * Spot checks of the folded BOARD_PIN_MAP: PA0 AF2 pull down, PA5 AF1, PC13 input
+ */
+static void test_board_map(void) {
+    const BOARD_Port_Config* a = &BOARD_ports[BOARD_PORT_A];
+    const BOARD_Port_Config* c = &BOARD_ports[BOARD_PORT_C];
+
+    TEST_ASSERT_EQUAL((0x01U << 0) | (0x01U << 5), a->pins);
+    TEST_ASSERT_EQUAL((0x02U << 0) | (0x02U << 10), a->moder);
+    TEST_ASSERT_EQUAL(0x02U << 0, a->pupdr);
+    TEST_ASSERT_EQUAL((0x02U << 0) | (0x01U << 20), a->afrl);
+    TEST_ASSERT_EQUAL(0, a->afrh_mask);
+    TEST_ASSERT_EQUAL(0x01U << 13, c->pins);
+    TEST_ASSERT_EQUAL(0, c->moder);
+    TEST_ASSERT_EQUAL(0x03U << 26, c->mask2);
+    TEST_ASSERT_EQUAL(0, BOARD_ports[BOARD_PORT_B].pins);
+    TEST_ASSERT_EQUAL((0x01U << BOARD_PORT_A) | (0x01U << BOARD_PORT_C), BOARD_CLOCK_MASK(BOARD_PIN_MAP));
+}
+
+static void test_invalid(void) {
+    TEST_ASSERT_EQUAL(HAL_ERROR, BOARD_apply_port(NULL, &test_config));
+    TEST_ASSERT_EQUAL(HAL_ERROR, BOARD_apply_port(&fake_port, NULL));
+}
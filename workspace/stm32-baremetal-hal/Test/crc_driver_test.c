@@ -0,0 +1,99 @@
+/**
+ * Source file containing tests for crc_driver
+ * Checks the standard mode against the well known CRC-32 check value, checks that splitting a buffer into
+ * odd sized, unaligned chunks (with another context interleaved) gives the same answer as one call, and that
+ * the DMA gives the same native checksum as the CPU. Then times each method over one block
+ * 
+ * Written by Ryan Wong
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include "test/crc_driver_test.h"
+#include "drivers/crc_driver.h"
+#include "drivers/dwt_driver.h"
+
+volatile CRC_Test_Result CRC_test_result;
+
+static uint8_t block[CRC_TEST_BLOCK_SIZE] __attribute__((aligned(4)));
+
+static uint32_t software_crc32(const uint8_t* data, uint32_t len);
+
+void CRC_test_init() {
+    DWT_init();
+    CRC_enable_clock();
+
+    for (uint32_t i = 0; i < CRC_TEST_BLOCK_SIZE; i++) {
+        block[i] = (uint8_t)(i * 13U + 5U);
+    }
+}
+
+void CRC_test() {
+    static const char check[] = "123456789";
+    uint8_t passed = 1;
+
+    CRC_test_result.check_value = CRC_compute(CRC_MODE_STANDARD, check, 9U);
+    if (CRC_test_result.check_value != 0xCBF43926U) passed = 0;
+
+    // Chunks of 1, 2, 3... bytes, starting at an odd address, with a second context sharing the unit
+    uint32_t expected = CRC_compute(CRC_MODE_STANDARD, block + 1, 1000U);
+    CRC_Context chunked;
+    CRC_Context other;
+    CRC_begin(&chunked, CRC_MODE_STANDARD);
+    CRC_begin(&other, CRC_MODE_STANDARD);
+    uint32_t offset = 0;
+    for (uint32_t size = 1; offset < 1000U; size++) {
+        if (size > 1000U - offset) size = 1000U - offset;
+        CRC_update(&chunked, block + 1 + offset, size);
+        CRC_update(&other, check, 9U);
+        offset += size;
+    }
+    if (CRC_finish(&chunked) != expected) passed = 0;
+    if (CRC_finish(&chunked) != software_crc32(block + 1, 1000U)) passed = 0;
+
+    uint32_t start = DWT_CYCLES();
+    uint32_t software = software_crc32(block, CRC_TEST_BLOCK_SIZE);
+    CRC_test_result.software_cycles = DWT_CYCLES() - start;
+
+    start = DWT_CYCLES();
+    uint32_t standard = CRC_compute(CRC_MODE_STANDARD, block, CRC_TEST_BLOCK_SIZE);
+    CRC_test_result.standard_cycles = DWT_CYCLES() - start;
+    if (standard != software) passed = 0;
+
+    start = DWT_CYCLES();
+    uint32_t native = CRC_compute(CRC_MODE_NATIVE, block, CRC_TEST_BLOCK_SIZE);
+    CRC_test_result.native_cycles = DWT_CYCLES() - start;
+
+    // First half on the CPU, second half on the DMA, to check resuming works across both
+    CRC_Context dma;
+    CRC_begin(&dma, CRC_MODE_NATIVE);
+    CRC_update(&dma, block, CRC_TEST_BLOCK_SIZE / 2U);
+    CRC_update(&other, check, 9U);
+    if (CRC_update_dma(&dma, block + CRC_TEST_BLOCK_SIZE / 2U, CRC_TEST_BLOCK_SIZE / 2U) != HAL_OK) passed = 0;
+    while (CRC_dma_poll(&dma) == CRC_DMA_BUSY);
+    if (CRC_dma_poll(&dma) != CRC_DMA_IDLE || CRC_finish(&dma) != native) passed = 0;
+
+    CRC_begin(&dma, CRC_MODE_NATIVE);
+    start = DWT_CYCLES();
+    CRC_update_dma(&dma, block, CRC_TEST_BLOCK_SIZE);
+    CRC_test_result.dma_submit_cycles = DWT_CYCLES() - start;
+    while (CRC_dma_poll(&dma) == CRC_DMA_BUSY);
+    CRC_test_result.dma_cycles = DWT_CYCLES() - start;
+    if (CRC_dma_poll(&dma) != CRC_DMA_IDLE || CRC_finish(&dma) != native) passed = 0;
+
+    CRC_test_result.passed = passed;
+}
+
+/**
+ * The usual bit at a time reflected CRC-32, i.e. what we were doing before the driver existed
+ */
+static uint32_t software_crc32(const uint8_t* data, uint32_t len) {
+    uint32_t crc = 0xFFFFFFFFU;
+    while (len--) {
+        crc ^= *data++;
+        for (uint32_t bit = 0; bit < 8U; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320U & (0U - (crc & 0x01U)));
+        }
+    }
+    return ~crc;
+}
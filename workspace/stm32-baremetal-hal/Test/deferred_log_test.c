@@ -0,0 +1,45 @@
+/**
+ * Source file containing implementation for simple tests for the deferred_log utility
+ * as of now, they are not automated and don't use a testing framework, just visual inspection
+ *
+ * Logs a counter, a negative number and a float every loop and drains the buffer straight to ITM port 0.
+ * Capture the SWV ITM data console to a file and run tools/dlog_decode.py on it with the ELF.
+ * DLOG_test_cycles (watch it with live expressions) is the cost of one 3 argument DLOG() call
+ * 
+ * Written by Ryan Wong
+ */
+
+#include <stdint.h>
+#include "test/deferred_log_test.h"
+#include "utils/deferred_log.h"
+#include "drivers/dwt_driver.h"
+
+extern void ITM_SendChar(uint8_t ch);
+
+volatile uint32_t DLOG_test_cycles = 0;
+
+static uint32_t counter = 0;
+
+/**
+ * Not through _write, so the binary stream stays on the ITM wherever stdout is redirected
+ */
+static int itm_sink(const uint8_t* data, uint32_t len) {
+    for (uint32_t i = 0; i < len; i++) ITM_SendChar(data[i]);
+    return (int)len;
+}
+
+void DLOG_test_init() {
+    DLOG_init();
+    DLOG("deferred log test started");
+}
+
+void DLOG_test() {
+    float ratio = (float)counter / 7.0f;
+
+    uint32_t start = DWT_CYCLES();
+    DLOG("count=%u neg=%d ratio=%f", counter, -(int32_t)counter, DLOG_FLOAT(ratio));
+    DLOG_test_cycles = DWT_CYCLES() - start;
+
+    counter++;
+    DLOG_drain(itm_sink, 64);
+}
@@ -0,0 +1,68 @@
+/**
+ * Source file containing the throughput benchmark for the dma_copy utility
+ * Copies and fills blocks of several sizes with the CPU and with the DMA and records the cycles taken.
+ * Bytes per cycle = block_size / cycles
+ * 
+ * Written by Ryan Wong
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include "test/dma_copy_test.h"
+#include "utils/dma_copy.h"
+#include "drivers/dwt_driver.h"
+
+#define DMA_COPY_TEST_MAX_BLOCK 16384U
+
+volatile DMA_Copy_Test_Result DMA_copy_test_results[DMA_COPY_TEST_NUM_SIZES];
+
+static const uint32_t block_sizes[DMA_COPY_TEST_NUM_SIZES] = {64U, 256U, 1024U, 4096U, 16384U};
+
+// 16 byte aligned so the DMA can use word bursts
+static uint8_t src_buffer[DMA_COPY_TEST_MAX_BLOCK] __attribute__((aligned(16)));
+static uint8_t dst_buffer[DMA_COPY_TEST_MAX_BLOCK] __attribute__((aligned(16)));
+
+void DMA_copy_test_init() {
+    DWT_init();
+    DMA_copy_init();
+
+    for (uint32_t i = 0; i < DMA_COPY_TEST_MAX_BLOCK; i++) {
+        src_buffer[i] = (uint8_t)(i * 7U + 3U);
+    }
+}
+
+void DMA_copy_test() {
+    DMA_Copy_Handle handle;
+    handle.callback = NULL;
+    handle.context = NULL;
+
+    for (uint32_t i = 0; i < DMA_COPY_TEST_NUM_SIZES; i++) {
+        uint32_t size = block_sizes[i];
+        volatile DMA_Copy_Test_Result* result = &DMA_copy_test_results[i];
+        result->block_size = size;
+
+        uint32_t start = DWT_CYCLES();
+        memcpy(dst_buffer, src_buffer, size);
+        result->cpu_memcpy_cycles = DWT_CYCLES() - start;
+
+        memset(dst_buffer, 0, size);
+        start = DWT_CYCLES();
+        dma_memcpy(dst_buffer, src_buffer, size, &handle);
+        result->dma_submit_cycles = DWT_CYCLES() - start;
+        DMA_copy_wait(&handle);
+        result->dma_memcpy_cycles = DWT_CYCLES() - start;
+        result->verified = (memcmp(dst_buffer, src_buffer, size) == 0);
+
+        start = DWT_CYCLES();
+        memset(dst_buffer, 0xA5, size);
+        result->cpu_memset_cycles = DWT_CYCLES() - start;
+
+        start = DWT_CYCLES();
+        dma_memset(dst_buffer, 0x5A, size, &handle);
+        DMA_copy_wait(&handle);
+        result->dma_memset_cycles = DWT_CYCLES() - start;
+        if (dst_buffer[0] != 0x5A || dst_buffer[size - 1U] != 0x5A) {
+            result->verified = 0;
+        }
+    }
+}
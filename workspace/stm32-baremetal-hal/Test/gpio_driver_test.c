@@ -1,24 +1,125 @@
 /**
- * Source file containing implementation for simple tests for the gpio_driver HAL
- * as of now, they are not automated and don't use a testing framework, just visual inspection
+ * Source file containing the self-checking tests and benchmarks for the gpio_driver HAL
+ * Each test fills a fake port with a known pattern first, so it can check both that the right bits
+ * changed and that nothing else did
  * 
  * Written by Ryan Wong
  */
 
- /*
-Still to test:
-- toggle
-- write port
-- read pin
-- read port
-- lock pins
-- AF capabilities
-*/
-
+ #include <stdint.h>
+ #include <string.h>
  #include "test/gpio_driver_test.h"
+ #include "test/test_runner.h"
  #include "drivers/gpio_driver.h"
 
-void GPIO_test_init() {
+#define GPIO_TEST_PATTERN 0xA5A5A5A5U
+
+static GPIO_Reg_TypeDef fake_port;
+
+static void test_init_output(void);
+static void test_init_af_low(void);
+static void test_init_af_high(void);
+static void test_init_invalid(void);
+static void test_write_pin(void);
+static void test_write_port(void);
+static void test_write_port_masked(void);
+static void test_toggle_pin(void);
+static void test_read_pin(void);
+static void test_read_port(void);
+static void test_lock_pins(void);
+static void test_enable_clock_invalid(void);
+
+void GPIO_run_tests() {
+    TEST_run("gpio_init_output", test_init_output);
+    TEST_run("gpio_init_af_low", test_init_af_low);
+    TEST_run("gpio_init_af_high", test_init_af_high);
+    TEST_run("gpio_init_invalid", test_init_invalid);
+    TEST_run("gpio_write_pin", test_write_pin);
+    TEST_run("gpio_write_port", test_write_port);
+    TEST_run("gpio_write_port_masked", test_write_port_masked);
+    TEST_run("gpio_toggle_pin", test_toggle_pin);
+    TEST_run("gpio_read_pin", test_read_pin);
+    TEST_run("gpio_read_port", test_read_port);
+    TEST_run("gpio_lock_pins", test_lock_pins);
+    TEST_run("gpio_enable_clock_invalid", test_enable_clock_invalid);
+}
+
+void GPIO_run_benchmarks() {
+    GPIO_Init_TypeDef init;
+    init.mode = GPIO_MODE_AF;
+    init.otype = GPIO_OTYPE_PP;
+    init.ospeed = GPIO_OSPEED_HIGH;
+    init.pupd = GPIO_PUPD_NONE;
+    init.afx = GPIO_AF7;
+    init.init_out_state = PIN_RESET;
+    uint16_t port_value;
+    volatile PIN_State pin_value;
+
+    TEST_reset_port(&fake_port, GPIO_TEST_PATTERN);
+    TEST_BENCH("GPIO_init", GPIO_init(&fake_port, GPIO_PIN_9, &init));
+    TEST_BENCH("GPIO_write_pin", GPIO_write_pin(&fake_port, GPIO_PIN_5, PIN_SET));
+    TEST_BENCH("GPIO_write_port", GPIO_write_port(&fake_port, 0x1234U));
+    TEST_BENCH("GPIO_write_port_masked", GPIO_write_port_masked(&fake_port, 0x00F0U, 0x0050U));
+    TEST_BENCH("GPIO_toggle_pin", GPIO_toggle_pin(&fake_port, GPIO_PIN_5));
+    TEST_BENCH("GPIO_read_pin", pin_value = GPIO_read_pin(&fake_port, GPIO_PIN_5));
+    TEST_BENCH("GPIO_read_port", GPIO_read_port(&fake_port, &port_value));
+    (void)pin_value;
+}
+
+static void test_init_output(void) {
+    GPIO_Init_TypeDef init;
+    init.mode = GPIO_MODE_OUTPUT;
+    init.otype = GPIO_OTYPE_OD;
+    init.ospeed = GPIO_OSPEED_FAST;
+    init.pupd = GPIO_PUPD_PU;
+    init.afx = GPIO_AF0;
+    init.init_out_state = PIN_SET;
+
+    TEST_reset_port(&fake_port, GPIO_TEST_PATTERN);
+    TEST_ASSERT_EQUAL(HAL_OK, GPIO_init(&fake_port, GPIO_PIN_5, &init));
+    TEST_ASSERT_EQUAL((GPIO_TEST_PATTERN & ~(0x03U << 10)) | (0x01U << 10), fake_port.MODER);
+    TEST_ASSERT_EQUAL(GPIO_TEST_PATTERN | (0x01U << 5), fake_port.OTYPER);
+    TEST_ASSERT_EQUAL((GPIO_TEST_PATTERN & ~(0x03U << 10)) | (0x02U << 10), fake_port.OSPEEDR);
+    TEST_ASSERT_EQUAL((GPIO_TEST_PATTERN & ~(0x03U << 10)) | (0x01U << 10), fake_port.PUPDR);
+    // AF registers are only touched in AF mode, and the initial state goes out through BSRR
+    TEST_ASSERT_EQUAL(GPIO_TEST_PATTERN, fake_port.AFRL);
+    TEST_ASSERT_EQUAL(0x01U << 5, fake_port.BSRR);
+}
+
+static void test_init_af_low(void) {
+    GPIO_Init_TypeDef init;
+    init.mode = GPIO_MODE_AF;
+    init.otype = GPIO_OTYPE_PP;
+    init.ospeed = GPIO_OSPEED_LOW;
+    init.pupd = GPIO_PUPD_NONE;
+    init.afx = GPIO_AF7;
+    init.init_out_state = PIN_SET;
+
+    TEST_reset_port(&fake_port, GPIO_TEST_PATTERN);
+    TEST_ASSERT_EQUAL(HAL_OK, GPIO_init(&fake_port, GPIO_PIN_2, &init));
+    TEST_ASSERT_EQUAL((GPIO_TEST_PATTERN & ~(0x03U << 4)) | (0x02U << 4), fake_port.MODER);
+    TEST_ASSERT_EQUAL((GPIO_TEST_PATTERN & ~(0x0FU << 8)) | (0x07U << 8), fake_port.AFRL);
+    TEST_ASSERT_EQUAL(GPIO_TEST_PATTERN, fake_port.AFRH);
+    TEST_ASSERT_EQUAL(0, fake_port.BSRR);
+}
+
+static void test_init_af_high(void) {
+    GPIO_Init_TypeDef init;
+    init.mode = GPIO_MODE_AF;
+    init.otype = GPIO_OTYPE_PP;
+    init.ospeed = GPIO_OSPEED_HIGH;
+    init.pupd = GPIO_PUPD_NONE;
+    init.afx = GPIO_AF12;
+    init.init_out_state = PIN_RESET;
+
+    TEST_reset_port(&fake_port, GPIO_TEST_PATTERN);
+    TEST_ASSERT_EQUAL(HAL_OK, GPIO_init(&fake_port, GPIO_PIN_15, &init));
+    TEST_ASSERT_EQUAL((GPIO_TEST_PATTERN & ~(0x0FU << 28)) | (0x0CU << 28), fake_port.AFRH);
+    TEST_ASSERT_EQUAL(GPIO_TEST_PATTERN, fake_port.AFRL);
+    TEST_ASSERT_EQUAL(GPIO_TEST_PATTERN | (0x03U << 30), fake_port.OSPEEDR);
+}
+
+static void test_init_invalid(void) {
     GPIO_Init_TypeDef init;
     init.mode = GPIO_MODE_OUTPUT;
     init.otype = GPIO_OTYPE_PP;
@@ -27,11 +128,90 @@ void GPIO_test_init() {
     init.afx = GPIO_AF0;
     init.init_out_state = PIN_RESET;
 
-    GPIO_enable_clock(GPIOA);
-    GPIO_init(GPIOA, GPIO_PIN_5, &init);
+    TEST_reset_port(&fake_port, GPIO_TEST_PATTERN);
+    TEST_ASSERT_EQUAL(HAL_ERROR, GPIO_init(NULL, GPIO_PIN_0, &init));
+    TEST_ASSERT_EQUAL(HAL_ERROR, GPIO_init(&fake_port, (GPIO_Pin)16, &init));
+    init.mode = (GPIO_Mode)4;
+    TEST_ASSERT_EQUAL(HAL_ERROR, GPIO_init(&fake_port, GPIO_PIN_0, &init));
+    init.mode = GPIO_MODE_OUTPUT;
+    init.pupd = (GPIO_Pupd)3;
+    TEST_ASSERT_EQUAL(HAL_ERROR, GPIO_init(&fake_port, GPIO_PIN_0, &init));
+
+    // Rejected before anything is written
+    TEST_ASSERT_EQUAL(GPIO_TEST_PATTERN, fake_port.MODER);
+    TEST_ASSERT_EQUAL(GPIO_TEST_PATTERN, fake_port.PUPDR);
+}
+
+static void test_write_pin(void) {
+    TEST_reset_port(&fake_port, GPIO_TEST_PATTERN);
+    TEST_ASSERT_EQUAL(HAL_OK, GPIO_write_pin(&fake_port, GPIO_PIN_0, PIN_SET));
+    TEST_ASSERT_EQUAL(0x01U, fake_port.BSRR);
+    TEST_ASSERT_EQUAL(HAL_OK, GPIO_write_pin(&fake_port, GPIO_PIN_15, PIN_RESET));
+    TEST_ASSERT_EQUAL(0x01U << 31, fake_port.BSRR);
+    TEST_ASSERT_EQUAL(HAL_ERROR, GPIO_write_pin(&fake_port, GPIO_PIN_1, (PIN_State)2));
+    TEST_ASSERT_EQUAL(HAL_ERROR, GPIO_write_pin(NULL, GPIO_PIN_1, PIN_SET));
+    // ODR is never read-modify-written
+    TEST_ASSERT_EQUAL(0, fake_port.ODR);
+}
+
+static void test_write_port(void) {
+    TEST_reset_port(&fake_port, GPIO_TEST_PATTERN);
+    TEST_ASSERT_EQUAL(HAL_OK, GPIO_write_port(&fake_port, 0x8421U));
+    TEST_ASSERT_EQUAL(0x8421U | ((uint32_t)0x7BDEU << 16), fake_port.BSRR);
+    TEST_ASSERT_EQUAL(HAL_ERROR, GPIO_write_port(NULL, 0));
+}
+
+static void test_write_port_masked(void) {
+    TEST_reset_port(&fake_port, GPIO_TEST_PATTERN);
+    TEST_ASSERT_EQUAL(HAL_OK, GPIO_write_port_masked(&fake_port, 0x00F0U, 0xFF50U));
+    TEST_ASSERT_EQUAL(0x0050U | ((uint32_t)0x00A0U << 16), fake_port.BSRR);
+    TEST_ASSERT_EQUAL(HAL_OK, GPIO_write_port_masked(&fake_port, 0, 0xFFFFU));
+    TEST_ASSERT_EQUAL(0, fake_port.BSRR);
+}
+
+static void test_toggle_pin(void) {
+    TEST_reset_port(&fake_port, GPIO_TEST_PATTERN);
+    fake_port.ODR = 0x01U << 3;
+    TEST_ASSERT_EQUAL(HAL_OK, GPIO_toggle_pin(&fake_port, GPIO_PIN_3));
+    TEST_ASSERT_EQUAL(0x01U << 19, fake_port.BSRR);
+    TEST_ASSERT_EQUAL(HAL_OK, GPIO_toggle_pin(&fake_port, GPIO_PIN_4));
+    TEST_ASSERT_EQUAL(0x01U << 4, fake_port.BSRR);
+    TEST_ASSERT_EQUAL(HAL_ERROR, GPIO_toggle_pin(&fake_port, (GPIO_Pin)16));
 }
 
-void GPIO_test() {
-    GPIO_write_pin(GPIOA, GPIO_PIN_5, PIN_SET);
-    // delay (not implemented yet)
-}
\ No newline at end of file
+static void test_read_pin(void) {
+    TEST_reset_port(&fake_port, GPIO_TEST_PATTERN);
+    fake_port.IDR = 0x8001U;
+    TEST_ASSERT_EQUAL(PIN_SET, GPIO_read_pin(&fake_port, GPIO_PIN_0));
+    TEST_ASSERT_EQUAL(PIN_SET, GPIO_read_pin(&fake_port, GPIO_PIN_15));
+    TEST_ASSERT_EQUAL(PIN_RESET, GPIO_read_pin(&fake_port, GPIO_PIN_7));
+    TEST_ASSERT_EQUAL((uint32_t)-1, GPIO_read_pin(NULL, GPIO_PIN_0));
+    TEST_ASSERT_EQUAL((uint32_t)-1, GPIO_read_pin(&fake_port, (GPIO_Pin)16));
+}
+
+static void test_read_port(void) {
+    uint16_t value = 0;
+
+    TEST_reset_port(&fake_port, GPIO_TEST_PATTERN);
+    fake_port.IDR = 0xFFFF1234U;
+    TEST_ASSERT_EQUAL(HAL_OK, GPIO_read_port(&fake_port, &value));
+    TEST_ASSERT_EQUAL(0x1234U, value);
+    TEST_ASSERT_EQUAL(HAL_ERROR, GPIO_read_port(&fake_port, NULL));
+}
+
+/**
+ * A RAM register keeps whatever was last written, so LCKK reads back as 1 after the key sequence
+ * just like a successfully locked port. The second call must then see the port as already locked
+ */
+static void test_lock_pins(void) {
+    TEST_reset_port(&fake_port, GPIO_TEST_PATTERN);
+    TEST_ASSERT_EQUAL(HAL_OK, GPIO_lock_pins(&fake_port, 0x0811U));
+    TEST_ASSERT_EQUAL((0x01U << 16) | 0x0811U, fake_port.LCKR);
+    TEST_ASSERT_EQUAL(HAL_ERROR, GPIO_lock_pins(&fake_port, 0x0001U));
+    TEST_ASSERT_EQUAL((0x01U << 16) | 0x0811U, fake_port.LCKR);
+}
+
+static void test_enable_clock_invalid(void) {
+    TEST_ASSERT_EQUAL(HAL_ERROR, GPIO_enable_clock(&fake_port));
+    TEST_ASSERT_EQUAL(HAL_ERROR, GPIO_enable_clock((GPIO_Reg_TypeDef*)(GPIO_BASE + 0x2000U)));
+}
@@ -0,0 +1,58 @@
+/**
+ * Source file containing implementation for simple tests for the input_scanner
+ * as of now, they are not automated and don't use a testing framework, just visual inspection
+ *
+ * TIM6 ticks every 1ms and debounces the whole of port C, watching the Nucleo user button (PC13, active low).
+ * SCAN_test_presses / SCAN_test_releases (watch them with live expressions) should go up by exactly
+ * one per press/release, no matter how much the button bounces. PC13 is set up by the board pin map
+ * (utils/board.h), so BOARD_apply() has to run first
+ * 
+ * Written by Ryan Wong
+ */
+
+ /*
+Still to test:
+- matrix keypad scanning (needs a keypad on the row/column pins)
+*/
+
+#include <stdint.h>
+#include "test/input_scanner_test.h"
+#include "drivers/input_scanner.h"
+#include "drivers/gpio_driver.h"
+#include "drivers/timer_driver.h"
+#include "drivers/nvic_driver.h"
+
+#define SCAN_TEST_BUTTON_MASK (0x01U << GPIO_PIN_13)
+
+volatile uint32_t SCAN_test_presses = 0;
+volatile uint32_t SCAN_test_releases = 0;
+
+static SCAN_Port button_scan;
+
+void TIM6_DAC_IRQHandler(void) {
+    TIM_clear_update_flag(TIM6);
+    SCAN_port_tick(&button_scan);
+}
+
+void SCAN_test_init() {
+    SCAN_port_init(&button_scan, GPIOC, SCAN_TEST_BUTTON_MASK, SCAN_TEST_BUTTON_MASK);
+
+    TIM_Init_TypeDef tim_init;
+    tim_init.frequency = 1000;
+    tim_init.count_mode = TIM_COUNT_UP;
+
+    TIM_enable_clock(TIM6);
+    TIM_init(TIM6, &tim_init);
+    TIM_enable_update_irq(TIM6);
+    NVIC_enable_irq(NVIC_IRQ_TIM6_DAC);
+    TIM_start(TIM6);
+}
+
+void SCAN_test() {
+    uint16_t pressed;
+    uint16_t released;
+    SCAN_get_events(&button_scan.lane, &pressed, &released);
+
+    if (pressed & SCAN_TEST_BUTTON_MASK) SCAN_test_presses++;
+    if (released & SCAN_TEST_BUTTON_MASK) SCAN_test_releases++;
+}
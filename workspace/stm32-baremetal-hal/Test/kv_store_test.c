@@ -0,0 +1,58 @@
+/**
+ * Source file containing tests for the flash driver and kv_store
+ * Mounts the store in flash sectors 2-3, bumps a boot counter and writes a small calibration record,
+ * then reads both back. KV_test() runs the background compaction from the main loop
+ * 
+ * Written by Ryan Wong
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include "test/kv_store_test.h"
+#include "utils/kv_store.h"
+#include "drivers/dwt_driver.h"
+
+#define KV_TEST_KEY_BOOT_COUNT 0x0001U
+#define KV_TEST_KEY_CALIBRATION 0x0002U
+
+volatile uint32_t KV_test_boot_count = 0;
+volatile uint32_t KV_test_mount_cycles = 0;
+volatile uint32_t KV_test_set_cycles = 0;
+volatile uint32_t KV_test_get_cycles = 0;
+volatile uint8_t KV_test_passed = 0;
+
+void KV_test_init() {
+    DWT_init();
+
+    uint32_t start = DWT_CYCLES();
+    if (KV_init(&KV_flash_ops) != HAL_OK) return;
+    KV_test_mount_cycles = DWT_CYCLES() - start;
+
+    uint32_t boot_count = 0;
+    KV_get(KV_TEST_KEY_BOOT_COUNT, &boot_count, sizeof(boot_count));
+    boot_count++;
+
+    start = DWT_CYCLES();
+    HAL_Status status = KV_set(KV_TEST_KEY_BOOT_COUNT, &boot_count, sizeof(boot_count));
+    KV_test_set_cycles = DWT_CYCLES() - start;
+
+    const float calibration[3] = {1.0f, -0.25f, (float)boot_count};
+    if (KV_set(KV_TEST_KEY_CALIBRATION, calibration, sizeof(calibration)) != HAL_OK) status = HAL_ERROR;
+
+    uint32_t read_back = 0;
+    start = DWT_CYCLES();
+    int32_t len = KV_get(KV_TEST_KEY_BOOT_COUNT, &read_back, sizeof(read_back));
+    KV_test_get_cycles = DWT_CYCLES() - start;
+
+    float calibration_read[3];
+    KV_test_passed = status == HAL_OK &&
+                     len == (int32_t)sizeof(read_back) &&
+                     read_back == boot_count &&
+                     KV_get(KV_TEST_KEY_CALIBRATION, calibration_read, sizeof(calibration_read)) == (int32_t)sizeof(calibration) &&
+                     memcmp(calibration_read, calibration, sizeof(calibration)) == 0;
+    KV_test_boot_count = boot_count;
+}
+
+void KV_test() {
+    KV_service(1);
+}
@@ -0,0 +1,119 @@
+/**
+ * Source file containing the self-checking tests for mem_stats
+ * Checks the stack watermark and heap tracking respond to real stack and heap use, then reports the RAM
+ * numbers as metrics so tools/ram_report.py can put them next to the linker's reservations
+ * 
+ * Written by Ryan Wong
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "test/mem_stats_test.h"
+#include "test/test_runner.h"
+#include "utils/mem_stats.h"
+
+#define MEM_TEST_STACK_DEPTH 1024U
+#define MEM_TEST_ALLOC_SIZE 256U
+#define MEM_TEST_HUGE_ALLOC 0x40000U // more than all of SRAM
+
+extern uint32_t _estack; // linker script symbol, only its address means anything
+
+static void use_stack(uint32_t bytes) __attribute__((noinline));
+static void test_stack_painted(void);
+static void test_stack_high_water_tracks_depth(void);
+static void test_heap_high_water(void);
+static void test_sbrk_failure_counted(void);
+static void record_metrics(void);
+
+void MEM_run_tests() {
+    TEST_run("mem_stack_painted", test_stack_painted);
+    TEST_run("mem_stack_high_water_tracks_depth", test_stack_high_water_tracks_depth);
+    TEST_run("mem_heap_high_water", test_heap_high_water);
+    TEST_run("mem_sbrk_failure_counted", test_sbrk_failure_counted);
+    record_metrics();
+}
+
+// HELPER FUNCTIONS ==============================================================
+/**
+ * Writes every byte of a bytes long local buffer, so the whole frame loses its paint
+ */
+static void use_stack(uint32_t bytes) {
+    volatile uint8_t buffer[bytes];
+    for (uint32_t i = 0; i < bytes; i++) {
+        buffer[i] = (uint8_t)i;
+    }
+    (void)buffer;
+}
+
+static void test_stack_painted(void) {
+    MEM_Stats stats;
+    MEM_get_stats(&stats);
+
+    TEST_ASSERT(stats.unused_bytes > 0U);
+    TEST_ASSERT(stats.stack_current > 0U);
+    TEST_ASSERT(stats.stack_high_water >= stats.stack_current);
+    TEST_ASSERT_EQUAL(stats.stack_high_water, MEM_stack_high_water());
+}
+
+/**
+ * Whatever ran before may already have gone deeper than this frame, so the buffer is sized from a local here
+ * to reach MEM_TEST_STACK_DEPTH past the current mark, and the mark has to move by at least that much
+ */
+static void test_stack_high_water_tracks_depth(void) {
+    MEM_Stats stats;
+    MEM_get_stats(&stats);
+    if (stats.unused_bytes < 2U * MEM_TEST_STACK_DEPTH) {
+        TEST_skip("not enough untouched RAM below the stack");
+        return;
+    }
+
+    volatile uint32_t here = 0;
+    uint32_t depth = (uint32_t)&_estack - (uint32_t)&here;
+    uint32_t before = MEM_stack_high_water();
+
+    use_stack(MEM_TEST_STACK_DEPTH + ((before > depth) ? before - depth : 0U));
+    TEST_ASSERT(MEM_stack_high_water() >= before + MEM_TEST_STACK_DEPTH);
+}
+
+static void test_heap_high_water(void) {
+    MEM_Stats before;
+    MEM_Stats after;
+    MEM_get_stats(&before);
+
+    void* block = malloc(MEM_TEST_ALLOC_SIZE);
+    TEST_ASSERT(block != NULL);
+    MEM_get_stats(&after);
+    TEST_ASSERT(after.heap_high_water >= MEM_TEST_ALLOC_SIZE);
+    TEST_ASSERT(after.heap_in_use >= before.heap_in_use + MEM_TEST_ALLOC_SIZE);
+    // The heap grew out of painted RAM, so the untouched gap has to shrink with it
+    TEST_ASSERT(after.unused_bytes <= before.unused_bytes - (after.heap_high_water - before.heap_high_water));
+
+    free(block);
+    MEM_get_stats(&after);
+    TEST_ASSERT_EQUAL(before.heap_in_use, after.heap_in_use);
+}
+
+static void test_sbrk_failure_counted(void) {
+    MEM_Stats before;
+    MEM_Stats after;
+    MEM_get_stats(&before);
+
+    void* block = malloc(MEM_TEST_HUGE_ALLOC);
+    TEST_ASSERT(block == NULL);
+    free(block);
+
+    MEM_get_stats(&after);
+    TEST_ASSERT(after.sbrk_failures > before.sbrk_failures);
+    TEST_ASSERT(after.largest_failed_request >= MEM_TEST_HUGE_ALLOC);
+}
+
+static void record_metrics(void) {
+    MEM_Stats stats;
+    MEM_get_stats(&stats);
+
+    TEST_record_metric("ram_data_bytes", stats.data_bytes);
+    TEST_record_metric("ram_bss_bytes", stats.bss_bytes);
+    TEST_record_metric("heap_high_water", stats.heap_high_water);
+    TEST_record_metric("stack_high_water", stats.stack_high_water);
+    TEST_record_metric("ram_unused_bytes", stats.unused_bytes);
+}
@@ -0,0 +1,149 @@
+/**
+ * Source file containing tests for the QUADSPI driver and qspi_flash
+ * Erases and programs a scratch 64KB block at the end of the flash, checks it through the memory mapped window
+ * and indirect reads, then times sequential and random reads from the window against the same reads from
+ * internal flash. Runs at whatever clock comes out of reset (HCLK on HSI, 16MHz flash clock)
+ * 
+ * Written by Ryan Wong
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include "test/qspi_flash_test.h"
+#include "utils/qspi_flash.h"
+#include "drivers/dwt_driver.h"
+
+#define QSPI_TEST_BYTES QSPI_FLASH_BLOCK_SIZE
+#define QSPI_TEST_CHUNK 4096U
+#define QSPI_TEST_RANDOM_READS 4096U
+#define QSPI_TEST_INTERNAL_BASE 0x08010000U // start of the FLASH region in the linker script
+#define QSPI_TEST_XIP_MAGIC 0x51535049U // "QSPI"
+
+volatile uint8_t QSPI_test_init_ok = 0;
+volatile uint32_t QSPI_test_id = 0;
+volatile uint32_t QSPI_test_size = 0;
+volatile uint32_t QSPI_test_mapped_kbps = 0;
+volatile uint32_t QSPI_test_internal_kbps = 0;
+volatile uint32_t QSPI_test_indirect_kbps = 0;
+volatile uint32_t QSPI_test_mapped_random_cycles = 0;
+volatile uint32_t QSPI_test_internal_random_cycles = 0;
+volatile uint8_t QSPI_test_passed = 0;
+volatile uint8_t QSPI_test_xip_ok = 0;
+
+static uint32_t buffer[QSPI_TEST_CHUNK / 4U];
+
+#ifdef QSPI_XIP_DEMO
+// Placed in the QSPI region, only readable once the .qspi image has been programmed (see utils/qspi_flash.h)
+static const uint32_t xip_table[4] QSPI_CONST = {QSPI_TEST_XIP_MAGIC, 1U, 2U, 3U};
+static uint32_t xip_sum(const uint32_t* table, uint32_t len) QSPI_CODE;
+#endif
+
+static uint32_t pattern(uint32_t index);
+static void fill_pattern(uint32_t* words, uint32_t offset);
+static uint32_t copy_kbps(uint32_t base);
+static uint32_t random_cycles(uint32_t base);
+
+void QSPI_test_init() {
+    DWT_init();
+
+    if (QSPI_flash_init(QSPI_FLASH_MAX_CLOCK) != HAL_OK) return;
+    QSPI_test_id = QSPI_flash_id();
+    QSPI_test_size = QSPI_flash_size();
+    QSPI_test_init_ok = 1;
+}
+
+void QSPI_test() {
+    if (!QSPI_test_init_ok) return;
+
+    // Leave the linked image alone if it reaches the scratch block
+    const uint32_t scratch = QSPI_test_size - QSPI_TEST_BYTES;
+    if (QSPI_MEMORY_BASE + scratch < (uint32_t)_qspi_end) return;
+
+    if (QSPI_flash_erase(scratch, QSPI_TEST_BYTES) != HAL_OK) return;
+    for (uint32_t done = 0; done < QSPI_TEST_BYTES; done += QSPI_TEST_CHUNK) {
+        fill_pattern(buffer, done);
+        if (QSPI_flash_write(scratch + done, buffer, QSPI_TEST_CHUNK) != HAL_OK) return;
+    }
+
+    // QSPI_flash_write() mapped the flash again, check through the window
+    const volatile uint32_t* mapped = (const volatile uint32_t*)(QSPI_MEMORY_BASE + scratch);
+    for (uint32_t done = 0; done < QSPI_TEST_BYTES; done += QSPI_TEST_CHUNK) {
+        for (uint32_t i = 0; i < QSPI_TEST_CHUNK / 4U; i++) {
+            if (mapped[done / 4U + i] != pattern(done / 4U + i)) return;
+        }
+    }
+
+    // Indirect reads, timed, checked against the pattern afterwards
+    uint32_t indirect_cycles = 0;
+    for (uint32_t done = 0; done < QSPI_TEST_BYTES; done += QSPI_TEST_CHUNK) {
+        uint32_t start = DWT_CYCLES();
+        if (QSPI_flash_read(scratch + done, buffer, QSPI_TEST_CHUNK) != HAL_OK) return;
+        indirect_cycles += DWT_CYCLES() - start;
+
+        for (uint32_t i = 0; i < QSPI_TEST_CHUNK / 4U; i++) {
+            if (buffer[i] != pattern(done / 4U + i)) return;
+        }
+    }
+    QSPI_test_indirect_kbps = DWT_to_kbps(QSPI_TEST_BYTES, indirect_cycles);
+
+    QSPI_test_mapped_kbps = copy_kbps(QSPI_MEMORY_BASE + scratch);
+    QSPI_test_internal_kbps = copy_kbps(QSPI_TEST_INTERNAL_BASE);
+    QSPI_test_mapped_random_cycles = random_cycles(QSPI_MEMORY_BASE + scratch);
+    QSPI_test_internal_random_cycles = random_cycles(QSPI_TEST_INTERNAL_BASE);
+    QSPI_test_passed = 1;
+
+#ifdef QSPI_XIP_DEMO
+    // Read through volatile so the compiler can't fold the check: an unprogrammed flash reads 0xFFFFFFFF
+    if (*(const volatile uint32_t*)&xip_table[0] == QSPI_TEST_XIP_MAGIC) {
+        QSPI_test_xip_ok = xip_sum(xip_table, 4U) == QSPI_TEST_XIP_MAGIC + 6U;
+    }
+#endif
+}
+
+#ifdef QSPI_XIP_DEMO
+/**
+ * Runs from the mapped window, an example of cold code that doesn't need to take up internal flash
+ */
+static uint32_t xip_sum(const uint32_t* table, uint32_t len) {
+    uint32_t sum = 0;
+    for (uint32_t i = 0; i < len; i++) sum += table[i];
+    return sum;
+}
+#endif
+
+static uint32_t pattern(uint32_t index) {
+    return (index * 0x9E3779B1U) ^ index;
+}
+
+static void fill_pattern(uint32_t* words, uint32_t offset) {
+    for (uint32_t i = 0; i < QSPI_TEST_CHUNK / 4U; i++) {
+        words[i] = pattern(offset / 4U + i);
+    }
+}
+
+static uint32_t copy_kbps(uint32_t base) {
+    uint32_t start = DWT_CYCLES();
+    for (uint32_t done = 0; done < QSPI_TEST_BYTES; done += QSPI_TEST_CHUNK) {
+        memcpy(buffer, (const void*)(base + done), QSPI_TEST_CHUNK);
+    }
+    return DWT_to_kbps(QSPI_TEST_BYTES, DWT_CYCLES() - start);
+}
+
+/**
+ * Word reads at xorshift addresses: every one breaks the prefetch, so on the QSPI each pays for a whole
+ * 0xEB command (instruction, address, mode byte, dummy cycles)
+ */
+static uint32_t random_cycles(uint32_t base) {
+    uint32_t x = 0x2545F491U;
+    uint32_t sink = 0;
+    uint32_t start = DWT_CYCLES();
+    for (uint32_t i = 0; i < QSPI_TEST_RANDOM_READS; i++) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        sink += *(const volatile uint32_t*)(base + ((x % QSPI_TEST_BYTES) & ~0x03U));
+    }
+    uint32_t cycles = DWT_CYCLES() - start;
+    (void)sink;
+    return cycles / QSPI_TEST_RANDOM_READS;
+}
@@ -0,0 +1,150 @@
+/**
+ * Source file containing the self-checking tests and benchmarks for the rcc_driver HAL
+ * The limit checks only depend on HCLK_frequency, so they pretend HCLK is 180MHz without touching the clock tree.
+ * The frequency tracking tests need RCC_CFGR to hold what's written to it, and skip themselves where it doesn't
+ * (QEMU's STM32F4 machines don't model the RCC)
+ * 
+ * Written by Ryan Wong
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "test/rcc_driver_test.h"
+#include "test/test_runner.h"
+#include "drivers/rcc_driver.h"
+
+#define RCC_TEST_MAX_HCLK 180000000U
+
+static uint8_t cfgr_is_modelled(void);
+static void restore_clocks(void);
+static void test_prescaler_invalid(void);
+static void test_apb1_limit(void);
+static void test_apb2_limit(void);
+static void test_hclk_tracks_ahb_prescaler(void);
+static void test_apb_timer_clock(void);
+static void test_pll_invalid(void);
+
+void RCC_run_tests() {
+    TEST_run("rcc_prescaler_invalid", test_prescaler_invalid);
+    TEST_run("rcc_apb1_limit", test_apb1_limit);
+    TEST_run("rcc_apb2_limit", test_apb2_limit);
+    TEST_run("rcc_hclk_tracks_ahb_prescaler", test_hclk_tracks_ahb_prescaler);
+    TEST_run("rcc_apb_timer_clock", test_apb_timer_clock);
+    TEST_run("rcc_pll_invalid", test_pll_invalid);
+}
+
+void RCC_run_benchmarks() {
+    volatile uint32_t clock;
+
+    TEST_BENCH("update_hclk", update_hclk());
+    TEST_BENCH("RCC_get_APB1_timer_clock", clock = RCC_get_APB1_timer_clock());
+    TEST_BENCH("RCC_set_APB2_prescaler", RCC_set_APB2_prescaler(RCC_APB_DIV_1));
+    TEST_BENCH("RCC_set_AHB_prescaler", RCC_set_AHB_prescaler(RCC_AHB_DIV_1));
+    (void)clock;
+}
+
+// HELPER FUNCTIONS ==============================================================
+static uint8_t cfgr_is_modelled(void) {
+    uint32_t before = RCC_CFGR;
+    RCC_set_APB2_prescaler(RCC_APB_DIV_2);
+    uint8_t modelled = ((RCC_CFGR >> 13) & 0x07U) == RCC_APB_DIV_2;
+    RCC_CFGR = before;
+    update_hclk();
+    return modelled;
+}
+
+static void restore_clocks(void) {
+    RCC_set_AHB_prescaler(RCC_AHB_DIV_1);
+    RCC_set_APB1_prescaler(RCC_APB_DIV_1);
+    RCC_set_APB2_prescaler(RCC_APB_DIV_1);
+    update_hclk();
+}
+
+static void test_prescaler_invalid(void) {
+    uint32_t before = RCC_CFGR;
+    TEST_ASSERT_EQUAL(HAL_ERROR, RCC_set_AHB_prescaler((RCC_AHB_Prescaler)0x10U));
+    TEST_ASSERT_EQUAL(HAL_ERROR, RCC_set_APB1_prescaler((RCC_APB_Prescaler)0x08U));
+    TEST_ASSERT_EQUAL(HAL_ERROR, RCC_set_APB2_prescaler((RCC_APB_Prescaler)0x08U));
+    TEST_ASSERT_EQUAL(before, RCC_CFGR);
+}
+
+/**
+ * PCLK1 can't go over 45MHz, so at 180MHz the smallest allowed divider is 4
+ */
+static void test_apb1_limit(void) {
+    uint32_t before = RCC_CFGR;
+    HCLK_frequency = RCC_TEST_MAX_HCLK;
+    TEST_ASSERT_EQUAL(HAL_ERROR, RCC_set_APB1_prescaler(RCC_APB_DIV_1));
+    TEST_ASSERT_EQUAL(HAL_ERROR, RCC_set_APB1_prescaler(RCC_APB_DIV_2));
+    TEST_ASSERT_EQUAL(before, RCC_CFGR);
+    TEST_ASSERT_EQUAL(HAL_OK, RCC_set_APB1_prescaler(RCC_APB_DIV_4));
+    restore_clocks();
+}
+
+static void test_apb2_limit(void) {
+    uint32_t before = RCC_CFGR;
+    HCLK_frequency = RCC_TEST_MAX_HCLK;
+    TEST_ASSERT_EQUAL(HAL_ERROR, RCC_set_APB2_prescaler(RCC_APB_DIV_1));
+    TEST_ASSERT_EQUAL(before, RCC_CFGR);
+    TEST_ASSERT_EQUAL(HAL_OK, RCC_set_APB2_prescaler(RCC_APB_DIV_2));
+    restore_clocks();
+}
+
+static void test_hclk_tracks_ahb_prescaler(void) {
+    if (!cfgr_is_modelled()) {
+        TEST_skip("RCC_CFGR not modelled");
+        return;
+    }
+
+    TEST_ASSERT_EQUAL(HAL_OK, RCC_set_AHB_prescaler(RCC_AHB_DIV_4));
+    TEST_ASSERT_EQUAL(HSI_FREQ / 4U, HCLK_frequency);
+    TEST_ASSERT_EQUAL(HSI_FREQ / 4U, PCLK1_frequency);
+    TEST_ASSERT_EQUAL(HSI_FREQ / 4U, PCLK2_frequency);
+    TEST_ASSERT_EQUAL(HAL_OK, RCC_set_AHB_prescaler(RCC_AHB_DIV_64));
+    TEST_ASSERT_EQUAL(HSI_FREQ / 64U, HCLK_frequency);
+    restore_clocks();
+    TEST_ASSERT_EQUAL(HSI_FREQ, HCLK_frequency);
+}
+
+/**
+ * Timers get 2x PCLK whenever their APB prescaler isn't 1
+ */
+static void test_apb_timer_clock(void) {
+    if (!cfgr_is_modelled()) {
+        TEST_skip("RCC_CFGR not modelled");
+        return;
+    }
+
+    TEST_ASSERT_EQUAL(HSI_FREQ, RCC_get_APB1_timer_clock());
+    TEST_ASSERT_EQUAL(HAL_OK, RCC_set_APB1_prescaler(RCC_APB_DIV_2));
+    TEST_ASSERT_EQUAL(HSI_FREQ / 2U, PCLK1_frequency);
+    TEST_ASSERT_EQUAL(HSI_FREQ, RCC_get_APB1_timer_clock());
+    TEST_ASSERT_EQUAL(HAL_OK, RCC_set_APB2_prescaler(RCC_APB_DIV_8));
+    TEST_ASSERT_EQUAL(HSI_FREQ / 8U, PCLK2_frequency);
+    TEST_ASSERT_EQUAL(HSI_FREQ / 4U, RCC_get_APB2_timer_clock());
+    restore_clocks();
+}
+
+/**
+ * Each config breaks one limit, and none of them may touch the PLL
+ */
+static void test_pll_invalid(void) {
+    const RCC_PLL_Config invalid[] = {
+        {.m = 4, .n = 96, .p = 4, .q = 4},    // VCO input 4MHz
+        {.m = 16, .n = 50, .p = 2, .q = 2},   // VCO 50MHz
+        {.m = 8, .n = 240, .p = 2, .q = 10},  // P 240MHz
+        {.m = 8, .n = 192, .p = 3, .q = 8},   // odd P
+        {.m = 8, .n = 192, .p = 4, .q = 7},   // Q 54.9MHz
+        {.m = 8, .n = 192, .p = 4, .q = 1},   // Q too small
+        {.m = 8, .n = 433, .p = 8, .q = 15}   // N too big
+    };
+    uint32_t cr = RCC_CR;
+    uint32_t pllcfgr = RCC_PLLCFGR;
+
+    TEST_ASSERT_EQUAL(HAL_ERROR, RCC_enable_PLL(NULL));
+    for (uint32_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++) {
+        TEST_ASSERT_EQUAL(HAL_ERROR, RCC_enable_PLL(&invalid[i]));
+    }
+    TEST_ASSERT_EQUAL(cr, RCC_CR);
+    TEST_ASSERT_EQUAL(pllcfgr, RCC_PLLCFGR);
+}
@@ -0,0 +1,86 @@
+/**
+ * Source file containing tests for the SDIO driver and sd_card
+ * Runs the card at whatever SDIOCLK straight out of reset gives (SYSCLK on HSI, 16MHz on 4 lines), streams
+ * SD_TEST_BYTES through two 16KB buffers the same way a data logger would (fill one while the other is being
+ * written), then reads it all back to check it and time the reads
+ * 
+ * Written by Ryan Wong
+ */
+
+#include <stdint.h>
+#include "test/sd_card_test.h"
+#include "drivers/sdio_driver.h"
+#include "drivers/rcc_driver.h"
+#include "drivers/dwt_driver.h"
+
+#define SD_TEST_BYTES (4U * 1024U * 1024U)
+#define SD_TEST_BUFFER_BLOCKS 32U
+#define SD_TEST_BUFFER_WORDS (SD_TEST_BUFFER_BLOCKS * SD_BLOCK_SIZE / 4U)
+
+volatile uint8_t SD_test_init_ok = 0;
+SD_Card_Info SD_test_info;
+volatile uint32_t SD_test_write_kbps = 0;
+volatile uint32_t SD_test_read_kbps = 0;
+volatile uint8_t SD_test_passed = 0;
+
+// 16 byte aligned so the DMA can use 4 word bursts on the memory side
+static uint32_t buffers[2][SD_TEST_BUFFER_WORDS] __attribute__((aligned(16)));
+
+static void fill_pattern(uint32_t* buffer, uint32_t first_block);
+
+void SD_test_init() {
+    DWT_init();
+
+    SDIO_Init_TypeDef sdio = {
+        .clock_source = SDIO_CLOCK_SYSCLK,
+        .clock_frequency = HSI_FREQ
+    };
+    if (SDIO_init(&sdio) != HAL_OK) return;
+    if (SD_init(&SD_sdio_ops) != HAL_OK) return;
+    if (SD_get_info(&SD_test_info) != HAL_OK) return;
+    SD_test_init_ok = 1;
+}
+
+void SD_test() {
+    if (!SD_test_init_ok) return;
+
+    const uint32_t total_blocks = SD_TEST_BYTES / SD_BLOCK_SIZE;
+    const uint32_t first_block = SD_test_info.block_count / 2U;
+    if (SD_test_info.block_count < total_blocks * 2U) return;
+
+    // Buffer i % 2 can be refilled once at most one buffer (the other one) is still queued
+    uint32_t start = DWT_CYCLES();
+    if (SD_stream_begin(first_block, total_blocks) != HAL_OK) return;
+    HAL_Status status = HAL_OK;
+    for (uint32_t done = 0, i = 0; done < total_blocks && status == HAL_OK; done += SD_TEST_BUFFER_BLOCKS, i++) {
+        while (SD_stream_pending() > 1U);
+        fill_pattern(buffers[i % 2U], first_block + done);
+        status = SD_stream_write(buffers[i % 2U], SD_TEST_BUFFER_BLOCKS);
+    }
+    if (SD_stream_end() != HAL_OK || status != HAL_OK) return;
+    SD_test_write_kbps = DWT_to_kbps(SD_TEST_BYTES, DWT_CYCLES() - start);
+
+    // Read back into one buffer, checking against the other
+    uint32_t read_cycles = 0;
+    for (uint32_t done = 0; done < total_blocks; done += SD_TEST_BUFFER_BLOCKS) {
+        start = DWT_CYCLES();
+        if (SD_read_blocks(first_block + done, buffers[0], SD_TEST_BUFFER_BLOCKS) != HAL_OK) return;
+        read_cycles += DWT_CYCLES() - start;
+
+        fill_pattern(buffers[1], first_block + done);
+        for (uint32_t i = 0; i < SD_TEST_BUFFER_WORDS; i++) {
+            if (buffers[0][i] != buffers[1][i]) return;
+        }
+    }
+    SD_test_read_kbps = DWT_to_kbps(SD_TEST_BYTES, read_cycles);
+    SD_test_passed = 1;
+}
+
+/**
+ * Every word different and tied to its block, so a dropped, repeated or misplaced block shows up
+ */
+static void fill_pattern(uint32_t* buffer, uint32_t first_block) {
+    for (uint32_t i = 0; i < SD_TEST_BUFFER_WORDS; i++) {
+        buffer[i] = ((first_block + i / (SD_BLOCK_SIZE / 4U)) << 8) ^ ((i % (SD_BLOCK_SIZE / 4U)) * 0x9E3779B1U);
+    }
+}
@@ -0,0 +1,228 @@
+/**
+ * Source file containing the self-checking test and benchmark runner
+ * Semihosting calls are a BKPT 0xAB with the operation in r0 and a pointer to its arguments in r1,
+ * which the debugger (or QEMU with -semihosting-config enable=on) services on the host
+ * 
+ * Written by Ryan Wong
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "test/test_runner.h"
+
+#define SYST_CSR (*(volatile uint32_t*)0xE000E010U)
+#define SYST_RVR (*(volatile uint32_t*)0xE000E014U)
+#define SYST_CVR (*(volatile uint32_t*)0xE000E018U)
+#define SYST_MASK 0x00FFFFFFU
+
+#define SEMIHOST_SYS_OPEN 0x01U
+#define SEMIHOST_SYS_CLOSE 0x02U
+#define SEMIHOST_SYS_WRITE0 0x04U
+#define SEMIHOST_SYS_WRITE 0x05U
+#define SEMIHOST_SYS_EXIT 0x18U
+#define SEMIHOST_MODE_W 4U
+#define SEMIHOST_EXIT_SUCCESS 0x20026U // ADP_Stopped_ApplicationExit
+#define SEMIHOST_EXIT_FAILURE 0x20023U // ADP_Stopped_RunTimeErrorUnknown
+
+typedef enum {
+    TEST_STATE_PASS = 0x00U,
+    TEST_STATE_FAIL = 0x01U,
+    TEST_STATE_SKIP = 0x02U
+} TEST_State;
+
+volatile TEST_Summary TEST_summary;
+
+static TEST_State current_state;
+static char line_buffer[256];
+static uint32_t loop_overhead = 0; // ticks for TEST_BENCH_ITERATIONS empty benchmark iterations
+static int results_handle = -1;
+
+#ifdef HAL_AUTOTEST
+static int semihost_call(uint32_t operation, void* args);
+#endif
+static void emit(const char* json, const char* console);
+static void append_json_string(char* out, uint32_t size, const char* text);
+
+// HAL FUNCTIONS ==============================================================
+void TEST_begin(void) {
+    memset((void*)&TEST_summary, 0, sizeof(TEST_summary));
+
+    SYST_RVR = SYST_MASK;
+    SYST_CVR = 0;
+    SYST_CSR = (0x01U << 2) | 0x01U; // processor clock, enabled, no interrupt
+
+    // Same loop shape as TEST_BENCH with nothing in it
+    uint32_t start = TEST_ticks();
+    for (uint32_t i = 0; i < TEST_BENCH_ITERATIONS; i++) {
+        __asm volatile ("" ::: "memory");
+    }
+    loop_overhead = TEST_elapsed(start);
+
+#ifdef HAL_AUTOTEST
+    uint32_t args[3] = {(uint32_t)TEST_RESULTS_FILE, SEMIHOST_MODE_W, sizeof(TEST_RESULTS_FILE) - 1U};
+    results_handle = semihost_call(SEMIHOST_SYS_OPEN, args);
+#endif
+}
+
+void TEST_run(const char* name, void (*test)(void)) {
+    current_state = TEST_STATE_PASS;
+    test();
+
+    static const char* const status[] = {"pass", "fail", "skip"};
+    char json[160];
+    snprintf(json, sizeof(json), "{\"type\":\"test\",\"name\":");
+    append_json_string(json, sizeof(json), name);
+    snprintf(json + strlen(json), sizeof(json) - strlen(json), ",\"status\":\"%s\"}\n", status[current_state]);
+    snprintf(line_buffer, sizeof(line_buffer), "%s %s\n", status[current_state], name);
+    emit(json, line_buffer);
+
+    if (current_state == TEST_STATE_PASS) {
+        TEST_summary.passed++;
+    } else if (current_state == TEST_STATE_FAIL) {
+        TEST_summary.failed++;
+    } else {
+        TEST_summary.skipped++;
+    }
+}
+
+void TEST_skip(const char* reason) {
+    if (current_state == TEST_STATE_PASS) {
+        current_state = TEST_STATE_SKIP;
+    }
+    snprintf(line_buffer, sizeof(line_buffer), "  skipped: %s\n", reason);
+    emit(NULL, line_buffer);
+}
+
+/**
+ * Every failed assertion is reported (not just the first), with its own JSON line, but a test only counts once
+ */
+void TEST_check(uint8_t passed, const char* expression, const char* file, uint32_t line) {
+    if (passed) return;
+
+    current_state = TEST_STATE_FAIL;
+    char json[256];
+    snprintf(json, sizeof(json), "{\"type\":\"assert\",\"expression\":");
+    append_json_string(json, sizeof(json), expression);
+    snprintf(json + strlen(json), sizeof(json) - strlen(json), ",\"file\":");
+    append_json_string(json, sizeof(json), file);
+    snprintf(json + strlen(json), sizeof(json) - strlen(json), ",\"line\":%lu}\n", (unsigned long)line);
+    snprintf(line_buffer, sizeof(line_buffer), "  FAILED %s:%lu: %s\n", file, (unsigned long)line, expression);
+    emit(json, line_buffer);
+}
+
+void TEST_check_equal(uint32_t expected, uint32_t actual, const char* expression, const char* file, uint32_t line) {
+    if (expected == actual) return;
+
+    TEST_check(0, expression, file, line);
+    snprintf(line_buffer, sizeof(line_buffer), "    expected 0x%08lX, got 0x%08lX\n", (unsigned long)expected, (unsigned long)actual);
+    emit(NULL, line_buffer);
+}
+
+/**
+ * ticks_per_call is rounded for the console, the JSON line also has the totals so tools/check_bench.py can work
+ * with fractions of a tick (a GPIO write is only a few ticks under QEMU)
+ */
+void TEST_record_bench(const char* name, uint32_t ticks) {
+    uint32_t overhead = loop_overhead;
+    uint32_t per_call = (ticks > overhead) ? (ticks - overhead + TEST_BENCH_ITERATIONS / 2U) / TEST_BENCH_ITERATIONS : 0U;
+
+    char json[192];
+    snprintf(json, sizeof(json), "{\"type\":\"bench\",\"name\":");
+    append_json_string(json, sizeof(json), name);
+    snprintf(json + strlen(json), sizeof(json) - strlen(json),
+             ",\"iterations\":%lu,\"ticks_total\":%lu,\"overhead_ticks\":%lu,\"ticks_per_call\":%lu}\n",
+             (unsigned long)TEST_BENCH_ITERATIONS, (unsigned long)ticks, (unsigned long)overhead, (unsigned long)per_call);
+    snprintf(line_buffer, sizeof(line_buffer), "bench %s: %lu ticks/call\n", name, (unsigned long)per_call);
+    emit(json, line_buffer);
+    TEST_summary.benchmarks++;
+}
+
+void TEST_record_metric(const char* name, uint32_t value) {
+    char json[160];
+    snprintf(json, sizeof(json), "{\"type\":\"metric\",\"name\":");
+    append_json_string(json, sizeof(json), name);
+    snprintf(json + strlen(json), sizeof(json) - strlen(json), ",\"value\":%lu}\n", (unsigned long)value);
+    snprintf(line_buffer, sizeof(line_buffer), "metric %s: %lu\n", name, (unsigned long)value);
+    emit(json, line_buffer);
+}
+
+void TEST_reset_port(GPIO_Reg_TypeDef* port, uint32_t pattern) {
+    port->MODER = pattern;
+    port->OTYPER = pattern;
+    port->OSPEEDR = pattern;
+    port->PUPDR = pattern;
+    port->IDR = 0;
+    port->ODR = 0;
+    port->BSRR = 0;
+    port->LCKR = 0;
+    port->AFRL = pattern;
+    port->AFRH = pattern;
+}
+
+uint32_t TEST_ticks(void) {
+    return SYST_CVR;
+}
+
+uint32_t TEST_elapsed(uint32_t start) {
+    return (start - SYST_CVR) & SYST_MASK;
+}
+
+int TEST_end(void) {
+    char json[128];
+    snprintf(json, sizeof(json), "{\"type\":\"summary\",\"passed\":%lu,\"failed\":%lu,\"skipped\":%lu,\"benchmarks\":%lu}\n",
+             (unsigned long)TEST_summary.passed, (unsigned long)TEST_summary.failed,
+             (unsigned long)TEST_summary.skipped, (unsigned long)TEST_summary.benchmarks);
+    snprintf(line_buffer, sizeof(line_buffer), "%lu passed, %lu failed, %lu skipped\n",
+             (unsigned long)TEST_summary.passed, (unsigned long)TEST_summary.failed, (unsigned long)TEST_summary.skipped);
+    emit(json, line_buffer);
+
+#ifdef HAL_AUTOTEST
+    if (results_handle != -1) {
+        uint32_t args[1] = {(uint32_t)results_handle};
+        semihost_call(SEMIHOST_SYS_CLOSE, args);
+    }
+    semihost_call(SEMIHOST_SYS_EXIT, (void*)(TEST_summary.failed ? SEMIHOST_EXIT_FAILURE : SEMIHOST_EXIT_SUCCESS));
+#endif
+    return (int)TEST_summary.failed;
+}
+
+// HELPER FUNCTIONS ==============================================================
+#ifdef HAL_AUTOTEST
+static int semihost_call(uint32_t operation, void* args) {
+    register uint32_t r0 __asm("r0") = operation;
+    register void* r1 __asm("r1") = args;
+    __asm volatile ("bkpt 0xAB" : "+r" (r0) : "r" (r1) : "memory");
+    return (int)r0;
+}
+#endif
+
+static void emit(const char* json, const char* console) {
+#ifdef HAL_AUTOTEST
+    if (console != NULL) {
+        semihost_call(SEMIHOST_SYS_WRITE0, (void*)console);
+    }
+    if (json != NULL && results_handle != -1) {
+        uint32_t args[3] = {(uint32_t)results_handle, (uint32_t)json, strlen(json)};
+        semihost_call(SEMIHOST_SYS_WRITE, args);
+    }
+#else
+    (void)json;
+    (void)console;
+#endif
+}
+
+/**
+ * Appends text as a quoted JSON string. Only quotes and backslashes can turn up in test names,
+ * expressions and file paths, so they're the only characters escaped
+ */
+static void append_json_string(char* out, uint32_t size, const char* text) {
+    uint32_t len = strlen(out);
+    if (len + 1U < size) out[len++] = '"';
+    for (; *text != '\0' && len + 3U < size; text++) {
+        if (*text == '"' || *text == '\\') out[len++] = '\\';
+        out[len++] = *text;
+    }
+    if (len + 1U < size) out[len++] = '"';
+    out[len] = '\0';
+}
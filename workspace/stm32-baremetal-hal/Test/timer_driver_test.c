@@ -0,0 +1,102 @@
+/**
+ * Source file containing implementation for simple tests for the timer_driver HAL
+ * as of now, they are not automated and don't use a testing framework, just visual inspection
+ *
+ * The Nucleo user LED (PA5) is TIM2_CH1 on AF1. TIM2 runs 500Hz PWM and a circular DMA burst
+ * rewrites CCR1-CCR4 every period from a triangle table, so the LED should "breathe"
+ * (~0.13s up, ~0.13s down: 128 steps at 500Hz) while the CPU does nothing
+ *
+ * Input capture: jumper PA5 to PA0 (TIM5_CH1, AF2). TIM5 timestamps every rising edge into a DMA buffer,
+ * and TIM_test_measured_freq (watch it with live expressions) should read 500
+ *
+ * Both pins are set up by the board pin map (utils/board.h), so BOARD_apply() has to run first
+ * 
+ * Written by Ryan Wong
+ */
+
+ /*
+Still to test:
+- center aligned mode
+- advanced timer (TIM1) outputs
+- encoder mode (needs an encoder on PA6/PA7, TIM3 AF2)
+*/
+
+#include <stdint.h>
+#include "test/timer_driver_test.h"
+#include "drivers/timer_driver.h"
+#include "drivers/dma_driver.h"
+
+#define TIM_TEST_STEPS 128U
+#define TIM_TEST_CHANNELS 4U
+#define TIM_TEST_CAPTURES 16U
+
+volatile uint32_t TIM_test_measured_freq = 0;
+
+// One burst (CCR1-CCR4) per PWM period
+static uint32_t duty_table[TIM_TEST_STEPS * TIM_TEST_CHANNELS];
+
+// TIM5 is 32 bit so the capture buffer is uint32_t
+static uint32_t capture_buffer[TIM_TEST_CAPTURES];
+
+static const TIM_Capture_TypeDef capture = {
+    .stream = DMA1_STREAM2,
+    .channel = DMA_CHANNEL_6, // TIM5_CH1
+    .buffer = capture_buffer,
+    .length = TIM_TEST_CAPTURES
+};
+
+static const TIM_Burst_TypeDef burst = {
+    .stream = DMA1_STREAM1,
+    .channel = DMA_CHANNEL_3, // TIM2_UP
+    .base = TIM_DMA_BASE_CCR1,
+    .length = TIM_TEST_CHANNELS
+};
+
+void TIM_test_init() {
+    TIM_Init_TypeDef tim_init;
+    tim_init.frequency = 500;
+    tim_init.count_mode = TIM_COUNT_UP;
+
+    TIM_enable_clock(TIM2);
+    TIM_init(TIM2, &tim_init);
+
+    TIM_PWM_Init_TypeDef pwm;
+    pwm.mode = TIM_PWM_MODE_1;
+    pwm.polarity = TIM_POLARITY_HIGH;
+    pwm.pulse = 0;
+    TIM_PWM_init(TIM2, TIM_CHANNEL_1, &pwm);
+
+    // Triangle ramp on CH1, the other channels get fixed duties (they aren't routed to pins here)
+    uint32_t period = TIM_get_period(TIM2);
+    for (uint32_t i = 0; i < TIM_TEST_STEPS; i++) {
+        uint32_t level = (i < TIM_TEST_STEPS / 2U) ? i : (TIM_TEST_STEPS - 1U - i);
+        duty_table[i * TIM_TEST_CHANNELS + 0] = (period * level) / (TIM_TEST_STEPS / 2U);
+        duty_table[i * TIM_TEST_CHANNELS + 1] = period / 4U;
+        duty_table[i * TIM_TEST_CHANNELS + 2] = period / 2U;
+        duty_table[i * TIM_TEST_CHANNELS + 3] = (period * 3U) / 4U;
+    }
+
+    DMA_enable_clock(DMA1);
+    TIM_DMA_burst_start(TIM2, &burst, duty_table, TIM_TEST_STEPS);
+    TIM_start(TIM2);
+
+    // Capture side, PA0 as TIM5_CH1
+    TIM_IC_Init_TypeDef ic;
+    ic.polarity = TIM_IC_RISING;
+    ic.prescaler = TIM_IC_DIV_1;
+    ic.filter = 0;
+
+    TIM_enable_clock(TIM5);
+    TIM_init_counter(TIM5, 1000000);
+    TIM_IC_init(TIM5, TIM_CHANNEL_1, &ic);
+    TIM_IC_start_dma(TIM5, TIM_CHANNEL_1, &capture);
+    TIM_start(TIM5);
+}
+
+void TIM_test() {
+    // The DMA keeps feeding the duty cycles, all that's left is reading the latest capture period
+    uint32_t period = TIM_IC_get_last_period(TIM5, &capture);
+    if (period != 0) {
+        TIM_test_measured_freq = TIM_get_tick_frequency(TIM5) / period;
+    }
+}
@@ -0,0 +1,126 @@
+/**
+ * Source file containing tests for the OTG FS driver and usb_cdc
+ * Every time the port is opened, prints a banner through printf and then streams lines of text from a ring of
+ * buffers handed straight to CDC_transmit(), timing the whole stream with the DWT. Runs from the main loop, so
+ * the other tests keep going meanwhile
+ *
+ * printf goes to the ITM like everywhere else. Build with USB_TEST_STDIO defined to send it to the port
+ * (CDC_write() through __io_write) while it's open instead, then every _write in the firmware lands in the stream
+ * 
+ * Written by Ryan Wong
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "test/usb_cdc_test.h"
+#include "utils/usb_cdc.h"
+#include "drivers/rcc_driver.h"
+#include "drivers/dwt_driver.h"
+
+#define USB_TEST_BYTES (1024U * 1024U)
+#define USB_TEST_BUFFER_SIZE 4096U
+#define USB_TEST_LINE 64U // a line per packet
+
+volatile uint8_t USB_test_init_ok = 0;
+volatile uint32_t USB_test_opens = 0;
+volatile uint32_t USB_test_bytes = 0;
+volatile uint32_t USB_test_kbps = 0;
+volatile uint8_t USB_test_passed = 0;
+
+static uint8_t buffers[CDC_TX_QUEUE_SIZE][USB_TEST_BUFFER_SIZE];
+static uint8_t was_open = 0;
+static uint8_t streaming = 0;
+static uint32_t queued = 0;
+static uint32_t start_cycles = 0;
+
+static void fill_lines(uint8_t* buffer, uint32_t offset);
+
+/**
+ * HSI / 8 * 192 = 384MHz VCO, / 8 = 48MHz for the USB (P output 96MHz, unused since SYSCLK stays on HSI)
+ */
+void USB_test_init() {
+    static const RCC_PLL_Config pll = {.m = 8U, .n = 192U, .p = 4U, .q = 8U};
+    DWT_init();
+
+    if (RCC_enable_PLL(&pll) != HAL_OK) return;
+    if (CDC_init(&CDC_otg_ops) != HAL_OK) return;
+    USB_test_init_ok = 1;
+}
+
+/**
+ * Keeps the transmit queue full: a buffer is free again once it's off the queue, and buffers leave the queue
+ * in the order they went in
+ */
+void USB_test() {
+    if (!USB_test_init_ok) return;
+
+    uint8_t open = CDC_is_open();
+    if (!open) {
+        if (streaming) USB_test_passed = 0;
+        was_open = 0;
+        streaming = 0;
+        return;
+    }
+    if (!was_open) {
+        was_open = 1;
+        USB_test_opens++;
+        printf("USB CDC test: port opened %lu times, streaming %lu kB\r\n", (unsigned long)USB_test_opens,
+               (unsigned long)(USB_TEST_BYTES / 1024U));
+        USB_test_passed = 0;
+        USB_test_bytes = 0;
+        streaming = 1;
+        queued = 0;
+        start_cycles = DWT_CYCLES();
+    }
+    if (!streaming) return;
+
+    while (queued < USB_TEST_BYTES && CDC_tx_pending() < CDC_TX_QUEUE_SIZE) {
+        uint8_t* buffer = buffers[(queued / USB_TEST_BUFFER_SIZE) % CDC_TX_QUEUE_SIZE];
+        fill_lines(buffer, queued);
+        if (CDC_transmit(buffer, USB_TEST_BUFFER_SIZE) != HAL_OK) {
+            // Reset or deconfigured under us
+            streaming = 0;
+            return;
+        }
+        queued += USB_TEST_BUFFER_SIZE;
+    }
+    if (queued == USB_TEST_BYTES && CDC_tx_pending() == 0) {
+        USB_test_kbps = DWT_to_kbps(USB_TEST_BYTES, DWT_CYCLES() - start_cycles);
+        USB_test_bytes = USB_TEST_BYTES;
+        USB_test_passed = 1;
+        streaming = 0;
+        printf("\r\nUSB CDC test: %lu bytes at %lu kB/s\r\n", (unsigned long)USB_test_bytes, (unsigned long)USB_test_kbps);
+    }
+}
+
+#if defined(USB_TEST_STDIO) && !defined(HAL_AUTOTEST)
+extern void ITM_SendChar(uint8_t ch);
+
+/**
+ * printf goes to the USB port while it's open, and to the ITM like before otherwise
+ */
+int __io_write(char* ptr, int len) {
+    if (CDC_is_open()) {
+        CDC_write(ptr, (uint32_t)len);
+    } else {
+        for (int i = 0; i < len; i++) ITM_SendChar((uint8_t)ptr[i]);
+    }
+    return len;
+}
+#endif
+
+/**
+ * 64 character lines: the byte offset in hex, then the alphabet. Cheap enough to keep up with the bus at 16MHz,
+ * and a dropped or repeated packet stands out in the offsets
+ */
+static void fill_lines(uint8_t* buffer, uint32_t offset) {
+    static const char hex[] = "0123456789ABCDEF";
+    static const char tail[] = " ABCDEFGHIJKLMNOPQRSTUVWXYZ abcdefghijklmnopqrstuvwxyz\r\n";
+    for (uint32_t line = 0; line < USB_TEST_BUFFER_SIZE; line += USB_TEST_LINE) {
+        uint8_t* text = buffer + line;
+        uint32_t position = offset + line;
+        for (uint32_t i = 0; i < 8U; i++) text[i] = (uint8_t)hex[(position >> (28U - 4U * i)) & 0x0FU];
+        memcpy(text + 8U, tail, USB_TEST_LINE - 8U);
+    }
+}
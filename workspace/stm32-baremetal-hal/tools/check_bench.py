@@ -0,0 +1,147 @@
+#!/usr/bin/env python3
+"""
+Checks the JSON lines results written by the HAL_AUTOTEST firmware (Test/test_runner.c).
+
+Fails (exit status 1) if:
+- any test failed, or the summary line is missing (firmware crashed or hung part way)
+- a benchmark in the baseline is missing from the results
+- a benchmark got slower than its baseline by more than the tolerance
+
+Benchmarks are compared per call at full resolution, (ticks_total - overhead_ticks) / iterations, not the rounded
+ticks_per_call the firmware prints: a GPIO write is only a few ticks, so rounding alone would hide a 20% change.
+Benchmarks that got faster by more than the tolerance are reported, so the baseline can be tightened with --update.
+An empty baseline (nothing recorded yet) checks the tests only and says so.
+
+Under QEMU with -icount shift=N every instruction takes 2^N ns of virtual time and SysTick counts the 168MHz
+netduinoplus2 SYSCLK, so one tick is 1000 / 168 / 2^N instructions (~5.95 at shift=0). The instruction count per
+call is printed next to the ticks. Cycle counts can't be had from QEMU (it doesn't model pipeline or flash wait
+state timing, and DWT CYCCNT isn't implemented), on the board the same ticks are HCLK cycles.
+Metrics (e.g. the stack high water mark) are printed but not checked, tools/ram_report.py puts them in context.
+
+Usage:
+    python3 tools/check_bench.py build/autotest/test_results.jsonl tools/bench_baseline.json
+    python3 tools/check_bench.py build/autotest/test_results.jsonl tools/bench_baseline.json --update
+
+Written by Ryan Wong
+"""
+
+import argparse
+import json
+import sys
+
+DEFAULT_TOLERANCE = 0.05
+# Each total is read off SysTick to within a tick, for both the benchmark and the empty loop it's corrected with,
+# so allow this much spread over the whole run (it becomes 2 / iterations per call)
+QUANTISATION_TICKS = 2
+QEMU_SYSTICK_HZ = 168000000
+
+
+def load_results(path):
+    tests, asserts, benches, metrics, summary = [], [], {}, {}, None
+    with open(path) as results:
+        for number, line in enumerate(results, 1):
+            line = line.strip()
+            if not line:
+                continue
+            try:
+                record = json.loads(line)
+            except ValueError:
+                raise SystemExit("{}:{}: not valid JSON: {}".format(path, number, line))
+            kind = record.get("type")
+            if kind == "test":
+                tests.append(record)
+            elif kind == "assert":
+                asserts.append(record)
+            elif kind == "bench":
+                benches[record["name"]] = record
+            elif kind == "metric":
+                metrics[record["name"]] = record["value"]
+            elif kind == "summary":
+                summary = record
+    return tests, asserts, benches, metrics, summary
+
+
+def per_call(record):
+    ticks = max(record["ticks_total"] - record["overhead_ticks"], 0)
+    return round(ticks / record["iterations"], 3)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Check emulator test results against the benchmark baseline")
+    parser.add_argument("results")
+    parser.add_argument("baseline")
+    parser.add_argument("--update", action="store_true", help="write the current benchmark numbers as the baseline")
+    parser.add_argument("--icount-shift", type=int, default=0, help="QEMU -icount shift the results were run with")
+    args = parser.parse_args()
+    instructions_per_tick = 1e9 / QEMU_SYSTICK_HZ / (1 << args.icount_shift)
+
+    tests, asserts, records, metrics, summary = load_results(args.results)
+    benches = {name: per_call(record) for name, record in records.items()}
+    ok = True
+
+    for record in asserts:
+        print("FAILED {}:{}: {}".format(record["file"], record["line"], record["expression"]))
+    failed = [t["name"] for t in tests if t["status"] == "fail"]
+    skipped = [t["name"] for t in tests if t["status"] == "skip"]
+    if failed:
+        print("failed tests: " + ", ".join(failed))
+        ok = False
+    if skipped:
+        print("skipped tests: " + ", ".join(skipped))
+    if summary is None:
+        print("no summary in the results, the firmware stopped early")
+        ok = False
+
+    if args.update:
+        try:
+            with open(args.baseline) as f:
+                tolerance = json.load(f).get("tolerance", DEFAULT_TOLERANCE)
+        except (OSError, ValueError):
+            tolerance = DEFAULT_TOLERANCE
+        with open(args.baseline, "w") as f:
+            json.dump({"tolerance": tolerance, "benchmarks": dict(sorted(benches.items()))}, f, indent=4)
+            f.write("\n")
+        print("baseline updated with {} benchmarks".format(len(benches)))
+    else:
+        try:
+            with open(args.baseline) as f:
+                baseline = json.load(f)
+        except OSError:
+            print("no baseline at {}, record one with --update".format(args.baseline))
+            return 1
+        tolerance = baseline.get("tolerance", DEFAULT_TOLERANCE)
+        if not baseline["benchmarks"]:
+            print("no benchmarks in {} yet, only the tests are checked. Record them with "
+                  "tools/run_emulator_tests.sh --update and commit the file".format(args.baseline))
+
+        print("{:<32} {:>9} {:>9} {:>8} {:>7}".format("benchmark", "baseline", "now", "change", "instr"))
+        for name, expected in sorted(baseline["benchmarks"].items()):
+            if name not in benches:
+                print("{:<32} {:>9.3f} {:>9}".format(name, expected, "missing"))
+                ok = False
+                continue
+            now = benches[name]
+            slack = QUANTISATION_TICKS / records[name]["iterations"]
+            change = (now - expected) / expected if expected else 0.0
+            verdict = ""
+            if now > expected * (1.0 + tolerance) + slack:
+                verdict = "REGRESSION"
+                ok = False
+            elif now < expected * (1.0 - tolerance) - slack:
+                verdict = "faster, consider --update"
+            print("{:<32} {:>9.3f} {:>9.3f} {:>+7.1f}% {:>7.1f} {}".format(name, expected, now, change * 100.0,
+                                                                        now * instructions_per_tick, verdict))
+        for name in sorted(set(benches) - set(baseline["benchmarks"])):
+            print("{:<32} {:>9} {:>9.3f} {:>8} {:>7.1f} new, not in baseline".format(
+                name, "-", benches[name], "", benches[name] * instructions_per_tick))
+
+    for name, value in sorted(metrics.items()):
+        print("metric {}: {}".format(name, value))
+    if summary is not None:
+        print("{} passed, {} failed, {} skipped".format(summary["passed"], summary["failed"], summary["skipped"]))
+    print("PASS" if ok else "FAIL")
+    return 0 if ok else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
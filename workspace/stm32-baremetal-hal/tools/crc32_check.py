@@ -0,0 +1,203 @@
+#!/usr/bin/env python3
+"""
+Host side check for the CRC driver (drivers/crc_driver.h).
+
+Models the F446 CRC unit bit for bit (poly 0x04C11DB7, init 0xFFFFFFFF, 32 bit words MSB first,
+no reflection, no final XOR) and runs the same algorithm as crc_driver.c on top of it:
+word reversal + software tail for CRC_MODE_STANDARD, and the reset + single word trick
+used to restore a saved running value. Results are compared against zlib.crc32 over random
+buffers split into random chunks (odd sizes, unaligned starts, interleaved contexts).
+
+It also prints the expected values for a buffer so they can be compared with what the target reports:
+    python3 tools/crc32_check.py                 # run the self check
+    python3 tools/crc32_check.py --print 123456789
+
+Written by Ryan Wong
+"""
+
+import argparse
+import random
+import struct
+import sys
+import zlib
+
+CRC_POLY = 0x04C11DB7
+CRC_POLY_REFLECTED = 0xEDB88320
+CRC_INIT = 0xFFFFFFFF
+MASK = 0xFFFFFFFF
+
+
+class CrcUnit:
+    """The hardware: DR reads back the running value, writes feed one word, CR bit 0 resets"""
+
+    def __init__(self):
+        self.dr = CRC_INIT
+
+    def reset(self):
+        self.dr = CRC_INIT
+
+    def write(self, word):
+        value = self.dr ^ word
+        for _ in range(32):
+            if value & 0x80000000:
+                value = ((value << 1) ^ CRC_POLY) & MASK
+            else:
+                value = (value << 1) & MASK
+        self.dr = value
+
+
+def reverse_bits(value):
+    return int("{:032b}".format(value)[::-1], 2)
+
+
+def unstep32(value):
+    for _ in range(32):
+        if value & 1:
+            value = ((value ^ CRC_POLY) >> 1) | 0x80000000
+        else:
+            value >>= 1
+    return value
+
+
+def restore_state(unit, value):
+    if unit.dr == value:
+        return
+    unit.reset()
+    unit.write(unstep32(value) ^ CRC_INIT)
+
+
+class Context:
+    def __init__(self, native=False):
+        self.native = native
+        self.state = CRC_INIT
+
+
+def crc_update(unit, ctx, data):
+    if ctx.native:
+        if len(data) % 4:
+            raise ValueError("native mode needs a multiple of 4 bytes")
+        restore_state(unit, ctx.state)
+        for (word,) in struct.iter_unpack("<I", data):
+            unit.write(word)
+        ctx.state = unit.dr
+        return
+
+    state = ctx.state
+    words = len(data) // 4
+    if words:
+        restore_state(unit, reverse_bits(state))
+        for (word,) in struct.iter_unpack("<I", data[:words * 4]):
+            unit.write(reverse_bits(word))
+        state = reverse_bits(unit.dr)
+    for byte in data[words * 4:]:
+        state ^= byte
+        for _ in range(8):
+            state = (state >> 1) ^ (CRC_POLY_REFLECTED if state & 1 else 0)
+    ctx.state = state
+
+
+def crc_finish(ctx):
+    return ctx.state if ctx.native else (~ctx.state) & MASK
+
+
+def crc_compute(data, native=False):
+    unit = CrcUnit()
+    ctx = Context(native)
+    crc_update(unit, ctx, data)
+    return crc_finish(ctx)
+
+
+def mpeg2_of_swapped_words(data):
+    """Independent reference for native mode: CRC-32/MPEG-2 over each word byte swapped"""
+    swapped = b"".join(struct.pack(">I", w) for (w,) in struct.iter_unpack("<I", data))
+    crc = CRC_INIT
+    for byte in swapped:
+        crc ^= byte << 24
+        for _ in range(8):
+            crc = ((crc << 1) ^ CRC_POLY) & MASK if crc & 0x80000000 else (crc << 1) & MASK
+    return crc
+
+
+def random_chunks(rng, data):
+    pos = 0
+    while pos < len(data):
+        size = rng.choice([0, 1, 2, 3, 4, 5, 7, 8, 13, 64, 255, rng.randint(1, 2048)])
+        yield data[pos:pos + size]
+        pos += size
+
+
+def self_check(iterations, seed):
+    rng = random.Random(seed)
+    failures = 0
+
+    if crc_compute(b"123456789") != 0xCBF43926:
+        print("FAIL check value")
+        failures += 1
+
+    for i in range(iterations):
+        length = rng.choice([0, 1, 3, 4, 9, 31, 64, 1000, rng.randint(0, 8192)])
+        data = bytes(rng.getrandbits(8) for _ in range(length))
+        expected = zlib.crc32(data)
+
+        if crc_compute(data) != expected:
+            print("FAIL one shot len={}".format(length))
+            failures += 1
+
+        # Two contexts interleaved on one unit, so every chunk after the first has to restore
+        unit = CrcUnit()
+        a, b = Context(), Context()
+        other = bytes(reversed(data))
+        chunks_a = list(random_chunks(rng, data))
+        chunks_b = list(random_chunks(rng, other))
+        for n in range(max(len(chunks_a), len(chunks_b))):
+            if n < len(chunks_a):
+                crc_update(unit, a, chunks_a[n])
+            if n < len(chunks_b):
+                crc_update(unit, b, chunks_b[n])
+        if crc_finish(a) != expected or crc_finish(b) != zlib.crc32(other):
+            print("FAIL chunked/interleaved len={}".format(length))
+            failures += 1
+
+        words = data[:len(data) & ~3]
+        unit = CrcUnit()
+        ctx = Context(native=True)
+        for n in range(0, len(words), 256):
+            crc_update(unit, ctx, words[n:n + 256])
+            unit.reset()  # something else used the unit in between
+        if crc_finish(ctx) != mpeg2_of_swapped_words(words):
+            print("FAIL native len={}".format(len(words)))
+            failures += 1
+
+        state = rng.getrandbits(32)
+        unit = CrcUnit()
+        restore_state(unit, state)
+        if unit.dr != state:
+            print("FAIL restore 0x{:08X}".format(state))
+            failures += 1
+
+        if failures:
+            break
+
+    print("{} iterations, {} failures".format(iterations, failures))
+    return failures == 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Check the CRC driver algorithm against zlib.crc32")
+    parser.add_argument("--iterations", type=int, default=200)
+    parser.add_argument("--seed", type=int, default=446)
+    parser.add_argument("--print", dest="text", help="print the standard and native CRC of this ASCII string")
+    args = parser.parse_args()
+
+    if args.text is not None:
+        data = args.text.encode("ascii")
+        print("standard 0x{:08X}".format(crc_compute(data)))
+        if len(data) % 4 == 0:
+            print("native   0x{:08X}".format(crc_compute(data, native=True)))
+        return 0
+
+    return 0 if self_check(args.iterations, args.seed) else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,144 @@
+#!/usr/bin/env python3
+"""
+Host side decoder for the deferred_log binary stream.
+
+Reads the format strings out of the .dlog_fmt section of the firmware ELF and turns the raw
+records captured from the target (ITM/SWO dump, UART capture, USB CDC...) back into text.
+
+Usage:
+    python3 tools/dlog_decode.py Debug/stm32-baremetal-hal.elf capture.bin [--hclk 16000000]
+    cat /dev/ttyACM0 | python3 tools/dlog_decode.py Debug/stm32-baremetal-hal.elf -
+
+The ELF must be the exact build that produced the log, the IDs are addresses in .dlog_fmt.
+
+Written by Ryan Wong
+"""
+
+import argparse
+import re
+import struct
+import sys
+
+DLOG_SYNC = 0xD1
+DLOG_ID_DROPPED = 0xFFFFF
+DLOG_MAX_ARGS = 4
+
+# printf conversion spec: flags, width, precision, length modifier, conversion
+FORMAT_SPEC = re.compile(r"%([-+ #0]*)(\d+|\*)?(?:\.(\d+|\*))?(hh|h|ll|l|z|j|t)?([diouxXeEfFgGcp%s])")
+
+
+def read_section(elf_path, name):
+    """Returns the raw bytes of the named section from a 32 bit little endian ELF."""
+    with open(elf_path, "rb") as f:
+        elf = f.read()
+
+    if elf[:4] != b"\x7fELF" or elf[4] != 1 or elf[5] != 1:
+        raise ValueError(f"{elf_path} is not a 32 bit little endian ELF")
+
+    e_shoff, = struct.unpack_from("<I", elf, 0x20)
+    e_shentsize, e_shnum, e_shstrndx = struct.unpack_from("<HHH", elf, 0x2E)
+
+    def section_header(index):
+        # name, type, flags, addr, offset, size
+        return struct.unpack_from("<IIIIII", elf, e_shoff + index * e_shentsize)
+
+    _, _, _, _, strtab_offset, strtab_size = section_header(e_shstrndx)
+    strtab = elf[strtab_offset:strtab_offset + strtab_size]
+
+    for i in range(e_shnum):
+        sh_name, _, _, _, sh_offset, sh_size = section_header(i)
+        end = strtab.index(b"\0", sh_name)
+        if strtab[sh_name:end].decode() == name:
+            return elf[sh_offset:sh_offset + sh_size]
+    raise ValueError(f"{elf_path} has no {name} section (is deferred_log linked in?)")
+
+
+def format_string(strings, fmt_id):
+    if fmt_id >= len(strings):
+        return None
+    end = strings.find(b"\0", fmt_id)
+    if end < 0:
+        end = len(strings)
+    return strings[fmt_id:end].decode(errors="replace")
+
+
+def render(fmt, args):
+    """Applies the raw 32 bit args to a printf style format, reinterpreting them by conversion type."""
+    args = list(args)
+
+    def convert(match):
+        flags, width, precision, _, conv = match.groups()
+        if conv == "%":
+            return "%"
+        if not args:
+            return "<missing>"
+        raw = args.pop(0)
+        spec = "%" + (flags or "") + (width or "") + ("." + precision if precision else "")
+        if conv in "di":
+            value = struct.unpack("<i", struct.pack("<I", raw))[0]
+            return (spec + "d") % value
+        if conv in "ouxX":
+            return (spec + conv) % raw
+        if conv in "eEfFgG":
+            value = struct.unpack("<f", struct.pack("<I", raw))[0]
+            return (spec + conv) % value
+        if conv == "c":
+            return (spec + "c") % chr(raw & 0xFF)
+        if conv == "p":
+            return "0x%08x" % raw
+        return "<%s unsupported>" % conv
+
+    return FORMAT_SPEC.sub(convert, fmt)
+
+
+def decode(strings, data, hclk):
+    """Yields decoded lines. Resynchronises on the sync byte if the stream is corrupt or starts mid record."""
+    pos = 0
+    while pos + 8 <= len(data):
+        header, timestamp = struct.unpack_from("<II", data, pos)
+        sync = header >> 24
+        nargs = (header >> 20) & 0x0F
+        fmt_id = header & 0xFFFFF
+
+        if sync != DLOG_SYNC or nargs > DLOG_MAX_ARGS:
+            pos += 1
+            continue
+        if fmt_id != DLOG_ID_DROPPED and format_string(strings, fmt_id) is None:
+            pos += 1
+            continue
+        if pos + 8 + nargs * 4 > len(data):
+            break
+
+        args = struct.unpack_from("<%dI" % nargs, data, pos + 8)
+        pos += 8 + nargs * 4
+
+        stamp = "%10u" % timestamp
+        if hclk:
+            stamp += " (%.6fs)" % (timestamp / hclk)
+
+        if fmt_id == DLOG_ID_DROPPED:
+            yield "%s <%u records dropped>" % (stamp, args[0] if args else 0)
+        else:
+            yield "%s %s" % (stamp, render(format_string(strings, fmt_id), args))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Decode deferred_log binary records")
+    parser.add_argument("elf", help="firmware ELF the log was produced by")
+    parser.add_argument("log", help="binary capture file, or - for stdin")
+    parser.add_argument("--hclk", type=int, default=0, help="HCLK in Hz, to also print timestamps in seconds")
+    args = parser.parse_args()
+
+    strings = read_section(args.elf, ".dlog_fmt")
+    if args.log == "-":
+        data = sys.stdin.buffer.read()
+    else:
+        with open(args.log, "rb") as f:
+            data = f.read()
+
+    for line in decode(strings, data, args.hclk):
+        print(line)
+
+
+if __name__ == "__main__":
+    main()
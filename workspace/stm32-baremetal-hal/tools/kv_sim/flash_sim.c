@@ -0,0 +1,122 @@
+/*
+ * flash_sim.c
+ *
+ * implementation file for flash_sim.h
+ *
+ *  Written by Ryan Wong
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "flash_sim.h"
+
+static uint32_t memory[FLASH_SIM_MAX_SECTORS][FLASH_SIM_MAX_SECTOR_SIZE / 4U];
+static uint32_t sim_sectors = 0;
+static uint32_t sim_sector_size = 0;
+static uint32_t rng_state = 1;
+static uint32_t cut_countdown = 0;
+static jmp_buf* cut_jump = NULL;
+static FLASH_Sim_Stats stats;
+
+static const uint32_t* sim_address(uint32_t sector);
+static HAL_Status sim_erase(uint32_t sector);
+static HAL_Status sim_program(uint32_t sector, uint32_t word_offset, uint32_t value);
+static uint32_t random_word(void);
+static uint8_t cut_now(void);
+
+static KV_Flash_Ops sim_ops = {
+    .address = sim_address,
+    .erase = sim_erase,
+    .program = sim_program
+};
+
+void FLASH_sim_init(uint32_t num_sectors, uint32_t sector_size, uint32_t seed) {
+    sim_sectors = num_sectors;
+    sim_sector_size = sector_size;
+    sim_ops.num_sectors = num_sectors;
+    sim_ops.sector_size = sector_size;
+    rng_state = seed ? seed : 1U;
+    cut_countdown = 0;
+    memset(memory, 0xFF, sizeof(memory));
+    memset(&stats, 0, sizeof(stats));
+}
+
+const KV_Flash_Ops* FLASH_sim_ops(void) {
+    return &sim_ops;
+}
+
+void FLASH_sim_arm_power_cut(uint32_t ops, jmp_buf* jump) {
+    cut_countdown = ops;
+    cut_jump = jump;
+}
+
+uint8_t FLASH_sim_power_cut_pending(void) {
+    return cut_countdown != 0;
+}
+
+FLASH_Sim_Stats* FLASH_sim_get_stats(void) {
+    return &stats;
+}
+
+// HELPER FUNCTIONS ==============================================================
+static const uint32_t* sim_address(uint32_t sector) {
+    if (sector >= sim_sectors) return NULL;
+    return memory[sector];
+}
+
+/**
+ * An interrupted erase leaves a random mix of erased and untouched words
+ */
+static HAL_Status sim_erase(uint32_t sector) {
+    if (sector >= sim_sectors) return HAL_ERROR;
+
+    uint32_t words = sim_sector_size / 4U;
+    if (cut_now()) {
+        for (uint32_t i = 0; i < words; i++) {
+            if (random_word() & 0x01U) memory[sector][i] = 0xFFFFFFFFU;
+        }
+        longjmp(*cut_jump, 1);
+    }
+
+    memset(memory[sector], 0xFF, sim_sector_size);
+    stats.erases++;
+    stats.erase_count[sector]++;
+    stats.busy_us += (uint64_t)FLASH_SIM_ERASE_16K_US * (sim_sector_size / 0x4000U);
+    return HAL_OK;
+}
+
+/**
+ * An interrupted program clears only some of the bits it was meant to
+ */
+static HAL_Status sim_program(uint32_t sector, uint32_t word_offset, uint32_t value) {
+    if (
+        sector >= sim_sectors ||
+        word_offset >= sim_sector_size / 4U
+    ) return HAL_ERROR;
+
+    uint32_t* word = &memory[sector][word_offset];
+    if (cut_now()) {
+        *word &= value | random_word();
+        longjmp(*cut_jump, 1);
+    }
+
+    stats.programs++;
+    stats.busy_us += FLASH_SIM_PROGRAM_US;
+    if ((*word & value) != value) stats.bad_programs++;
+    *word &= value;
+    return (*word == value) ? HAL_OK : HAL_ERROR;
+}
+
+// xorshift32
+static uint32_t random_word(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static uint8_t cut_now(void) {
+    if (cut_countdown == 0 || cut_jump == NULL) return 0;
+    return --cut_countdown == 0;
+}
@@ -0,0 +1,60 @@
+/*
+ * flash_sim.h
+ *
+ * RAM backed NOR flash for running kv_store.c on the PC. Behaves like the F446 main memory as far as the
+ * store can tell: erase sets bytes to 0xFF, programming can only clear bits, and the program call
+ * fails if the word doesn't read back as written (same check as kv_store_flash.c).
+ *
+ * A power cut can be armed to hit during the Nth flash operation. That operation is left half done
+ * (some bits programmed, or some words erased) and control jumps back to the harness with longjmp,
+ * which then "reboots" by calling KV_init() again.
+ *
+ * Times are the F446 datasheet typical values for x32 parallelism, to estimate throughput
+ *
+ *  Written by Ryan Wong
+ */
+
+#ifndef FLASH_SIM_H_
+#define FLASH_SIM_H_
+
+#include <stdint.h>
+#include <setjmp.h>
+#include "utils/kv_store.h"
+
+#define FLASH_SIM_MAX_SECTORS 4U
+#define FLASH_SIM_MAX_SECTOR_SIZE 0x20000U
+#define FLASH_SIM_PROGRAM_US 16U
+#define FLASH_SIM_ERASE_16K_US 400000U
+
+typedef struct {
+    uint64_t programs;
+    uint64_t erases;
+    uint64_t bad_programs; // programs that tried to turn a 0 back into a 1
+    uint64_t busy_us; // simulated time spent erasing/programming
+    uint32_t erase_count[FLASH_SIM_MAX_SECTORS];
+} FLASH_Sim_Stats;
+
+/**
+ * @brief Creates a blank (all 0xFF) flash and resets the statistics
+ */
+void FLASH_sim_init(uint32_t num_sectors, uint32_t sector_size, uint32_t seed);
+
+/**
+ * @brief Returns the backend to pass to KV_init()
+ */
+const KV_Flash_Ops* FLASH_sim_ops(void);
+
+/**
+ * @brief Arms a power cut during the ops-th flash operation from now (1 = the next one). 0 disarms.
+ * 		  When it hits, the simulator longjmps to jump with value 1
+ */
+void FLASH_sim_arm_power_cut(uint32_t ops, jmp_buf* jump);
+
+/**
+ * @brief Returns 1 if an armed power cut hasn't happened yet
+ */
+uint8_t FLASH_sim_power_cut_pending(void);
+
+FLASH_Sim_Stats* FLASH_sim_get_stats(void);
+
+#endif
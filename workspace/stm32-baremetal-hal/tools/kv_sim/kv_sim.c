@@ -0,0 +1,255 @@
+/*
+ * kv_sim.c
+ *
+ * Runs the real kv_store.c against the flash simulator on the PC:
+ *   1. functional checks (set/get/overwrite/delete/remount)
+ *   2. a long random workload, reporting throughput, write amplification and wear spread
+ *   3. power cut recovery: thousands of random workloads each cut at a random flash operation (sometimes
+ *      again during the recovery), checking after every "reboot" that no committed value was lost or changed
+ *
+ * Build and run from workspace/stm32-baremetal-hal:
+ *   gcc -std=c99 -O2 -Wall -Wextra -IInc -Itools/kv_sim tools/kv_sim/flash_sim.c tools/kv_sim/kv_sim.c Src/utils/kv_store.c -o kv_sim && ./kv_sim
+ *
+ * Exits non zero if any check fails
+ *
+ *  Written by Ryan Wong
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include "utils/kv_store.h"
+#include "flash_sim.h"
+
+#define SIM_SECTORS 2U
+#define SIM_SECTOR_SIZE 0x4000U
+#define SIM_KEYS 32U
+#define SIM_MAX_LEN 40U
+#define SIM_WORKLOAD_WRITES 200000U
+#define SIM_POWER_CUT_RUNS 3000U
+
+/**
+ * What the store should contain. Values are generated from (key, version), so only the version is kept
+ */
+typedef struct {
+    uint8_t exists;
+    uint32_t version;
+} Model_Entry;
+
+static Model_Entry model[SIM_KEYS];
+static uint32_t failures = 0;
+static uint32_t rng_state = 12345;
+
+static uint32_t random_below(uint32_t n);
+static uint32_t make_value(uint16_t key, uint32_t version, uint8_t* value);
+static uint8_t stored_matches(uint16_t key, uint8_t exists, uint32_t version);
+static void check(uint8_t condition, const char* what);
+static void functional_test(void);
+static void workload_test(uint8_t use_service);
+static void power_cut_test(void);
+
+int main(void) {
+    functional_test();
+    workload_test(1);
+    workload_test(0);
+    power_cut_test();
+
+    printf("%s (%u failures)\n", failures ? "FAIL" : "PASS", failures);
+    return failures ? 1 : 0;
+}
+
+static void functional_test(void) {
+    uint8_t value[SIM_MAX_LEN];
+    uint8_t buffer[SIM_MAX_LEN];
+    FLASH_sim_init(SIM_SECTORS, SIM_SECTOR_SIZE, 1);
+
+    check(KV_init(FLASH_sim_ops()) == HAL_OK, "mount blank flash");
+    check(KV_get(1, buffer, sizeof(buffer)) == -1, "missing key");
+
+    uint32_t len = make_value(1, 7, value);
+    check(KV_set(1, value, len) == HAL_OK, "set");
+    check(KV_get(1, buffer, sizeof(buffer)) == (int32_t)len && memcmp(buffer, value, len) == 0, "get after set");
+
+    uint64_t programs = FLASH_sim_get_stats()->programs;
+    check(KV_set(1, value, len) == HAL_OK && FLASH_sim_get_stats()->programs == programs, "identical set writes nothing");
+
+    len = make_value(1, 8, value);
+    KV_set(1, value, len);
+    KV_set(2, NULL, 0);
+    check(KV_get(2, NULL, 0) == 0, "zero length value");
+    check(KV_delete(3) == HAL_OK, "delete missing key");
+
+    check(KV_init(FLASH_sim_ops()) == HAL_OK, "remount");
+    check(KV_get(1, buffer, sizeof(buffer)) == (int32_t)len && memcmp(buffer, value, len) == 0, "overwrite survives remount");
+    check(KV_get(2, NULL, 0) == 0, "zero length survives remount");
+
+    KV_delete(1);
+    check(KV_get(1, NULL, 0) == -1, "delete");
+    check(KV_init(FLASH_sim_ops()) == HAL_OK && KV_get(1, NULL, 0) == -1, "delete survives remount");
+
+    uint8_t big[KV_MAX_VALUE_SIZE + 1U];
+    memset(big, 0x5A, sizeof(big));
+    check(KV_set(4, big, sizeof(big)) == HAL_ERROR, "oversized value rejected");
+    check(KV_set(KV_KEY_INVALID, value, 4) == HAL_ERROR, "invalid key rejected");
+    check(FLASH_sim_get_stats()->bad_programs == 0, "no word programmed twice");
+}
+
+/**
+ * Random overwrites of SIM_KEYS keys. With use_service the main loop does a little compaction after
+ * every write, otherwise every compaction (and its erase) lands inside a KV_set() call
+ */
+static void workload_test(uint8_t use_service) {
+    uint8_t value[SIM_MAX_LEN];
+    FLASH_sim_init(SIM_SECTORS, SIM_SECTOR_SIZE, 2);
+    memset(model, 0, sizeof(model));
+    KV_init(FLASH_sim_ops());
+
+    uint64_t user_bytes = 0;
+    uint64_t worst_set_us = 0;
+    for (uint32_t i = 0; i < SIM_WORKLOAD_WRITES; i++) {
+        uint16_t key = (uint16_t)random_below(SIM_KEYS);
+        uint32_t len = make_value(key, i, value);
+
+        uint64_t before = FLASH_sim_get_stats()->busy_us;
+        if (KV_set(key, value, len) != HAL_OK) {
+            check(0, "workload set");
+            return;
+        }
+        uint64_t took = FLASH_sim_get_stats()->busy_us - before;
+        if (took > worst_set_us) worst_set_us = took;
+
+        model[key].exists = 1;
+        model[key].version = i;
+        user_bytes += len;
+        if (use_service) KV_service(2);
+    }
+
+    KV_init(FLASH_sim_ops());
+    for (uint16_t key = 0; key < SIM_KEYS; key++) {
+        check(stored_matches(key, model[key].exists, model[key].version), "workload contents after remount");
+    }
+
+    FLASH_Sim_Stats* stats = FLASH_sim_get_stats();
+    KV_Stats kv;
+    KV_get_stats(&kv);
+    printf("workload (%s): %u writes, %.1f us flash time per write, worst write %.1f ms\n",
+           use_service ? "KV_service in main loop" : "no KV_service", SIM_WORKLOAD_WRITES,
+           (double)stats->busy_us / SIM_WORKLOAD_WRITES, (double)worst_set_us / 1000.0);
+    printf("  write amplification %.2f (programmed bytes / value bytes), %llu erases, erase counts %u..%u\n",
+           (double)(stats->programs * 4U) / (double)user_bytes, (unsigned long long)stats->erases,
+           kv.min_erase_count, kv.max_erase_count);
+    check(stats->bad_programs == 0, "no word programmed twice");
+    check(kv.max_erase_count - kv.min_erase_count <= 1U, "wear spread over sectors");
+}
+
+/**
+ * During each run the op in flight is the only thing allowed to be either old or new after the cut.
+ * The cut also sometimes hits the recovery in KV_init(), which has to cope with its own half done work
+ */
+static void power_cut_test(void) {
+    static jmp_buf jump;
+    uint8_t value[SIM_MAX_LEN];
+    volatile uint32_t cuts = 0;
+
+    for (volatile uint32_t run = 0; run < SIM_POWER_CUT_RUNS && !failures; run++) {
+        FLASH_sim_init(SIM_SECTORS, SIM_SECTOR_SIZE, run + 100U);
+        memset(model, 0, sizeof(model));
+        KV_init(FLASH_sim_ops());
+
+        // Get the store into a random spot in its life first, sometimes mid compaction
+        uint32_t warmup = random_below(3000);
+        for (uint32_t i = 0; i < warmup; i++) {
+            uint16_t key = (uint16_t)random_below(SIM_KEYS);
+            KV_set(key, value, make_value(key, i, value));
+            model[key].exists = 1;
+            model[key].version = i;
+            if (random_below(4) == 0) KV_service(1);
+        }
+
+        volatile uint16_t key = (uint16_t)random_below(SIM_KEYS);
+        volatile uint8_t is_delete = random_below(5) == 0;
+        volatile uint8_t in_recovery = 0;
+        volatile uint32_t version = warmup + 1U;
+
+        if (setjmp(jump) == 0) {
+            FLASH_sim_arm_power_cut(1U + random_below(600), &jump);
+            for (;;) {
+                if (is_delete) {
+                    KV_delete(key);
+                    model[key].exists = 0;
+                } else {
+                    KV_set(key, value, make_value(key, version, value));
+                    model[key].exists = 1;
+                    model[key].version = version;
+                }
+                KV_service(1 + random_below(3));
+
+                key = (uint16_t)random_below(SIM_KEYS);
+                is_delete = random_below(5) == 0;
+                version++;
+            }
+        }
+
+        // Power came back. Maybe lose it again during recovery
+        cuts++;
+        if (random_below(4) == 0 && setjmp(jump) == 0) {
+            in_recovery = 1;
+            FLASH_sim_arm_power_cut(1U + random_below(8), &jump);
+            KV_init(FLASH_sim_ops());
+            FLASH_sim_arm_power_cut(0, NULL);
+        }
+        FLASH_sim_arm_power_cut(0, NULL);
+        check(KV_init(FLASH_sim_ops()) == HAL_OK, "mount after power cut");
+
+        for (uint16_t k = 0; k < SIM_KEYS; k++) {
+            if (k == key) {
+                // The interrupted op: old or new are both fine, but it has to be one of them
+                uint8_t old_ok = stored_matches(k, model[k].exists, model[k].version);
+                uint8_t new_ok = is_delete ? stored_matches(k, 0, 0) : stored_matches(k, 1, version);
+                check(old_ok || new_ok, in_recovery ? "in flight op after double cut" : "in flight op after cut");
+            } else {
+                check(stored_matches(k, model[k].exists, model[k].version), "committed value after cut");
+            }
+        }
+        check(FLASH_sim_get_stats()->bad_programs == 0, "no word programmed twice after recovery");
+
+        // And the store still works afterwards
+        check(KV_set(0, value, make_value(0, 1, value)) == HAL_OK && stored_matches(0, 1, 1), "set after recovery");
+        if (failures) printf("  failed on run %u (seed %u)\n", run, run + 100U);
+    }
+    printf("power cut: %u cuts recovered\n", cuts);
+}
+
+// HELPER FUNCTIONS ==============================================================
+static uint32_t random_below(uint32_t n) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state % n;
+}
+
+static uint32_t make_value(uint16_t key, uint32_t version, uint8_t* value) {
+    uint32_t len = (key * 7U + version * 13U) % (SIM_MAX_LEN + 1U);
+    for (uint32_t i = 0; i < len; i++) {
+        value[i] = (uint8_t)(key + version * 31U + i * 3U);
+    }
+    return len;
+}
+
+static uint8_t stored_matches(uint16_t key, uint8_t exists, uint32_t version) {
+    uint8_t expected[SIM_MAX_LEN];
+    uint8_t buffer[SIM_MAX_LEN];
+    int32_t len = KV_get(key, buffer, sizeof(buffer));
+    if (!exists) return len == -1;
+
+    uint32_t expected_len = make_value(key, version, expected);
+    return len == (int32_t)expected_len && memcmp(buffer, expected, expected_len) == 0;
+}
+
+static void check(uint8_t condition, const char* what) {
+    if (condition) return;
+    if (failures < 10U) printf("FAILED: %s\n", what);
+    failures++;
+}
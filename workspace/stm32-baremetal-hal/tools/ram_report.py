@@ -0,0 +1,229 @@
+#!/usr/bin/env python3
+"""
+RAM and flash budget report from the GNU ld map file (-Wl,-Map=...).
+
+Breaks .text/.rodata/.data/.bss down per object file (module), then shows how RAM is split between
+static data, the heap and stack reservations (_Min_Heap_Size/_Min_Stack_Size) and what's left over.
+Given the results of an emulator run (tools/run_emulator_tests.sh), it also shows the measured stack and
+heap high water marks from utils/mem_stats.h next to the reservations.
+
+Usage:
+    python3 tools/ram_report.py Debug/stm32-baremetal-hal.map
+    python3 tools/ram_report.py build/autotest/autotest.map --results build/autotest/test_results.jsonl
+    python3 tools/ram_report.py Debug/stm32-baremetal-hal.map --sort bss --top 10 --ram-budget 100K
+
+With --ram-budget the script exits non zero if static RAM plus the stack and heap (measured high water marks
+when --results is given, otherwise the reservations) goes over the budget.
+
+Written by Ryan Wong
+"""
+
+import argparse
+import json
+import os
+import re
+import sys
+
+COLUMNS = ["text", "rodata", "data", "bss"]
+
+MEMORY_LINE = re.compile(r"^(\S+)\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+)")
+OUTPUT_SECTION = re.compile(r"^(\.\S+|COMMON)(?:\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+))?")
+INPUT_SECTION = re.compile(r"^ (\.\S+|COMMON)(?:\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+)\s+(\S.*))?$")
+WRAPPED_INPUT = re.compile(r"^\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+)\s+(\S.*)$")
+SYMBOL_ASSIGNMENT = re.compile(r"^\s+0x([0-9a-fA-F]+)\s+(_Min_Heap_Size|_Min_Stack_Size|_estack)\s*=")
+
+
+def parse_size(text):
+    text = text.strip().upper()
+    scale = 1
+    if text.endswith("K"):
+        scale, text = 1024, text[:-1]
+    elif text.endswith("M"):
+        scale, text = 1024 * 1024, text[:-1]
+    return int(text, 0) * scale
+
+
+def module_name(path, expand_libs):
+    """./Src/drivers/gpio_driver.o -> Src/drivers/gpio_driver.o, /long/path/libc_nano.a(lib_a-memcpy.o) -> libc_nano.a"""
+    path = path.strip()
+    archive = re.match(r"^(.*\.a)\((.*)\)$", path)
+    if archive:
+        library = os.path.basename(archive.group(1))
+        return "{}({})".format(library, archive.group(2)) if expand_libs else library
+    if path.startswith("./"):
+        path = path[2:]
+    return path
+
+
+def classify(output_section, address, regions):
+    """Which column an input section counts towards, or None if it isn't loaded (debug info, INFO sections)"""
+    if output_section == ".data":
+        return "data"
+    if output_section == ".bss":
+        return "bss"
+    if output_section.startswith(".rodata"):
+        return "rodata"
+    if output_section == "._user_heap_stack" or region_of(address, regions) is None:
+        return None
+    # Everything else that gets loaded is code, or tables the code needs (vectors, exception index, init arrays)
+    return "text"
+
+
+def region_of(address, regions):
+    for region in regions:
+        if region["origin"] <= address < region["origin"] + region["length"]:
+            return region
+    return None
+
+
+def parse_map(path, expand_libs):
+    regions = []
+    symbols = {}
+    modules = {}
+    state = "start"
+    output_section = None
+    pending_input = None
+
+    with open(path, errors="replace") as map_file:
+        for line in map_file:
+            line = line.rstrip("\n")
+
+            if line.startswith("Memory Configuration"):
+                state = "memory"
+                continue
+            if line.startswith("Linker script and memory map"):
+                state = "map"
+                continue
+
+            if state == "memory":
+                match = MEMORY_LINE.match(line)
+                if match and match.group(1) not in ("Name", "*default*"):
+                    attributes = line.split()[3] if len(line.split()) > 3 else ""
+                    regions.append({"name": match.group(1), "origin": int(match.group(2), 16),
+                                    "length": int(match.group(3), 16), "attributes": attributes})
+                continue
+            if state != "map":
+                continue
+
+            match = SYMBOL_ASSIGNMENT.match(line)
+            if match:
+                symbols[match.group(2)] = int(match.group(1), 16)
+                continue
+
+            # A long input section name puts its address, size and file on the next line
+            if pending_input is not None:
+                match = WRAPPED_INPUT.match(line)
+                if match:
+                    add_input(modules, output_section, int(match.group(1), 16), int(match.group(2), 16),
+                              match.group(3), regions, expand_libs)
+                pending_input = None
+                continue
+
+            if line and not line[0].isspace():
+                match = OUTPUT_SECTION.match(line)
+                output_section = match.group(1) if match else None
+                continue
+
+            match = INPUT_SECTION.match(line)
+            if match and output_section is not None:
+                if match.group(2) is None:
+                    pending_input = match.group(1)
+                else:
+                    add_input(modules, output_section, int(match.group(2), 16), int(match.group(3), 16),
+                              match.group(4), regions, expand_libs)
+
+    return regions, symbols, modules
+
+
+def add_input(modules, output_section, address, size, source, regions, expand_libs):
+    if size == 0:
+        return
+    column = classify(output_section, address, regions)
+    if column is None:
+        return
+    sizes = modules.setdefault(module_name(source, expand_libs), dict.fromkeys(COLUMNS, 0))
+    sizes[column] += size
+
+
+def load_metrics(path):
+    metrics = {}
+    with open(path) as results:
+        for line in results:
+            line = line.strip()
+            if not line:
+                continue
+            record = json.loads(line)
+            if record.get("type") == "metric":
+                metrics[record["name"]] = record["value"]
+    return metrics
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Per module RAM/flash usage and RAM budget from a linker map file")
+    parser.add_argument("map")
+    parser.add_argument("--results", help="test_results.jsonl from the emulator run, for measured stack/heap use")
+    parser.add_argument("--sort", choices=COLUMNS + ["ram", "name"], default="ram")
+    parser.add_argument("--top", type=int, default=0, help="only show this many modules")
+    parser.add_argument("--expand-libs", action="store_true", help="one row per archive member instead of per library")
+    parser.add_argument("--ram-budget", type=parse_size, help="fail if RAM use goes over this (e.g. 100K)")
+    args = parser.parse_args()
+
+    regions, symbols, modules = parse_map(args.map, args.expand_libs)
+    if not modules:
+        raise SystemExit("no sections found in {}, is it a GNU ld map file?".format(args.map))
+
+    def sort_key(item):
+        name, sizes = item
+        if args.sort == "name":
+            return name
+        if args.sort == "ram":
+            return -(sizes["data"] + sizes["bss"])
+        return -sizes[args.sort]
+
+    rows = sorted(modules.items(), key=sort_key)
+    if args.top:
+        rows = rows[:args.top]
+
+    print("{:<48} {:>8} {:>8} {:>8} {:>8}".format("module", *COLUMNS))
+    for name, sizes in rows:
+        print("{:<48} {:>8} {:>8} {:>8} {:>8}".format(name[-48:], *(sizes[c] for c in COLUMNS)))
+    totals = {c: sum(sizes[c] for sizes in modules.values()) for c in COLUMNS}
+    print("{:<48} {:>8} {:>8} {:>8} {:>8}".format("total", *(totals[c] for c in COLUMNS)))
+
+    ram = next((r for r in regions if r["name"] == "RAM"), None)
+    heap_reserved = symbols.get("_Min_Heap_Size", 0)
+    stack_reserved = symbols.get("_Min_Stack_Size", 0)
+    metrics = load_metrics(args.results) if args.results else {}
+
+    static = totals["data"] + totals["bss"]
+    heap = metrics.get("heap_high_water", heap_reserved)
+    stack = metrics.get("stack_high_water", stack_reserved)
+    measured = " (measured)" if metrics else " (reserved)"
+
+    print()
+    if ram is not None:
+        print("RAM 0x{:08X}, {} bytes".format(ram["origin"], ram["length"]))
+    print("  {:<28} {:>8}".format(".data", totals["data"]))
+    print("  {:<28} {:>8}".format(".bss", totals["bss"]))
+    print("  {:<28} {:>8}{}".format("heap reserved", heap_reserved,
+                                    "   high water {}".format(metrics["heap_high_water"]) if "heap_high_water" in metrics else ""))
+    print("  {:<28} {:>8}{}".format("stack reserved", stack_reserved,
+                                    "   high water {}".format(metrics["stack_high_water"]) if "stack_high_water" in metrics else ""))
+    if "stack_high_water" in metrics and metrics["stack_high_water"] > stack_reserved:
+        print("  WARNING: the stack went {} bytes past _Min_Stack_Size".format(metrics["stack_high_water"] - stack_reserved))
+    if ram is not None:
+        print("  {:<28} {:>8}".format("free after reservations", ram["length"] - static - heap_reserved - stack_reserved))
+    if "ram_unused_bytes" in metrics:
+        print("  {:<28} {:>8}".format("never touched (measured)", metrics["ram_unused_bytes"]))
+
+    if args.ram_budget is not None:
+        used = static + heap + stack
+        verdict = "over" if used > args.ram_budget else "within"
+        print("\nRAM use{} {} is {} the budget of {}".format(measured, used, verdict, args.ram_budget))
+        if used > args.ram_budget:
+            return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,62 @@
+#!/usr/bin/env bash
+#
+# Builds the HAL_AUTOTEST firmware and runs it under QEMU (netduinoplus2 = STM32F405, same Cortex-M4F core and
+# flash/SRAM addresses as the F446), then checks the results against the benchmark baseline.
+#
+# Needs arm-none-eabi-gcc, qemu-system-arm (7.0 or newer) and python3 on the PATH.
+#
+# Usage (from workspace/stm32-baremetal-hal):
+#   tools/run_emulator_tests.sh            # build, run, fail on test failures or benchmark regressions
+#   tools/run_emulator_tests.sh --update   # same, but record the current numbers as the new baseline
+#
+# A missing baseline is a failure rather than an implicit --update, so a lost or uncommitted
+# tools/bench_baseline.json can't turn the benchmark gate into a pass.
+#
+# -icount shift=0 makes QEMU's clock advance a fixed amount per instruction, so SysTick based benchmark
+# numbers are deterministic and only change when the generated code changes. check_bench.py turns them back
+# into instructions per call with the same shift.
+#
+# Written by Ryan Wong
+
+set -euo pipefail
+
+cd "$(dirname "$0")/.."
+BUILD_DIR=build/autotest
+BASELINE=tools/bench_baseline.json
+ICOUNT_SHIFT=0
+ELF="$BUILD_DIR/autotest.elf"
+
+CFLAGS=(-mcpu=cortex-m4 -mthumb -mfpu=fpv4-sp-d16 -mfloat-abi=hard
+        -O2 -g3 -std=gnu11 -Wall -ffunction-sections -fdata-sections
+        -DHAL_AUTOTEST -IInc)
+LDFLAGS=(-T STM32F446RETX_FLASH.ld --specs=nano.specs -Wl,--gc-sections
+         -Wl,-Map="$BUILD_DIR/autotest.map" -Wl,--no-warn-rwx-segments)
+
+mkdir -p "$BUILD_DIR"
+arm-none-eabi-gcc "${CFLAGS[@]}" \
+    Startup/startup_stm32f446retx.s Src/*.c Src/drivers/*.c Src/utils/*.c Test/*.c \
+    "${LDFLAGS[@]}" -o "$ELF"
+arm-none-eabi-size "$ELF"
+
+# Semihosting file writes land in QEMU's working directory
+rm -f "$BUILD_DIR/test_results.jsonl"
+status=0
+(cd "$BUILD_DIR" && timeout 60 qemu-system-arm -M netduinoplus2 -nographic -monitor none -serial null \
+    -semihosting-config enable=on,target=native -icount shift=$ICOUNT_SHIFT -kernel autotest.elf) || status=$?
+
+if [ ! -f "$BUILD_DIR/test_results.jsonl" ]; then
+    echo "no results file, the firmware crashed or hung (exit status $status)"
+    exit 1
+fi
+
+python3 tools/ram_report.py "$BUILD_DIR/autotest.map" --results "$BUILD_DIR/test_results.jsonl" --top 10
+echo
+
+if [ "${1:-}" = "--update" ]; then
+    python3 tools/check_bench.py "$BUILD_DIR/test_results.jsonl" "$BASELINE" --icount-shift "$ICOUNT_SHIFT" --update
+elif [ ! -f "$BASELINE" ]; then
+    echo "no benchmark baseline ($BASELINE), record one with tools/run_emulator_tests.sh --update and commit it"
+    exit 1
+else
+    python3 tools/check_bench.py "$BUILD_DIR/test_results.jsonl" "$BASELINE" --icount-shift "$ICOUNT_SHIFT"
+fi
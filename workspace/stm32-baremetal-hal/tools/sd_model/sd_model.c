@@ -0,0 +1,733 @@
+/*
+ * sd_model.c
+ *
+ * implementation file for sd_model.h
+ * Card states, responses and register layouts follow the SD Physical Layer Simplified Specification.
+ * Only what sd_card.c uses is modelled: no CMD23, erase, lock, SPI mode or UHS-I
+ *
+ *  Written by Ryan Wong
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include "sd_model.h"
+
+#define MODEL_BLOCK_SIZE 512U
+#define MODEL_RCA 0xB368U
+
+#define STATE_IDLE 0U
+#define STATE_READY 1U
+#define STATE_IDENT 2U
+#define STATE_STBY 3U
+#define STATE_TRAN 4U
+#define STATE_DATA 5U
+#define STATE_RCV 6U
+#define STATE_PRG 7U
+
+#define R1_OUT_OF_RANGE (0x01U << 31)
+#define R1_ADDRESS_ERROR (0x01U << 30)
+#define R1_BLOCK_LEN_ERROR (0x01U << 29)
+#define R1_READY_FOR_DATA (0x01U << 8)
+#define R1_APP_CMD (0x01U << 5)
+
+#define OCR_VOLTAGES 0x00FF8000U
+#define OCR_HCS (0x01U << 30)
+#define OCR_READY (0x01U << 31)
+
+// Command: 48 bits + 2 turnaround (Ncr) + 8 (Ncc). Responses: 48 or 136 bits
+#define CMD_CLOCKS 58U
+#define SHORT_RESP_CLOCKS 48U
+#define LONG_RESP_CLOCKS 136U
+// Per block on the data lines: start bit, CRC16, end bit, then CRC status (start, 3 bits, end) and Nwr gap
+#define BLOCK_OVERHEAD_CLOCKS 25U
+
+typedef struct {
+    uint8_t active;
+    uint8_t read;
+    uint8_t started; // reads only start moving once their command arrives
+    uint8_t failed;
+    uint8_t* buffer;
+    uint32_t len;
+    uint32_t block_size;
+    double done_at;
+} Model_Data;
+
+static SD_Model_Config config;
+static SD_Model_Stats stats;
+static uint8_t* storage = NULL;
+
+// host side
+static uint32_t host_clock = 0;
+static uint8_t host_width = 1;
+static Model_Data data;
+static uint32_t inject_countdown = 0;
+
+// card side
+static uint32_t state = STATE_IDLE;
+static uint8_t card_width = 1;
+static uint8_t card_high_speed = 0;
+static uint8_t app_pending = 0;
+static uint8_t if_cond_seen = 0;
+static uint8_t hcs_requested = 0;
+static uint32_t op_cond_polls = 0;
+static uint32_t block_len = MODEL_BLOCK_SIZE;
+static uint32_t position = 0; // next block of a write
+static uint8_t multi_write = 0;
+static uint8_t first_write_transfer = 0;
+static uint32_t pre_erase = 0;
+static double busy_until = 0.0;
+static double ready_for_block = 0.0; // when a write's next block can start on the bus
+static uint32_t cid[4];
+static uint32_t csd[4];
+
+static HAL_Status model_send_command(uint8_t index, uint32_t arg, SD_Response response, uint32_t* resp);
+static uint32_t model_set_clock(uint32_t max_hz);
+static HAL_Status model_set_bus_width(uint8_t width);
+static HAL_Status model_start_data(uint8_t read, void* buffer, uint32_t len, uint32_t block_size, uint32_t timeout_ms);
+static SD_Data_State model_data_poll(void);
+static void model_abort_data(void);
+
+static const SD_Host_Ops model_ops = {
+    .send_command = model_send_command,
+    .set_clock = model_set_clock,
+    .set_bus_width = model_set_bus_width,
+    .start_data = model_start_data,
+    .data_poll = model_data_poll,
+    .abort_data = model_abort_data
+};
+
+static void violation(const char* format, ...);
+static double clocks_us(uint32_t clocks);
+static double block_bus_us(uint32_t block_size);
+static uint32_t card_max_clock(void);
+static uint8_t switch_supported(void);
+static uint32_t status_bits(void);
+static uint8_t rca_matches(uint32_t arg);
+static uint8_t take_block_address(uint32_t arg, uint32_t* block);
+static uint8_t start_read(uint32_t block, uint32_t blocks);
+static void start_control_read(const uint8_t* source, uint32_t len);
+static void start_write_transfer(void);
+static uint8_t consume_injected_error(void);
+static void set_bits(uint32_t* reg, uint32_t msb, uint32_t lsb, uint32_t value);
+static void build_registers(void);
+
+// MODEL FUNCTIONS ==============================================================
+void SD_model_default_config(SD_Model_Config* cfg, uint8_t high_capacity) {
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->present = 1;
+    cfg->high_capacity = high_capacity;
+    cfg->supports_4bit = 1;
+    cfg->supports_high_speed = high_capacity;
+    cfg->block_count = high_capacity ? 131072U : 65536U;
+    cfg->sdioclk_hz = 16000000U;
+    cfg->power_up_polls = 50;
+    cfg->read_access_us = 100.0;
+    cfg->write_start_us = 300.0;
+    cfg->block_program_us = 40.0;
+    cfg->single_busy_us = 800.0;
+    cfg->stop_busy_us = 2000.0;
+}
+
+void SD_model_init(const SD_Model_Config* cfg) {
+    config = *cfg;
+    memset(&stats, 0, sizeof(stats));
+    memset(&data, 0, sizeof(data));
+
+    free(storage);
+    storage = malloc((size_t)config.block_count * MODEL_BLOCK_SIZE);
+    if (storage == NULL) {
+        fprintf(stderr, "sd_model: out of memory\n");
+        exit(2);
+    }
+    memset(storage, 0xFF, (size_t)config.block_count * MODEL_BLOCK_SIZE);
+
+    host_clock = 0;
+    host_width = 1;
+    inject_countdown = 0;
+    state = STATE_IDLE;
+    card_width = 1;
+    card_high_speed = 0;
+    app_pending = 0;
+    if_cond_seen = 0;
+    hcs_requested = 0;
+    op_cond_polls = 0;
+    block_len = MODEL_BLOCK_SIZE;
+    busy_until = 0.0;
+    build_registers();
+}
+
+const SD_Host_Ops* SD_model_ops(void) {
+    return &model_ops;
+}
+
+void SD_model_inject_data_error(uint32_t transfers) {
+    inject_countdown = transfers;
+}
+
+void SD_model_advance_us(double us) {
+    stats.time_us += us;
+}
+
+const uint8_t* SD_model_storage(void) {
+    return storage;
+}
+
+SD_Model_Stats* SD_model_get_stats(void) {
+    return &stats;
+}
+
+// HOST OPS ==============================================================
+/**
+ * A card that doesn't answer (no card, illegal command, wrong state) is a response timeout, 64 clocks
+ */
+static HAL_Status model_send_command(uint8_t index, uint32_t arg, SD_Response response, uint32_t* resp) {
+    stats.commands++;
+    stats.time_us += clocks_us(CMD_CLOCKS);
+
+    if (!config.present) {
+        stats.time_us += clocks_us(64U);
+        return HAL_ERROR;
+    }
+    if (state <= STATE_IDENT && host_clock > SD_IDENT_CLOCK) {
+        violation("CMD%u sent at %u Hz during identification", index, host_clock);
+    }
+    if (host_clock > card_max_clock()) {
+        violation("CMD%u sent at %u Hz, card only allows %u Hz", index, host_clock, card_max_clock());
+    }
+    if (data.active && !data.read && index != 12U && index != 13U) {
+        violation("CMD%u sent while write data is moving", index);
+    }
+
+    // Programming finishes on its own, CMD13 just sees it
+    if (state == STATE_PRG && stats.time_us >= busy_until) state = STATE_TRAN;
+
+    uint8_t app = app_pending;
+    app_pending = 0;
+    uint32_t status = status_bits() | (app ? R1_APP_CMD : 0U);
+    SD_Response expected = SD_RESPONSE_R1;
+    uint8_t answered = 1;
+    uint32_t words[4] = {0};
+
+    if (app) {
+        switch (index) {
+            case 6U:
+                if (state != STATE_TRAN || (arg != 0U && arg != 2U) || (arg == 2U && !config.supports_4bit)) {
+                    answered = 0;
+                    break;
+                }
+                card_width = (arg == 2U) ? 4U : 1U;
+                words[0] = status;
+                break;
+            case 23U:
+                if (state != STATE_TRAN) {
+                    answered = 0;
+                    break;
+                }
+                pre_erase = arg & 0x7FFFFFU;
+                stats.pre_erase_hints++;
+                words[0] = status;
+                break;
+            case 41U:
+                expected = SD_RESPONSE_R3;
+                if (state != STATE_IDLE) {
+                    answered = 0;
+                    break;
+                }
+                if (arg & OCR_HCS) hcs_requested = 1;
+                words[0] = OCR_VOLTAGES;
+                // A v2.0 card that was asked CMD8 but not given HCS never comes out of busy if it is SDHC
+                if (++op_cond_polls > config.power_up_polls && !(config.high_capacity && !(arg & OCR_HCS))) {
+                    words[0] |= OCR_READY | ((config.high_capacity && hcs_requested && if_cond_seen) ? OCR_HCS : 0U);
+                    state = STATE_READY;
+                }
+                break;
+            case 51U: {
+                if (state != STATE_TRAN) {
+                    answered = 0;
+                    break;
+                }
+                // SCR: structure 0, SD_SPEC 2 (2.00) or 0 (1.01), erased data = 0, bus widths 1 (+4)
+                uint8_t scr[8] = {0};
+                scr[0] = switch_supported() ? 0x02U : 0x00U;
+                scr[1] = config.supports_4bit ? 0x05U : 0x01U;
+                words[0] = status;
+                start_control_read(scr, sizeof(scr));
+                break;
+            }
+            default:
+                // Not an application command, the card treats it as the regular one
+                app = 0;
+                break;
+        }
+    }
+
+    if (!app) {
+        switch (index) {
+            case 0U:
+                expected = SD_RESPONSE_NONE;
+                state = STATE_IDLE;
+                card_width = 1;
+                card_high_speed = 0;
+                if_cond_seen = 0;
+                hcs_requested = 0;
+                op_cond_polls = 0;
+                block_len = MODEL_BLOCK_SIZE;
+                break;
+            case 2U:
+                expected = SD_RESPONSE_R2;
+                if (state != STATE_READY) {
+                    answered = 0;
+                    break;
+                }
+                memcpy(words, cid, sizeof(words));
+                state = STATE_IDENT;
+                break;
+            case 3U:
+                expected = SD_RESPONSE_R6;
+                if (state != STATE_IDENT && state != STATE_STBY) {
+                    answered = 0;
+                    break;
+                }
+                state = STATE_STBY;
+                words[0] = (MODEL_RCA << 16) | (state << 9);
+                break;
+            case 6U: {
+                if (state != STATE_TRAN || !switch_supported()) {
+                    answered = 0; // a 1.01 card doesn't know CMD6
+                    break;
+                }
+                uint8_t switch_status[64] = {0};
+                uint32_t function = arg & 0x0FU;
+                switch_status[0] = 0x00U;
+                switch_status[1] = 0x64U; // 100mA
+                switch_status[13] = config.supports_high_speed ? 0x03U : 0x01U; // group 1 functions supported
+                if (function == 1U && !config.supports_high_speed) {
+                    switch_status[16] = 0x0FU;
+                } else {
+                    switch_status[16] = (uint8_t)((function == 0x0FU) ? (card_high_speed ? 1U : 0U) : function);
+                    if ((arg & 0x80000000U) && function == 1U) card_high_speed = 1;
+                    if ((arg & 0x80000000U) && function == 0U) card_high_speed = 0;
+                }
+                words[0] = status;
+                start_control_read(switch_status, sizeof(switch_status));
+                break;
+            }
+            case 7U:
+                expected = SD_RESPONSE_R1B;
+                if (state != STATE_STBY && state != STATE_TRAN) {
+                    answered = 0;
+                    break;
+                }
+                if ((arg >> 16) == MODEL_RCA) {
+                    if (state != STATE_STBY) {
+                        answered = 0;
+                        break;
+                    }
+                    words[0] = status;
+                    state = STATE_TRAN;
+                } else {
+                    // Deselecting (RCA 0 or someone else's) gives no response
+                    if (state == STATE_TRAN) state = STATE_STBY;
+                    answered = 0;
+                }
+                break;
+            case 8U:
+                expected = SD_RESPONSE_R7;
+                if (!config.high_capacity || state != STATE_IDLE) {
+                    answered = 0; // v1.x cards ignore CMD8
+                    break;
+                }
+                if_cond_seen = 1;
+                words[0] = arg & 0xFFFU;
+                break;
+            case 9U:
+                expected = SD_RESPONSE_R2;
+                if (state != STATE_STBY || !rca_matches(arg)) {
+                    answered = 0;
+                    break;
+                }
+                memcpy(words, csd, sizeof(words));
+                break;
+            case 12U:
+                expected = SD_RESPONSE_R1B;
+                if (state == STATE_DATA) {
+                    words[0] = status;
+                    state = STATE_TRAN;
+                    if (data.active && data.read) data.active = 0;
+                } else if (state == STATE_RCV) {
+                    words[0] = status;
+                    if (data.active && !data.read) {
+                        // Stopped mid transfer, only the blocks already on the bus count
+                        data.active = 0;
+                    }
+                    double program_done = (ready_for_block > stats.time_us) ? ready_for_block : stats.time_us;
+                    busy_until = program_done + config.stop_busy_us;
+                    state = STATE_PRG;
+                } else {
+                    answered = 0;
+                }
+                break;
+            case 13U:
+                if (state <= STATE_IDENT || !rca_matches(arg)) {
+                    answered = 0;
+                    break;
+                }
+                words[0] = status;
+                break;
+            case 16U:
+                if (state != STATE_TRAN) {
+                    answered = 0;
+                    break;
+                }
+                if (!config.high_capacity) {
+                    if (arg == 0U || arg > MODEL_BLOCK_SIZE) {
+                        words[0] = status | R1_BLOCK_LEN_ERROR;
+                        break;
+                    }
+                    block_len = arg;
+                }
+                words[0] = status;
+                break;
+            case 17U:
+            case 18U: {
+                if (state != STATE_TRAN) {
+                    answered = 0;
+                    break;
+                }
+                uint32_t block;
+                if (!take_block_address(arg, &block)) {
+                    words[0] = status | (config.high_capacity ? R1_OUT_OF_RANGE : R1_ADDRESS_ERROR);
+                    break;
+                }
+                words[0] = status;
+                uint32_t blocks = (index == 17U) ? 1U : 0U;
+                if (!start_read(block, blocks)) break;
+                if (index == 18U) state = STATE_DATA;
+                break;
+            }
+            case 24U:
+            case 25U: {
+                if (state != STATE_TRAN) {
+                    answered = 0;
+                    break;
+                }
+                uint32_t block;
+                if (!take_block_address(arg, &block)) {
+                    words[0] = status | (config.high_capacity ? R1_OUT_OF_RANGE : R1_ADDRESS_ERROR);
+                    break;
+                }
+                words[0] = status;
+                position = block;
+                multi_write = (index == 25U);
+                first_write_transfer = 1;
+                ready_for_block = stats.time_us + config.write_start_us;
+                state = STATE_RCV;
+                if (!multi_write) pre_erase = 0;
+                break;
+            }
+            case 55U:
+                if (state == STATE_IDLE ? (arg >> 16) != 0U : !rca_matches(arg)) {
+                    answered = 0;
+                    break;
+                }
+                app_pending = 1;
+                words[0] = status | R1_APP_CMD;
+                break;
+            default:
+                violation("CMD%u isn't supported by the model", index);
+                answered = 0;
+                break;
+        }
+    }
+
+    if (response != expected) {
+        violation("CMD%u%s sent expecting response %u, it has response %u", index, app ? " (app)" : "", response, expected);
+    }
+    if (!answered) {
+        // Probing CMD8 on a v1.x card and CMD6 on a 1.01 card are expected to time out, the rest is a mistake
+        if (!(index == 8U && !app) && !(index == 6U && !app)) {
+            violation("CMD%u%s not accepted in state %u", index, app ? " (app)" : "", state);
+        }
+        stats.time_us += clocks_us(64U);
+        return HAL_ERROR;
+    }
+    if (expected == SD_RESPONSE_NONE) return HAL_OK;
+
+    stats.time_us += clocks_us(expected == SD_RESPONSE_R2 ? LONG_RESP_CLOCKS : SHORT_RESP_CLOCKS);
+    if (resp != NULL) {
+        memcpy(resp, words, (expected == SD_RESPONSE_R2) ? sizeof(words) : sizeof(words[0]));
+    }
+    return HAL_OK;
+}
+
+/**
+ * Same divider rules as SDIO_set_clock(): SDIOCLK itself, or SDIOCLK / (div + 2)
+ */
+static uint32_t model_set_clock(uint32_t max_hz) {
+    if (max_hz == 0) return 0;
+
+    if (config.sdioclk_hz <= max_hz) {
+        host_clock = config.sdioclk_hz;
+        return host_clock;
+    }
+    uint32_t div = (config.sdioclk_hz + max_hz - 1U) / max_hz;
+    div = (div < 2U) ? 0U : div - 2U;
+    if (div > 0xFFU) return 0;
+    host_clock = config.sdioclk_hz / (div + 2U);
+    return host_clock;
+}
+
+static HAL_Status model_set_bus_width(uint8_t width) {
+    if (width != 1U && width != 4U) return HAL_ERROR;
+    if (data.active) violation("bus width changed while data is moving");
+
+    host_width = width;
+    return HAL_OK;
+}
+
+static HAL_Status model_start_data(uint8_t read, void* buffer, uint32_t len, uint32_t block_size, uint32_t timeout_ms) {
+    (void)timeout_ms;
+    if (
+        data.active ||
+        buffer == NULL ||
+        ((uintptr_t)buffer & 0x03U) ||
+        len == 0 ||
+        block_size == 0 ||
+        (block_size & (block_size - 1U)) ||
+        block_size > 16384U ||
+        len % block_size ||
+        len >= (0x01U << 25)
+    ) return HAL_ERROR;
+
+    memset(&data, 0, sizeof(data));
+    data.active = 1;
+    data.read = read;
+    data.buffer = buffer;
+    data.len = len;
+    data.block_size = block_size;
+    stats.data_transfers++;
+
+    if (!read) start_write_transfer();
+    return HAL_OK;
+}
+
+static SD_Data_State model_data_poll(void) {
+    if (!data.active) return SD_DATA_IDLE;
+
+    stats.time_us += SD_MODEL_POLL_US;
+    if (data.read && !data.started) {
+        // Armed but the command never came: the host's data timeout fires eventually
+        return SD_DATA_BUSY;
+    }
+    if (stats.time_us < data.done_at) return SD_DATA_BUSY;
+
+    data.active = 0;
+    return data.failed ? SD_DATA_ERROR : SD_DATA_IDLE;
+}
+
+static void model_abort_data(void) {
+    data.active = 0;
+}
+
+// HELPER FUNCTIONS ==============================================================
+static void violation(const char* format, ...) {
+    if (stats.violations++ == 0) {
+        va_list args;
+        va_start(args, format);
+        vsnprintf(stats.first_violation, sizeof(stats.first_violation), format, args);
+        va_end(args);
+    }
+}
+
+static double clocks_us(uint32_t clocks) {
+    return host_clock ? (clocks * 1e6) / host_clock : 0.0;
+}
+
+static double block_bus_us(uint32_t block_size) {
+    return clocks_us(block_size * 8U / host_width + BLOCK_OVERHEAD_CLOCKS);
+}
+
+static uint32_t card_max_clock(void) {
+    if (state <= STATE_IDENT) return SD_DEFAULT_SPEED_CLOCK; // 400kHz is checked separately
+    return card_high_speed ? SD_HIGH_SPEED_CLOCK : SD_DEFAULT_SPEED_CLOCK;
+}
+
+/**
+ * The model claims SD 2.00 (which has CMD6) for SDHC or high speed cards, 1.01 otherwise
+ */
+static uint8_t switch_supported(void) {
+    return config.high_capacity || config.supports_high_speed;
+}
+
+static uint32_t status_bits(void) {
+    uint32_t ready = (state == STATE_TRAN || state == STATE_RCV) ? R1_READY_FOR_DATA : 0U;
+    return (state << 9) | ready;
+}
+
+static uint8_t rca_matches(uint32_t arg) {
+    return (arg >> 16) == MODEL_RCA;
+}
+
+/**
+ * SDHC addresses are block numbers, SDSC ones bytes that have to be block aligned
+ */
+static uint8_t take_block_address(uint32_t arg, uint32_t* block) {
+    if (!config.high_capacity) {
+        if (arg % block_len) return 0;
+        arg /= MODEL_BLOCK_SIZE;
+    }
+    if (arg >= config.block_count) return 0;
+    *block = arg;
+    return 1;
+}
+
+/**
+ * blocks = 0 means open ended (CMD18), the armed transfer decides how much actually moves
+ */
+static uint8_t start_read(uint32_t block, uint32_t blocks) {
+    if (!data.active || !data.read || data.started) {
+        violation("read command sent without the read data armed first");
+        return 0;
+    }
+    data.started = 1;
+    if (data.block_size != MODEL_BLOCK_SIZE || (blocks && data.len != blocks * MODEL_BLOCK_SIZE)) {
+        violation("read armed for %u bytes in blocks of %u", data.len, data.block_size);
+        data.failed = 1;
+    }
+    if (host_width != card_width) {
+        violation("read with host on %u lines, card on %u", host_width, card_width);
+        data.failed = 1;
+    }
+    uint32_t count = data.len / MODEL_BLOCK_SIZE;
+    if (block + count > config.block_count) {
+        // The card reads up to the end, then flags OUT_OF_RANGE and stops sending
+        data.failed = 1;
+        count = config.block_count - block;
+    }
+    if (consume_injected_error()) data.failed = 1;
+
+    if (!data.failed) {
+        memcpy(data.buffer, storage + (size_t)block * MODEL_BLOCK_SIZE, (size_t)count * MODEL_BLOCK_SIZE);
+        stats.bytes_read += (uint64_t)count * MODEL_BLOCK_SIZE;
+    }
+    data.done_at = stats.time_us + config.read_access_us + count * block_bus_us(MODEL_BLOCK_SIZE);
+    return 1;
+}
+
+static void start_control_read(const uint8_t* source, uint32_t len) {
+    if (!data.active || !data.read || data.started) {
+        violation("control read sent without the read data armed first");
+        return;
+    }
+    data.started = 1;
+    if (data.len != len || data.block_size != len) {
+        violation("control read armed for %u bytes, card sends %u", data.len, len);
+        data.failed = 1;
+    }
+    if (host_width != card_width) {
+        violation("control read with host on %u lines, card on %u", host_width, card_width);
+        data.failed = 1;
+    }
+    if (!data.failed) memcpy(data.buffer, source, len);
+    data.done_at = stats.time_us + block_bus_us(len);
+}
+
+/**
+ * Blocks go onto the bus back to back, each one waiting for the card to be ready for it: the first one waits
+ * out the write start latency, after that the card takes a block every block_program_us at most
+ */
+static void start_write_transfer(void) {
+    data.started = 1;
+    if (state != STATE_RCV) {
+        violation("write data started in state %u (write command missing)", state);
+        data.failed = 1;
+        data.done_at = stats.time_us;
+        return;
+    }
+    if (data.block_size != MODEL_BLOCK_SIZE) {
+        violation("write in blocks of %u", data.block_size);
+        data.failed = 1;
+    }
+    if (host_width != card_width) {
+        violation("write with host on %u lines, card on %u", host_width, card_width);
+        data.failed = 1;
+    }
+    if (!multi_write && !first_write_transfer) {
+        violation("second data transfer after a single block write");
+        data.failed = 1;
+    }
+    first_write_transfer = 0;
+
+    uint32_t count = data.len / MODEL_BLOCK_SIZE;
+    if (!multi_write && count != 1U) {
+        violation("single block write given %u blocks", count);
+        data.failed = 1;
+    }
+    if (position + count > config.block_count) data.failed = 1;
+    if (consume_injected_error()) data.failed = 1;
+
+    double bus = block_bus_us(MODEL_BLOCK_SIZE);
+    double t = stats.time_us;
+    for (uint32_t i = 0; i < count; i++) {
+        if (t < ready_for_block) t = ready_for_block;
+        t += bus;
+        double per_block = (config.block_program_us > bus) ? config.block_program_us : bus;
+        ready_for_block = t - bus + per_block;
+    }
+    data.done_at = t;
+
+    if (!data.failed) {
+        memcpy(storage + (size_t)position * MODEL_BLOCK_SIZE, data.buffer, (size_t)count * MODEL_BLOCK_SIZE);
+        stats.bytes_written += (uint64_t)count * MODEL_BLOCK_SIZE;
+        position += count;
+    }
+    if (!multi_write) {
+        busy_until = t + config.single_busy_us;
+        state = STATE_PRG;
+    } else if (data.failed) {
+        // A block with a bad CRC is refused and the card waits for the stop
+        position = config.block_count;
+    }
+}
+
+static uint8_t consume_injected_error(void) {
+    if (inject_countdown == 0) return 0;
+    return --inject_countdown == 0;
+}
+
+/**
+ * Bits msb:lsb of a 128 bit register stored bits 127:96 first, like sd_card.c reads them
+ */
+static void set_bits(uint32_t* reg, uint32_t msb, uint32_t lsb, uint32_t value) {
+    for (uint32_t bit = lsb; bit <= msb; bit++) {
+        uint32_t word = 3U - bit / 32U;
+        reg[word] = (reg[word] & ~(0x01U << (bit % 32U))) | (((value >> (bit - lsb)) & 0x01U) << (bit % 32U));
+    }
+}
+
+static void build_registers(void) {
+    memset(cid, 0, sizeof(cid));
+    set_bits(cid, 127U, 120U, 0x03U); // manufacturer
+    set_bits(cid, 119U, 104U, 0x5344U); // "SD"
+    set_bits(cid, 103U, 72U, 0x4D4F444CU); // product name "MODL" (the 5th character left blank)
+    set_bits(cid, 55U, 24U, 0x12345678U); // serial
+    set_bits(cid, 0U, 0U, 1U);
+
+    memset(csd, 0, sizeof(csd));
+    set_bits(csd, 0U, 0U, 1U);
+    set_bits(csd, 103U, 96U, 0x32U); // TRAN_SPEED 25MHz
+    if (config.high_capacity) {
+        set_bits(csd, 127U, 126U, 1U);
+        set_bits(csd, 83U, 80U, 9U);
+        set_bits(csd, 69U, 48U, config.block_count / 1024U - 1U);
+    } else {
+        // (C_SIZE + 1) << (C_SIZE_MULT + 2) blocks of 512, C_SIZE_MULT = 7
+        set_bits(csd, 127U, 126U, 0U);
+        set_bits(csd, 83U, 80U, 9U);
+        set_bits(csd, 73U, 62U, config.block_count / 512U - 1U);
+        set_bits(csd, 49U, 47U, 7U);
+    }
+}
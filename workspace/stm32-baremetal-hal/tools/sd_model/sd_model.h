@@ -0,0 +1,98 @@
+/*
+ * sd_model.h
+ *
+ * Host controller + SD card model for running sd_card.c on the PC. Implements SD_Host_Ops against a card
+ * state machine that follows the simplified physical layer spec closely enough to catch protocol mistakes:
+ * commands sent in the wrong state, data not armed before a read command, identification above 400kHz,
+ * a bus clock the card wasn't switched up to, host and card bus widths disagreeing, bad addresses.
+ * Each mistake is counted as a violation (and the first one is kept as text).
+ *
+ * Time is simulated: commands and data cost bus clocks at the current clock and width, the card adds
+ * access/programming latencies, and every data_poll() costs SD_MODEL_POLL_US of CPU time. The harness can
+ * add CPU time of its own (e.g. filling a buffer) with SD_model_advance_us(), so throughput numbers
+ * include the overlap (or lack of it) between the CPU and the card
+ *
+ *  Written by Ryan Wong
+ */
+
+#ifndef SD_MODEL_H_
+#define SD_MODEL_H_
+
+#include <stdint.h>
+#include "utils/sd_card.h"
+
+#define SD_MODEL_POLL_US 0.5
+
+/**
+ * present - 0 simulates an empty slot (no command ever gets a response)
+ * high_capacity - 1 for a v2.0 SDHC card (block addressed), 0 for a v1.x SDSC card (byte addressed, no CMD8)
+ * supports_4bit, supports_high_speed - what the SCR and CMD6 advertise (high speed needs SD_SPEC >= 1.10)
+ * block_count - capacity, a multiple of 1024
+ * sdioclk_hz - clock the host divides the bus clock from, same rules as SDIO_set_clock()
+ * power_up_polls - ACMD41s answered busy before the card is ready
+ * read_access_us - card latency before the first block of a read
+ * write_start_us - card latency before it takes the first block after CMD24/CMD25
+ * block_program_us - internal programming time per block, overlapped with the bus (the card buffers)
+ * single_busy_us - busy after a single block write
+ * stop_busy_us - busy after CMD12 ends a multi block write
+ */
+typedef struct {
+    uint8_t present;
+    uint8_t high_capacity;
+    uint8_t supports_4bit;
+    uint8_t supports_high_speed;
+    uint32_t block_count;
+    uint32_t sdioclk_hz;
+    uint32_t power_up_polls;
+    double read_access_us;
+    double write_start_us;
+    double block_program_us;
+    double single_busy_us;
+    double stop_busy_us;
+} SD_Model_Config;
+
+typedef struct {
+    uint64_t commands;
+    uint64_t bytes_written;
+    uint64_t bytes_read;
+    uint64_t data_transfers;
+    uint64_t pre_erase_hints;
+    uint32_t violations;
+    char first_violation[160];
+    double time_us;
+} SD_Model_Stats;
+
+/**
+ * @brief Fills in a typical class 10 card: 64MB SDHC (or 32MB SDSC), 4 bit, high speed (SDHC only),
+ * 		  SDIOCLK = 16MHz (SYSCLK on HSI)
+ */
+void SD_model_default_config(SD_Model_Config* config, uint8_t high_capacity);
+
+/**
+ * @brief Powers up a blank (all 0xFF) card and resets the statistics and simulated time
+ */
+void SD_model_init(const SD_Model_Config* config);
+
+/**
+ * @brief Returns the backend to pass to SD_init()
+ */
+const SD_Host_Ops* SD_model_ops(void);
+
+/**
+ * @brief Makes the transfers-th data transfer from now (1 = the next one) fail with a CRC error. 0 disarms
+ */
+void SD_model_inject_data_error(uint32_t transfers);
+
+/**
+ * @brief Adds CPU time that isn't spent talking to the card
+ */
+void SD_model_advance_us(double us);
+
+/**
+ * @brief The card's contents, block_count * 512 bytes
+ */
+const uint8_t* SD_model_storage(void);
+
+SD_Model_Stats* SD_model_get_stats(void);
+
+#endif
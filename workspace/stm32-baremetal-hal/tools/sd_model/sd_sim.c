@@ -0,0 +1,362 @@
+/*
+ * sd_sim.c
+ *
+ * Runs the real sd_card.c against the SD card model on the PC:
+ *   1. identification of SDHC and SDSC cards, with and without 4 bit / high speed support, and an empty slot
+ *   2. random single and multi block reads/writes checked against a copy of what the card should hold
+ *   3. streaming writes with two buffers, the CPU filling one while the other goes to the card, compared against
+ *      writing each buffer with its own command and against single block writes, at 16MHz and 48MHz SDIOCLK
+ *   4. data CRC errors in the middle of reads and streams, and the card still working afterwards
+ * Every test also fails if the model caught a protocol violation (wrong state, clock too fast, data not armed...)
+ *
+ * Build and run from workspace/stm32-baremetal-hal:
+ *   gcc -std=c99 -O2 -Wall -Wextra -IInc -Itools/sd_model tools/sd_model/sd_model.c tools/sd_model/sd_sim.c Src/utils/sd_card.c -o sd_sim && ./sd_sim
+ *
+ * Exits non zero if any check fails
+ *
+ *  Written by Ryan Wong
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include "utils/sd_card.h"
+#include "sd_model.h"
+
+#define SIM_RANDOM_OPS 2000U
+#define SIM_MAX_BLOCKS 64U
+#define SIM_STREAM_BYTES (4U * 1024U * 1024U)
+#define SIM_BUFFER_BLOCKS 32U // 16KB per buffer, same as Test/sd_card_test.c
+#define SIM_FILL_US_PER_KB 20.0 // CPU time to produce data, ~50MB/s
+#define SIM_MIN_STREAM_MBPS 5.0
+
+static uint32_t failures = 0;
+static uint32_t rng_state = 0x5D5EED01U;
+static uint8_t* shadow = NULL;
+static uint32_t buffers[2][SIM_BUFFER_BLOCKS * SD_BLOCK_SIZE / 4U];
+static uint32_t io_buffer[SIM_MAX_BLOCKS * SD_BLOCK_SIZE / 4U];
+
+static void init_test(void);
+static void random_test(uint8_t high_capacity);
+static void stream_test(uint32_t sdioclk_hz);
+static void error_test(void);
+static double stream_run(uint32_t first_block, uint32_t total_blocks);
+static double blocking_run(uint32_t first_block, uint32_t total_blocks);
+static double single_run(uint32_t first_block, uint32_t total_blocks);
+static uint32_t rng(void);
+static void fill_random(void* buffer, uint32_t len);
+static void fill_pattern(void* buffer, uint32_t first_block, uint32_t blocks);
+static uint8_t pattern_matches(const uint8_t* data, uint32_t first_block, uint32_t blocks);
+static uint8_t card_matches(uint32_t first_block, uint32_t blocks);
+static uint8_t start_card(const SD_Model_Config* config);
+static void check_no_violations(const char* test);
+static void check(uint8_t condition, const char* format, ...);
+
+int main(void) {
+    init_test();
+    random_test(1);
+    random_test(0);
+    stream_test(16000000U);
+    stream_test(48000000U);
+    error_test();
+
+    printf("%s (%u failures)\n", failures ? "FAIL" : "PASS", failures);
+    return failures ? 1 : 0;
+}
+
+// TESTS ==============================================================
+static void init_test(void) {
+    printf("identification\n");
+    SD_Model_Config config;
+    SD_Card_Info info;
+
+    SD_model_default_config(&config, 1);
+    check(start_card(&config), "SDHC init failed");
+    check(SD_get_info(&info) == HAL_OK, "no info after init");
+    check(info.high_capacity == 1 && info.high_speed == 1 && info.bus_width == 4, "SDHC: hc %u hs %u width %u",
+          info.high_capacity, info.high_speed, info.bus_width);
+    check(info.block_count == config.block_count, "SDHC: %u blocks, expected %u", info.block_count, config.block_count);
+    check(info.clock_hz == 16000000U, "SDHC: clock %u", info.clock_hz);
+    check_no_violations("SDHC init");
+    printf("  SDHC: %u blocks, %u bit, %u Hz, init took %.1f ms\n", info.block_count, info.bus_width, info.clock_hz,
+           SD_model_get_stats()->time_us / 1000.0);
+
+    SD_model_default_config(&config, 1);
+    config.sdioclk_hz = 48000000U;
+    check(start_card(&config) && SD_get_info(&info) == HAL_OK, "SDHC init at 48MHz failed");
+    check(info.clock_hz == 48000000U && info.high_speed, "SDHC at 48MHz: clock %u hs %u", info.clock_hz, info.high_speed);
+    check_no_violations("SDHC init at 48MHz");
+
+    // 2.00 card without high speed: CMD6 answers "function not supported", so it stays at 24MHz
+    config.supports_high_speed = 0;
+    check(start_card(&config) && SD_get_info(&info) == HAL_OK, "SDHC without high speed init failed");
+    check(info.clock_hz == 24000000U && !info.high_speed, "SDHC without high speed: clock %u hs %u", info.clock_hz, info.high_speed);
+    check_no_violations("SDHC without high speed init");
+
+    SD_model_default_config(&config, 0);
+    check(start_card(&config), "SDSC init failed");
+    check(SD_get_info(&info) == HAL_OK, "no SDSC info");
+    check(info.high_capacity == 0 && info.high_speed == 0 && info.bus_width == 4, "SDSC: hc %u hs %u width %u",
+          info.high_capacity, info.high_speed, info.bus_width);
+    check(info.block_count == config.block_count, "SDSC: %u blocks, expected %u", info.block_count, config.block_count);
+    check_no_violations("SDSC init");
+
+    config.supports_4bit = 0;
+    check(start_card(&config) && SD_get_info(&info) == HAL_OK && info.bus_width == 1, "1 bit SDSC init failed");
+    check_no_violations("1 bit SDSC init");
+
+    SD_model_default_config(&config, 1);
+    config.present = 0;
+    SD_model_init(&config);
+    check(SD_init(SD_model_ops()) == HAL_ERROR, "init succeeded with no card");
+    check(SD_get_info(&info) == HAL_ERROR, "info available with no card");
+    check(SD_read_blocks(0, io_buffer, 1) == HAL_ERROR, "read succeeded with no card");
+}
+
+static void random_test(uint8_t high_capacity) {
+    printf("random reads/writes (%s)\n", high_capacity ? "SDHC" : "SDSC");
+    SD_Model_Config config;
+    SD_model_default_config(&config, high_capacity);
+    if (!start_card(&config)) {
+        check(0, "init failed");
+        return;
+    }
+
+    // Keep the workload in a small window so reads mostly land on written data
+    uint32_t window = 4096U;
+    uint32_t base = config.block_count - window;
+    size_t shadow_len = (size_t)config.block_count * SD_BLOCK_SIZE;
+    shadow = malloc(shadow_len);
+    memcpy(shadow, SD_model_storage(), shadow_len);
+
+    for (uint32_t op = 0; op < SIM_RANDOM_OPS; op++) {
+        uint32_t count = (rng() % 4U == 0) ? 1U : 1U + rng() % SIM_MAX_BLOCKS;
+        uint32_t block = base + rng() % (window - count + 1U);
+        if (rng() % 2U) {
+            fill_random(io_buffer, count * SD_BLOCK_SIZE);
+            check(SD_write_blocks(block, io_buffer, count) == HAL_OK, "write %u+%u failed", block, count);
+            memcpy(shadow + (size_t)block * SD_BLOCK_SIZE, io_buffer, (size_t)count * SD_BLOCK_SIZE);
+        } else {
+            memset(io_buffer, 0, sizeof(io_buffer));
+            check(SD_read_blocks(block, io_buffer, count) == HAL_OK, "read %u+%u failed", block, count);
+            check(memcmp(io_buffer, shadow + (size_t)block * SD_BLOCK_SIZE, (size_t)count * SD_BLOCK_SIZE) == 0,
+                  "read %u+%u returned the wrong data", block, count);
+        }
+        if (failures) break;
+    }
+    check(memcmp(SD_model_storage(), shadow, shadow_len) == 0, "card contents differ from what was written");
+
+    // Past the end is refused before anything is sent
+    uint64_t commands = SD_model_get_stats()->commands;
+    check(SD_read_blocks(config.block_count - 1U, io_buffer, 2) == HAL_ERROR, "read past the end accepted");
+    check(SD_write_blocks(config.block_count, io_buffer, 1) == HAL_ERROR, "write past the end accepted");
+    check(SD_model_get_stats()->commands == commands, "commands sent for an out of range access");
+    check(SD_read_blocks(config.block_count - 1U, io_buffer, 1) == HAL_OK, "last block not readable");
+    check_no_violations("random reads/writes");
+
+    free(shadow);
+    shadow = NULL;
+}
+
+/**
+ * Same loop as the hardware test: refill a buffer as soon as it's off the queue, hand it over, repeat.
+ * Returns MB/s (1 MB = 10^6 bytes), 0 on failure
+ */
+static double stream_run(uint32_t first_block, uint32_t total_blocks) {
+    SD_Model_Stats* stats = SD_model_get_stats();
+    double start = stats->time_us;
+
+    if (SD_stream_begin(first_block, total_blocks) != HAL_OK) return 0.0;
+    for (uint32_t done = 0, i = 0; done < total_blocks; done += SIM_BUFFER_BLOCKS, i++) {
+        while (SD_stream_pending() > 1U);
+        fill_pattern(buffers[i % 2U], first_block + done, SIM_BUFFER_BLOCKS);
+        SD_model_advance_us(SIM_FILL_US_PER_KB * SIM_BUFFER_BLOCKS / 2U);
+        if (SD_stream_write(buffers[i % 2U], SIM_BUFFER_BLOCKS) != HAL_OK) {
+            SD_stream_end();
+            return 0.0;
+        }
+    }
+    if (SD_stream_end() != HAL_OK) return 0.0;
+    return (double)total_blocks * SD_BLOCK_SIZE / (stats->time_us - start);
+}
+
+/**
+ * Each buffer written with its own CMD25 + CMD12, nothing overlapped
+ */
+static double blocking_run(uint32_t first_block, uint32_t total_blocks) {
+    SD_Model_Stats* stats = SD_model_get_stats();
+    double start = stats->time_us;
+
+    for (uint32_t done = 0; done < total_blocks; done += SIM_BUFFER_BLOCKS) {
+        fill_pattern(buffers[0], first_block + done, SIM_BUFFER_BLOCKS);
+        SD_model_advance_us(SIM_FILL_US_PER_KB * SIM_BUFFER_BLOCKS / 2U);
+        if (SD_write_blocks(first_block + done, buffers[0], SIM_BUFFER_BLOCKS) != HAL_OK) return 0.0;
+    }
+    return (double)total_blocks * SD_BLOCK_SIZE / (stats->time_us - start);
+}
+
+static double single_run(uint32_t first_block, uint32_t total_blocks) {
+    SD_Model_Stats* stats = SD_model_get_stats();
+    double start = stats->time_us;
+
+    for (uint32_t done = 0; done < total_blocks; done++) {
+        fill_pattern(buffers[0], first_block + done, 1U);
+        SD_model_advance_us(SIM_FILL_US_PER_KB / 2U);
+        if (SD_write_blocks(first_block + done, buffers[0], 1U) != HAL_OK) return 0.0;
+    }
+    return (double)total_blocks * SD_BLOCK_SIZE / (stats->time_us - start);
+}
+
+static void stream_test(uint32_t sdioclk_hz) {
+    printf("streaming writes, SDIOCLK %u MHz\n", sdioclk_hz / 1000000U);
+    SD_Model_Config config;
+    SD_model_default_config(&config, 1);
+    config.sdioclk_hz = sdioclk_hz;
+    if (!start_card(&config)) {
+        check(0, "init failed");
+        return;
+    }
+
+    uint32_t total = SIM_STREAM_BYTES / SD_BLOCK_SIZE;
+    uint32_t first = config.block_count / 4U;
+    double stream = stream_run(first, total);
+    check(stream > 0.0, "stream failed");
+    check(card_matches(first, total), "streamed data wrong on the card");
+
+    double blocking = blocking_run(first + total, total);
+    check(blocking > 0.0, "buffer at a time writes failed");
+    check(card_matches(first + total, total), "buffer at a time data wrong on the card");
+
+    uint32_t single_total = 512U;
+    double single = single_run(first + 2U * total, single_total);
+    check(single > 0.0, "single block writes failed");
+    check(card_matches(first + 2U * total, single_total), "single block data wrong on the card");
+
+    // Read it all back in 32KB chunks, timing the reads
+    SD_Model_Stats* stats = SD_model_get_stats();
+    double start = stats->time_us;
+    uint8_t read_ok = 1;
+    for (uint32_t done = 0; done < total && read_ok; done += SIM_MAX_BLOCKS) {
+        read_ok = SD_read_blocks(first + done, io_buffer, SIM_MAX_BLOCKS) == HAL_OK &&
+                  memcmp(io_buffer, SD_model_storage() + (size_t)(first + done) * SD_BLOCK_SIZE, sizeof(io_buffer)) == 0;
+    }
+    double read = (double)total * SD_BLOCK_SIZE / (stats->time_us - start);
+    check(read_ok, "read back failed");
+
+    printf("  double buffered stream: %6.2f MB/s\n", stream);
+    printf("  buffer at a time:       %6.2f MB/s\n", blocking);
+    printf("  single blocks:          %6.2f MB/s\n", single);
+    printf("  multi block reads:      %6.2f MB/s\n", read);
+    check(stream >= SIM_MIN_STREAM_MBPS, "stream only %.2f MB/s", stream);
+    check(stream > blocking * 1.5, "streaming barely beats buffer at a time writes (%.2f vs %.2f MB/s)", stream, blocking);
+    check_no_violations("streaming writes");
+}
+
+static void error_test(void) {
+    printf("data errors\n");
+    SD_Model_Config config;
+    SD_model_default_config(&config, 1);
+    if (!start_card(&config)) {
+        check(0, "init failed");
+        return;
+    }
+
+    // Third buffer of a stream fails: the stream reports it, the first two are on the card, the card recovers
+    uint32_t first = 1000U;
+    uint32_t total = 8U * SIM_BUFFER_BLOCKS;
+    SD_model_inject_data_error(3);
+    check(stream_run(first, total) == 0.0, "stream with a bad buffer reported success");
+    check(card_matches(first, 2U * SIM_BUFFER_BLOCKS), "buffers before the error lost");
+    check(SD_stream_pending() == 0, "stream still pending after it ended");
+
+    check(stream_run(first, total) > 0.0, "stream after an error failed");
+    check(card_matches(first, total), "stream after an error wrote the wrong data");
+
+    // Bad read, then a good one
+    SD_model_inject_data_error(1);
+    check(SD_read_blocks(first, io_buffer, 8) == HAL_ERROR, "read with a CRC error reported success");
+    check(SD_read_blocks(first, io_buffer, 8) == HAL_OK, "read after an error failed");
+    check(pattern_matches((const uint8_t*)io_buffer, first, 8), "read after an error wrong");
+
+    // Bad single block write, then a good one
+    SD_model_inject_data_error(1);
+    fill_pattern(io_buffer, 7U, 1U);
+    check(SD_write_blocks(7U, io_buffer, 1) == HAL_ERROR, "single write with a CRC error reported success");
+    check(SD_write_blocks(7U, io_buffer, 1) == HAL_OK, "single write after an error failed");
+    check(card_matches(7U, 1U), "single write after an error wrong");
+
+    // Misuse is refused without upsetting the card
+    check(SD_stream_write(buffers[0], 1) == HAL_ERROR, "stream write without a stream accepted");
+    check(SD_stream_end() == HAL_ERROR, "stream end without a stream accepted");
+    check(SD_stream_begin(first, 0) == HAL_OK, "stream begin failed");
+    check(SD_read_blocks(first, io_buffer, 1) == HAL_ERROR, "read during a stream accepted");
+    check(SD_stream_end() == HAL_OK, "empty stream failed to end");
+    check_no_violations("data errors");
+}
+
+// HELPER FUNCTIONS ==============================================================
+static uint32_t rng(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static void fill_random(void* buffer, uint32_t len) {
+    uint32_t* words = buffer;
+    for (uint32_t i = 0; i < len / 4U; i++) {
+        words[i] = rng();
+    }
+}
+
+/**
+ * Data for block n of a stream, so it can be checked without keeping a copy
+ */
+static void fill_pattern(void* buffer, uint32_t first_block, uint32_t blocks) {
+    uint32_t* words = buffer;
+    for (uint32_t i = 0; i < blocks * SD_BLOCK_SIZE / 4U; i++) {
+        words[i] = ((first_block + i / (SD_BLOCK_SIZE / 4U)) << 8) ^ ((i % (SD_BLOCK_SIZE / 4U)) * 0x9E3779B1U);
+    }
+}
+
+/**
+ * Checks data holding blocks first_block onwards against fill_pattern()
+ */
+static uint8_t pattern_matches(const uint8_t* data, uint32_t first_block, uint32_t blocks) {
+    static uint32_t expected[SIM_BUFFER_BLOCKS * SD_BLOCK_SIZE / 4U];
+    for (uint32_t done = 0; done < blocks; done += SIM_BUFFER_BLOCKS) {
+        uint32_t n = (blocks - done < SIM_BUFFER_BLOCKS) ? blocks - done : SIM_BUFFER_BLOCKS;
+        fill_pattern(expected, first_block + done, n);
+        if (memcmp(data + (size_t)done * SD_BLOCK_SIZE, expected, (size_t)n * SD_BLOCK_SIZE)) return 0;
+    }
+    return 1;
+}
+
+static uint8_t card_matches(uint32_t first_block, uint32_t blocks) {
+    return pattern_matches(SD_model_storage() + (size_t)first_block * SD_BLOCK_SIZE, first_block, blocks);
+}
+
+static void check_no_violations(const char* test) {
+    SD_Model_Stats* stats = SD_model_get_stats();
+    check(stats->violations == 0, "%s: %u protocol violations, first: %s", test, stats->violations, stats->first_violation);
+}
+
+static uint8_t start_card(const SD_Model_Config* config) {
+    SD_model_init(config);
+    return SD_init(SD_model_ops()) == HAL_OK;
+}
+
+static void check(uint8_t condition, const char* format, ...) {
+    if (condition) return;
+    if (failures < 10U) {
+        va_list args;
+        va_start(args, format);
+        printf("FAILED: ");
+        vprintf(format, args);
+        printf("\n");
+        va_end(args);
+    }
+    failures++;
+}
@@ -0,0 +1,521 @@
+/*
+ * usb_model.c
+ *
+ * implementation file for usb_model.h
+ * Transfers and handshakes follow USB 2.0 chapters 5, 8 and 9 at full speed. Only what usb_cdc.c uses is
+ * modelled: no isochronous endpoints, SOFs, suspend or errors on the wire
+ *
+ *  Written by Ryan Wong
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include "usb_model.h"
+
+#define MODEL_NUM_ENDPOINTS 4U
+#define MODEL_EP0_SIZE 64U
+#define MODEL_MAX_PACKET 64U
+
+#define TOKEN_NAK -1
+#define TOKEN_STALL -2
+
+typedef struct {
+    uint8_t open;
+    uint8_t type;
+    uint16_t max_packet;
+    uint8_t stalled;
+    uint8_t busy;
+    const uint8_t* in_buffer;
+    uint8_t* out_buffer;
+    uint32_t len;
+    uint32_t done;
+} Model_EP;
+
+static USB_Model_Config config;
+static USB_Model_Stats stats;
+
+// device side
+static Model_EP in_eps[MODEL_NUM_ENDPOINTS];
+static Model_EP out_eps[MODEL_NUM_ENDPOINTS];
+static uint8_t connected = 0;
+static uint8_t device_address = 0;
+static uint8_t locked = 0;
+static uint8_t in_event = 0;
+
+// host side
+static uint8_t setup_active = 0;
+static uint8_t setup_packet[8];
+static uint16_t setup_length = 0;
+static uint8_t host_reading = 1;
+static uint8_t* read_buffer = NULL;
+static uint32_t read_len = 0;
+static uint8_t* received = NULL;
+static uint32_t received_len = 0;
+static uint8_t* send_buffer = NULL;
+static uint32_t send_len = 0;
+static uint32_t send_pos = 0;
+static double next_slot_us = 0.0;
+static double reset_at_us = -1.0;
+
+static HAL_Status model_connect(void);
+static void model_set_address(uint8_t address);
+static HAL_Status model_ep_open(uint8_t ep_addr, uint8_t type, uint16_t max_packet);
+static HAL_Status model_ep_transmit(uint8_t ep_addr, const void* buffer, uint32_t len);
+static HAL_Status model_ep_receive(uint8_t ep_addr, void* buffer, uint32_t len);
+static void model_ep_abort(uint8_t ep_addr);
+static void model_ep_stall(uint8_t ep_addr, uint8_t stall);
+static void model_lock(void);
+static void model_unlock(void);
+static void model_poll(void);
+
+static const CDC_Device_Ops model_ops = {
+    .connect = model_connect,
+    .set_address = model_set_address,
+    .ep_open = model_ep_open,
+    .ep_transmit = model_ep_transmit,
+    .ep_receive = model_ep_receive,
+    .ep_abort = model_ep_abort,
+    .ep_stall = model_ep_stall,
+    .lock = model_lock,
+    .unlock = model_unlock,
+    .poll = model_poll
+};
+
+static void violation(const char* format, ...);
+static Model_EP* endpoint(uint8_t ep_addr, const char* caller);
+static uint8_t access_allowed(const char* caller);
+static int in_token(uint8_t ep_num, uint8_t* dest, uint32_t max);
+static int out_token(uint8_t ep_num, const uint8_t* data, uint32_t len);
+static void bus_slot(void);
+static void host_bulk_read(void);
+static void reset_endpoints(void);
+
+// MODEL FUNCTIONS ==============================================================
+void USB_model_default_config(USB_Model_Config* cfg) {
+    cfg->host_read_size = 4096U;
+    cfg->rx_capacity = 8U * 1024U * 1024U;
+}
+
+void USB_model_init(const USB_Model_Config* cfg) {
+    config = *cfg;
+    memset(&stats, 0, sizeof(stats));
+    reset_endpoints();
+    connected = 0;
+    device_address = 0;
+    locked = 0;
+    in_event = 0;
+    setup_active = 0;
+    host_reading = 1;
+    next_slot_us = USB_MODEL_SLOT_US;
+    reset_at_us = -1.0;
+
+    free(read_buffer);
+    free(received);
+    free(send_buffer);
+    read_buffer = malloc(config.host_read_size);
+    received = malloc(config.rx_capacity);
+    send_buffer = NULL;
+    read_len = 0;
+    received_len = 0;
+    send_len = 0;
+    send_pos = 0;
+}
+
+const CDC_Device_Ops* USB_model_ops(void) {
+    return &model_ops;
+}
+
+void USB_model_bus_reset(void) {
+    if (!connected) return;
+
+    reset_endpoints();
+    device_address = 0;
+    setup_active = 0;
+    read_len = 0;
+    send_len = 0;
+    send_pos = 0;
+    in_event = 1;
+    CDC_on_reset();
+    in_event = 0;
+}
+
+void USB_model_schedule_reset(double at_us) {
+    reset_at_us = at_us;
+}
+
+/**
+ * The host gives up on a NAK where the device should already have answered: the stack does all its endpoint 0
+ * work in the bus events, so nothing else would ever arm the endpoint
+ */
+HAL_Status USB_model_control(uint8_t request_type, uint8_t request, uint16_t value, uint16_t index, void* data,
+                             uint16_t length, uint32_t* actual) {
+    if (actual) *actual = 0;
+    if (!connected) return HAL_ERROR;
+
+    uint8_t packet[8] = {
+        request_type, request, (uint8_t)value, (uint8_t)(value >> 8),
+        (uint8_t)index, (uint8_t)(index >> 8), (uint8_t)length, (uint8_t)(length >> 8)
+    };
+    memcpy(setup_packet, packet, sizeof(packet));
+    setup_length = length;
+    setup_active = 1;
+    stats.setups++;
+
+    // SETUP always gets through: endpoint 0's stalls and transfers are cleared
+    memset(&in_eps[0], 0, sizeof(Model_EP));
+    memset(&out_eps[0], 0, sizeof(Model_EP));
+    in_eps[0].open = out_eps[0].open = 1;
+    in_eps[0].max_packet = out_eps[0].max_packet = MODEL_EP0_SIZE;
+    in_event = 1;
+    CDC_on_setup(packet);
+    in_event = 0;
+
+    uint8_t* bytes = data;
+    uint32_t moved = 0;
+    int result;
+    if (length > 0 && (request_type & 0x80U)) {
+        do {
+            result = in_token(0, bytes + moved, length - moved);
+            if (result == TOKEN_STALL) break;
+            if (result == TOKEN_NAK) {
+                violation("control read %02X/%02X: NAK after %u of %u bytes (missing data or ZLP)", request_type, request,
+                          moved, length);
+                break;
+            }
+            moved += (uint32_t)result;
+        } while (result == MODEL_EP0_SIZE && moved < length);
+
+        if (result >= 0) {
+            result = out_token(0, NULL, 0);
+            if (result == TOKEN_NAK) violation("control read %02X/%02X: status stage not armed", request_type, request);
+        }
+    } else if (length > 0) {
+        do {
+            uint32_t n = (length - moved < MODEL_EP0_SIZE) ? length - moved : MODEL_EP0_SIZE;
+            result = out_token(0, bytes + moved, n);
+            if (result == TOKEN_NAK) violation("control write %02X/%02X: data stage NAKed", request_type, request);
+            if (result < 0) break;
+            moved += n;
+        } while (moved < length);
+
+        if (result >= 0) {
+            uint8_t status[MODEL_EP0_SIZE];
+            result = in_token(0, status, sizeof(status));
+            if (result == TOKEN_NAK) violation("control write %02X/%02X: no status stage", request_type, request);
+            if (result > 0) violation("control write %02X/%02X: %d byte status stage", request_type, request, result);
+        }
+    } else {
+        uint8_t status[MODEL_EP0_SIZE];
+        result = in_token(0, status, sizeof(status));
+        if (result == TOKEN_NAK) violation("request %02X/%02X: no status stage", request_type, request);
+        if (result > 0) violation("request %02X/%02X: %d byte status stage", request_type, request, result);
+    }
+    setup_active = 0;
+    if (actual) *actual = moved;
+    if (result < 0) return HAL_ERROR;
+
+    // From here on the host talks to the new address
+    if (request_type == 0x00U && request == 0x05U && device_address != value) {
+        violation("SET_ADDRESS %u: device on address %u after the status stage", value, device_address);
+    }
+    return HAL_OK;
+}
+
+void USB_model_advance_us(double us) {
+    if (locked) violation("time passed with the bus events locked out");
+
+    double end = stats.time_us + us;
+    while (next_slot_us <= end) {
+        stats.time_us = next_slot_us;
+        next_slot_us += USB_MODEL_SLOT_US;
+        if (reset_at_us >= 0.0 && stats.time_us >= reset_at_us) {
+            reset_at_us = -1.0;
+            USB_model_bus_reset();
+            continue;
+        }
+        bus_slot();
+    }
+    stats.time_us = end;
+}
+
+void USB_model_host_reading(uint8_t on) {
+    host_reading = on;
+}
+
+void USB_model_host_send(const void* data, uint32_t len) {
+    uint8_t* buffer = malloc(send_len - send_pos + len);
+    if (send_buffer) memcpy(buffer, send_buffer + send_pos, send_len - send_pos);
+    memcpy(buffer + send_len - send_pos, data, len);
+    free(send_buffer);
+    send_buffer = buffer;
+    send_len = send_len - send_pos + len;
+    send_pos = 0;
+}
+
+const uint8_t* USB_model_received(void) {
+    return received;
+}
+
+uint32_t USB_model_received_len(void) {
+    return received_len;
+}
+
+void USB_model_clear_received(void) {
+    received_len = 0;
+}
+
+USB_Model_Stats* USB_model_get_stats(void) {
+    return &stats;
+}
+
+// DEVICE OPS ==============================================================
+static HAL_Status model_connect(void) {
+    connected = 1;
+    return HAL_OK;
+}
+
+static void model_set_address(uint8_t address) {
+    if (!in_event || !setup_active || setup_packet[1] != 0x05U) violation("set_address outside SET_ADDRESS");
+    if (address > 127U) violation("address %u", address);
+    device_address = address;
+}
+
+/**
+ * Endpoints only open while the host is setting the configuration
+ */
+static HAL_Status model_ep_open(uint8_t ep_addr, uint8_t type, uint16_t max_packet) {
+    Model_EP* ep = endpoint(ep_addr, "ep_open");
+    if (ep == NULL) return HAL_ERROR;
+    if (!setup_active || setup_packet[1] != 0x09U) violation("ep_open %02X outside SET_CONFIGURATION", ep_addr);
+    if ((ep_addr & 0x7FU) == 0 || type < 2U || type > 3U) {
+        violation("ep_open %02X: type %u", ep_addr, type);
+        return HAL_ERROR;
+    }
+    if (max_packet > MODEL_MAX_PACKET || (type == 2U && max_packet != 8U && max_packet != 16U && max_packet != 32U &&
+                                          max_packet != 64U)) {
+        violation("ep_open %02X: max packet %u", ep_addr, max_packet);
+        return HAL_ERROR;
+    }
+    memset(ep, 0, sizeof(Model_EP));
+    ep->open = 1;
+    ep->type = type;
+    ep->max_packet = max_packet;
+    return HAL_OK;
+}
+
+static HAL_Status model_ep_transmit(uint8_t ep_addr, const void* buffer, uint32_t len) {
+    Model_EP* ep = endpoint(ep_addr, "ep_transmit");
+    if (ep == NULL || !access_allowed("ep_transmit")) return HAL_ERROR;
+    if (!(ep_addr & 0x80U)) {
+        violation("ep_transmit on OUT endpoint %02X", ep_addr);
+        return HAL_ERROR;
+    }
+    if (!ep->open || ep->busy || ep->stalled || (len > 0 && buffer == NULL)) {
+        violation("ep_transmit %02X: open %u busy %u stalled %u", ep_addr, ep->open, ep->busy, ep->stalled);
+        return HAL_ERROR;
+    }
+    if (ep_addr == 0x80U && (!setup_active || len > setup_length)) {
+        violation("endpoint 0 IN: %u bytes for wLength %u", len, setup_length);
+    }
+    if (ep_addr == CDC_EP_DATA_IN) stats.last_bulk_in_buffer = buffer;
+
+    ep->busy = 1;
+    ep->in_buffer = buffer;
+    ep->len = len;
+    ep->done = 0;
+    return HAL_OK;
+}
+
+static HAL_Status model_ep_receive(uint8_t ep_addr, void* buffer, uint32_t len) {
+    Model_EP* ep = endpoint(ep_addr, "ep_receive");
+    if (ep == NULL || !access_allowed("ep_receive")) return HAL_ERROR;
+    if (ep_addr & 0x80U) {
+        violation("ep_receive on IN endpoint %02X", ep_addr);
+        return HAL_ERROR;
+    }
+    if (!ep->open || ep->busy || ep->stalled || (len > 0 && buffer == NULL)) {
+        violation("ep_receive %02X: open %u busy %u stalled %u", ep_addr, ep->open, ep->busy, ep->stalled);
+        return HAL_ERROR;
+    }
+    ep->busy = 1;
+    ep->out_buffer = buffer;
+    ep->len = len;
+    ep->done = 0;
+    return HAL_OK;
+}
+
+static void model_ep_abort(uint8_t ep_addr) {
+    Model_EP* ep = endpoint(ep_addr, "ep_abort");
+    if (ep == NULL || !access_allowed("ep_abort")) return;
+    if (!(ep_addr & 0x80U)) violation("ep_abort on OUT endpoint %02X", ep_addr);
+
+    ep->busy = 0;
+}
+
+/**
+ * Stalling drops the endpoint's transfer, clearing it puts the data toggle back to DATA0
+ */
+static void model_ep_stall(uint8_t ep_addr, uint8_t stall) {
+    Model_EP* ep = endpoint(ep_addr, "ep_stall");
+    if (ep == NULL || !access_allowed("ep_stall")) return;
+    if (!ep->open) violation("ep_stall on closed endpoint %02X", ep_addr);
+
+    ep->stalled = stall;
+    ep->busy = 0;
+}
+
+static void model_lock(void) {
+    if (locked) violation("lock() nested");
+    locked = 1;
+}
+
+static void model_unlock(void) {
+    if (!locked) violation("unlock() without lock()");
+    locked = 0;
+}
+
+static void model_poll(void) {
+    if (locked) violation("poll() with the bus events locked out");
+    USB_model_advance_us(USB_MODEL_SLOT_US);
+}
+
+// HELPER FUNCTIONS ==============================================================
+static void violation(const char* format, ...) {
+    if (stats.violations++ == 0) {
+        va_list args;
+        va_start(args, format);
+        vsnprintf(stats.first_violation, sizeof(stats.first_violation), format, args);
+        va_end(args);
+    }
+}
+
+static Model_EP* endpoint(uint8_t ep_addr, const char* caller) {
+    if ((ep_addr & 0x7FU) >= MODEL_NUM_ENDPOINTS) {
+        violation("%s: endpoint %02X doesn't exist", caller, ep_addr);
+        return NULL;
+    }
+    return (ep_addr & 0x80U) ? &in_eps[ep_addr & 0x7FU] : &out_eps[ep_addr];
+}
+
+/**
+ * Anything touching the endpoints has to keep the bus events out, or be one
+ */
+static uint8_t access_allowed(const char* caller) {
+    if (!in_event && !locked) violation("%s with the bus events unmasked", caller);
+    return 1;
+}
+
+/**
+ * Host IN token: returns the packet's length, TOKEN_NAK or TOKEN_STALL. The device completes the transfer
+ * after its last packet (a 0 byte transfer is one ZLP), there's no automatic ZLP after a full one
+ */
+static int in_token(uint8_t ep_num, uint8_t* dest, uint32_t max) {
+    Model_EP* ep = &in_eps[ep_num];
+    if (ep->stalled) {
+        stats.stalls++;
+        return TOKEN_STALL;
+    }
+    if (!ep->busy) return TOKEN_NAK;
+
+    uint32_t n = ep->len - ep->done;
+    if (n > ep->max_packet) n = ep->max_packet;
+    if (n > max) {
+        violation("endpoint %02X: %u byte packet, host only had room for %u", ep_num | 0x80U, n, max);
+        n = max;
+    }
+    memcpy(dest, ep->in_buffer + ep->done, n);
+    ep->done += n;
+
+    if (ep->done == ep->len) {
+        ep->busy = 0;
+        in_event = 1;
+        CDC_on_complete(0x80U | ep_num, ep->len);
+        in_event = 0;
+    }
+    return (int)n;
+}
+
+/**
+ * Host OUT token with len bytes: NAKed unless the endpoint is armed with room for the whole packet.
+ * The transfer completes on a short packet or once it's full
+ */
+static int out_token(uint8_t ep_num, const uint8_t* data, uint32_t len) {
+    Model_EP* ep = &out_eps[ep_num];
+    if (ep->stalled) {
+        stats.stalls++;
+        return TOKEN_STALL;
+    }
+    if (!ep->busy || len > ep->len - ep->done) return TOKEN_NAK;
+
+    if (len > 0) memcpy(ep->out_buffer + ep->done, data, len);
+    ep->done += len;
+    if (len < ep->max_packet || ep->done == ep->len) {
+        ep->busy = 0;
+        in_event = 1;
+        CDC_on_complete(ep_num, ep->done);
+        in_event = 0;
+    }
+    return (int)len;
+}
+
+/**
+ * One bulk packet's worth of bus time: an IN packet if the host is reading and the device has one,
+ * otherwise an OUT packet if the host has data and the device is taking it
+ */
+static void bus_slot(void) {
+    if (!connected) return;
+
+    Model_EP* in = &in_eps[CDC_EP_DATA_IN & 0x7FU];
+    if (host_reading && in->open && (in->busy || in->stalled)) {
+        host_bulk_read();
+        return;
+    }
+
+    Model_EP* out = &out_eps[CDC_EP_DATA_OUT];
+    if (send_pos < send_len && out->open) {
+        uint32_t n = send_len - send_pos;
+        if (n > out->max_packet) n = out->max_packet;
+        if (out_token(CDC_EP_DATA_OUT, send_buffer + send_pos, n) >= 0) {
+            send_pos += n;
+            stats.bulk_out_packets++;
+        }
+    }
+}
+
+/**
+ * A read completes when it's full or on a short packet (ZLP included)
+ */
+static void host_bulk_read(void) {
+    uint8_t packet[MODEL_MAX_PACKET];
+    int result = in_token(CDC_EP_DATA_IN & 0x7FU, packet, sizeof(packet));
+    if (result < 0) return;
+
+    stats.bulk_in_packets++;
+    if (result == 0) stats.bulk_in_zlps++;
+    uint32_t n = (uint32_t)result;
+    if (n > config.host_read_size - read_len) {
+        violation("bulk IN packet overran the host's read");
+        n = config.host_read_size - read_len;
+    }
+    memcpy(read_buffer + read_len, packet, n);
+    read_len += n;
+
+    if ((uint32_t)result < in_eps[CDC_EP_DATA_IN & 0x7FU].max_packet || read_len == config.host_read_size) {
+        uint32_t room = config.rx_capacity - received_len;
+        uint32_t copy = (read_len < room) ? read_len : room;
+        memcpy(received + received_len, read_buffer, copy);
+        received_len += copy;
+        read_len = 0;
+        stats.host_reads++;
+    }
+}
+
+static void reset_endpoints(void) {
+    memset(in_eps, 0, sizeof(in_eps));
+    memset(out_eps, 0, sizeof(out_eps));
+    in_eps[0].open = out_eps[0].open = 1;
+    in_eps[0].max_packet = out_eps[0].max_packet = MODEL_EP0_SIZE;
+}
@@ -0,0 +1,112 @@
+/*
+ * usb_model.h
+ *
+ * Device controller + USB host model for running usb_cdc.c on the PC. Implements CDC_Device_Ops against
+ * endpoints that behave like the OTG FS core's (transfers split into max packet sized packets, no automatic
+ * ZLPs, SETUP clears endpoint 0 stalls) and a full speed host that drives them: control transfers with their
+ * data and status stages, bulk IN reads and bulk OUT writes. It catches the protocol mistakes a real host
+ * would choke on: a control data stage longer than wLength, a missing ZLP or status stage, the address not
+ * taken before the SET_ADDRESS status stage, endpoints used before they're opened or while busy or halted,
+ * and endpoints touched with the bus events unmasked. Each mistake is counted as a violation (and the first
+ * one is kept as text).
+ *
+ * Time is simulated: the bus moves one bulk packet every USB_MODEL_SLOT_US (19 per 1ms frame, the full speed
+ * bulk limit with nothing else on the bus), and every poll() waits one slot. The harness adds CPU time of its
+ * own (e.g. filling a buffer) with USB_model_advance_us(), and the bus keeps moving meanwhile
+ *
+ *  Written by Ryan Wong
+ */
+
+#ifndef USB_MODEL_H_
+#define USB_MODEL_H_
+
+#include <stdint.h>
+#include "utils/usb_cdc.h"
+
+#define USB_MODEL_SLOT_US (1000.0 / 19.0)
+
+/**
+ * host_read_size - size of the host's bulk IN reads. A read only completes (and its data shows up in
+ * 					USB_model_received()) once it's full or ends on a short packet, like usbser on Windows
+ * rx_capacity - most bytes USB_model_received() can hold, the rest is dropped
+ */
+typedef struct {
+    uint32_t host_read_size;
+    uint32_t rx_capacity;
+} USB_Model_Config;
+
+typedef struct {
+    uint64_t setups;
+    uint64_t stalls; // STALL handshakes the host got
+    uint64_t bulk_in_packets;
+    uint64_t bulk_in_zlps;
+    uint64_t bulk_out_packets;
+    uint64_t host_reads; // completed bulk IN reads
+    const void* last_bulk_in_buffer; // buffer of the latest bulk IN transfer, to check nothing was copied
+    uint32_t violations;
+    char first_violation[160];
+    double time_us;
+} USB_Model_Stats;
+
+/**
+ * @brief 4KB host reads, 8MB of received data
+ */
+void USB_model_default_config(USB_Model_Config* config);
+
+/**
+ * @brief Unplugged device, empty host buffers, statistics and simulated time reset
+ */
+void USB_model_init(const USB_Model_Config* config);
+
+/**
+ * @brief Returns the backend to pass to CDC_init()
+ */
+const CDC_Device_Ops* USB_model_ops(void);
+
+/**
+ * @brief Bus reset (only once the device has connected): endpoints but 0 closed, transfers dropped,
+ * 		  address 0, and the host's partial read and unsent OUT data discarded
+ */
+void USB_model_bus_reset(void);
+
+/**
+ * @brief Resets the bus once the simulated time reaches at_us, from inside USB_model_advance_us() or poll()
+ */
+void USB_model_schedule_reset(double at_us);
+
+/**
+ * @brief Runs a whole control transfer on endpoint 0: SETUP, the data stage (direction from bit 7 of
+ * 		  request_type) and the status stage
+ *
+ * @param data - IN: receives up to length bytes, OUT: length bytes to send
+ * @param actual - bytes moved in the data stage, may be NULL
+ * @return HAL_Status - HAL_ERROR if the device stalled the request (or broke the protocol, see the violations)
+ */
+HAL_Status USB_model_control(uint8_t request_type, uint8_t request, uint16_t value, uint16_t index, void* data,
+                             uint16_t length, uint32_t* actual);
+
+/**
+ * @brief Lets time pass, the bus moves packets meanwhile
+ */
+void USB_model_advance_us(double us);
+
+/**
+ * @brief 1 (default) the host keeps a bulk IN read pending, 0 it stops reading and the device's IN data waits
+ */
+void USB_model_host_reading(uint8_t on);
+
+/**
+ * @brief Queues data for the host to send on bulk OUT, 64 bytes per packet as the device takes them
+ */
+void USB_model_host_send(const void* data, uint32_t len);
+
+/**
+ * @brief Everything the host has read on bulk IN so far (completed reads only)
+ */
+const uint8_t* USB_model_received(void);
+uint32_t USB_model_received_len(void);
+void USB_model_clear_received(void);
+
+USB_Model_Stats* USB_model_get_stats(void);
+
+#endif
@@ -0,0 +1,463 @@
+/*
+ * usb_sim.c
+ *
+ * Runs the real usb_cdc.c against the USB host model on the PC:
+ *   1. enumeration the way Windows does it, with the descriptors parsed and checked
+ *   2. standard and class requests: stalls on unsupported ones, line coding, DTR, GET_STATUS, endpoint halts
+ *   3. ZLPs after control and bulk transfers that end on a full packet
+ *   4. streaming from application buffers with CDC_transmit(), compared against one buffer at a time, checking
+ *      nothing was copied and the host got every byte in order
+ *   5. CDC_write() as a _write sink: dropped with the port closed, timeouts and bus resets while waiting
+ *   6. bulk OUT into CDC_read(), and a bus reset in the middle of a stream
+ * Every test also fails if the model caught a protocol violation (missing ZLP or status stage, busy endpoint...)
+ *
+ * Build and run from workspace/stm32-baremetal-hal:
+ *   gcc -std=c99 -O2 -Wall -Wextra -IInc -Itools/usb_model tools/usb_model/usb_model.c tools/usb_model/usb_sim.c Src/utils/usb_cdc.c -o usb_sim && ./usb_sim
+ *
+ * Exits non zero if any check fails
+ *
+ *  Written by Ryan Wong
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include "utils/usb_cdc.h"
+#include "usb_model.h"
+
+#define SIM_STREAM_BYTES (2U * 1024U * 1024U)
+#define SIM_BUFFER_SIZE 4096U // same as Test/usb_cdc_test.c
+#define SIM_FILL_US_PER_KB 400.0 // CPU time to produce data, ~2.5MB/s
+#define SIM_MIN_STREAM_KBPS 1150.0 // 1216 is the full speed bulk limit
+
+#define REQ_IN 0x80U
+#define REQ_CLASS_INTERFACE 0x21U
+#define REQ_ENDPOINT 0x02U
+
+static uint32_t failures = 0;
+static uint8_t buffers[CDC_TX_QUEUE_SIZE][SIM_BUFFER_SIZE];
+static uint8_t control[256];
+
+static void enumeration_test(void);
+static void request_test(void);
+static void zlp_test(void);
+static void stream_test(void);
+static void write_test(void);
+static void read_test(void);
+static void reset_test(void);
+static double stream_run(uint32_t offset, uint32_t total, uint32_t depth);
+static uint8_t pattern(uint32_t offset);
+static uint8_t received_matches(uint32_t offset, uint32_t len);
+static uint8_t received_len_is(uint32_t len);
+static uint8_t start_device(void);
+static uint8_t enumerate(void);
+static HAL_Status get_descriptor(uint8_t type, uint8_t index, uint16_t length, uint32_t* actual);
+static HAL_Status set_line_state(uint16_t state);
+static void wait_sent(void);
+static void check_no_violations(const char* test);
+static void check(uint8_t condition, const char* format, ...);
+
+int main(void) {
+    enumeration_test();
+    request_test();
+    zlp_test();
+    stream_test();
+    write_test();
+    read_test();
+    reset_test();
+
+    printf("%s (%u failures)\n", failures ? "FAIL" : "PASS", failures);
+    return failures ? 1 : 0;
+}
+
+// TESTS ==============================================================
+static void enumeration_test(void) {
+    printf("enumeration\n");
+    check(start_device(), "enumeration failed");
+    check(CDC_is_configured() && CDC_is_open(), "configured %u open %u", CDC_is_configured(), CDC_is_open());
+
+    uint32_t actual;
+    check(get_descriptor(0x01U, 0, 18, &actual) == HAL_OK && actual == 18, "device descriptor: %u bytes", actual);
+    check(control[0] == 18 && control[1] == 0x01U && control[4] == 0x02U, "device descriptor: class %02X", control[4]);
+    check(control[7] == 64 && control[17] == 1, "device descriptor: EP0 %u, %u configurations", control[7], control[17]);
+
+    // Configuration: header first for the total length, then all of it
+    check(get_descriptor(0x02U, 0, 9, &actual) == HAL_OK && actual == 9, "configuration header: %u bytes", actual);
+    uint16_t total = (uint16_t)(control[2] | (control[3] << 8));
+    check(get_descriptor(0x02U, 0, 255, &actual) == HAL_OK && actual == total, "configuration: %u of %u bytes", actual, total);
+
+    uint8_t interfaces = 0, bulk_in = 0, bulk_out = 0, notify = 0, union_ok = 0;
+    for (uint32_t i = 0; i + 1U < actual && control[i] != 0; i += control[i]) {
+        const uint8_t* d = &control[i];
+        if (d[1] == 0x04U) {
+            interfaces++;
+            check((d[2] == 0 && d[5] == 0x02U && d[6] == 0x02U) || (d[2] == 1 && d[5] == 0x0AU),
+                  "interface %u: class %02X/%02X", d[2], d[5], d[6]);
+        } else if (d[1] == 0x05U) {
+            uint16_t size = (uint16_t)(d[4] | (d[5] << 8));
+            if (d[2] == CDC_EP_DATA_IN && d[3] == 0x02U && size == 64) bulk_in = 1;
+            if (d[2] == CDC_EP_DATA_OUT && d[3] == 0x02U && size == 64) bulk_out = 1;
+            if (d[2] == CDC_EP_NOTIFY && d[3] == 0x03U) notify = 1;
+        } else if (d[1] == 0x24U && d[2] == 0x06U) {
+            union_ok = d[3] == 0 && d[4] == 1;
+        }
+    }
+    check(interfaces == control[4] && interfaces == 2, "%u interfaces", interfaces);
+    check(bulk_in && bulk_out && notify && union_ok, "endpoints in %u out %u notify %u, union %u", bulk_in, bulk_out,
+          notify, union_ok);
+
+    check(get_descriptor(0x03U, 0, 255, &actual) == HAL_OK && actual == 4 && control[2] == 0x09U && control[3] == 0x04U,
+          "language IDs");
+    check(get_descriptor(0x03U, 1, 255, &actual) == HAL_OK && actual == control[0] && actual > 2, "manufacturer string");
+    char text[40] = {0};
+    for (uint32_t i = 2; i < actual && i / 2U - 1U < sizeof(text) - 1U; i += 2U) text[i / 2U - 1U] = (char)control[i];
+    check(strcmp(text, "Ryan Wong") == 0, "manufacturer \"%s\"", text);
+    check(get_descriptor(0x03U, 9, 255, &actual) == HAL_ERROR, "string 9 not stalled");
+
+    check(USB_model_control(REQ_IN, 0x08U, 0, 0, control, 1, &actual) == HAL_OK && control[0] == 1,
+          "GET_CONFIGURATION %u", control[0]);
+    check_no_violations("enumeration");
+}
+
+static void request_test(void) {
+    printf("requests\n");
+    if (!start_device()) {
+        check(0, "enumeration failed");
+        return;
+    }
+    uint32_t actual;
+
+    // Unsupported requests stall, and the next request works
+    uint64_t stalls = USB_model_get_stats()->stalls;
+    check(get_descriptor(0x06U, 0, 10, &actual) == HAL_ERROR, "device qualifier not stalled");
+    check(USB_model_control(0x40U, 0x01U, 0, 0, NULL, 0, NULL) == HAL_ERROR, "vendor request not stalled");
+    check(USB_model_control(REQ_CLASS_INTERFACE, 0x22U, 1, 1, NULL, 0, NULL) == HAL_ERROR, "class request to the data interface not stalled");
+    check(USB_model_control(REQ_CLASS_INTERFACE, 0x20U, 0, 0, control, 6, NULL) == HAL_ERROR, "short SET_LINE_CODING not stalled");
+    check(USB_model_control(0x00U, 0x09U, 2, 0, NULL, 0, NULL) == HAL_ERROR, "SET_CONFIGURATION 2 not stalled");
+    check(USB_model_get_stats()->stalls >= stalls + 5U, "only %u stalls", (uint32_t)(USB_model_get_stats()->stalls - stalls));
+    check(get_descriptor(0x01U, 0, 18, &actual) == HAL_OK && actual == 18, "request after a stall failed");
+
+    // Line coding round trip
+    CDC_Line_Coding coding;
+    check(CDC_get_line_coding(&coding) == HAL_OK && coding.baud == 115200U && coding.data_bits == 8, "default line coding");
+    uint8_t set[7] = {0x00, 0x10, 0x0E, 0x00, 2, 2, 7}; // 921600, 2 stop bits, even, 7 bits
+    check(USB_model_control(REQ_CLASS_INTERFACE, 0x20U, 0, 0, set, 7, NULL) == HAL_OK, "SET_LINE_CODING failed");
+    check(CDC_get_line_coding(&coding) == HAL_OK && coding.baud == 921600U && coding.stop_bits == 2 &&
+          coding.parity == 2 && coding.data_bits == 7, "line coding %u %u %u %u", coding.baud, coding.stop_bits,
+          coding.parity, coding.data_bits);
+    check(USB_model_control(REQ_IN | REQ_CLASS_INTERFACE, 0x21U, 0, 0, control, 7, &actual) == HAL_OK && actual == 7 &&
+          memcmp(control, set, 7) == 0, "GET_LINE_CODING");
+
+    // DTR
+    check(set_line_state(0) == HAL_OK && !CDC_is_open() && CDC_is_configured(), "DTR clear: open %u", CDC_is_open());
+    check(set_line_state(1) == HAL_OK && CDC_is_open(), "DTR set: open %u", CDC_is_open());
+    check(USB_model_control(REQ_CLASS_INTERFACE, 0x23U, 100, 0, NULL, 0, NULL) == HAL_OK, "SEND_BREAK failed");
+
+    // Status, interfaces
+    check(USB_model_control(REQ_IN, 0x00U, 0, 0, control, 2, &actual) == HAL_OK && actual == 2 && control[0] == 0,
+          "device GET_STATUS");
+    check(USB_model_control(REQ_IN | 0x01U, 0x0AU, 0, 1, control, 1, &actual) == HAL_OK && control[0] == 0, "GET_INTERFACE");
+    check(USB_model_control(0x01U, 0x0BU, 0, 1, NULL, 0, NULL) == HAL_OK, "SET_INTERFACE 0 failed");
+    check(USB_model_control(0x01U, 0x0BU, 1, 1, NULL, 0, NULL) == HAL_ERROR, "SET_INTERFACE 1 not stalled");
+
+    // Halting bulk IN: the host gets STALL, nothing goes out until the halt is cleared, then the data follows
+    check(USB_model_control(REQ_ENDPOINT, 0x03U, 0, CDC_EP_DATA_IN, NULL, 0, NULL) == HAL_OK, "SET_FEATURE halt failed");
+    check(USB_model_control(REQ_IN | REQ_ENDPOINT, 0x00U, 0, CDC_EP_DATA_IN, control, 2, NULL) == HAL_OK && control[0] == 1,
+          "halted endpoint GET_STATUS %u", control[0]);
+    static const char message[] = "after the halt";
+    check(CDC_transmit(message, sizeof(message) - 1U) == HAL_OK, "transmit while halted refused");
+    USB_model_advance_us(2000.0);
+    check(USB_model_received_len() == 0 && CDC_tx_pending() == 1, "data moved while halted");
+    check(USB_model_control(REQ_ENDPOINT, 0x01U, 0, CDC_EP_DATA_IN, NULL, 0, NULL) == HAL_OK, "CLEAR_FEATURE halt failed");
+    check(USB_model_control(REQ_IN | REQ_ENDPOINT, 0x00U, 0, CDC_EP_DATA_IN, control, 2, NULL) == HAL_OK && control[0] == 0,
+          "cleared endpoint GET_STATUS %u", control[0]);
+    wait_sent();
+    check(received_len_is(sizeof(message) - 1U) && memcmp(USB_model_received(), message, sizeof(message) - 1U) == 0,
+          "data after the halt");
+    check(USB_model_control(REQ_ENDPOINT, 0x03U, 0, 0x85U, NULL, 0, NULL) == HAL_ERROR, "halt on a missing endpoint not stalled");
+    check_no_violations("requests");
+}
+
+/**
+ * The product string is 64 bytes, so reading it with a bigger wLength needs a ZLP. Bulk IN needs one when the
+ * queue runs dry on a full packet, but not between queued buffers
+ */
+static void zlp_test(void) {
+    printf("zero length packets\n");
+    if (!start_device()) {
+        check(0, "enumeration failed");
+        return;
+    }
+    uint32_t actual;
+    check(get_descriptor(0x03U, 2, 255, &actual) == HAL_OK && actual == 64 && control[0] == 64, "64 byte string: %u bytes", actual);
+    check(get_descriptor(0x03U, 2, 64, &actual) == HAL_OK && actual == 64, "64 byte string, wLength 64: %u bytes", actual);
+    check(get_descriptor(0x02U, 0, 64, &actual) == HAL_OK && actual == 64, "configuration cut to 64: %u bytes", actual);
+
+    USB_Model_Stats* stats = USB_model_get_stats();
+    for (uint32_t i = 0; i < 256U; i++) buffers[0][i] = pattern(i);
+
+    uint64_t reads = stats->host_reads, zlps = stats->bulk_in_zlps;
+    check(CDC_write(buffers[0], 64U) == 64, "64 byte write failed");
+    USB_model_advance_us(1000.0);
+    check(received_len_is(64U) && received_matches(0, 64U), "64 byte write: host got %u bytes", USB_model_received_len());
+    check(stats->host_reads == reads + 1U && stats->bulk_in_zlps == zlps + 1U, "64 byte write: %u reads %u ZLPs",
+          (uint32_t)(stats->host_reads - reads), (uint32_t)(stats->bulk_in_zlps - zlps));
+
+    USB_model_clear_received();
+    zlps = stats->bulk_in_zlps;
+    check(CDC_write(buffers[0], 100U) == 100, "100 byte write failed");
+    USB_model_advance_us(1000.0);
+    check(received_len_is(100U) && received_matches(0, 100U) && stats->bulk_in_zlps == zlps, "100 byte write");
+
+    // Two full buffers back to back: one ZLP, after the second
+    USB_model_clear_received();
+    reads = stats->host_reads;
+    zlps = stats->bulk_in_zlps;
+    check(CDC_transmit(buffers[0], 128U) == HAL_OK && CDC_transmit(buffers[0] + 128U, 128U) == HAL_OK, "queueing failed");
+    wait_sent();
+    USB_model_advance_us(1000.0);
+    check(received_len_is(256U) && received_matches(0, 256U), "queued buffers: host got %u bytes", USB_model_received_len());
+    check(stats->host_reads == reads + 1U && stats->bulk_in_zlps == zlps + 1U, "queued buffers: %u reads %u ZLPs",
+          (uint32_t)(stats->host_reads - reads), (uint32_t)(stats->bulk_in_zlps - zlps));
+    check_no_violations("zero length packets");
+}
+
+/**
+ * Refill a buffer as soon as it's off the queue, hand it over, repeat. depth 1 is one buffer at a time.
+ * Returns kB/s (1 kB = 1000 bytes), 0 on failure
+ */
+static double stream_run(uint32_t offset, uint32_t total, uint32_t depth) {
+    USB_Model_Stats* stats = USB_model_get_stats();
+    double start = stats->time_us;
+
+    for (uint32_t done = 0, i = 0; done < total; done += SIM_BUFFER_SIZE, i++) {
+        while (CDC_tx_pending() >= depth) USB_model_advance_us(USB_MODEL_SLOT_US);
+        uint8_t* buffer = buffers[i % depth];
+        for (uint32_t j = 0; j < SIM_BUFFER_SIZE; j++) buffer[j] = pattern(offset + done + j);
+        USB_model_advance_us(SIM_FILL_US_PER_KB * SIM_BUFFER_SIZE / 1024U);
+
+        if (CDC_transmit(buffer, SIM_BUFFER_SIZE) != HAL_OK) return 0.0;
+        if (stats->last_bulk_in_buffer != buffer && CDC_tx_pending() == 1U) return 0.0;
+    }
+    wait_sent();
+    return (double)total * 1000.0 / (stats->time_us - start);
+}
+
+static void stream_test(void) {
+    printf("streaming\n");
+    if (!start_device()) {
+        check(0, "enumeration failed");
+        return;
+    }
+    USB_Model_Stats* stats = USB_model_get_stats();
+
+    uint64_t packets = stats->bulk_in_packets;
+    double stream = stream_run(0, SIM_STREAM_BYTES, CDC_TX_QUEUE_SIZE);
+    check(stream > 0.0, "stream failed (or a buffer was copied)");
+    USB_model_advance_us(1000.0);
+    check(received_len_is(SIM_STREAM_BYTES) && received_matches(0, SIM_STREAM_BYTES), "stream: host got %u bytes",
+          USB_model_received_len());
+    check(stats->bulk_in_packets - packets == SIM_STREAM_BYTES / 64U + 1U, "stream: %u packets",
+          (uint32_t)(stats->bulk_in_packets - packets));
+
+    USB_model_clear_received();
+    double single = stream_run(0, SIM_STREAM_BYTES / 4U, 1U);
+    check(single > 0.0, "buffer at a time failed");
+    USB_model_advance_us(1000.0);
+    check(received_len_is(SIM_STREAM_BYTES / 4U) && received_matches(0, SIM_STREAM_BYTES / 4U), "buffer at a time data");
+
+    printf("  %u deep queue:     %7.1f kB/s\n", CDC_TX_QUEUE_SIZE, stream);
+    printf("  buffer at a time: %7.1f kB/s\n", single);
+    check(stream >= SIM_MIN_STREAM_KBPS, "stream only %.1f kB/s", stream);
+    check(stream > single * 1.3, "streaming barely beats buffer at a time (%.1f vs %.1f kB/s)", stream, single);
+    check_no_violations("streaming");
+}
+
+static void write_test(void) {
+    printf("CDC_write\n");
+    if (!start_device()) {
+        check(0, "enumeration failed");
+        return;
+    }
+    USB_Model_Stats* stats = USB_model_get_stats();
+    static const char hello[] = "hello\r\n";
+
+    check(CDC_write(hello, sizeof(hello) - 1U) == (int)sizeof(hello) - 1, "write failed");
+    USB_model_advance_us(1000.0);
+    check(received_len_is(sizeof(hello) - 1U) && memcmp(USB_model_received(), hello, sizeof(hello) - 1U) == 0, "wrong data");
+
+    // Port closed: dropped straight away, nothing on the bus
+    uint64_t packets = stats->bulk_in_packets;
+    double start = stats->time_us;
+    check(set_line_state(0) == HAL_OK, "DTR clear failed");
+    check(CDC_write(hello, sizeof(hello) - 1U) == 0, "write with the port closed not dropped");
+    USB_model_advance_us(2000.0);
+    check(stats->bulk_in_packets == packets && stats->time_us - start < 2100.0, "write with the port closed went out");
+
+    // Host stops reading: times out, the transfer is taken back, the next write goes out whole
+    check(set_line_state(1) == HAL_OK, "DTR set failed");
+    USB_model_clear_received();
+    USB_model_host_reading(0);
+    check(CDC_write(hello, sizeof(hello) - 1U) == -1, "write with no reader didn't time out");
+    check(CDC_tx_pending() == 0, "timed out write still queued");
+    USB_model_host_reading(1);
+    check(CDC_write(hello, sizeof(hello) - 1U) == (int)sizeof(hello) - 1, "write after a timeout failed");
+    USB_model_advance_us(1000.0);
+    check(received_len_is(sizeof(hello) - 1U), "after a timeout the host got %u bytes", USB_model_received_len());
+
+    // Times out behind a zero-copy buffer: only the write leaves the queue, the buffer still goes out whole
+    static uint8_t queued[200];
+    for (uint32_t i = 0; i < sizeof(queued); i++) queued[i] = pattern(i);
+    USB_model_clear_received();
+    USB_model_host_reading(0);
+    check(CDC_transmit(queued, sizeof(queued)) == HAL_OK, "transmit failed");
+    check(CDC_write(hello, sizeof(hello) - 1U) == -1, "write behind a stalled buffer didn't time out");
+    check(CDC_tx_pending() == 1, "%u buffers pending after the write timed out, not the transmitted one",
+          CDC_tx_pending());
+    USB_model_host_reading(1);
+    wait_sent();
+    USB_model_advance_us(1000.0);
+    check(received_len_is(sizeof(queued)) && received_matches(0, sizeof(queued)),
+          "transmitted buffer lost to the timed out write, host got %u bytes", USB_model_received_len());
+
+    // Bus reset while waiting
+    USB_model_host_reading(0);
+    USB_model_schedule_reset(stats->time_us + 5000.0);
+    check(CDC_write(hello, sizeof(hello) - 1U) == -1, "write across a bus reset reported success");
+    check(!CDC_is_configured() && CDC_write(hello, sizeof(hello) - 1U) == 0, "still configured after a reset");
+    USB_model_host_reading(1);
+    check(enumerate() && CDC_write(hello, sizeof(hello) - 1U) == (int)sizeof(hello) - 1, "write after re-enumerating failed");
+    check_no_violations("CDC_write");
+}
+
+static void read_test(void) {
+    printf("bulk OUT\n");
+    if (!start_device()) {
+        check(0, "enumeration failed");
+        return;
+    }
+    uint8_t sent[1000], got[1000];
+    for (uint32_t i = 0; i < sizeof(sent); i++) sent[i] = pattern(i * 3U);
+    uint8_t empty = 1;
+    for (uint32_t i = 0; i < 10U; i++) empty &= CDC_read(got, sizeof(got)) == 0;
+    check(empty, "data before the host sent any");
+
+    // Read in odd sized pieces while the host sends, the endpoint only takes more once a packet's been read
+    USB_model_host_send(sent, sizeof(sent));
+    uint32_t total = 0;
+    for (uint32_t i = 0; i < 10000U && total < sizeof(got); i++) {
+        total += CDC_read(got + total, (sizeof(got) - total < 37U) ? sizeof(got) - total : 37U);
+        USB_model_advance_us(USB_MODEL_SLOT_US);
+    }
+    check(total == sizeof(sent) && memcmp(got, sent, sizeof(sent)) == 0, "read %u of %u bytes", total, (uint32_t)sizeof(sent));
+    check(USB_model_get_stats()->bulk_out_packets == (sizeof(sent) + 63U) / 64U, "%u OUT packets",
+          (uint32_t)USB_model_get_stats()->bulk_out_packets);
+    check_no_violations("bulk OUT");
+}
+
+static void reset_test(void) {
+    printf("bus reset mid-stream\n");
+    if (!start_device()) {
+        check(0, "enumeration failed");
+        return;
+    }
+    for (uint32_t i = 0; i < CDC_TX_QUEUE_SIZE; i++) {
+        check(CDC_transmit(buffers[i], SIM_BUFFER_SIZE) == HAL_OK, "queueing buffer %u failed", i);
+    }
+    USB_model_advance_us(5000.0);
+    USB_model_bus_reset();
+    check(CDC_tx_pending() == 0 && !CDC_is_configured(), "queue kept across a reset");
+    check(CDC_transmit(buffers[0], SIM_BUFFER_SIZE) == HAL_ERROR, "transmit accepted before configuration");
+
+    USB_model_clear_received();
+    check(enumerate(), "enumeration after a reset failed");
+    check(stream_run(0, 64U * 1024U, CDC_TX_QUEUE_SIZE) > 0.0, "stream after a reset failed");
+    USB_model_advance_us(1000.0);
+    check(received_len_is(64U * 1024U) && received_matches(0, 64U * 1024U), "stream after a reset: host got %u bytes",
+          USB_model_received_len());
+    check_no_violations("bus reset mid-stream");
+}
+
+// HELPER FUNCTIONS ==============================================================
+static uint8_t pattern(uint32_t offset) {
+    return (uint8_t)((offset * 31U) ^ (offset >> 8));
+}
+
+static uint8_t received_matches(uint32_t offset, uint32_t len) {
+    const uint8_t* data = USB_model_received();
+    for (uint32_t i = 0; i < len; i++) {
+        if (data[i] != pattern(offset + i)) return 0;
+    }
+    return 1;
+}
+
+static uint8_t received_len_is(uint32_t len) {
+    return USB_model_received_len() == len;
+}
+
+static uint8_t start_device(void) {
+    USB_Model_Config config;
+    USB_model_default_config(&config);
+    USB_model_init(&config);
+    if (CDC_init(USB_model_ops()) != HAL_OK) return 0;
+    return enumerate();
+}
+
+/**
+ * Windows' order: reset, 64 byte device descriptor read, reset, address, then the full reads.
+ * A terminal program opening the port adds the line coding and DTR
+ */
+static uint8_t enumerate(void) {
+    uint32_t actual;
+    USB_model_bus_reset();
+    if (get_descriptor(0x01U, 0, 64, &actual) != HAL_OK || actual != 18) return 0;
+    USB_model_bus_reset();
+    if (USB_model_control(0x00U, 0x05U, 7, 0, NULL, 0, NULL) != HAL_OK) return 0;
+    if (get_descriptor(0x01U, 0, 18, &actual) != HAL_OK) return 0;
+    if (get_descriptor(0x02U, 0, 9, &actual) != HAL_OK) return 0;
+    if (get_descriptor(0x02U, 0, 255, &actual) != HAL_OK) return 0;
+    if (get_descriptor(0x03U, 0, 255, &actual) != HAL_OK) return 0;
+    if (get_descriptor(0x03U, 2, 255, &actual) != HAL_OK) return 0;
+    if (CDC_is_configured()) return 0;
+    if (USB_model_control(0x00U, 0x09U, 1, 0, NULL, 0, NULL) != HAL_OK) return 0;
+
+    uint8_t coding[7] = {0x00, 0xC2, 0x01, 0x00, 0, 0, 8};
+    if (USB_model_control(REQ_CLASS_INTERFACE, 0x20U, 0, 0, coding, 7, NULL) != HAL_OK) return 0;
+    return set_line_state(0x03U) == HAL_OK && CDC_is_open();
+}
+
+static HAL_Status get_descriptor(uint8_t type, uint8_t index, uint16_t length, uint32_t* actual) {
+    return USB_model_control(REQ_IN, 0x06U, (uint16_t)((type << 8) | index), (type == 0x03U && index) ? 0x0409U : 0,
+                             control, length, actual);
+}
+
+static HAL_Status set_line_state(uint16_t state) {
+    return USB_model_control(REQ_CLASS_INTERFACE, 0x22U, state, 0, NULL, 0, NULL);
+}
+
+/**
+ * Until everything queued is off the queue (the ZLP may still follow)
+ */
+static void wait_sent(void) {
+    for (uint32_t i = 0; i < 1000000U && CDC_tx_pending(); i++) USB_model_advance_us(USB_MODEL_SLOT_US);
+}
+
+static void check_no_violations(const char* test) {
+    USB_Model_Stats* stats = USB_model_get_stats();
+    check(stats->violations == 0, "%s: %u protocol violations, first: %s", test, stats->violations, stats->first_violation);
+}
+
+static void check(uint8_t condition, const char* format, ...) {
+    if (condition) return;
+    if (failures < 10U) {
+        va_list args;
+        va_start(args, format);
+        printf("FAILED: ");
+        vprintf(format, args);
+        printf("\n");
+        va_end(args);
+    }
+    failures++;
+}